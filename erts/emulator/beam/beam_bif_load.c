@@ -1526,6 +1526,38 @@ complete_literal_area_switch(void *literal_area)
 }
 #endif
 
+/*
+ * Hand over a literal area to the literal area collector. The area
+ * is released when no process refers to it any more. c_p is either
+ * the calling process (with the main lock held) or NULL.
+ */
+void
+erts_queue_release_literals(Process *c_p, ErtsLiteralArea *literals)
+{
+    ErtsLiteralAreaRef *ref;
+
+    ref = erts_alloc(ERTS_ALC_T_LITERAL_REF, sizeof(ErtsLiteralAreaRef));
+    ref->literal_area = literals;
+    ref->next = NULL;
+
+    erts_smp_mtx_lock(&release_literal_areas.mtx);
+    if (release_literal_areas.last) {
+	release_literal_areas.last->next = ref;
+	release_literal_areas.last = ref;
+    }
+    else {
+	release_literal_areas.first = ref;
+	release_literal_areas.last = ref;
+    }
+    erts_smp_mtx_unlock(&release_literal_areas.mtx);
+
+    erts_queue_message(erts_literal_area_collector,
+		       0,
+		       erts_alloc_message(0, NULL),
+		       am_copy_literals,
+		       c_p ? c_p->common.id : am_system);
+}
+
 #endif /* ERTS_NEW_PURGE_STRATEGY */
 
 BIF_RETTYPE erts_internal_release_literal_area_switch_0(BIF_ALIST_0)
@@ -1932,28 +1964,8 @@ BIF_RETTYPE erts_internal_purge_module_2(BIF_ALIST_2)
 
 #else /* ERTS_NEW_PURGE_STRATEGY */
 
-	if (literals) {
-	    ErtsLiteralAreaRef *ref;
-	    ref = erts_alloc(ERTS_ALC_T_LITERAL_REF,
-			     sizeof(ErtsLiteralAreaRef));
-	    ref->literal_area = literals;
-	    ref->next = NULL;
-	    erts_smp_mtx_lock(&release_literal_areas.mtx);
-	    if (release_literal_areas.last) {
-		release_literal_areas.last->next = ref;
-		release_literal_areas.last = ref;
-	    }
-	    else {
-		release_literal_areas.first = ref;
-		release_literal_areas.last = ref;
-	    }
-	    erts_smp_mtx_unlock(&release_literal_areas.mtx);
-	    erts_queue_message(erts_literal_area_collector,
-			       0,
-			       erts_alloc_message(0, NULL),
-			       am_copy_literals,
-			       BIF_P->common.id);
-	}
+	if (literals)
+	    erts_queue_release_literals(BIF_P, literals);
 
 #endif /* ERTS_NEW_PURGE_STRATEGY */
 
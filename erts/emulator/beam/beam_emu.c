@@ -374,6 +374,18 @@ void** beam_ops;
 
 
 
+/*
+ * Let c_p->i point into the current function before an instruction
+ * allocates an off-heap binary. The allocation profiler (see
+ * erl_alloc_util.c) finds the allocation site through c_p->current or
+ * c_p->i, and neither is kept up to date while the process is running.
+ */
+#define SET_ALLOC_SITE()			\
+  do {						\
+    c_p->i = I;					\
+    c_p->current = NULL;			\
+  } while (0)
+
 /*
  * Check if Nh words of heap are available; if not, do a garbage collection.
  * Live is number of active argument registers to be preserved.
@@ -1282,6 +1294,7 @@ void process_main(void)
 #endif
 
     Eterm pt_arity;		/* Used by do_put_tuple */
+    Eterm recv_ref;		/* Used by do_recv_ref */
 
     Uint64 start_time = 0;          /* Monitor long schedule */
     BeamInstr* start_time_i = NULL;
@@ -1839,6 +1852,7 @@ void process_main(void)
   *             call make_ref/monitor            Optional
   *             ...
   *             recv_set L1                      Optional
+  *             recv_ref Ref                     Optional
   *      L1:          <-------------------+
   *                   <-----------+       |
   *     	     	       	  |   	  |
@@ -1868,6 +1882,29 @@ void process_main(void)
      Next(1);
  }
 
+ OpCase(i_recv_ref_y): {
+     recv_ref = yb(Arg(0));
+     goto do_recv_ref;
+ }
+
+ OpCase(i_recv_ref_x): {
+     recv_ref = xb(Arg(0));
+
+ do_recv_ref:
+     /*
+      * The following receive can only match out messages that
+      * contain the reference in recv_ref as first or second element
+      * of a tuple. Use the reference index of the message queue to
+      * skip messages that cannot possibly be matched out.
+      */
+     if (is_internal_ref(recv_ref)) {
+	 ErtsMessage **save = erts_msgq_ref_ix_lookup(&c_p->msg, recv_ref);
+	 if (save)
+	     c_p->msg.save = save;
+     }
+     Next(1);
+ }
+
  OpCase(i_recv_set): {
      /*
       * If the mark is valid (points to the loop_rec/2
@@ -1931,8 +1968,20 @@ void process_main(void)
 	 }
      }
      if (is_non_value(ERL_MESSAGE_TERM(msgp))) {
+	 Sint decode_reds = FCALLS - neg_o_reds;
+	 int decoded;
 	 SWAPOUT; /* erts_decode_dist_message() may write to heap... */
-	 if (!erts_decode_dist_message(c_p, ERTS_PROC_LOCK_MAIN, msgp, 0)) {
+	 decoded = erts_decode_dist_message_yielding(c_p, msgp, &decode_reds);
+	 FCALLS = neg_o_reds + decode_reds;
+	 if (decoded < 0) {
+	     /* Large message partly decoded; continue when rescheduled */
+	     c_p->flags &= ~F_DELAY_GC;
+	     c_p->i = I;
+	     c_p->arity = 0;
+	     c_p->current = NULL;
+	     goto do_schedule;
+	 }
+	 if (!decoded) {
 	     /*
 	      * A corrupt distribution message that we weren't able to decode;
 	      * remove it...
@@ -2166,8 +2215,7 @@ void process_main(void)
 	     c_p->arity = 0;
 
 	     if (!ERTS_PTMR_IS_TIMED_OUT(c_p))
-		 erts_smp_atomic32_read_band_relb(&c_p->state,
-						  ~ERTS_PSFLG_ACTIVE);
+		 erts_proc_wait_deactivate(c_p);
 	     ASSERT(!ERTS_PROC_IS_EXITING(c_p));
 	     erts_smp_proc_unlock(c_p, ERTS_PROC_LOCKS_MSG_RECEIVE);
 	     c_p->current = NULL;
@@ -3854,6 +3902,7 @@ do {						\
 	 /*
 	  * Allocate the binary struct itself.
 	  */
+	 SET_ALLOC_SITE();
 	 bptr = erts_bin_nrml_alloc(num_bytes);
 	 erts_refc_init(&bptr->refc, 1);
 	 erts_current_bin = (byte *) bptr->orig_bytes;
@@ -3949,6 +3998,7 @@ do {						\
 	 /*
 	  * Allocate the binary struct itself.
 	  */
+	 SET_ALLOC_SITE();
 	 bptr = erts_bin_nrml_alloc(BsOp1);
 	 erts_refc_init(&bptr->refc, 1);
 	 erts_current_bin = (byte *) bptr->orig_bytes;
@@ -4109,6 +4159,7 @@ do {						\
      GetArg1(4, Size);
      HEAVY_SWAPOUT;
      reg[live] = x(SCRATCH_X_REG);
+     SET_ALLOC_SITE();
      res = erts_bs_append(c_p, reg, live, Size, Arg(1), Arg(3));
      HEAVY_SWAPIN;
      if (is_non_value(res)) {
@@ -4126,6 +4177,7 @@ do {						\
      Eterm Size, Src;
 
      GetArg2(2, Size, Src);
+     SET_ALLOC_SITE();
      res = erts_bs_private_append(c_p, Src, Size, Arg(1));
      if (is_non_value(res)) {
 	 /* c_p->freason is already set (may be either BADARG or SYSTEM_LIMIT). */
@@ -4136,6 +4188,7 @@ do {						\
 
  OpCase(bs_init_writable): {
      HEAVY_SWAPOUT;
+     SET_ALLOC_SITE();
      r(0) = erts_bs_init_writable(c_p, r(0));
      HEAVY_SWAPIN;
      Next(0);
@@ -6448,7 +6501,7 @@ erts_hibernate(Process* c_p, Eterm module, Eterm function, Eterm args, Eterm* re
         ERTS_SMP_MSGQ_MV_INQ2PRIVQ(c_p);
 	if (!c_p->msg.len)
 #endif
-	    erts_smp_atomic32_read_band_relb(&c_p->state, ~ERTS_PSFLG_ACTIVE);
+	    erts_proc_wait_deactivate(c_p);
 	ASSERT(!ERTS_PROC_IS_EXITING(c_p));
     }
     erts_smp_proc_unlock(c_p, ERTS_PROC_LOCK_MSGQ|ERTS_PROC_LOCK_STATUS);
@@ -1889,6 +1889,12 @@ BIF_RETTYPE process_flag_2(BIF_ALIST_2)
 	   goto error;
        BIF_RET(old_value);
    }
+   else if (BIF_ARG_1 == am_message_queue_limit) {
+       old_value = erts_change_message_queue_limit(BIF_P, BIF_ARG_2);
+       if (is_non_value(old_value))
+	   goto error;
+       BIF_RET(old_value);
+   }
    else if (BIF_ARG_1 == am_sensitive) {
        Uint is_sensitive;
        if (BIF_ARG_2 == am_true) {
@@ -2306,15 +2312,28 @@ do_send(Process *p, Eterm to, Eterm msg, Eterm *refp, ErtsSendContext* ctx)
 	    rp_locks |= ERTS_PROC_LOCK_MAIN;
 #endif
 	/* send to local process */
-	res = erts_send_message(p, rp, &rp_locks, msg, 0);
-	if (erts_use_sender_punish)
-	    res *= 4;
-	else
-	    res = 0;
+	res = erts_send_message(p, rp, &rp_locks, msg,
+				ERTS_SND_FLG_MSGQ_LIMIT);
 	erts_smp_proc_unlock(rp,
 			     p == rp
 			     ? (rp_locks & ~ERTS_PROC_LOCK_MAIN)
 			     : rp_locks);
+	if (res < 0) {
+	    /*
+	     * Message queue limit of receiver reached. The message
+	     * has been sent, but we may have to be suspended. A
+	     * nosuspend sender is not, and the send has succeeded...
+	     */
+	    if (res == ERTS_MSGQ_LIMIT_RES_SUSPEND && !ctx->suspend)
+		return 0;
+	    if (erts_msgq_limit_exceeded(p, rp, res))
+		return SEND_YIELD_RETURN;
+	    return 0;
+	}
+	if (erts_use_sender_punish)
+	    res *= 4;
+	else
+	    res = 0;
 	return res;
     }
 }
@@ -4598,6 +4617,12 @@ BIF_RETTYPE system_flag_2(BIF_ALIST_2)
 		      ref,
 		      old ? am_true : am_false);
 	}
+    } else if (BIF_ARG_1 == am_alloc_profile) {
+	Uint old;
+	if (!is_small(BIF_ARG_2) || signed_val(BIF_ARG_2) < 0)
+	    goto error;
+	old = erts_alcu_set_alloc_profile((Uint) signed_val(BIF_ARG_2));
+	BIF_RET(make_small(old));
 #if defined(ERTS_SMP) && defined(ERTS_DIRTY_SCHEDULERS)
     } else if (BIF_ARG_1 == am_dirty_cpu_schedulers_online) {
 	Sint old_no;
@@ -280,9 +280,9 @@ do {                                                                    \
 #define COUNT_OFF_HEAP (0)
 
 #define IN_LITERAL_PURGE_AREA(info, ptr)                 \
-    ((info)->range_ptr && (                              \
+    ((info)->copy_literals || ((info)->range_ptr && (    \
         (info)->range_ptr <= (ptr) &&                    \
-        (ptr) < ((info)->range_ptr + (info)->range_sz)))
+        (ptr) < ((info)->range_ptr + (info)->range_sz))))
 /*
  *  Return the real size of an object and find sharing information
  *  This currently returns the same as erts_debug:size/1.
@@ -1758,6 +1758,146 @@ all_clean:
     return result;
 }
 
+/*
+ * Cheap check for sharing before deciding how to copy a term.
+ *
+ * Visits at most ERTS_SHCOPY_PROBE_NODES of the compound subterms of
+ * obj, breadth first, remembering their addresses in a small hash
+ * table on the C stack. Returns non-zero if one of them is reached
+ * twice. Tree shaped terms, which is what almost all messages are,
+ * are thus rejected after a bounded amount of work, while the
+ * typical shared structures (the same subterm in several elements of
+ * a tuple or list, or a chain of {T,T} nodes) are found within the
+ * first few nodes. Binaries and other leaves are recorded but not
+ * descended into.
+ */
+
+#define ERTS_SHCOPY_PROBE_NODES 64
+#define ERTS_SHCOPY_PROBE_SLOTS (2*ERTS_SHCOPY_PROBE_NODES)
+
+int erts_shcopy_probe(Eterm obj)
+{
+    Eterm *seen[ERTS_SHCOPY_PROBE_SLOTS];
+    Eterm queue[ERTS_SHCOPY_PROBE_NODES];
+    Uint qhead = 0, qtail = 0, nodes = 0;
+
+#define PROBE_ENQUEUE(T)                                \
+    do {                                                \
+        Eterm t__ = (T);                                \
+        if (!IS_CONST(t__) && qtail < ERTS_SHCOPY_PROBE_NODES) \
+            queue[qtail++] = t__;                       \
+    } while (0)
+
+    if (IS_CONST(obj))
+        return 0;
+
+    sys_memzero(seen, sizeof(seen));
+    queue[qtail++] = obj;
+
+    while (qhead < qtail) {
+        Eterm *ptr;
+        Uint ix;
+
+        obj = queue[qhead++];
+        ptr = is_list(obj) ? list_val(obj) : boxed_val(obj);
+        if (erts_is_literal(obj, ptr))
+            continue;
+
+        ix = ((UWord) ptr / sizeof(Eterm)) & (ERTS_SHCOPY_PROBE_SLOTS - 1);
+        while (seen[ix]) {
+            if (seen[ix] == ptr)
+                return 1;
+            ix = (ix + 1) & (ERTS_SHCOPY_PROBE_SLOTS - 1);
+        }
+        seen[ix] = ptr;
+        if (++nodes == ERTS_SHCOPY_PROBE_NODES)
+            return 0;
+
+        if (is_list(obj)) {
+            PROBE_ENQUEUE(CAR(ptr));
+            PROBE_ENQUEUE(CDR(ptr));
+        }
+        else {
+            Eterm hdr = *ptr;
+            Uint i, n;
+
+            switch (hdr & _TAG_HEADER_MASK) {
+            case ARITYVAL_SUBTAG:
+                n = arityval(hdr);
+                for (i = 1; i <= n; i++)
+                    PROBE_ENQUEUE(ptr[i]);
+                break;
+            case MAP_SUBTAG:
+                switch (MAP_HEADER_TYPE(hdr)) {
+                case MAP_HEADER_TAG_FLATMAP_HEAD:
+                    /* keys tuple followed by the values */
+                    n = flatmap_get_size((flatmap_t *) ptr) + 1;
+                    for (i = 0; i < n; i++)
+                        PROBE_ENQUEUE(ptr[2 + i]);
+                    break;
+                default:
+                    n = hashmap_bitcount(MAP_HEADER_VAL(hdr));
+                    ptr += 1 + header_arity(hdr);
+                    for (i = 0; i < n; i++)
+                        PROBE_ENQUEUE(ptr[i]);
+                    break;
+                }
+                break;
+            case FUN_SUBTAG:
+                /* the environment follows the creator */
+                n = ((ErlFunThing *) ptr)->num_free;
+                ptr += 1 + thing_arityval(hdr) + 1;
+                for (i = 0; i < n; i++)
+                    PROBE_ENQUEUE(ptr[i]);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return 0;
+
+#undef PROBE_ENQUEUE
+}
+
+/*
+ * Copy a term, preserving sharing if the term has any.
+ *
+ * erts_copy_calculate() returns the number of words needed and
+ * erts_copy_perform() then makes the copy. A sharing-preserving copy
+ * is only made if erts_shcopy_probe() finds shared subterms, or
+ * always in an emulator configured with --enable-sharing-preserving;
+ * otherwise this is size_object() and copy_struct(). As with
+ * copy_shared_calculate(), the heap of obj must not be touched
+ * between the two calls, and DESTROY_SHCOPY() must be called after
+ * the copy has been made.
+ */
+Uint erts_copy_calculate(Eterm obj, erts_shcopy_t *info)
+{
+    if (IS_CONST(obj)) {
+        info->shared = 0;
+        return 0;
+    }
+#ifndef SHCOPY
+    if (!erts_shcopy_probe(obj)) {
+        info->shared = 0;
+        return size_object(obj);
+    }
+#endif
+    info->shared = 1;
+    return copy_shared_calculate(obj, info);
+}
+
+Eterm erts_copy_perform(Eterm obj, Uint size, erts_shcopy_t *info,
+                        Eterm **hpp, ErlOffHeap *off_heap)
+{
+    if (IS_CONST(obj))
+        return obj;
+    if (info->shared)
+        return copy_shared_perform(obj, size, info, hpp, off_heap);
+    return copy_struct(obj, size, hpp, off_heap);
+}
+
 
 /*
  * Copy a term that is guaranteed to be contained in a single
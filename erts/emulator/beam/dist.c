@@ -43,6 +43,7 @@
 #include "external.h"
 #include "erl_binary.h"
 #include "erl_thr_progress.h"
+#include "erl_zlib.h"
 #include "dtrace-wrapper.h"
 
 #define DIST_CTL_DEFAULT_SIZE 64
@@ -74,7 +75,13 @@ dist_msg_dbg(ErtsDistExternal *edep, char *what, byte *buf, int sz)
     byte *extp = edep->extp;
     Eterm msg;
     Sint ctl_len;
-    Sint size = ctl_len = erts_decode_dist_ext_size(edep);
+    Sint size;
+    if (extp < edep->ext_endp && *extp == COMPRESSED) {
+	/* Uncompressed by the receiver */
+	erts_fprintf(stderr, "    %s: <compressed>\n", what);
+	return;
+    }
+    size = ctl_len = erts_decode_dist_ext_size(edep);
     if (size < 0) {
 	erts_fprintf(stderr,
 		     "DIST MSG DEBUG: erts_decode_dist_ext_size(%s) failed:\n",
@@ -106,6 +113,8 @@ dist_msg_dbg(ErtsDistExternal *edep, char *what, byte *buf, int sz)
 
 int erts_is_alive; /* System must be blocked on change */
 int erts_dist_buf_busy_limit;
+int erts_dist_compress_threshold;
+int erts_dist_bin_ref_threshold;
 
 
 /* distribution trap functions */
@@ -125,11 +134,16 @@ Export* dmonitor_p_trap = NULL;
 /* forward declarations */
 
 static void clear_dist_entry(DistEntry*);
-static int dsig_send_ctl(ErtsDSigData* dsdp, Eterm ctl, int force_busy);
+static void clear_dist_chnl(DistEntry*, ErtsDistChannel*);
+static void kill_dist_chnls(Eterm *, int, Eterm);
+static int dsig_send_ctl(ErtsDSigData* dsdp, Eterm ctl, Eterm sender,
+			 int force_busy);
+static int dsig_send_enqueue(ErtsDSigData *, struct erts_dsig_send_context *,
+			     ErtsDistOutputBuf *, int *);
 static void send_nodes_mon_msgs(Process *, Eterm, Eterm, Eterm, Eterm);
 static void init_nodes_monitors(void);
 
-static erts_smp_atomic_t no_caches;
+static erts_smp_atomic_t caches_size;
 static erts_smp_atomic_t no_nodes;
 
 struct {
@@ -138,54 +152,370 @@ struct {
 } nodedown;
 
 
+static ERTS_INLINE Uint
+cache_alloc_size(int size)
+{
+    return (sizeof(ErtsAtomCache)
+	    + size*(2*sizeof(Eterm) + sizeof(Uint64)));
+}
+
 static void
 delete_cache(ErtsAtomCache *cache)
 {
     if (cache) {
+	Uint size = cache_alloc_size(cache->size);
 	erts_free(ERTS_ALC_T_DCACHE, (void *) cache);
-	ASSERT(erts_smp_atomic_read_nob(&no_caches) > 0);
-	erts_smp_atomic_dec_nob(&no_caches);
+	ASSERT(erts_smp_atomic_read_nob(&caches_size) >= size);
+	erts_smp_atomic_add_nob(&caches_size, -((erts_aint_t) size));
     }
 }
 
 
 static void
-create_cache(DistEntry *dep)
+create_cache(ErtsDistChannel *chnl, Uint32 flags)
 {
-    int i;
+    int i, size;
+    Uint alloc_size;
     ErtsAtomCache *cp;
 
     ERTS_SMP_LC_ASSERT(
-	is_internal_port(dep->cid)
-	&& erts_lc_is_port_locked(erts_port_lookup_raw(dep->cid)));
-    ASSERT(!dep->cache);
-
-    dep->cache = cp = (ErtsAtomCache*) erts_alloc(ERTS_ALC_T_DCACHE,
-						  sizeof(ErtsAtomCache));
-    erts_smp_atomic_inc_nob(&no_caches);
-    for (i = 0; i < sizeof(cp->in_arr)/sizeof(cp->in_arr[0]); i++) {
+	is_internal_port(chnl->cid)
+	&& erts_lc_is_port_locked(erts_port_lookup_raw(chnl->cid)));
+    ASSERT(!chnl->cache);
+
+    size = ((flags & DFLAG_LARGE_ATOM_CACHE)
+	    ? ERTS_LARGE_ATOM_CACHE_SIZE
+	    : ERTS_ATOM_CACHE_SIZE);
+    alloc_size = cache_alloc_size(size);
+    chnl->cache = cp = (ErtsAtomCache*) erts_alloc(ERTS_ALC_T_DCACHE,
+						  alloc_size);
+    erts_smp_atomic_add_nob(&caches_size, (erts_aint_t) alloc_size);
+    cp->size = size;
+    cp->clock = 0;
+    cp->out_hits = 0;
+    cp->out_misses = 0;
+    cp->in_hits = 0;
+    cp->in_misses = 0;
+    cp->out_used = (Uint64 *) (((char *) cp) + sizeof(ErtsAtomCache));
+    cp->in_arr = (Eterm *) &cp->out_used[size];
+    cp->out_arr = &cp->in_arr[size];
+    for (i = 0; i < size; i++) {
 	cp->in_arr[i] = THE_NON_VALUE;
 	cp->out_arr[i] = THE_NON_VALUE;
+	cp->out_used[i] = 0;
     }
 }
 
 Uint erts_dist_cache_size(void)
 {
-    return (Uint) erts_smp_atomic_read_mb(&no_caches)*sizeof(ErtsAtomCache);
+    return (Uint) erts_smp_atomic_read_mb(&caches_size);
+}
+
+/*
+ * erlang:system_info({dist_stats, Node}). Returns the statistics of
+ * the current (or last) connection to Node, or undefined if there is
+ * no dist entry for Node. Neither the dist entry nor its channels
+ * are locked, so the counters are not read atomically as a whole.
+ */
+Eterm
+erts_dist_stats_info(Process *c_p, Eterm node)
+{
+    DistEntry *dep;
+    ErtsDistStats *stats;
+    Uint64 cnt[9], hcnt[ERTS_DIST_STAT_SIZE_BUCKETS];
+    Eterm hist[ERTS_DIST_STAT_SIZE_BUCKETS];
+    Eterm atoms[10], vals[10];
+    Uint sz = 0, *szp = &sz;
+    Eterm *hp, **hpp = NULL;
+    Eterm res;
+    Uint ix;
+    int i;
+
+    if (is_not_atom(node))
+	return THE_NON_VALUE;
+    dep = erts_find_dist_entry(node);
+    if (!dep)
+	return am_undefined;
+    if (dep == erts_this_dist_entry) {
+	erts_deref_dist_entry(dep);
+	return am_undefined;
+    }
+    stats = &dep->stats;
+    cnt[0] = (Uint64) erts_smp_atomic_read_nob(&stats->out_msgs);
+    cnt[1] = (Uint64) erts_smp_atomic_read_nob(&stats->out_bytes);
+    cnt[4] = 0;
+    for (i = 0; i < ERTS_DIST_MAX_CHANNELS; i++)
+	cnt[4] += (Uint64) erts_smp_atomic_read_nob(&dep->chnl[i].qsize);
+    cnt[6] = (Uint64) erts_smp_atomic_read_nob(&stats->busy_count);
+    cnt[7] = (Uint64) erts_smp_atomic64_read_nob(&stats->busy_time);
+    cnt[2] = cnt[3] = cnt[5] = cnt[8] = 0;
+    for (i = 0; i < ERTS_DIST_STAT_SIZE_BUCKETS; i++)
+	hcnt[i] = 0;
+    for (ix = 0; ix <= erts_no_schedulers; ix++) {
+	ErtsDistSchedStats *sst = &stats->sched[ix].s;
+	Uint64 max_queue = (Uint64) erts_smp_atomic_read_nob(&sst->max_queue);
+	cnt[2] += (Uint64) erts_smp_atomic_read_nob(&sst->in_msgs);
+	cnt[3] += (Uint64) erts_smp_atomic_read_nob(&sst->in_bytes);
+	if (max_queue > cnt[5])
+	    cnt[5] = max_queue;
+	cnt[8] += (Uint64) erts_smp_atomic64_read_nob(&sst->encode_time);
+	for (i = 0; i < ERTS_DIST_STAT_SIZE_BUCKETS; i++)
+	    hcnt[i] += (Uint64) erts_smp_atomic_read_nob(&sst->size_hist[i]);
+    }
+    erts_deref_dist_entry(dep);
+
+    atoms[0] = am_atom_put("out_msgs", 8);
+    atoms[1] = am_atom_put("out_bytes", 9);
+    atoms[2] = am_atom_put("in_msgs", 7);
+    atoms[3] = am_atom_put("in_bytes", 8);
+    atoms[4] = am_atom_put("queue", 5);
+    atoms[5] = am_atom_put("max_queue", 9);
+    atoms[6] = am_atom_put("busy_count", 10);
+    atoms[7] = am_atom_put("busy_time", 9);
+    atoms[8] = am_atom_put("encode_time", 11);
+    atoms[9] = am_atom_put("size_histogram", 14);
+
+    while (1) {
+	for (i = 0; i < 9; i++)
+	    vals[i] = erts_bld_uint64(hpp, szp, cnt[i]);
+	for (i = 0; i < ERTS_DIST_STAT_SIZE_BUCKETS; i++)
+	    hist[i] = erts_bld_uint64(hpp, szp, hcnt[i]);
+	vals[9] = erts_bld_list(hpp, szp, ERTS_DIST_STAT_SIZE_BUCKETS, hist);
+	res = erts_bld_2tup_list(hpp, szp, 10, atoms, vals);
+	if (hpp)
+	    break;
+	hp = HAlloc(c_p, sz);
+	hpp = &hp;
+	szp = NULL;
+    }
+
+    return res;
+}
+
+/*
+ * erlang:system_info({dist_atom_cache, Node}). Returns the atom cache
+ * size and hit/miss counters of the connection to Node, summed over
+ * its channels, or undefined if Node isn't connected or doesn't use
+ * the atom cache.
+ */
+Eterm
+erts_dist_atom_cache_info(Process *c_p, Eterm node)
+{
+    DistEntry *dep;
+    Eterm atoms[5];
+    UWord vals[5];
+    int ix;
+    Uint hsz;
+    Eterm *hp;
+
+    if (is_not_atom(node))
+	return THE_NON_VALUE;
+    dep = erts_sysname_to_connected_dist_entry(node);
+    if (!dep)
+	return am_undefined;
+    if (dep == erts_this_dist_entry) {
+	erts_deref_dist_entry(dep);
+	return am_undefined;
+    }
+    sys_memzero((void *) vals, sizeof(vals));
+    erts_smp_de_rlock(dep);
+    if (ERTS_DE_IS_CONNECTED(dep)) {
+	for (ix = 0; ix < dep->no_chnls; ix++) {
+	    ErtsAtomCache *cache = dep->chnl[ix].cache;
+	    if (cache) {
+		vals[0] = (UWord) cache->size;
+		vals[1] += (UWord) cache->out_hits;
+		vals[2] += (UWord) cache->out_misses;
+		vals[3] += (UWord) cache->in_hits;
+		vals[4] += (UWord) cache->in_misses;
+	    }
+	}
+    }
+    erts_smp_de_runlock(dep);
+    erts_deref_dist_entry(dep);
+
+    if (!vals[0])
+	return am_undefined;
+
+    atoms[0] = am_size;
+    atoms[1] = am_atom_put("out_hits", 8);
+    atoms[2] = am_atom_put("out_misses", 10);
+    atoms[3] = am_atom_put("in_hits", 7);
+    atoms[4] = am_atom_put("in_misses", 9);
+    hsz = 0;
+    erts_bld_atom_uword_2tup_list(NULL, &hsz, 5, atoms, vals);
+    hp = HAlloc(c_p, hsz);
+    return erts_bld_atom_uword_2tup_list(&hp, NULL, 5, atoms, vals);
+}
+
+/*
+ * Move the buffers that senders have pushed on in_queue to the end
+ * of out_queue, in the order they were enqueued.
+ */
+static void
+fetch_in_queue(ErtsDistChannel *chnl)
+{
+    ErtsDistOutputBuf *obuf, *first = NULL, *last;
+
+    ERTS_SMP_LC_ASSERT(erts_smp_lc_mtx_is_locked(&chnl->qlock));
+
+    obuf = (ErtsDistOutputBuf *) erts_smp_atomic_xchg_mb(&chnl->in_queue,
+							 (erts_aint_t) NULL);
+    if (!obuf)
+	return;
+
+    last = obuf;
+    while (obuf) {
+	ErtsDistOutputBuf *next = obuf->next;
+	obuf->next = first;
+	first = obuf;
+	obuf = next;
+    }
+
+    if (chnl->out_queue.last)
+	chnl->out_queue.last->next = first;
+    else
+	chnl->out_queue.first = first;
+    chnl->out_queue.last = last;
+}
+
+static ERTS_INLINE void
+dec_qsize(ErtsDistChannel *chnl, Sint size)
+{
+    ERTS_SMP_LC_ASSERT(erts_smp_lc_mtx_is_locked(&chnl->qlock));
+#ifdef DEBUG
+    {
+	erts_aint_t qsize;
+	qsize = erts_smp_atomic_add_read_nob(&chnl->qsize, (erts_aint_t) -size);
+	ASSERT(qsize >= 0);
+    }
+#else
+    erts_smp_atomic_add_nob(&chnl->qsize, (erts_aint_t) -size);
+#endif
+}
+
+/*
+ * Per scheduler statistics, see ErtsDistStats. A scheduler is the only
+ * writer of its slot and can update it without atomic read-modify-write
+ * operations; other threads share slot 0.
+ */
+static ERTS_INLINE ErtsDistSchedStats *
+dist_sched_stats(DistEntry *dep, int *sharedp)
+{
+    ErtsSchedulerData *esdp = erts_get_scheduler_data();
+    if (!esdp || ERTS_SCHEDULER_IS_DIRTY(esdp)) {
+	*sharedp = 1;
+	return &dep->stats.sched[0].s;
+    }
+    ASSERT(0 < esdp->no && esdp->no <= erts_no_schedulers);
+    *sharedp = 0;
+    return &dep->stats.sched[esdp->no].s;
+}
+
+static ERTS_INLINE erts_aint_t
+dist_stat_add(erts_smp_atomic_t *var, erts_aint_t val, int shared)
+{
+    erts_aint_t res;
+    if (shared)
+	return erts_smp_atomic_add_read_nob(var, val);
+    res = erts_smp_atomic_read_nob(var) + val;
+    erts_smp_atomic_set_nob(var, res);
+    return res;
+}
+
+static ERTS_INLINE void
+dist_stat_add64(erts_smp_atomic64_t *var, erts_aint64_t val, int shared)
+{
+    if (shared)
+	erts_smp_atomic64_add_nob(var, val);
+    else
+	erts_smp_atomic64_set_nob(var, erts_smp_atomic64_read_nob(var) + val);
+}
+
+static ERTS_INLINE void
+dist_stat_in(DistEntry *dep, Uint size)
+{
+    int shared;
+    ErtsDistSchedStats *sst = dist_sched_stats(dep, &shared);
+    dist_stat_add(&sst->in_msgs, 1, shared);
+    dist_stat_add(&sst->in_bytes, (erts_aint_t) size, shared);
+}
+
+static ERTS_INLINE void
+dist_stat_queue(DistEntry *dep, erts_aint_t qsize)
+{
+    int shared;
+    ErtsDistSchedStats *sst = dist_sched_stats(dep, &shared);
+    erts_aint_t max = erts_smp_atomic_read_nob(&sst->max_queue);
+    if (!shared) {
+	if (qsize > max)
+	    erts_smp_atomic_set_nob(&sst->max_queue, qsize);
+	return;
+    }
+    while (qsize > max) {
+	erts_aint_t act = erts_smp_atomic_cmpxchg_nob(&sst->max_queue,
+						      qsize, max);
+	if (act == max)
+	    break;
+	max = act;
+    }
+}
+
+static ERTS_INLINE void
+dist_stat_msg_size(DistEntry *dep, Uint size)
+{
+    int shared;
+    ErtsDistSchedStats *sst = dist_sched_stats(dep, &shared);
+    int ix = 0;
+    size >>= 6;
+    while (size && ix < ERTS_DIST_STAT_SIZE_BUCKETS-1) {
+	size >>= 1;
+	ix++;
+    }
+    dist_stat_add(&sst->size_hist[ix], 1, shared);
+}
+
+/*
+ * Only every ERTS_DIST_STAT_TIME_SAMPLE:th send is timed, to not read
+ * the clock twice per send; encode_time is an estimate made from
+ * them.
+ */
+#define ERTS_DIST_STAT_TIME_SAMPLE 16
+
+static ERTS_INLINE int
+dist_stat_time_sample(DistEntry *dep)
+{
+    int shared;
+    ErtsDistSchedStats *sst = dist_sched_stats(dep, &shared);
+    erts_aint_t sends = dist_stat_add(&sst->sends, 1, shared);
+    return sends % ERTS_DIST_STAT_TIME_SAMPLE == 0;
+}
+
+static ERTS_INLINE void
+dist_stat_encode_time(DistEntry *dep, ErtsMonotonicTime time)
+{
+    int shared;
+    ErtsDistSchedStats *sst = dist_sched_stats(dep, &shared);
+    dist_stat_add64(&sst->encode_time,
+		    (erts_aint64_t) (ERTS_MONOTONIC_TO_NSEC(time)
+				     * ERTS_DIST_STAT_TIME_SAMPLE),
+		    shared);
 }
 
 static ErtsProcList *
-get_suspended_on_de(DistEntry *dep, Uint32 unset_qflgs)
+get_suspended_on_de(ErtsDistChannel *chnl, Uint32 unset_qflgs)
 {
-    ERTS_SMP_LC_ASSERT(erts_smp_lc_mtx_is_locked(&dep->qlock));
-    dep->qflgs &= ~unset_qflgs;
-    if (dep->qflgs & ERTS_DE_QFLG_EXIT) {
+    erts_aint32_t qflgs;
+    ERTS_SMP_LC_ASSERT(erts_smp_lc_mtx_is_locked(&chnl->qlock));
+    qflgs = erts_smp_atomic32_read_band_nob(&chnl->qflgs,
+					    ~((erts_aint32_t) unset_qflgs));
+    if (qflgs & ~unset_qflgs & ERTS_DE_QFLG_EXIT) {
 	/* No resume when exit has been scheduled */
 	return NULL;
     }
     else {
-	ErtsProcList *suspended = dep->suspended;
-	dep->suspended = NULL;
+	ErtsProcList *suspended = chnl->suspended;
+	chnl->suspended = NULL;
 	erts_proclist_fetch(&suspended, NULL);
 	return suspended;
     }
@@ -450,7 +780,7 @@ inc_no_nodes(void)
 /*
  * proc is currently running or exiting process.
  */
-int erts_do_net_exits(DistEntry *dep, Eterm reason)
+int erts_do_net_exits(DistEntry *dep, ErtsDistChannel *chnl, Eterm reason)
 {
     Eterm nodename;
 
@@ -524,35 +854,51 @@ int erts_do_net_exits(DistEntry *dep, Eterm reason)
 					  &nodedown.bp->off_heap);
 	}
     }
+    else if (chnl != &dep->chnl[0]) { /* Call from extra channel port */
+	clear_dist_chnl(dep, chnl);
+	return 1;
+    }
     else { /* Call from distribution port */
 	NetExitsContext nec = {dep};
 	ErtsLink *nlinks;
 	ErtsLink *node_links;
 	ErtsMonitor *monitors;
 	Uint32 flags;
+	Eterm xchnl_port[ERTS_DIST_MAX_CHANNELS];
+	int ix, no_xchnls = 0;
 
-	erts_smp_atomic_set_mb(&dep->dist_cmd_scheduled, 1);
+	erts_smp_atomic_set_mb(&chnl->dist_cmd_scheduled, 1);
 	erts_smp_de_rwlock(dep);
 
 	ERTS_SMP_LC_ASSERT(is_internal_port(dep->cid)
 			   && erts_lc_is_port_locked(erts_port_lookup_raw(dep->cid)));
 
-	if (erts_port_task_is_scheduled(&dep->dist_cmd))
-	    erts_port_task_abort(&dep->dist_cmd);
+	if (erts_port_task_is_scheduled(&chnl->dist_cmd))
+	    erts_port_task_abort(&chnl->dist_cmd);
 
 	if (dep->status & ERTS_DE_SFLG_EXITING) {
 #ifdef DEBUG
-	    erts_smp_mtx_lock(&dep->qlock);
-	    ASSERT(dep->qflgs & ERTS_DE_QFLG_EXIT);
-	    erts_smp_mtx_unlock(&dep->qlock);
+	    erts_smp_mtx_lock(&chnl->qlock);
+	    ASSERT(erts_smp_atomic32_read_nob(&chnl->qflgs)
+		   & ERTS_DE_QFLG_EXIT);
+	    erts_smp_mtx_unlock(&chnl->qlock);
 #endif
 	}
 	else {
+	    ERTS_DECLARE_DUMMY(erts_aint32_t qflgs);
 	    dep->status |= ERTS_DE_SFLG_EXITING;
-	    erts_smp_mtx_lock(&dep->qlock);
-	    ASSERT(!(dep->qflgs & ERTS_DE_QFLG_EXIT));
-	    dep->qflgs |= ERTS_DE_QFLG_EXIT;
-	    erts_smp_mtx_unlock(&dep->qlock);
+	    erts_smp_mtx_lock(&chnl->qlock);
+	    qflgs = erts_smp_atomic32_read_bor_nob(&chnl->qflgs,
+						   ERTS_DE_QFLG_EXIT);
+	    ASSERT(!(qflgs & ERTS_DE_QFLG_EXIT));
+	    erts_smp_mtx_unlock(&chnl->qlock);
+	}
+
+	/* The extra channels of the connection go down with it */
+	for (ix = 1; ix < dep->no_chnls; ix++) {
+	    if (is_internal_port(dep->chnl[ix].cid)
+		&& !dep->chnl[ix].pending)
+		xchnl_port[no_xchnls++] = dep->chnl[ix].cid;
 	}
 
 	erts_smp_de_links_lock(dep);
@@ -583,6 +929,8 @@ int erts_do_net_exits(DistEntry *dep, Eterm reason)
 
 	clear_dist_entry(dep);
 
+	kill_dist_chnls(xchnl_port, no_xchnls, reason);
+
     }
 
     dec_no_nodes();
@@ -604,7 +952,7 @@ void init_dist(void)
     nodedown.bp = NULL;
 
     erts_smp_atomic_init_nob(&no_nodes, 0);
-    erts_smp_atomic_init_nob(&no_caches, 0);
+    erts_smp_atomic_init_nob(&caches_size, 0);
 
     /* Lookup/Install all references to trap functions */
     dsend2_trap = trap_function(am_dsend,2);
@@ -633,6 +981,8 @@ alloc_dist_obuf(Uint size)
     obuf->dbg_pattern = ERTS_DIST_OUTPUT_BUF_DBG_PATTERN;
     ASSERT(bin == ErtsDistOutputBuf2Binary(obuf));
 #endif
+    obuf->bin_refs = NULL;
+    obuf->payload = NULL;
     return obuf;
 }
 
@@ -641,27 +991,451 @@ free_dist_obuf(ErtsDistOutputBuf *obuf)
 {
     Binary *bin = ErtsDistOutputBuf2Binary(obuf);
     ASSERT(obuf->dbg_pattern == ERTS_DIST_OUTPUT_BUF_DBG_PATTERN);
-    if (erts_refc_dectest(&bin->refc, 0) == 0)
+    if (erts_refc_dectest(&bin->refc, 0) == 0) {
+	if (obuf->payload)
+	    free_dist_obuf(obuf->payload);
+	if (obuf->bin_refs)
+	    erts_free_ext_bin_refs(obuf->bin_refs);
 	erts_bin_free(bin);
+    }
 }
 
 static ERTS_INLINE Sint
 size_obuf(ErtsDistOutputBuf *obuf)
 {
     Binary *bin = ErtsDistOutputBuf2Binary(obuf);
+    if (obuf->payload)
+	return bin->orig_size + obuf->payload_size;
+    if (obuf->bin_refs)
+	return bin->orig_size + obuf->bin_refs->size;
     return bin->orig_size;
 }
 
-static void clear_dist_entry(DistEntry *dep)
+/*
+ * Binaries of at least ERTS_EXT_BIN_REF_MIN bytes in a message are,
+ * unless the message is to be compressed, not copied when the message
+ * is encoded. The output buffer then refers to them (bin_refs), and
+ * the message is passed to the port as an I/O vector in which they
+ * are inserted where they belong. A driver that cannot write all of
+ * it at once may keep the binaries of the vector it is passed. The
+ * output buffer itself is therefore only passed if it does not refer
+ * to anything that has to be released with it; otherwise the driver
+ * copies what it keeps of it.
+ *
+ * Fill in iov and bv with size bytes of the message data of obuf,
+ * starting offset bytes after p which is at or before the first
+ * binary referred to. Returns the number of entries used; at most
+ * 2*obuf->bin_refs->n + 1.
+ */
+static int
+dist_obuf_iov(ErtsDistOutputBuf *obuf, byte *p, Uint offset, Uint size,
+	      SysIOVec *iov, ErlDrvBinary **bv)
+{
+    ErtsExtBinRefs *refs = obuf->bin_refs;
+    Uint nrefs = refs ? refs->n : 0;
+    ErlDrvBinary *obin;
+    Uint k;
+    int n = 0;
+
+    if (refs)
+	obin = NULL;
+    else
+	obin = Binary2ErlDrvBinary(ErtsDistOutputBuf2Binary(obuf));
+
+    /* Even k are parts of obuf, odd k are the binaries referred to */
+    for (k = 0; k <= 2*nrefs && size > 0; k++) {
+	ErlDrvBinary *sbin;
+	byte *sp;
+	Uint len;
+
+	if (k & 1) {
+	    ErtsExtBinRef *ref = &refs->ref[k/2];
+	    sp = ref->bytes;
+	    len = ref->size;
+	    sbin = Binary2ErlDrvBinary(ref->bin);
+	}
+	else {
+	    byte *endp = (k/2 < nrefs
+			  ? refs->base + refs->ref[k/2].offset
+			  : obuf->ext_endp);
+	    ASSERT(p <= endp);
+	    sp = p;
+	    len = endp - p;
+	    sbin = obin;
+	    p = endp;
+	}
+	if (offset >= len) {
+	    offset -= len;
+	    continue;
+	}
+	sp += offset;
+	len -= offset;
+	offset = 0;
+	if (len > size)
+	    len = size;
+	iov[n].iov_base = sp;
+	iov[n].iov_len = len;
+	bv[n] = sbin;
+	n++;
+	size -= len;
+    }
+    ASSERT(size == 0);
+    return n;
+}
+
+/*
+ * Fragments.
+ *
+ * A message larger than ERTS_DIST_FRAGMENT_SIZE is, if the other node
+ * supports DFLAG_FRAGMENTS, encoded as usual into one buffer which is
+ * then sent as a number of fragment buffers referring to parts of
+ * it. The sending process enqueues the fragments one by one, and
+ * suspends between them while the queue is busy, so that signals
+ * from other processes are interleaved with the fragments instead of
+ * being stuck behind the whole message.
+ *
+ * The first fragment is sent as
+ *
+ *   VERSION_MAGIC, DIST_FRAG_HEADER, SequenceId:64, FragmentId:64,
+ *
+ * followed by the dist header minus its VERSION_MAGIC and DIST_HEADER
+ * bytes, and the first part of the control message and message.
+ * Following fragments are sent as
+ *
+ *   VERSION_MAGIC, DIST_FRAG_CONT, SequenceId:64, FragmentId:64,
+ *
+ * followed by the next part of the data. The sequence id identifies
+ * the message (it is the sender pid) and the fragment id counts down
+ * from the number of fragments to 1. If the sender goes away before
+ * all fragments have been enqueued, a DIST_FRAG_CONT fragment with
+ * fragment id 0 and no data is sent so that the receiver drops what
+ * it has got of the message.
+ *
+ * The dist header of the first fragment is finalized when the first
+ * fragment is passed to the port, so the atom cache is updated in
+ * the order the fragment is sent. The receiver resolves the atom
+ * cache references of the header when the first fragment arrives for
+ * the same reason.
+ */
+
+static ERTS_INLINE ErtsDistOutputBuf *
+alloc_dist_frag_obuf(ErtsDistOutputBuf *payload, byte tag, Uint64 seq_id,
+		     Uint64 frag_id, byte *datap, Uint offset, Uint size)
+{
+    ErtsDistOutputBuf *obuf = alloc_dist_obuf(ERTS_DIST_FRAG_HEADER_SIZE);
+    byte *ep = &obuf->data[0];
+    obuf->extp = ep;
+    *ep++ = VERSION_MAGIC;
+    *ep++ = tag;
+    put_int64(seq_id, ep);
+    put_int64(frag_id, ep + 8);
+    obuf->ext_endp = ep + 16;
+    erts_refc_inc(&ErtsDistOutputBuf2Binary(payload)->refc, 2);
+    obuf->payload = payload;
+    obuf->payload_p = datap;
+    obuf->payload_offset = offset;
+    obuf->payload_size = size;
+    return obuf;
+}
+
+/*
+ * Fill in iov and bv with all data to send for obuf, and set *sizep
+ * to its size. Returns the number of entries used; at most
+ * dist_obuf_iov_len(obuf).
+ *
+ * A fragment is sent as its fragment header followed by its part of
+ * the payload. The first fragment also includes the (finalized) dist
+ * header of the payload except for VERSION_MAGIC and DIST_HEADER
+ * which are replaced by the fragment header.
+ */
+static int
+dist_obuf_to_iov(ErtsDistOutputBuf *obuf, SysIOVec *iov, ErlDrvBinary **bv,
+		 Uint *sizep)
+{
+    ErtsDistOutputBuf *payload = obuf->payload;
+    byte *p;
+    Uint size;
+
+    if (!payload) {
+	size = obuf->ext_endp - obuf->extp;
+	if (obuf->bin_refs)
+	    size += obuf->bin_refs->size;
+	*sizep = size;
+	return dist_obuf_iov(obuf, obuf->extp, 0, size, iov, bv);
+    }
+
+    iov[0].iov_base = obuf->extp;
+    iov[0].iov_len = obuf->ext_endp - obuf->extp;
+    bv[0] = NULL; /* Refers to the payload; see above */
+
+    p = obuf->payload_p;
+    size = obuf->payload_size;
+    if (obuf->extp[1] == DIST_FRAG_HEADER) {
+	ASSERT(payload->extp[0] == VERSION_MAGIC
+	       && payload->extp[1] == DIST_HEADER);
+	ASSERT(obuf->payload_offset == 0);
+	size += p - (payload->extp + 2);
+	p = payload->extp + 2;
+    }
+    *sizep = iov[0].iov_len + size;
+    return 1 + dist_obuf_iov(payload, p, obuf->payload_offset, size,
+			     &iov[1], &bv[1]);
+}
+
+static ERTS_INLINE int
+dist_obuf_iov_len(ErtsDistOutputBuf *obuf)
+{
+    ErtsExtBinRefs *refs = (obuf->payload
+			    ? obuf->payload->bin_refs
+			    : obuf->bin_refs);
+    return 2 + (refs ? 2*refs->n : 0);
+}
+
+#define ERTS_DIST_DEF_IOV_LEN 8
+
+static ERTS_INLINE void
+finalize_dist_obuf(ErtsDistOutputBuf *obuf, ErtsAtomCache *cache,
+		   Uint32 flags)
+{
+    ErtsDistOutputBuf *ob = obuf;
+    if (obuf->payload) {
+	if (obuf->extp[1] != DIST_FRAG_HEADER)
+	    return; /* Only the first fragment has a dist header */
+	ob = obuf->payload;
+    }
+    ob->extp = erts_encode_ext_dist_header_finalize(ob->extp, cache, flags);
+    if (!(flags & DFLAG_DIST_HDR_ATOM_CACHE))
+	*--ob->extp = PASS_THROUGH; /* Old node; 'pass through' needed */
+    ASSERT(&ob->data[0] <= ob->extp && ob->extp < ob->ext_endp);
+}
+
+/*
+ * Compression.
+ *
+ * The message of a message at least erts_dist_compress_threshold
+ * bytes large is, if the other node supports DFLAG_COMPRESSED,
+ * compressed by the sending process after it has been encoded, before
+ * it is enqueued and possibly fragmented. The dist header and the
+ * control message are kept as is, and the message is replaced by
+ *
+ *   COMPRESSED, UncompressedSize:32, zlib data,
+ *
+ * i.e. the format of a compressed term_to_binary/2 result. The
+ * receiving process uncompresses the message when it decodes it (see
+ * erts_decode_dist_ext_yielding()), so the distribution port does not
+ * pay for it. If compressing does not make the message smaller, it is
+ * sent uncompressed.
+ */
+
+#define ERTS_DIST_COMPRESS_CHUNK (16*1024)
+/* Reductions (times TERM_TO_BINARY_LOOP_FACTOR) per compressed chunk */
+#define ERTS_DSIG_SEND_COMPRESS_REDS (250*TERM_TO_BINARY_LOOP_FACTOR)
+/* COMPRESSED and UncompressedSize */
+#define ERTS_DIST_COMPRESS_HEADER_SIZE (1+4)
+
+typedef struct ErtsDistCompress_ {
+    z_stream stream;
+    ErtsDistOutputBuf *obuf;	/* Buffer compressed into */
+    byte *datap;		/* Data to compress */
+    Uint size;
+    Uint offset;		/* Offset of data not yet compressed */
+} ErtsDistCompress;
+
+static ErtsDistCompress *
+dist_compress_start(ErtsDistOutputBuf *obuf, byte *datap)
+{
+    ErtsDistCompress *zc;
+    Uint hdr_offset = obuf->extp - &obuf->data[0];
+    Uint data_offset = datap - &obuf->data[0];
+    Uint size = obuf->ext_endp - datap;
+
+    ASSERT(size > ERTS_DIST_COMPRESS_HEADER_SIZE);
+
+    zc = erts_alloc(ERTS_ALC_T_DIST_ZLIB, sizeof(ErtsDistCompress));
+    erl_zlib_alloc_init(&zc->stream);
+    if (deflateInit(&zc->stream, Z_BEST_SPEED) != Z_OK) {
+	erts_free(ERTS_ALC_T_DIST_ZLIB, zc);
+	return NULL;
+    }
+
+    zc->obuf = alloc_dist_obuf(data_offset + size);
+    /* The dist header is finalized later; copy it as is */
+    sys_memcpy((void *) &zc->obuf->data[hdr_offset],
+	       (void *) obuf->extp,
+	       data_offset - hdr_offset);
+    zc->obuf->extp = &zc->obuf->data[hdr_offset];
+    zc->datap = datap;
+    zc->size = size;
+    zc->offset = 0;
+    /* Give up unless the result is smaller than the original */
+    zc->stream.next_out = (&zc->obuf->data[data_offset]
+			   + ERTS_DIST_COMPRESS_HEADER_SIZE);
+    zc->stream.avail_out = (uInt) (size - ERTS_DIST_COMPRESS_HEADER_SIZE);
+    return zc;
+}
+
+/*
+ * Compress the next chunk. Returns 1 when done, 0 when there is more
+ * to compress, and -1 if the message should be sent uncompressed.
+ */
+static int
+dist_compress_chunk(ErtsDistCompress *zc)
+{
+    Uint chunk = zc->size - zc->offset;
+    int res;
+
+    if (chunk > ERTS_DIST_COMPRESS_CHUNK)
+	chunk = ERTS_DIST_COMPRESS_CHUNK;
+    zc->stream.next_in = zc->datap + zc->offset;
+    zc->stream.avail_in = (uInt) chunk;
+    zc->offset += chunk;
+
+    res = deflate(&zc->stream,
+		  zc->offset == zc->size ? Z_FINISH : Z_NO_FLUSH);
+    if (res == Z_STREAM_END)
+	return 1;
+    if (res != Z_OK
+	|| zc->stream.avail_out == 0
+	|| zc->offset == zc->size)
+	return -1;
+    return 0;
+}
+
+/*
+ * Returns the buffer with the compressed message, or NULL if the
+ * message should be sent uncompressed.
+ */
+static ErtsDistOutputBuf *
+dist_compress_finish(ErtsDistCompress *zc, int done)
+{
+    ErtsDistOutputBuf *obuf = NULL;
+
+    if (!done)
+	free_dist_obuf(zc->obuf);
+    else {
+	byte *ep = (zc->stream.next_out - zc->stream.total_out
+		    - ERTS_DIST_COMPRESS_HEADER_SIZE);
+	ep[0] = COMPRESSED;
+	put_int32(zc->size, ep + 1);
+	obuf = zc->obuf;
+	obuf->ext_endp = zc->stream.next_out;
+    }
+    deflateEnd(&zc->stream);
+    erts_free(ERTS_ALC_T_DIST_ZLIB, zc);
+    return obuf;
+}
+
+/*
+ * Reassembly of incoming fragmented messages (see the description of
+ * the fragment format above). Partially received messages are kept
+ * in a list on the dist entry which only is accessed by the
+ * distribution port, i.e. with the port lock held.
+ */
+
+typedef struct ErtsDistFragments_ ErtsDistFragments;
+struct ErtsDistFragments_ {
+    ErtsDistFragments *next;
+    Uint64 seq_id;
+    Uint64 frag_id;		/* Id of next expected fragment */
+    Uint ext_offset;		/* Offset of ede.extp in buf */
+    Uint size;
+    Uint capacity;
+    Binary *bin;		/* Large binaries in the message may refer to it */
+    ErtsDistExternal ede;
+};
+
+/* Max number of bytes preallocated for following fragments */
+#define ERTS_DIST_FRAGS_PREALLOC_MAX (16*1024*1024)
+
+static void
+free_dist_frags(ErtsDistFragments *frags)
+{
+    erts_release_dist_ext_binary(frags->bin);
+    erts_free(ERTS_ALC_T_DIST_FRAGS, (void *) frags);
+}
+
+static void
+free_dist_frags_list(ErtsDistFragments *frags)
+{
+    while (frags) {
+	ErtsDistFragments *free_frags = frags;
+	frags = frags->next;
+	free_dist_frags(free_frags);
+    }
+}
+
+/*
+ * Detach everything buffered on a channel. The dist entry has to be
+ * write locked; the detached data is freed by free_dist_chnl_data()
+ * once the lock has been released.
+ */
+static ErtsProcList *
+detach_dist_chnl(ErtsDistChannel *chnl, ErtsAtomCache **cachep,
+		 ErtsDistFragments **fragsp, ErtsDistOutputBuf **obufp)
+{
+    ErtsProcList *suspendees;
+
+    *cachep = chnl->cache;
+    chnl->cache = NULL;
+    *fragsp = chnl->fragments;
+    chnl->fragments = NULL;
+
+    erts_smp_mtx_lock(&chnl->qlock);
+
+    fetch_in_queue(chnl);
+    if (!chnl->out_queue.last)
+	*obufp = chnl->finalized_out_queue.first;
+    else {
+	chnl->out_queue.last->next = chnl->finalized_out_queue.first;
+	*obufp = chnl->out_queue.first;
+    }
+
+    chnl->out_queue.first = NULL;
+    chnl->out_queue.last = NULL;
+    chnl->finalized_out_queue.first = NULL;
+    chnl->finalized_out_queue.last = NULL;
+    suspendees = get_suspended_on_de(chnl, ERTS_DE_QFLGS_ALL);
+
+    erts_smp_mtx_unlock(&chnl->qlock);
+    erts_smp_atomic_set_nob(&chnl->dist_cmd_scheduled, 0);
+    chnl->send = NULL;
+
+    return suspendees;
+}
+
+static void
+free_dist_chnl_data(ErtsDistChannel *chnl, ErtsAtomCache *cache,
+		    ErtsDistFragments *frags, ErtsDistOutputBuf *obuf)
 {
     Sint obufsize = 0;
+
+    delete_cache(cache);
+    free_dist_frags_list(frags);
+
+    while (obuf) {
+	ErtsDistOutputBuf *fobuf;
+	fobuf = obuf;
+	obuf = obuf->next;
+	obufsize += size_obuf(fobuf);
+	free_dist_obuf(fobuf);
+    }
+
+    if (obufsize) {
+	erts_smp_mtx_lock(&chnl->qlock);
+	dec_qsize(chnl, obufsize);
+	erts_smp_mtx_unlock(&chnl->qlock);
+    }
+}
+
+static void clear_dist_entry(DistEntry *dep)
+{
+    ErtsDistChannel *chnl = &dep->chnl[0];
     ErtsAtomCache *cache;
     ErtsProcList *suspendees;
     ErtsDistOutputBuf *obuf;
+    ErtsDistFragments *frags;
 
     erts_smp_de_rwlock(dep);
-    cache = dep->cache;
-    dep->cache = NULL;
 
 #ifdef DEBUG
     erts_smp_de_links_lock(dep);
@@ -671,44 +1445,86 @@ static void clear_dist_entry(DistEntry *dep)
     erts_smp_de_links_unlock(dep);
 #endif
 
-    erts_smp_mtx_lock(&dep->qlock);
+    dep->status = 0;
+    suspendees = detach_dist_chnl(chnl, &cache, &frags, &obuf);
+    erts_smp_de_rwunlock(dep);
 
-    if (!dep->out_queue.last)
-	obuf = dep->finalized_out_queue.first;
-    else {
-	dep->out_queue.last->next = dep->finalized_out_queue.first;
-	obuf = dep->out_queue.first;
+    erts_resume_processes(suspendees);
+
+    free_dist_chnl_data(chnl, cache, frags, obuf);
+}
+
+/*
+ * Mark the connection as exiting and let the port of channel 0 take
+ * it down. The dist entry has to be write locked.
+ */
+static void
+kill_connection(DistEntry *dep)
+{
+    ERTS_SMP_LC_ASSERT(erts_lc_is_de_rwlocked(dep));
+    if (is_internal_port(dep->cid)
+	&& !(dep->status & ERTS_DE_SFLG_EXITING)) {
+	ErtsDistChannel *chnl = &dep->chnl[0];
+
+	ERTS_DECLARE_DUMMY(erts_aint32_t qflgs);
+
+	dep->status |= ERTS_DE_SFLG_EXITING;
+
+	erts_smp_mtx_lock(&chnl->qlock);
+	qflgs = erts_smp_atomic32_read_bor_nob(&chnl->qflgs,
+					       ERTS_DE_QFLG_EXIT);
+	ASSERT(!(qflgs & ERTS_DE_QFLG_EXIT));
+	erts_smp_mtx_unlock(&chnl->qlock);
+
+	erts_schedule_dist_command(NULL, dep, chnl);
     }
+}
 
-    dep->out_queue.first = NULL;
-    dep->out_queue.last = NULL;
-    dep->finalized_out_queue.first = NULL;
-    dep->finalized_out_queue.last = NULL;
-    dep->status = 0;
-    suspendees = get_suspended_on_de(dep, ERTS_DE_QFLGS_ALL);
+/*
+ * The port of an extra channel has exited. A connection cannot
+ * continue without one of its channels, so if the channel was in use
+ * the whole connection is taken down.
+ */
+static void
+clear_dist_chnl(DistEntry *dep, ErtsDistChannel *chnl)
+{
+    ErtsAtomCache *cache;
+    ErtsProcList *suspendees;
+    ErtsDistOutputBuf *obuf;
+    ErtsDistFragments *frags;
+
+    erts_smp_atomic_set_mb(&chnl->dist_cmd_scheduled, 1);
+    erts_smp_de_rwlock(dep);
+
+    ERTS_SMP_LC_ASSERT(is_internal_port(chnl->cid)
+		       && erts_lc_is_port_locked(erts_port_lookup_raw(chnl->cid)));
+
+    if (erts_port_task_is_scheduled(&chnl->dist_cmd))
+	erts_port_task_abort(&chnl->dist_cmd);
+
+    if (!chnl->pending && chnl - &dep->chnl[0] < dep->no_chnls)
+	kill_connection(dep);
 
-    erts_smp_mtx_unlock(&dep->qlock);
-    erts_smp_atomic_set_nob(&dep->dist_cmd_scheduled, 0);
-    dep->send = NULL;
+    chnl->cid = NIL;
+    chnl->pending = 0;
+    suspendees = detach_dist_chnl(chnl, &cache, &frags, &obuf);
     erts_smp_de_rwunlock(dep);
 
     erts_resume_processes(suspendees);
 
-    delete_cache(cache);
-
-    while (obuf) {
-	ErtsDistOutputBuf *fobuf;
-	fobuf = obuf;
-	obuf = obuf->next;
-	obufsize += size_obuf(fobuf);
-	free_dist_obuf(fobuf);
-    }
+    free_dist_chnl_data(chnl, cache, frags, obuf);
+}
 
-    if (obufsize) {
-	erts_smp_mtx_lock(&dep->qlock);
-	ASSERT(dep->qsize >= obufsize);
-	dep->qsize -= obufsize;
-	erts_smp_mtx_unlock(&dep->qlock);
+static void
+kill_dist_chnls(Eterm *chnl_port, int no_chnl_ports, Eterm reason)
+{
+    int i;
+    for (i = 0; i < no_chnl_ports; i++) {
+	Port *prt = erts_port_lookup(chnl_port[i],
+				     ERTS_PORT_SFLGS_INVALID_LOOKUP);
+	if (prt)
+	    erts_port_exit(NULL, ERTS_PORT_SIG_FLG_FORCE_SCHED,
+			   prt, chnl_port[i], reason, NULL);
     }
 }
 
@@ -724,6 +1540,29 @@ void erts_dsend_context_dtor(Binary* ctx_bin)
 	break;
     default:;
     }
+    if (ctx->dss.phase == ERTS_DSIG_SEND_PHASE_COMPRESS && ctx->dss.zc)
+	(void) dist_compress_finish(ctx->dss.zc, 0);
+    if (ctx->dss.phase == ERTS_DSIG_SEND_PHASE_FRAGMENTS) {
+	DistEntry *dep = ctx->dsd.dep;
+	if (ctx->dss.frag_offset > 0) {
+	    /* Make the receiver drop the fragments already sent */
+	    ErtsDistOutputBuf *payload = ctx->dss.obuf;
+	    ErtsDistOutputBuf *fob;
+	    int suspended;
+	    fob = alloc_dist_frag_obuf(payload, DIST_FRAG_CONT,
+				       (Uint64) ctx->dss.sender, 0,
+				       (&payload->data[0]
+					+ ctx->dss.pass_through_size
+					+ ctx->dss.dhdr_ext_size),
+				       ctx->dss.frag_offset, 0);
+	    fob->next = NULL;
+	    ctx->dss.force_busy = 1;
+	    (void) dsig_send_enqueue(&ctx->dsd, &ctx->dss, fob, &suspended);
+	}
+	free_dist_obuf(ctx->dss.obuf);
+	ctx->dss.obuf = NULL;
+	erts_deref_dist_entry(dep);
+    }
     if (ctx->dss.phase >= ERTS_DSIG_SEND_PHASE_ALLOC && ctx->dss.obuf) {
 	free_dist_obuf(ctx->dss.obuf);
     }
@@ -775,7 +1614,7 @@ erts_dsig_send_link(ErtsDSigData *dsdp, Eterm local, Eterm remote)
     int res;
     UseTmpHeapNoproc(4);
 
-    res = dsig_send_ctl(dsdp, ctl, 0);
+    res = dsig_send_ctl(dsdp, ctl, local, 0);
     UnUseTmpHeapNoproc(4);
     return res;
 }
@@ -788,7 +1627,7 @@ erts_dsig_send_unlink(ErtsDSigData *dsdp, Eterm local, Eterm remote)
     int res;
 
     UseTmpHeapNoproc(4);
-    res = dsig_send_ctl(dsdp, ctl, 0);
+    res = dsig_send_ctl(dsdp, ctl, local, 0);
     UnUseTmpHeapNoproc(4);
     return res;
 }
@@ -796,10 +1635,11 @@ erts_dsig_send_unlink(ErtsDSigData *dsdp, Eterm local, Eterm remote)
 
 /* A local process that's beeing monitored by a remote one exits. We send:
    {DOP_MONITOR_P_EXIT, Local pid or name, Remote pid, ref, reason},
-   which is rather sad as only the ref is needed, no pid's... */
+   which is rather sad as only the ref is needed, no pid's...
+   local is the pid of the exiting process, or NIL if it did not exist. */
 int
 erts_dsig_send_m_exit(ErtsDSigData *dsdp, Eterm watcher, Eterm watched, 
-			  Eterm ref, Eterm reason)
+		      Eterm local, Eterm ref, Eterm reason)
 {
     Eterm ctl;
     DeclareTmpHeapNoproc(ctl_heap,6);
@@ -816,7 +1656,7 @@ erts_dsig_send_m_exit(ErtsDSigData *dsdp, Eterm watcher, Eterm watched,
     erts_smp_de_links_unlock(dsdp->dep);
 #endif
 
-    res = dsig_send_ctl(dsdp, ctl, 1);
+    res = dsig_send_ctl(dsdp, ctl, local, 1);
     UnUseTmpHeapNoproc(6);
     return res;
 }
@@ -837,7 +1677,7 @@ erts_dsig_send_monitor(ErtsDSigData *dsdp, Eterm watcher, Eterm watched,
 		 make_small(DOP_MONITOR_P),
 		 watcher, watched, ref);
 
-    res = dsig_send_ctl(dsdp, ctl, 0);
+    res = dsig_send_ctl(dsdp, ctl, watcher, 0);
     UnUseTmpHeapNoproc(5);
     return res;
 }
@@ -859,7 +1699,7 @@ erts_dsig_send_demonitor(ErtsDSigData *dsdp, Eterm watcher,
 		 make_small(DOP_DEMONITOR_P),
 		 watcher, watched, ref);
 
-    res = dsig_send_ctl(dsdp, ctl, force);
+    res = dsig_send_ctl(dsdp, ctl, watcher, force);
     UnUseTmpHeapNoproc(5);
     return res;
 }
@@ -915,6 +1755,7 @@ erts_dsig_send_msg(Eterm remote, Eterm message, ErtsSendContext* ctx)
             msize, tok_label, tok_lastcnt, tok_serial);
     ctx->dss.ctl = ctl;
     ctx->dss.msg = message;
+    ctx->dss.sender = sender->common.id;
     ctx->dss.force_busy = 0;
     res = erts_dsig_send(&ctx->dsd, &ctx->dss);
     return res;
@@ -973,6 +1814,7 @@ erts_dsig_send_reg_msg(Eterm remote_name, Eterm message,
             msize, tok_label, tok_lastcnt, tok_serial);
     ctx->dss.ctl = ctl;
     ctx->dss.msg = message;
+    ctx->dss.sender = sender->common.id;
     ctx->dss.force_busy = 0;
     res = erts_dsig_send(&ctx->dsd, &ctx->dss);
     return res;
@@ -1027,7 +1869,7 @@ erts_dsig_send_exit_tt(ErtsDSigData *dsdp, Eterm local, Eterm remote,
     DTRACE7(process_exit_signal_remote, sender_name, node_name,
             remote_name, reason_str, tok_label, tok_lastcnt, tok_serial);
     /* forced, i.e ignore busy */
-    res = dsig_send_ctl(dsdp, ctl, 1);
+    res = dsig_send_ctl(dsdp, ctl, local, 1);
     UnUseTmpHeapNoproc(6);
     return res;
 }
@@ -1043,7 +1885,7 @@ erts_dsig_send_exit(ErtsDSigData *dsdp, Eterm local, Eterm remote, Eterm reason)
     ctl = TUPLE4(&ctl_heap[0],
 		 make_small(DOP_EXIT), local, remote, reason);
     /* forced, i.e ignore busy */
-    res =  dsig_send_ctl(dsdp, ctl, 1);
+    res =  dsig_send_ctl(dsdp, ctl, local, 1);
     UnUseTmpHeapNoproc(5);
     return res;
 }
@@ -1059,7 +1901,7 @@ erts_dsig_send_exit2(ErtsDSigData *dsdp, Eterm local, Eterm remote, Eterm reason
     ctl = TUPLE4(&ctl_heap[0],
 		 make_small(DOP_EXIT2), local, remote, reason);
 
-    res = dsig_send_ctl(dsdp, ctl, 0);
+    res = dsig_send_ctl(dsdp, ctl, local, 0);
     UnUseTmpHeapNoproc(5);
     return res;
 }
@@ -1076,7 +1918,8 @@ erts_dsig_send_group_leader(ErtsDSigData *dsdp, Eterm leader, Eterm remote)
     ctl = TUPLE3(&ctl_heap[0],
 		 make_small(DOP_GROUP_LEADER), leader, remote);
 
-    res = dsig_send_ctl(dsdp, ctl, 0);
+    res = dsig_send_ctl(dsdp, ctl,
+			dsdp->proc ? dsdp->proc->common.id : leader, 0);
     UnUseTmpHeapNoproc(4);
     return res;
 }
@@ -1107,6 +1950,118 @@ erts_dsig_send_group_leader(ErtsDSigData *dsdp, Eterm leader, Eterm remote)
 #  define PURIFY_MSG(msg)
 #endif
 
+static void
+dist_frags_append(ErtsDistFragments *frags, byte *data, Uint size)
+{
+    if (frags->size + size > frags->capacity) {
+	Uint capacity = 2*frags->capacity;
+	if (capacity < frags->size + size)
+	    capacity = frags->size + size;
+	ASSERT(erts_refc_read(&frags->bin->refc, 1) == 1);
+	frags->bin = erts_bin_realloc(frags->bin, capacity);
+	frags->capacity = capacity;
+    }
+    sys_memcpy((void *) (frags->bin->orig_bytes + frags->size),
+	       (void *) data, size);
+    frags->size += size;
+}
+
+/*
+ * Returns -1 on protocol error, 0 if more fragments are needed, and
+ * 1 when the message is complete. The complete message is then
+ * unlinked from the dist entry and returned in *fragsp with its
+ * external data prepared.
+ */
+static int
+dist_frags_receive(DistEntry *dep, ErtsDistChannel *chnl,
+		   byte *buf, ErlDrvSizeT len, ErtsDistFragments **fragsp)
+{
+    ErtsDistFragments *frags, **prevp;
+    Uint64 seq_id, frag_id;
+
+    ASSERT(len >= ERTS_DIST_FRAG_HEADER_SIZE);
+    seq_id = get_int64(buf + 2);
+    frag_id = get_int64(buf + 10);
+    if (frag_id == 0 && buf[1] == DIST_FRAG_HEADER)
+	return -1;
+
+    for (prevp = &chnl->fragments; *prevp; prevp = &(*prevp)->next) {
+	if ((*prevp)->seq_id == seq_id)
+	    break;
+    }
+    frags = *prevp;
+
+    if (buf[1] == DIST_FRAG_HEADER) {
+	Uint size = len - ERTS_DIST_FRAG_HEADER_SIZE;
+	Uint capacity;
+
+	if (frags) {
+	    /* Sender gave up on the previous message; drop it... */
+	    *prevp = frags->next;
+	    free_dist_frags(frags);
+	}
+
+	capacity = 2 + size;
+	if (frag_id - 1 <= ERTS_DIST_FRAGS_PREALLOC_MAX / ERTS_DIST_FRAGMENT_SIZE)
+	    capacity += (Uint) (frag_id - 1) * ERTS_DIST_FRAGMENT_SIZE;
+
+	frags = erts_alloc(ERTS_ALC_T_DIST_FRAGS, sizeof(ErtsDistFragments));
+	frags->seq_id = seq_id;
+	frags->frag_id = frag_id - 1;
+	frags->bin = erts_bin_nrml_alloc(capacity);
+	erts_refc_init(&frags->bin->refc, 1);
+	frags->capacity = capacity;
+	frags->bin->orig_bytes[0] = VERSION_MAGIC;
+	frags->bin->orig_bytes[1] = DIST_HEADER;
+	frags->size = 2;
+	dist_frags_append(frags, buf + ERTS_DIST_FRAG_HEADER_SIZE, size);
+
+	/*
+	 * The dist header is complete in the first fragment; resolve
+	 * it now since following messages may update the atom cache.
+	 */
+	if (erts_prepare_dist_ext(&frags->ede, (byte *) frags->bin->orig_bytes,
+				  frags->size, dep, chnl->cache) < 0) {
+	    free_dist_frags(frags);
+	    return -1;
+	}
+	frags->ext_offset = frags->ede.extp - (byte *) frags->bin->orig_bytes;
+
+	if (frags->frag_id) {
+	    frags->next = chnl->fragments;
+	    chnl->fragments = frags;
+	    return 0;
+	}
+    }
+    else {
+	ASSERT(buf[1] == DIST_FRAG_CONT);
+	if (frag_id == 0) {
+	    /* The sender gave up on the message */
+	    if (len != ERTS_DIST_FRAG_HEADER_SIZE)
+		return -1;
+	    if (frags) {
+		*prevp = frags->next;
+		free_dist_frags(frags);
+	    }
+	    return 0;
+	}
+	if (!frags || frags->frag_id != frag_id)
+	    return -1;
+	dist_frags_append(frags,
+			  buf + ERTS_DIST_FRAG_HEADER_SIZE,
+			  len - ERTS_DIST_FRAG_HEADER_SIZE);
+	if (--frags->frag_id)
+	    return 0;
+	*prevp = frags->next;
+    }
+
+    frags->ede.extp = (byte *) frags->bin->orig_bytes + frags->ext_offset;
+    frags->ede.ext_endp = (byte *) frags->bin->orig_bytes + frags->size;
+    frags->ede.binp = frags->bin;
+    *fragsp = frags;
+    return 1;
+}
+
 /*
 ** Input from distribution port.
 **  Input follows the distribution protocol v4.5
@@ -1122,7 +2077,8 @@ int erts_net_message(Port *prt,
 		     byte *hbuf,
 		     ErlDrvSizeT hlen,
 		     byte *buf,
-		     ErlDrvSizeT len)
+		     ErlDrvSizeT len,
+		     Binary *bin)
 {
     ErtsDistExternal ede;
     byte *t;
@@ -1145,6 +2101,8 @@ int erts_net_message(Port *prt,
     ErtsLink *lnk;
     Uint tuple_arity;
     int res;
+    ErtsDistFragments *frags = NULL;
+    ErtsDistChannel *chnl = prt->dist_chnl;
 #ifdef ERTS_DIST_MSG_DBG
     ErlDrvSizeT orig_len = len;
 #endif
@@ -1166,25 +2124,53 @@ int erts_net_message(Port *prt,
 	return 0;
     }
 
+    dist_stat_in(dep, len);
+
 #ifdef ERTS_RAW_DIST_MSG_DBG
     erts_fprintf(stderr, "<< ");
     bw(buf, len);
 #endif
 
-    if (dep->flags & DFLAG_DIST_HDR_ATOM_CACHE)
-	t = buf;
-    else {
-	/* Skip PASS_THROUGH */
-	t = buf+1;
-	len--;
+    if ((dep->flags & DFLAG_FRAGMENTS)
+	&& len >= ERTS_DIST_FRAG_HEADER_SIZE
+	&& buf[0] == VERSION_MAGIC
+	&& (buf[1] == DIST_FRAG_HEADER || buf[1] == DIST_FRAG_CONT)) {
+	res = dist_frags_receive(dep, chnl, buf, len, &frags);
+	if (res < 0) {
+	    PURIFY_MSG("data error");
+	    goto data_error;
+	}
+	if (res == 0) {
+	    UnUseTmpHeapNoproc(DIST_CTL_DEFAULT_SIZE);
+	    return 0;
+	}
+	/* Last fragment received; handle the complete message */
+	t = buf = (byte *) frags->bin->orig_bytes;
+	len = frags->size;
+	ede = frags->ede;
+	res = 0;
     }
+    else {
+	if (dep->flags & DFLAG_DIST_HDR_ATOM_CACHE)
+	    t = buf;
+	else {
+	    /* Skip PASS_THROUGH */
+	    t = buf+1;
+	    len--;
+	}
 
-    if (len == 0) {
-	PURIFY_MSG("data error");
-	goto data_error;
+	if (len == 0) {
+	    PURIFY_MSG("data error");
+	    goto data_error;
+	}
+
+	res = erts_prepare_dist_ext(&ede, t, len, dep, chnl->cache);
+	ede.binp = bin;
     }
 
-    res = erts_prepare_dist_ext(&ede, t, len, dep, dep->cache);
+    /* Only messages are compressed, never control messages */
+    if (res >= 0 && ede.extp < ede.ext_endp && ede.extp[0] == COMPRESSED)
+	res = -1;
 
     if (res >= 0)
 	res = ctl_len = erts_decode_dist_ext_size(&ede);
@@ -1347,8 +2333,8 @@ int erts_net_message(Port *prt,
 	    int code;
 	    code = erts_dsig_prepare(&dsd, dep, NULL, ERTS_DSP_NO_LOCK, 0);
 	    if (code == ERTS_DSIG_PREP_CONNECTED) {
-		code = erts_dsig_send_m_exit(&dsd, watcher, watched, ref,
-					     am_noproc);
+		code = erts_dsig_send_m_exit(&dsd, watcher, watched, NIL,
+					     ref, am_noproc);
 		ASSERT(code == ERTS_DSIG_SEND_OK);
 	    }
 	}
@@ -1706,6 +2692,8 @@ int erts_net_message(Port *prt,
     if (ctl != ctl_default) {
 	erts_free(ERTS_ALC_T_DCTRL_BUF, (void *) ctl);
     }
+    if (frags)
+	free_dist_frags(frags);
     UnUseTmpHeapNoproc(DIST_CTL_DEFAULT_SIZE);
     ERTS_SMP_CHK_NO_PROC_LOCKS;
     return 0;
@@ -1722,18 +2710,22 @@ decode_error:
 	erts_free(ERTS_ALC_T_DCTRL_BUF, (void *) ctl);
     }
 data_error:
+    if (frags)
+	free_dist_frags(frags);
     UnUseTmpHeapNoproc(DIST_CTL_DEFAULT_SIZE);
-    erts_deliver_port_exit(prt, dep->cid, am_killed, 0, 1);
+    erts_deliver_port_exit(prt, prt->common.id, am_killed, 0, 1);
     ERTS_SMP_CHK_NO_PROC_LOCKS;
     return -1;
 }
 
-static int dsig_send_ctl(ErtsDSigData* dsdp, Eterm ctl, int force_busy)
+static int dsig_send_ctl(ErtsDSigData* dsdp, Eterm ctl, Eterm sender,
+			 int force_busy)
 {
     struct erts_dsig_send_context ctx;
     int ret;
     ctx.ctl = ctl;
     ctx.msg = THE_NON_VALUE;
+    ctx.sender = sender;
     ctx.force_busy = force_busy;
     ctx.phase = ERTS_DSIG_SEND_PHASE_INIT;
 #ifdef DEBUG
@@ -1744,12 +2736,173 @@ static int dsig_send_ctl(ErtsDSigData* dsdp, Eterm ctl, int force_busy)
     return ret;
 }
 
+/* Reductions (times TERM_TO_BINARY_LOOP_FACTOR) per enqueued fragment */
+#define ERTS_DSIG_SEND_FRAG_REDS (10*TERM_TO_BINARY_LOOP_FACTOR)
+
+/*
+ * Enqueue an encoded signal on the dist entry if the connection still
+ * is the one the signal was encoded for. Returns 0 if the signal was
+ * dropped. *suspendedp is set if the sender was suspended due to a
+ * busy queue; it then has to yield even if it already has been
+ * resumed.
+ */
+static int
+dsig_send_enqueue(ErtsDSigData *dsdp, struct erts_dsig_send_context *ctx,
+		  ErtsDistOutputBuf *obuf, int *suspendedp)
+{
+    DistEntry *dep = dsdp->dep;
+    ErtsDistChannel *chnl;
+    int suspended = 0;
+    int resume = 0;
+    Eterm cid;
+
+    ASSERT(!obuf->next);
+
+    erts_smp_de_rlock(dep);
+    cid = dep->cid;
+    if (cid != dsdp->cid
+	|| dep->connection_id != dsdp->connection_id
+	|| dep->status & ERTS_DE_SFLG_EXITING) {
+	/* Not the same connection as when we started; drop message... */
+	erts_smp_de_runlock(dep);
+	free_dist_obuf(obuf);
+	*suspendedp = 0;
+	return 0;
+    }
+    else {
+	ErtsProcList *plp = NULL;
+	ErtsDistOutputBuf *head;
+	erts_aint_t qsize;
+
+	chnl = erts_dist_sender_chnl(dep, ctx->sender);
+	cid = chnl->cid;
+
+	/*
+	 * Enqueue obuf on channel without locking; many senders may
+	 * do this in parallel. The port fetches everything pushed on
+	 * in_queue in one go and restores the order.
+	 */
+	qsize = erts_smp_atomic_add_read_nob(&chnl->qsize,
+					     (erts_aint_t) size_obuf(obuf));
+	head = (ErtsDistOutputBuf *) erts_smp_atomic_read_nob(&chnl->in_queue);
+	while (1) {
+	    ErtsDistOutputBuf *act;
+	    obuf->next = head;
+	    act = (ErtsDistOutputBuf *)
+		erts_smp_atomic_cmpxchg_mb(&chnl->in_queue,
+					   (erts_aint_t) obuf,
+					   (erts_aint_t) head);
+	    if (act == head)
+		break;
+	    head = act;
+	}
+	dist_stat_queue(dep, qsize);
+
+	if (qsize < erts_dist_buf_busy_limit
+	    && !(erts_smp_atomic32_read_nob(&chnl->qflgs)
+		 & ERTS_DE_QFLG_BUSY)) {
+	    /* Fast path; not busy */
+	    erts_schedule_dist_command(NULL, dep, chnl);
+	    erts_smp_de_runlock(dep);
+	    *suspendedp = 0;
+	    return 1;
+	}
+
+	if (!ctx->force_busy) {
+	    plp = erts_proclist_create(ctx->c_p);
+	    erts_suspend(ctx->c_p, ERTS_PROC_LOCK_MAIN, NULL);
+	    suspended = 1;
+	}
+
+	/*
+	 * qsize is only decreased, and the busy state only cleared, by
+	 * the port while holding qlock, so checking again while holding
+	 * it cannot miss a resume.
+	 */
+	erts_smp_mtx_lock(&chnl->qlock);
+	if (erts_smp_atomic_read_nob(&chnl->qsize) >= erts_dist_buf_busy_limit
+	    && !(erts_smp_atomic32_read_bor_nob(&chnl->qflgs,
+						ERTS_DE_QFLG_BUSY)
+		 & ERTS_DE_QFLG_BUSY)) {
+	    chnl->busy_since = erts_get_monotonic_time(NULL);
+	    erts_smp_atomic_inc_nob(&dep->stats.busy_count);
+	}
+
+	if (!ctx->force_busy) {
+	    if (!(erts_smp_atomic32_read_nob(&chnl->qflgs)
+		  & ERTS_DE_QFLG_BUSY)) {
+		resume = 1; /* was busy when we started, but isn't now */
+#ifdef USE_VM_PROBES
+		if (resume && DTRACE_ENABLED(dist_port_not_busy)) {
+		    DTRACE_CHARBUF(port_str, 64);
+		    DTRACE_CHARBUF(remote_str, 64);
+
+		    erts_snprintf(port_str, sizeof(DTRACE_CHARBUF_NAME(port_str)),
+				  "%T", cid);
+		    erts_snprintf(remote_str, sizeof(DTRACE_CHARBUF_NAME(remote_str)),
+				  "%T", dep->sysname);
+		    DTRACE3(dist_port_not_busy, erts_this_node_sysname,
+			    port_str, remote_str);
+		}
+#endif
+	    }
+	    else {
+		/* Enqueue suspended process on channel */
+		ASSERT(plp);
+		erts_proclist_store_last(&chnl->suspended, plp);
+	    }
+	}
+
+	erts_smp_mtx_unlock(&chnl->qlock);
+	erts_schedule_dist_command(NULL, dep, chnl);
+	erts_smp_de_runlock(dep);
+
+	if (resume) {
+	    erts_resume(ctx->c_p, ERTS_PROC_LOCK_MAIN);
+	    erts_proclist_destroy(plp);
+	    /*
+	     * Note that the calling process still have to yield as if it
+	     * suspended. If not, the calling process could later be
+	     * erroneously scheduled when it shouldn't be.
+	     */
+	}
+    }
+
+    if (suspended) {
+#ifdef USE_VM_PROBES
+	if (!resume && DTRACE_ENABLED(dist_port_busy)) {
+	    DTRACE_CHARBUF(port_str, 64);
+	    DTRACE_CHARBUF(remote_str, 64);
+	    DTRACE_CHARBUF(pid_str, 16);
+
+	    erts_snprintf(port_str, sizeof(DTRACE_CHARBUF_NAME(port_str)), "%T", cid);
+	    erts_snprintf(remote_str, sizeof(DTRACE_CHARBUF_NAME(remote_str)),
+			  "%T", dep->sysname);
+	    erts_snprintf(pid_str, sizeof(DTRACE_CHARBUF_NAME(pid_str)),
+			  "%T", ctx->c_p->common.id);
+	    DTRACE4(dist_port_busy, erts_this_node_sysname,
+		    port_str, remote_str, pid_str);
+	}
+#endif
+	if (!resume && erts_system_monitor_flags.busy_dist_port)
+	    monitor_generic(ctx->c_p, am_busy_dist_port, cid);
+    }
+
+    *suspendedp = suspended;
+    return 1;
+}
+
 int
 erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx)
 {
     int retval;
     Sint initial_reds = ctx->reds;
-    Eterm cid;
+    ErtsMonotonicTime start = 0;
+
+    if (ctx->phase == ERTS_DSIG_SEND_PHASE_INIT)
+	ctx->time_sample = dist_stat_time_sample(dsdp->dep);
+    if (ctx->time_sample)
+	start = erts_get_monotonic_time(NULL);
 
     while (1) {
 	switch (ctx->phase) {
@@ -1767,6 +2920,9 @@ erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx)
 	    if (!erts_is_alive)
 		return ERTS_DSIG_SEND_OK;
 
+	    ctx->compress_tried = 0;
+	    ctx->zc = NULL;
+
 	    if (ctx->flags & DFLAG_DIST_HDR_ATOM_CACHE) {
 		ctx->acmp = erts_get_atom_cache_map(ctx->c_p);
 		ctx->pass_through_size = 0;
@@ -1790,6 +2946,9 @@ erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx)
 		ctx->u.sc.wstack.wstart = NULL;
 		ctx->u.sc.flags = ctx->flags;
 		ctx->u.sc.level = 0;
+		/* Refer to large binaries unless the data may be compressed */
+		ctx->u.sc.iovec = !(ctx->flags & DFLAG_COMPRESSED);
+		ctx->u.sc.bin_refs = 0;
 		ctx->phase = ERTS_DSIG_SEND_PHASE_MSG_SIZE;
 	    } else {
 		ctx->phase = ERTS_DSIG_SEND_PHASE_ALLOC;
@@ -1803,7 +2962,9 @@ erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx)
 	    }
 
 	    ctx->phase = ERTS_DSIG_SEND_PHASE_ALLOC;
-	case ERTS_DSIG_SEND_PHASE_ALLOC:
+	case ERTS_DSIG_SEND_PHASE_ALLOC: {
+	    Uint bin_refs = is_value(ctx->msg) ? ctx->u.sc.bin_refs : 0;
+
 	    erts_finalize_atom_cache_map(ctx->acmp, ctx->flags);
 
 	    ctx->dhdr_ext_size = erts_encode_ext_dist_header_size(ctx->acmp);
@@ -1811,20 +2972,27 @@ erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx)
 
 	    ctx->obuf = alloc_dist_obuf(ctx->data_size);
 	    ctx->obuf->ext_endp = &ctx->obuf->data[0] + ctx->pass_through_size + ctx->dhdr_ext_size;
+	    if (bin_refs) {
+		ctx->obuf->bin_refs = erts_alloc_ext_bin_refs(bin_refs);
+		ctx->obuf->bin_refs->base = ctx->obuf->ext_endp;
+	    }
 
 	    /* Encode internal version of dist header */
 	    ctx->obuf->extp = erts_encode_ext_dist_header_setup(ctx->obuf->ext_endp, ctx->acmp);
 	    /* Encode control message */
 	    erts_encode_dist_ext(ctx->ctl, &ctx->obuf->ext_endp, ctx->flags, ctx->acmp, NULL, NULL);
+	    ctx->msg_offset = ctx->obuf->ext_endp - &ctx->obuf->data[0];
 	    if (is_value(ctx->msg)) {
 		ctx->u.ec.flags = ctx->flags;
 		ctx->u.ec.level = 0;
 		ctx->u.ec.wstack.wstart = NULL;
+		ctx->u.ec.bin_refs = ctx->obuf->bin_refs;
 		ctx->phase = ERTS_DSIG_SEND_PHASE_MSG_ENCODE;
 	    } else {
 		ctx->phase = ERTS_DSIG_SEND_PHASE_FIN;
 	    }
 	    break;
+	}
 
 	case ERTS_DSIG_SEND_PHASE_MSG_ENCODE:
 	    if (erts_encode_dist_ext(ctx->msg, &ctx->obuf->ext_endp, ctx->flags, ctx->acmp, &ctx->u.ec, &ctx->reds)) {
@@ -1834,116 +3002,143 @@ erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx)
 
 	    ctx->phase = ERTS_DSIG_SEND_PHASE_FIN;
 	case ERTS_DSIG_SEND_PHASE_FIN: {
-	    DistEntry *dep = dsdp->dep;
-	    int suspended = 0;
-	    int resume = 0;
+	    int suspended;
 
 	    ASSERT(ctx->obuf->extp < ctx->obuf->ext_endp);
 	    ASSERT(&ctx->obuf->data[0] <= ctx->obuf->extp - ctx->pass_through_size);
 	    ASSERT(ctx->obuf->ext_endp <= &ctx->obuf->data[0] + ctx->data_size);
 
 	    ctx->data_size = ctx->obuf->ext_endp - ctx->obuf->extp;
+	    if (ctx->obuf->bin_refs)
+		ctx->data_size += ctx->obuf->bin_refs->size;
+
+	    if (!ctx->compress_tried)
+		dist_stat_msg_size(dsdp->dep, ctx->data_size);
+
+	    if (!ctx->compress_tried
+		&& (ctx->flags & DFLAG_COMPRESSED)
+		&& (ctx->flags & DFLAG_DIST_HDR_ATOM_CACHE)
+		&& ctx->c_p
+		&& is_value(ctx->msg)) {
+		byte *datap = &ctx->obuf->data[0] + ctx->msg_offset;
+		Uint size = ctx->obuf->ext_endp - datap;
+		ASSERT(!ctx->obuf->bin_refs);
+		ctx->compress_tried = 1;
+		if (size >= erts_dist_compress_threshold
+		    && size > 2*ERTS_DIST_COMPRESS_HEADER_SIZE) {
+		    ctx->zc = dist_compress_start(ctx->obuf, datap);
+		    if (ctx->zc) {
+			ctx->phase = ERTS_DSIG_SEND_PHASE_COMPRESS;
+			break;
+		    }
+		}
+	    }
 
-	    /*
-	     * Signal encoded; now verify that the connection still exists,
-	     * and if so enqueue the signal and schedule it for send.
-	     */
-	    ctx->obuf->next = NULL;
-	    erts_smp_de_rlock(dep);
-	    cid = dep->cid;
-	    if (cid != dsdp->cid
-		|| dep->connection_id != dsdp->connection_id
-		|| dep->status & ERTS_DE_SFLG_EXITING) {
-		/* Not the same connection as when we started; drop message... */
-		erts_smp_de_runlock(dep);
-		free_dist_obuf(ctx->obuf);
+	    if ((ctx->flags & DFLAG_FRAGMENTS)
+		&& (ctx->flags & DFLAG_DIST_HDR_ATOM_CACHE)
+		&& ctx->c_p
+		&& is_value(ctx->msg)
+		&& ctx->data_size > ERTS_DIST_FRAGMENT_SIZE) {
+		byte *datap = (&ctx->obuf->data[0] + ctx->pass_through_size
+			       + ctx->dhdr_ext_size);
+		Uint size = ctx->obuf->ext_endp - datap;
+		if (ctx->obuf->bin_refs)
+		    size += ctx->obuf->bin_refs->size;
+		ctx->frag_offset = 0;
+		ctx->frag_size = size;
+		ctx->frag_id = ((size + ERTS_DIST_FRAGMENT_SIZE - 1)
+				/ ERTS_DIST_FRAGMENT_SIZE);
+		/* Keep the entry for an abort; see erts_dsend_context_dtor() */
+		erts_refc_inc(&dsdp->dep->refc, 1);
+		ctx->phase = ERTS_DSIG_SEND_PHASE_FRAGMENTS;
+		break;
 	    }
-	    else {
-		ErtsProcList *plp = NULL;
-		erts_smp_mtx_lock(&dep->qlock);
-		dep->qsize += size_obuf(ctx->obuf);
-		if (dep->qsize >= erts_dist_buf_busy_limit)
-		    dep->qflgs |= ERTS_DE_QFLG_BUSY;
-		if (!ctx->force_busy && (dep->qflgs & ERTS_DE_QFLG_BUSY)) {
-		    erts_smp_mtx_unlock(&dep->qlock);
-
-		    plp = erts_proclist_create(ctx->c_p);
-		    erts_suspend(ctx->c_p, ERTS_PROC_LOCK_MAIN, NULL);
-		    suspended = 1;
-		    erts_smp_mtx_lock(&dep->qlock);
-		}
 
-		/* Enqueue obuf on dist entry */
-		if (dep->out_queue.last)
-		    dep->out_queue.last->next = ctx->obuf;
-		else
-		    dep->out_queue.first = ctx->obuf;
-		dep->out_queue.last = ctx->obuf;
-
-		if (!ctx->force_busy) {
-		    if (!(dep->qflgs & ERTS_DE_QFLG_BUSY)) {
-			if (suspended)
-			    resume = 1; /* was busy when we started, but isn't now */
-    #ifdef USE_VM_PROBES
-			if (resume && DTRACE_ENABLED(dist_port_not_busy)) {
-			    DTRACE_CHARBUF(port_str, 64);
-			    DTRACE_CHARBUF(remote_str, 64);
-
-			    erts_snprintf(port_str, sizeof(DTRACE_CHARBUF_NAME(port_str)),
-					  "%T", cid);
-			    erts_snprintf(remote_str, sizeof(DTRACE_CHARBUF_NAME(remote_str)),
-					  "%T", dep->sysname);
-			    DTRACE3(dist_port_not_busy, erts_this_node_sysname,
-				    port_str, remote_str);
-			}
-    #endif
-		    }
-		    else {
-			/* Enqueue suspended process on dist entry */
-			ASSERT(plp);
-			erts_proclist_store_last(&dep->suspended, plp);
-		    }
-		}
+	    ctx->obuf->next = NULL;
+	    dsig_send_enqueue(dsdp, ctx, ctx->obuf, &suspended);
+	    ctx->obuf = NULL;
+
+	    retval = suspended ? ERTS_DSIG_SEND_YIELD : ERTS_DSIG_SEND_OK;
+	    goto done;
+	}
 
-		erts_smp_mtx_unlock(&dep->qlock);
-		erts_schedule_dist_command(NULL, dep);
-		erts_smp_de_runlock(dep);
-
-		if (resume) {
-		    erts_resume(ctx->c_p, ERTS_PROC_LOCK_MAIN);
-		    erts_proclist_destroy(plp);
-		    /*
-		     * Note that the calling process still have to yield as if it
-		     * suspended. If not, the calling process could later be
-		     * erroneously scheduled when it shouldn't be.
-		     */
+	case ERTS_DSIG_SEND_PHASE_COMPRESS: {
+	    ErtsDistOutputBuf *zobuf;
+	    int res;
+
+	    while (1) {
+		res = dist_compress_chunk(ctx->zc);
+		ctx->reds -= ERTS_DSIG_SEND_COMPRESS_REDS;
+		if (res != 0)
+		    break;
+		if (ctx->reds <= 0) {
+		    retval = ERTS_DSIG_SEND_CONTINUE;
+		    goto done;
 		}
 	    }
-	    ctx->obuf = NULL;
 
-	    if (suspended) {
-    #ifdef USE_VM_PROBES
-		if (!resume && DTRACE_ENABLED(dist_port_busy)) {
-		    DTRACE_CHARBUF(port_str, 64);
-		    DTRACE_CHARBUF(remote_str, 64);
-		    DTRACE_CHARBUF(pid_str, 16);
+	    zobuf = dist_compress_finish(ctx->zc, res > 0);
+	    ctx->zc = NULL;
+	    if (zobuf) {
+		free_dist_obuf(ctx->obuf);
+		ctx->obuf = zobuf;
+	    }
+	    ctx->data_size = ctx->obuf->ext_endp - &ctx->obuf->data[0];
+	    ctx->phase = ERTS_DSIG_SEND_PHASE_FIN;
+	    break;
+	}
 
-		    erts_snprintf(port_str, sizeof(DTRACE_CHARBUF_NAME(port_str)), "%T", cid);
-		    erts_snprintf(remote_str, sizeof(DTRACE_CHARBUF_NAME(remote_str)),
-				  "%T", dep->sysname);
-		    erts_snprintf(pid_str, sizeof(DTRACE_CHARBUF_NAME(pid_str)),
-				  "%T", ctx->c_p->common.id);
-		    DTRACE4(dist_port_busy, erts_this_node_sysname,
-			    port_str, remote_str, pid_str);
+	case ERTS_DSIG_SEND_PHASE_FRAGMENTS: {
+	    ErtsDistOutputBuf *payload = ctx->obuf;
+	    byte *first_datap = (&payload->data[0] + ctx->pass_through_size
+				 + ctx->dhdr_ext_size);
+	    int suspended;
+
+	    while (1) {
+		ErtsDistOutputBuf *fob;
+		Uint size;
+		int enqueued;
+
+		ASSERT(ctx->frag_id > 0);
+		if (ctx->frag_id == 1)
+		    size = ctx->frag_size - ctx->frag_offset;
+		else
+		    size = ERTS_DIST_FRAGMENT_SIZE;
+		ASSERT(ctx->frag_offset + size <= ctx->frag_size);
+
+		fob = alloc_dist_frag_obuf(payload,
+					   (ctx->frag_offset == 0
+					    ? DIST_FRAG_HEADER
+					    : DIST_FRAG_CONT),
+					   (Uint64) ctx->c_p->common.id,
+					   ctx->frag_id,
+					   first_datap,
+					   ctx->frag_offset,
+					   size);
+		fob->next = NULL;
+		ctx->frag_offset += size;
+		ctx->frag_id--;
+
+		enqueued = dsig_send_enqueue(dsdp, ctx, fob, &suspended);
+
+		if (!enqueued || ctx->frag_id == 0) {
+		    /* Done, or connection lost; drop the rest... */
+		    free_dist_obuf(payload);
+		    ctx->obuf = NULL;
+		    ctx->phase = ERTS_DSIG_SEND_PHASE_FIN;
+		    erts_deref_dist_entry(dsdp->dep);
+		    retval = (suspended
+			      ? ERTS_DSIG_SEND_YIELD
+			      : ERTS_DSIG_SEND_OK);
+		    goto done;
+		}
+
+		ctx->reds -= ERTS_DSIG_SEND_FRAG_REDS;
+		if (suspended || ctx->reds <= 0) {
+		    retval = ERTS_DSIG_SEND_CONTINUE;
+		    goto done;
 		}
-    #endif
-		if (!resume && erts_system_monitor_flags.busy_dist_port)
-		    monitor_generic(ctx->c_p, am_busy_dist_port, cid);
-		retval = ERTS_DSIG_SEND_YIELD;
-	    } else {
-		retval = ERTS_DSIG_SEND_OK;
 	    }
-	    goto done;
 	}
 	default:
 	    erts_exit(ERTS_ABORT_EXIT, "dsig_send invalid phase (%d)\n", (int)ctx->phase);
@@ -1954,6 +3149,8 @@ done:
     if (ctx->msg && ctx->c_p) {
 	BUMP_REDS(ctx->c_p, (initial_reds - ctx->reds) / TERM_TO_BINARY_LOOP_FACTOR);
     }
+    if (ctx->time_sample)
+	dist_stat_encode_time(dsdp->dep, erts_get_monotonic_time(NULL) - start);
     return retval;
 }
 
@@ -1962,6 +3159,33 @@ dist_port_command(Port *prt, ErtsDistOutputBuf *obuf)
 {
     int fpe_was_unmasked;
     Uint size = obuf->ext_endp - obuf->extp;
+    byte *data = obuf->extp;
+
+    if (obuf->payload || obuf->bin_refs) {
+	/* The driver wants it in one piece */
+	SysIOVec def_iov[ERTS_DIST_DEF_IOV_LEN];
+	ErlDrvBinary *def_bv[ERTS_DIST_DEF_IOV_LEN];
+	SysIOVec *iov = def_iov;
+	ErlDrvBinary **bv = def_bv;
+	int len = dist_obuf_iov_len(obuf);
+	int i, n;
+	byte *dp;
+
+	if (len > ERTS_DIST_DEF_IOV_LEN) {
+	    iov = erts_alloc(ERTS_ALC_T_TMP, len*sizeof(SysIOVec));
+	    bv = erts_alloc(ERTS_ALC_T_TMP, len*sizeof(ErlDrvBinary *));
+	}
+	n = dist_obuf_to_iov(obuf, iov, bv, &size);
+	data = dp = erts_alloc(ERTS_ALC_T_TMP, size);
+	for (i = 0; i < n; i++) {
+	    sys_memcpy((void *) dp, iov[i].iov_base, iov[i].iov_len);
+	    dp += iov[i].iov_len;
+	}
+	if (iov != def_iov) {
+	    erts_free(ERTS_ALC_T_TMP, iov);
+	    erts_free(ERTS_ALC_T_TMP, bv);
+	}
+    }
 
     ERTS_SMP_CHK_NO_PROC_LOCKS;
     ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(prt));
@@ -1988,9 +3212,11 @@ dist_port_command(Port *prt, ErtsDistOutputBuf *obuf)
     prt->caller = NIL;
     fpe_was_unmasked = erts_block_fpe();
     (*prt->drv_ptr->output)((ErlDrvData) prt->drv_data,
-			    (char*) obuf->extp,
+			    (char*) data,
 			    (int) size);
     erts_unblock_fpe(fpe_was_unmasked);
+    if (data != obuf->extp)
+	erts_free(ERTS_ALC_T_TMP, (void *) data);
     return size;
 }
 
@@ -1998,29 +3224,36 @@ static Uint
 dist_port_commandv(Port *prt, ErtsDistOutputBuf *obuf)
 {
     int fpe_was_unmasked;
-    Uint size = obuf->ext_endp - obuf->extp;
-    SysIOVec iov[2];
-    ErlDrvBinary* bv[2];
+    Uint size;
+    SysIOVec def_iov[1 + ERTS_DIST_DEF_IOV_LEN];
+    ErlDrvBinary* def_bv[1 + ERTS_DIST_DEF_IOV_LEN];
+    SysIOVec *iov = def_iov;
+    ErlDrvBinary **bv = def_bv;
+    int len = 1 + dist_obuf_iov_len(obuf);
     ErlIOVec eiov;
+    int vsize;
 
     ERTS_SMP_CHK_NO_PROC_LOCKS;
     ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(prt));
 
-    if (size > (Uint) INT_MAX)
-	erts_exit(ERTS_DUMP_EXIT,
-		 "Absurdly large distribution output data buffer "
-		 "(%beu bytes) passed.\n",
-		 size);
+    if (len > 1 + ERTS_DIST_DEF_IOV_LEN) {
+	iov = erts_alloc(ERTS_ALC_T_TMP, len*sizeof(SysIOVec));
+	bv = erts_alloc(ERTS_ALC_T_TMP, len*sizeof(ErlDrvBinary *));
+    }
 
     iov[0].iov_base = NULL;
     iov[0].iov_len = 0;
     bv[0] = NULL;
 
-    iov[1].iov_base = obuf->extp;
-    iov[1].iov_len = size;
-    bv[1] = Binary2ErlDrvBinary(ErtsDistOutputBuf2Binary(obuf));
+    vsize = 1 + dist_obuf_to_iov(obuf, &iov[1], &bv[1], &size);
 
-    eiov.vsize = 2;
+    if (size > (Uint) INT_MAX)
+	erts_exit(ERTS_DUMP_EXIT,
+		 "Absurdly large distribution output data buffer "
+		 "(%beu bytes) passed.\n",
+		 size);
+
+    eiov.vsize = vsize;
     eiov.size = size;
     eiov.iov = iov;
     eiov.binv = bv;
@@ -2045,6 +3278,10 @@ dist_port_commandv(Port *prt, ErtsDistOutputBuf *obuf)
     (*prt->drv_ptr->outputv)((ErlDrvData) prt->drv_data, &eiov);
     erts_unblock_fpe(fpe_was_unmasked);
 
+    if (iov != def_iov) {
+	erts_free(ERTS_ALC_T_TMP, iov);
+	erts_free(ERTS_ALC_T_TMP, bv);
+    }
     return size;
 }
 
@@ -2073,8 +3310,11 @@ erts_dist_command(Port *prt, int reds_limit)
     Uint32 status;
     Uint32 flags;
     Sint obufsize = 0;
+    Uint out_msgs = 0, out_bytes = 0;
     ErtsDistOutputQueue oq, foq;
     DistEntry *dep = prt->dist_entry;
+    ErtsDistChannel *chnl = prt->dist_chnl;
+    int stale;
     Uint (*send)(Port *prt, ErtsDistOutputBuf *obuf);
     erts_aint32_t sched_flags;
     ErtsSchedulerData *esdp = erts_get_scheduler_data();
@@ -2084,15 +3324,17 @@ erts_dist_command(Port *prt, int reds_limit)
     erts_refc_inc(&dep->refc, 1); /* Otherwise dist_entry might be
 				     removed if port command fails */
 
-    erts_smp_atomic_set_mb(&dep->dist_cmd_scheduled, 0);
+    erts_smp_atomic_set_mb(&chnl->dist_cmd_scheduled, 0);
 
     erts_smp_de_rlock(dep);
     flags = dep->flags;
     status = dep->status;
-    send = dep->send;
+    /* An extra channel left behind by a connection that is gone */
+    stale = is_nil(dep->cid) && !chnl->pending;
+    send = chnl->send;
     erts_smp_de_runlock(dep);
 
-    if (status & ERTS_DE_SFLG_EXITING) {
+    if ((status & ERTS_DE_SFLG_EXITING) || stale) {
 	erts_deliver_port_exit(prt, prt->common.id, am_killed, 0, 1);
 	erts_deref_dist_entry(dep);
 	return reds + ERTS_PORT_REDS_DIST_CMD_EXIT;
@@ -2108,17 +3350,18 @@ erts_dist_command(Port *prt, int reds_limit)
      * a mess.
      */
 
-    erts_smp_mtx_lock(&dep->qlock);
-    oq.first = dep->out_queue.first;
-    oq.last = dep->out_queue.last;
-    dep->out_queue.first = NULL;
-    dep->out_queue.last = NULL;
-    erts_smp_mtx_unlock(&dep->qlock);
+    erts_smp_mtx_lock(&chnl->qlock);
+    fetch_in_queue(chnl);
+    oq.first = chnl->out_queue.first;
+    oq.last = chnl->out_queue.last;
+    chnl->out_queue.first = NULL;
+    chnl->out_queue.last = NULL;
+    erts_smp_mtx_unlock(&chnl->qlock);
 
-    foq.first = dep->finalized_out_queue.first;
-    foq.last = dep->finalized_out_queue.last;
-    dep->finalized_out_queue.first = NULL;
-    dep->finalized_out_queue.last = NULL;
+    foq.first = chnl->finalized_out_queue.first;
+    foq.last = chnl->finalized_out_queue.last;
+    chnl->finalized_out_queue.first = NULL;
+    chnl->finalized_out_queue.last = NULL;
 
     sched_flags = erts_smp_atomic32_read_nob(&prt->sched.flags);
 
@@ -2133,6 +3376,8 @@ erts_dist_command(Port *prt, int reds_limit)
 
 	    size = (*send)(prt, foq.first);
 	    esdp->io.out += (Uint64) size;
+	    out_msgs++;
+	    out_bytes += size;
 #ifdef ERTS_RAW_DIST_MSG_DBG
 	    erts_fprintf(stderr, ">> ");
 	    bw(foq.first->extp, size);
@@ -2162,13 +3407,7 @@ erts_dist_command(Port *prt, int reds_limit)
 	    ob = oq.first;
 	    ASSERT(ob);
 	    do {
-		ob->extp = erts_encode_ext_dist_header_finalize(ob->extp,
-								dep->cache,
-								flags);
-		if (!(flags & DFLAG_DIST_HDR_ATOM_CACHE))
-		    *--ob->extp = PASS_THROUGH; /* Old node; 'pass through'
-						   needed */
-		ASSERT(&ob->data[0] <= ob->extp && ob->extp < ob->ext_endp);
+		finalize_dist_obuf(ob, chnl->cache, flags);
 		reds += ERTS_PORT_REDS_DIST_CMD_FINALIZE;
 		preempt = reds > reds_limit;
 		if (preempt)
@@ -2206,18 +3445,12 @@ erts_dist_command(Port *prt, int reds_limit)
 	while (oq.first && !preempt) {
 	    ErtsDistOutputBuf *fob;
 	    Uint size;
-	    oq.first->extp
-		= erts_encode_ext_dist_header_finalize(oq.first->extp,
-						       dep->cache,
-						       flags);
+	    finalize_dist_obuf(oq.first, chnl->cache, flags);
 	    reds += ERTS_PORT_REDS_DIST_CMD_FINALIZE;
-	    if (!(flags & DFLAG_DIST_HDR_ATOM_CACHE))
-		*--oq.first->extp = PASS_THROUGH; /* Old node; 'pass through'
-						     needed */
-	    ASSERT(&oq.first->data[0] <= oq.first->extp
-		   && oq.first->extp < oq.first->ext_endp);
 	    size = (*send)(prt, oq.first);
 	    esdp->io.out += (Uint64) size;
+	    out_msgs++;
+	    out_bytes += size;
 #ifdef ERTS_RAW_DIST_MSG_DBG
 	    erts_fprintf(stderr, ">> ");
 	    bw(oq.first->extp, size);
@@ -2254,23 +3487,28 @@ erts_dist_command(Port *prt, int reds_limit)
 	 * dist entry in a non-busy state and resume suspended
 	 * processes.
 	 */
-	erts_smp_mtx_lock(&dep->qlock);
-	ASSERT(dep->qsize >= obufsize);
-	dep->qsize -= obufsize;
+	erts_smp_mtx_lock(&chnl->qlock);
+	dec_qsize(chnl, obufsize);
 	obufsize = 0;
 	if (!(sched_flags & ERTS_PTS_FLG_BUSY_PORT)
-	    && (dep->qflgs & ERTS_DE_QFLG_BUSY)
-	    && dep->qsize < erts_dist_buf_busy_limit) {
+	    && (erts_smp_atomic32_read_nob(&chnl->qflgs) & ERTS_DE_QFLG_BUSY)
+	    && (erts_smp_atomic_read_nob(&chnl->qsize)
+		< erts_dist_buf_busy_limit)) {
 	    ErtsProcList *suspendees;
+	    ErtsMonotonicTime busy_time;
 	    int resumed;
-	    suspendees = get_suspended_on_de(dep, ERTS_DE_QFLG_BUSY);
-	    erts_smp_mtx_unlock(&dep->qlock);
+	    suspendees = get_suspended_on_de(chnl, ERTS_DE_QFLG_BUSY);
+	    busy_time = erts_get_monotonic_time(NULL) - chnl->busy_since;
+	    erts_smp_mtx_unlock(&chnl->qlock);
+
+	    erts_smp_atomic64_add_nob(&dep->stats.busy_time,
+				      ERTS_MONOTONIC_TO_NSEC(busy_time));
 
 	    resumed = erts_resume_processes(suspendees);
 	    reds += resumed*ERTS_PORT_REDS_DIST_CMD_RESUMED;
 	}
 	else
-	    erts_smp_mtx_unlock(&dep->qlock);
+	    erts_smp_mtx_unlock(&chnl->qlock);
     }
 
     ASSERT(!oq.first && !oq.last);
@@ -2279,20 +3517,24 @@ erts_dist_command(Port *prt, int reds_limit)
 
     if (obufsize != 0) {
 	ASSERT(obufsize > 0);
-	erts_smp_mtx_lock(&dep->qlock);
-	ASSERT(dep->qsize >= obufsize);
-	dep->qsize -= obufsize;
-	erts_smp_mtx_unlock(&dep->qlock);
+	erts_smp_mtx_lock(&chnl->qlock);
+	dec_qsize(chnl, obufsize);
+	erts_smp_mtx_unlock(&chnl->qlock);
     }
 
     ASSERT(foq.first || !foq.last);
     ASSERT(!foq.first || foq.last);
-    ASSERT(!dep->finalized_out_queue.first);
-    ASSERT(!dep->finalized_out_queue.last);
+    ASSERT(!chnl->finalized_out_queue.first);
+    ASSERT(!chnl->finalized_out_queue.last);
 
     if (foq.first) {
-	dep->finalized_out_queue.first = foq.first;
-	dep->finalized_out_queue.last = foq.last;
+	chnl->finalized_out_queue.first = foq.first;
+	chnl->finalized_out_queue.last = foq.last;
+    }
+
+    if (out_msgs) {
+	erts_smp_atomic_add_nob(&dep->stats.out_msgs, (erts_aint_t) out_msgs);
+	erts_smp_atomic_add_nob(&dep->stats.out_bytes, (erts_aint_t) out_bytes);
     }
 
      /* Avoid wrapping reduction counter... */
@@ -2336,9 +3578,9 @@ erts_dist_command(Port *prt, int reds_limit)
 	foq.last = NULL;
 
 #ifdef DEBUG
-	erts_smp_mtx_lock(&dep->qlock);
-	ASSERT(dep->qsize == obufsize);
-	erts_smp_mtx_unlock(&dep->qlock);
+	erts_smp_mtx_lock(&chnl->qlock);
+	ASSERT(erts_smp_atomic_read_nob(&chnl->qsize) == obufsize);
+	erts_smp_mtx_unlock(&chnl->qlock);
 #endif
     }
     else {
@@ -2347,17 +3589,17 @@ erts_dist_command(Port *prt, int reds_limit)
 	     * Unhandle buffers need to be put back first
 	     * in out_queue.
 	     */
-	    erts_smp_mtx_lock(&dep->qlock);
-	    dep->qsize -= obufsize;
+	    erts_smp_mtx_lock(&chnl->qlock);
+	    dec_qsize(chnl, obufsize);
 	    obufsize = 0;
-	    oq.last->next = dep->out_queue.first;
-	    dep->out_queue.first = oq.first;
-	    if (!dep->out_queue.last)
-		dep->out_queue.last = oq.last;
-	    erts_smp_mtx_unlock(&dep->qlock);
+	    oq.last->next = chnl->out_queue.first;
+	    chnl->out_queue.first = oq.first;
+	    if (!chnl->out_queue.last)
+		chnl->out_queue.last = oq.last;
+	    erts_smp_mtx_unlock(&chnl->qlock);
 	}
 
-	erts_schedule_dist_command(prt, NULL);
+	erts_schedule_dist_command(prt, NULL, NULL);
     }
     goto done;
 }
@@ -2378,26 +3620,15 @@ erts_dist_port_not_busy(Port *prt)
                 port_str, remote_str);
     }
 #endif
-    erts_schedule_dist_command(prt, NULL);
+    erts_schedule_dist_command(prt, NULL, NULL);
 }
 
 void
 erts_kill_dist_connection(DistEntry *dep, Uint32 connection_id)
 {
     erts_smp_de_rwlock(dep);
-    if (is_internal_port(dep->cid)
-	&& connection_id == dep->connection_id
-	&& !(dep->status & ERTS_DE_SFLG_EXITING)) {
-
-	dep->status |= ERTS_DE_SFLG_EXITING;
-
-	erts_smp_mtx_lock(&dep->qlock);
-	ASSERT(!(dep->qflgs & ERTS_DE_QFLG_EXIT));
-	dep->qflgs |= ERTS_DE_QFLG_EXIT;
-	erts_smp_mtx_unlock(&dep->qlock);
-
-	erts_schedule_dist_command(NULL, dep);
-    }
+    if (connection_id == dep->connection_id)
+	kill_connection(dep);
     erts_smp_de_rwunlock(dep);
 }
 
@@ -2681,6 +3912,12 @@ BIF_RETTYPE setnode_2(BIF_ALIST_2)
  ** sent in the distribution messages but are only used in 
  ** the handshake.
  **
+ ** setnode_3(name@host, Cid, {Type, Version, Channel}) registers Cid
+ ** as extra channel number Channel (1 .. ERTS_DIST_MAX_CHANNELS-1) of
+ ** the connection to name@host. Extra channels have to be registered
+ ** before the connection is set up; the connection then uses channel
+ ** 1 and upwards up to the first channel not registered.
+ **
  ***********************************************************************/
 
 BIF_RETTYPE setnode_3(BIF_ALIST_3)
@@ -2690,6 +3927,9 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     unsigned long version;
     Eterm ic, oc;
     Eterm *tp;
+    Sint chnl_ix = 0;
+    int ix;
+    ErtsDistChannel *chnl;
     DistEntry *dep = NULL;
     Port *pp = NULL;
 
@@ -2709,17 +3949,26 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     if (!is_tuple(BIF_ARG_3))
 	goto badarg;
     tp = tuple_val(BIF_ARG_3);
-    if (*tp++ != make_arityval(4))
+    if (*tp != make_arityval(4) && *tp != make_arityval(3))
 	goto badarg;
+    if (*tp++ == make_arityval(3)) {
+	if (!is_small(tp[2]))
+	    goto badarg;
+	chnl_ix = signed_val(tp[2]);
+	if (chnl_ix < 1 || chnl_ix >= ERTS_DIST_MAX_CHANNELS)
+	    goto badarg;
+    }
     if (!is_small(*tp))
 	goto badarg;
     flags = unsigned_val(*tp++);
     if (!is_small(*tp) || (version = unsigned_val(*tp)) == 0)
 	goto badarg;
-    ic = *(++tp);
-    oc = *(++tp);
-    if (!is_atom(ic) || !is_atom(oc))
-	goto badarg;
+    if (!chnl_ix) {
+	ic = *(++tp);
+	oc = *(++tp);
+	if (!is_atom(ic) || !is_atom(oc))
+	    goto badarg;
+    }
 
     /* DFLAG_EXTENDED_REFERENCES is compulsory from R9 and forward */
     if (!(DFLAG_EXTENDED_REFERENCES & flags)) {
@@ -2759,7 +4008,9 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     if ((pp->drv_ptr->flags & ERL_DRV_FLAG_SOFT_BUSY) == 0)
 	goto badarg;
 
-    if (dep->cid == BIF_ARG_2 && pp->dist_entry == dep)
+    chnl = &dep->chnl[chnl_ix];
+
+    if (chnl->cid == BIF_ARG_2 && pp->dist_entry == dep)
 	goto done; /* Already set */
 
     if (dep->status & ERTS_DE_SFLG_EXITING) {
@@ -2767,9 +4018,9 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
 	ErtsProcList *plp = erts_proclist_create(BIF_P);
 	plp->next = NULL;
 	erts_suspend(BIF_P, ERTS_PROC_LOCK_MAIN, NULL);
-	erts_smp_mtx_lock(&dep->qlock);
-	erts_proclist_store_last(&dep->suspended, plp);
-	erts_smp_mtx_unlock(&dep->qlock);
+	erts_smp_mtx_lock(&dep->chnl[0].qlock);
+	erts_proclist_store_last(&dep->chnl[0].suspended, plp);
+	erts_smp_mtx_unlock(&dep->chnl[0].qlock);
 	goto yield;
     }
 
@@ -2778,6 +4029,18 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     if (pp->dist_entry || is_not_nil(dep->cid))
 	goto badarg;
 
+    if (is_not_nil(chnl->cid)) {
+	/*
+	 * A port registered by another connection attempt is still
+	 * alive, or a port of an earlier connection has not finished
+	 * exiting yet; wait for it to go away.
+	 */
+	if (chnl->pending
+	    && erts_port_lookup(chnl->cid, ERTS_PORT_SFLGS_INVALID_LOOKUP))
+	    goto badarg;
+	goto yield;
+    }
+
     erts_atomic32_read_bor_nob(&pp->state, ERTS_PORT_SFLG_DISTRIBUTION);
 
     /*
@@ -2790,31 +4053,52 @@ BIF_RETTYPE setnode_3(BIF_ALIST_3)
     }
 
     pp->dist_entry = dep;
-
-    dep->version = version;
-    dep->creation = 0;
+    pp->dist_chnl = chnl;
 
     ASSERT(pp->drv_ptr->outputv || pp->drv_ptr->output);
 
 #if 1
-    dep->send = (pp->drv_ptr->outputv
-		 ? dist_port_commandv
-		 : dist_port_command);
+    chnl->send = (pp->drv_ptr->outputv
+		  ? dist_port_commandv
+		  : dist_port_command);
 #else
-    dep->send = dist_port_command;
+    chnl->send = dist_port_command;
 #endif
-    ASSERT(dep->send);
+    ASSERT(chnl->send);
 
 #ifdef DEBUG
-    erts_smp_mtx_lock(&dep->qlock);
-    ASSERT(dep->qsize == 0);
-    erts_smp_mtx_unlock(&dep->qlock);
+    erts_smp_mtx_lock(&chnl->qlock);
+    ASSERT(erts_smp_atomic_read_nob(&chnl->qsize) == 0);
+    erts_smp_mtx_unlock(&chnl->qlock);
 #endif
 
+    if (chnl_ix) {
+	chnl->cid = BIF_ARG_2;
+	chnl->pending = 1;
+	if (flags & DFLAG_DIST_HDR_ATOM_CACHE)
+	    create_cache(chnl, flags);
+	erts_smp_de_rwunlock(dep);
+	dep = NULL; /* inc of refc transferred to port (dist_entry field) */
+	goto done;
+    }
+
+    dep->version = version;
+    dep->creation = 0;
+
     erts_set_dist_entry_connected(dep, BIF_ARG_2, flags);
 
     if (flags & DFLAG_DIST_HDR_ATOM_CACHE)
-	create_cache(dep);
+	create_cache(chnl, flags);
+
+    /* Take the extra channels registered for this connection into use */
+    for (ix = 1; ix < ERTS_DIST_MAX_CHANNELS; ix++) {
+	ErtsDistChannel *xchnl = &dep->chnl[ix];
+	if (!xchnl->pending
+	    || !xchnl->cache != !(flags & DFLAG_DIST_HDR_ATOM_CACHE))
+	    break;
+	xchnl->pending = 0;
+    }
+    dep->no_chnls = ix;
 
     erts_smp_de_rwunlock(dep);
     dep = NULL; /* inc of refc transferred to port (dist_entry field) */
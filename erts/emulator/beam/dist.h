@@ -44,6 +44,10 @@
 #define DFLAG_UTF8_ATOMS          0x10000
 #define DFLAG_MAP_TAG             0x20000
 #define DFLAG_BIG_CREATION        0x40000
+#define DFLAG_FRAGMENTS           0x800000
+#define DFLAG_MULTI_CHANNEL       0x1000000
+#define DFLAG_COMPRESSED          0x2000000
+#define DFLAG_LARGE_ATOM_CACHE    0x4000000
 
 /* All flags that should be enabled when term_to_binary/1 is used. */
 #define TERM_TO_BINARY_DFLAGS (DFLAG_EXTENDED_REFERENCES	\
@@ -108,7 +112,41 @@ typedef struct {
   (!ERTS_DE_IS_NOT_CONNECTED((DEP)))
 
 #define ERTS_DE_BUSY_LIMIT (1024*1024)
+
+/*
+ * Messages larger than this are sent in fragments to nodes that
+ * support DFLAG_FRAGMENTS, see erts_dsig_send().
+ */
+#define ERTS_DIST_FRAGMENT_SIZE (64*1024)
+/* VERSION_MAGIC, tag, sequence id, and fragment id */
+#define ERTS_DIST_FRAG_HEADER_SIZE (1+1+8+8)
+
+/*
+ * Messages larger than this are compressed when sent to nodes that
+ * support DFLAG_COMPRESSED, see erts_dsig_send().
+ */
+#define ERTS_DIST_COMPRESS_THRESHOLD (4*1024)
+
+/*
+ * Received messages and binaries at least this large refer to the
+ * binary that the driver delivered them in instead of being copied,
+ * see erts_make_dist_ext_copy() and dec_term(). Zero disables this.
+ */
+#define ERTS_DIST_BIN_REF_THRESHOLD (16*1024)
+/*
+ * ... as long as they make up at least 1/ERTS_DIST_BIN_REF_MAX_RATIO of
+ * that binary, so that a small part of a large buffer does not keep all
+ * of it alive.
+ */
+#define ERTS_DIST_BIN_REF_MAX_RATIO 4
+#define ERTS_DIST_BIN_REF(BP, SZ)					\
+    (erts_dist_bin_ref_threshold					\
+     && (Uint) (SZ) >= (Uint) erts_dist_bin_ref_threshold		\
+     && ((Uint) (SZ)) * ERTS_DIST_BIN_REF_MAX_RATIO			\
+        >= (Uint) (BP)->orig_size)
 extern int erts_dist_buf_busy_limit;
+extern int erts_dist_compress_threshold;
+extern int erts_dist_bin_ref_threshold;
 extern int erts_is_alive;
 
 /*
@@ -129,6 +167,8 @@ extern int erts_is_alive;
 /* System not alive (distributed) */
 #define ERTS_DSIG_PREP_NOT_ALIVE	3
 
+ERTS_GLB_INLINE ErtsDistChannel *erts_dist_sender_chnl(DistEntry *, Eterm);
+
 ERTS_GLB_INLINE int erts_dsig_prepare(ErtsDSigData *,
 				      DistEntry *,
 				      Process *,
@@ -136,10 +176,32 @@ ERTS_GLB_INLINE int erts_dsig_prepare(ErtsDSigData *,
 				      int);
 
 ERTS_GLB_INLINE
-void erts_schedule_dist_command(Port *, DistEntry *);
+void erts_schedule_dist_command(Port *, DistEntry *, ErtsDistChannel *);
 
 #if ERTS_GLB_INLINE_INCL_FUNC_DEF
 
+/*
+ * Channel to pass signals from sender over. Signals from the same
+ * local process or port always use the same channel, which preserves
+ * the order of signals between each pair of processes.
+ */
+ERTS_GLB_INLINE ErtsDistChannel *
+erts_dist_sender_chnl(DistEntry *dep, Eterm sender)
+{
+    Uint ix;
+    ERTS_SMP_LC_ASSERT(erts_lc_rwmtx_is_rlocked(&dep->rwmtx)
+		       || erts_lc_rwmtx_is_rwlocked(&dep->rwmtx));
+    if (dep->no_chnls == 1)
+	return &dep->chnl[0];
+    if (is_internal_pid(sender))
+	ix = internal_pid_data(sender);
+    else if (is_internal_port(sender))
+	ix = internal_port_data(sender);
+    else
+	ix = 0;
+    return &dep->chnl[ix % dep->no_chnls];
+}
+
 ERTS_GLB_INLINE int 
 erts_dsig_prepare(ErtsDSigData *dsdp,
 		  DistEntry *dep,
@@ -161,12 +223,10 @@ erts_dsig_prepare(ErtsDSigData *dsdp,
 	goto fail;
     }
     if (no_suspend) {
-	failure = ERTS_DSIG_PREP_CONNECTED;
-	erts_smp_mtx_lock(&dep->qlock);
-	if (dep->qflgs & ERTS_DE_QFLG_BUSY)
-	    failure = ERTS_DSIG_PREP_WOULD_SUSPEND;
-	erts_smp_mtx_unlock(&dep->qlock);
-	if (failure == ERTS_DSIG_PREP_WOULD_SUSPEND)
+	ErtsDistChannel *chnl;
+	chnl = erts_dist_sender_chnl(dep, proc ? proc->common.id : NIL);
+	failure = ERTS_DSIG_PREP_WOULD_SUSPEND;
+	if (erts_smp_atomic32_read_nob(&chnl->qflgs) & ERTS_DE_QFLG_BUSY)
 	    goto fail;
     }
     dsdp->proc = proc;
@@ -188,32 +248,33 @@ erts_dsig_prepare(ErtsDSigData *dsdp,
 }
 
 ERTS_GLB_INLINE
-void erts_schedule_dist_command(Port *prt, DistEntry *dist_entry)
+void erts_schedule_dist_command(Port *prt, DistEntry *dist_entry,
+				ErtsDistChannel *dist_chnl)
 {
-    DistEntry *dep;
+    ErtsDistChannel *chnl;
     Eterm id;
 
     if (prt) {
 	ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(prt));
 	ASSERT((erts_atomic32_read_nob(&prt->state)
 		& ERTS_PORT_SFLGS_DEAD) == 0);
-	ASSERT(prt->dist_entry);
+	ASSERT(prt->dist_entry && prt->dist_chnl);
 
-	dep = prt->dist_entry;
+	chnl = prt->dist_chnl;
 	id = prt->common.id;
     }
     else {
-	ASSERT(dist_entry);
+	ASSERT(dist_entry && dist_chnl);
 	ERTS_SMP_LC_ASSERT(erts_lc_rwmtx_is_rlocked(&dist_entry->rwmtx)
 			   || erts_lc_rwmtx_is_rwlocked(&dist_entry->rwmtx));
-	ASSERT(is_internal_port(dist_entry->cid));
+	ASSERT(is_internal_port(dist_chnl->cid));
 
- 	dep = dist_entry;
-	id = dep->cid;
+	chnl = dist_chnl;
+	id = chnl->cid;
     }
 
-    if (!erts_smp_atomic_xchg_mb(&dep->dist_cmd_scheduled, 1))
-	erts_port_task_schedule(id, &dep->dist_cmd, ERTS_PORT_TASK_DIST_CMD);
+    if (!erts_smp_atomic_xchg_mb(&chnl->dist_cmd_scheduled, 1))
+	erts_port_task_schedule(id, &chnl->dist_cmd, ERTS_PORT_TASK_DIST_CMD);
 }
 
 #endif
@@ -283,6 +344,8 @@ typedef enum { TTBSize, TTBEncode, TTBCompress } TTBState;
 typedef struct TTBSizeContext_ {
     Uint flags;
     int level;
+    int iovec;			/* Size for encoding into an I/O vector */
+    Uint bin_refs;		/* Binaries to refer to if iovec */
     Uint result;
     Eterm obj;
     ErtsWStack wstack;
@@ -295,6 +358,8 @@ typedef struct TTBEncodeContext_ {
     Eterm obj;
     ErtsWStack wstack;
     Binary *result_bin;
+    /* Binaries referred to, if encoding into an I/O vector */
+    struct ErtsExtBinRefs_ *bin_refs;
 } TTBEncodeContext;
 
 typedef struct {
@@ -309,6 +374,7 @@ typedef struct {
 typedef struct {
     int alive;
     TTBState state;
+    int iovec;			/* Result is a list of binaries */
     union {
 	TTBSizeContext sc;
 	TTBEncodeContext ec;
@@ -321,7 +387,9 @@ enum erts_dsig_send_phase {
     ERTS_DSIG_SEND_PHASE_MSG_SIZE,
     ERTS_DSIG_SEND_PHASE_ALLOC,
     ERTS_DSIG_SEND_PHASE_MSG_ENCODE,
-    ERTS_DSIG_SEND_PHASE_FIN
+    ERTS_DSIG_SEND_PHASE_FIN,
+    ERTS_DSIG_SEND_PHASE_COMPRESS,
+    ERTS_DSIG_SEND_PHASE_FRAGMENTS
 };
 
 struct erts_dsig_send_context {
@@ -330,6 +398,7 @@ struct erts_dsig_send_context {
 
     Eterm ctl;
     Eterm msg;
+    Eterm sender;
     int force_busy;
     Uint32 pass_through_size;
     Uint data_size, dhdr_ext_size;
@@ -337,6 +406,15 @@ struct erts_dsig_send_context {
     ErtsDistOutputBuf *obuf;
     Uint32 flags;
     Process *c_p;
+    int time_sample; /* Encode time is measured for this send */
+    /* Compressed send; obuf is then the buffer being compressed */
+    int compress_tried;
+    struct ErtsDistCompress_ *zc;
+    Uint msg_offset; /* Offset of the message in obuf */
+    /* Fragmented send; obuf is then the buffer being fragmented */
+    Uint64 frag_id;
+    Uint frag_offset; /* Offset into, and size of, the payload data */
+    Uint frag_size;
     union {
 	TTBSizeContext sc;
 	TTBEncodeContext ec;
@@ -372,7 +450,7 @@ extern int erts_dsig_send_exit(ErtsDSigData *, Eterm, Eterm, Eterm);
 extern int erts_dsig_send_exit2(ErtsDSigData *, Eterm, Eterm, Eterm);
 extern int erts_dsig_send_demonitor(ErtsDSigData *, Eterm, Eterm, Eterm, int);
 extern int erts_dsig_send_monitor(ErtsDSigData *, Eterm, Eterm, Eterm);
-extern int erts_dsig_send_m_exit(ErtsDSigData *, Eterm, Eterm, Eterm, Eterm);
+extern int erts_dsig_send_m_exit(ErtsDSigData *, Eterm, Eterm, Eterm, Eterm, Eterm);
 
 extern int erts_dsig_send(ErtsDSigData *dsdp, struct erts_dsig_send_context* ctx);
 extern void erts_dsend_context_dtor(Binary*);
@@ -383,6 +461,8 @@ extern void erts_dist_port_not_busy(Port *prt);
 extern void erts_kill_dist_connection(DistEntry *dep, Uint32);
 
 extern Uint erts_dist_cache_size(void);
+extern Eterm erts_dist_atom_cache_info(Process *c_p, Eterm node);
+extern Eterm erts_dist_stats_info(Process *c_p, Eterm node);
 
 
 #endif
@@ -90,6 +90,13 @@
 #  define ERTS_ALC_DEFAULT_ACUL_LL_ALLOC 0
 #endif
 
+/* Largest block size cached per scheduler by eheap, binary and ets alloc */
+#ifdef ERTS_SMP
+#  define ERTS_ALC_DEFAULT_BCS 512
+#else
+#  define ERTS_ALC_DEFAULT_BCS 0
+#endif
+
 #ifdef DEBUG
 static Uint install_debug_functions(void);
 #if 0
@@ -417,6 +424,7 @@ set_default_eheap_alloc_opts(struct au_init *ip)
     ip->init.util.ts 		= ERTS_ALC_MTA_EHEAP;
     ip->init.util.rsbcst	= 50;
     ip->init.util.acul		= ERTS_ALC_DEFAULT_ACUL_EHEAP_ALLOC;
+    ip->init.util.bcs		= ERTS_ALC_DEFAULT_BCS;
 }
 
 static void
@@ -435,6 +443,7 @@ set_default_binary_alloc_opts(struct au_init *ip)
 #endif
     ip->init.util.ts 		= ERTS_ALC_MTA_BINARY;
     ip->init.util.acul		= ERTS_ALC_DEFAULT_ACUL;
+    ip->init.util.bcs		= ERTS_ALC_DEFAULT_BCS;
 }
 
 static void
@@ -453,6 +462,7 @@ set_default_ets_alloc_opts(struct au_init *ip)
 #endif
     ip->init.util.ts 		= ERTS_ALC_MTA_ETS;
     ip->init.util.acul		= ERTS_ALC_DEFAULT_ACUL;
+    ip->init.util.bcs		= ERTS_ALC_DEFAULT_BCS;
 }
 
 static void
@@ -1307,7 +1317,6 @@ get_mb_value(char *param_end, char** argv, int* ip)
 }
 
 
-#if 0
 static Uint
 get_byte_value(char *param_end, char** argv, int* ip)
 {
@@ -1321,7 +1330,6 @@ get_byte_value(char *param_end, char** argv, int* ip)
 	bad_value(param, param_end, value);
     return (Uint) tmp;
 }
-#endif
 
 static Uint
 get_amount_value(char *param_end, char** argv, int* ip)
@@ -1424,6 +1432,13 @@ handle_au_arg(struct au_init *auip,
 	else
 	    goto bad_switch;
 	break;
+    case 'b':
+	if (has_prefix("bcs", sub_param)) {
+	    auip->init.util.bcs = get_byte_value(sub_param + 3, argv, ip);
+	}
+	else
+	    goto bad_switch;
+	break;
     case 'e': {
 	int e = get_bool_value(sub_param + 1, argv, ip);
         if (!auip->disable_allowed && !e) {
@@ -1613,6 +1628,12 @@ handle_args(int *argc, char **argv, erts_alc_hndl_args_init_t *init)
 #endif
 			    get_amount_value(argv[i]+6, argv, &i);
 		    }
+		    else if (has_prefix("msl", argv[i]+3)) {
+#if HAVE_ERTS_MSEG
+			init->mseg.msl =
+#endif
+			    get_mb_value(argv[i]+6, argv, &i);
+		    }
 		    else if (has_prefix("scs", argv[i]+3)) {
 #if HAVE_ERTS_MSEG
 			init->mseg.dflt_mmap.scs =
@@ -1637,6 +1658,20 @@ handle_args(int *argc, char **argv, erts_alc_hndl_args_init_t *init)
 #endif
 			    get_amount_value(argv[i]+9, argv, &i);
 		    }
+		    else if (has_prefix("hp", argv[i]+3)) {
+			char *param = argv[i]+1;
+			char *value = get_value(argv[i]+5, argv, &i);
+			int hp = ERTS_MMAP_HP_NONE;
+			if (strcmp("transparent", value) == 0)
+			    hp = ERTS_MMAP_HP_TRANSPARENT;
+			else if (strcmp("explicit", value) == 0)
+			    hp = ERTS_MMAP_HP_EXPLICIT;
+			else if (strcmp("none", value) != 0)
+			    bad_value(param, param+4, value);
+#if HAVE_ERTS_MSEG
+			init->mseg.dflt_mmap.hp = hp;
+#endif
+		    }
 		    else {
 			bad_param(param, param+2);
 		    }
@@ -1940,6 +1975,21 @@ erts_alloc_fix_alloc_shrink(int ix, erts_aint32_t flgs)
 {
 #ifdef ERTS_SMP
     ErtsAllocatorThrSpec_t *tspec;
+
+    if (!flgs && ix > 0) {
+	/* Flush; also empty the block caches of this scheduler */
+	int aix;
+	for (aix = ERTS_ALC_A_MIN; aix <= ERTS_ALC_A_MAX; aix++) {
+	    tspec = &erts_allctr_thr_spec[aix];
+	    if (erts_allctrs_info[aix].alloc_util
+		&& tspec->enabled
+		&& tspec->dd
+		&& ix < tspec->size
+		&& tspec->allctr[ix])
+		erts_alcu_flush_block_cache(tspec->allctr[ix]);
+	}
+    }
+
     tspec = &erts_allctr_thr_spec[ERTS_ALC_A_FIXED_SIZE];
     if (erts_allctrs_info[ERTS_ALC_A_FIXED_SIZE].thr_spec && tspec->enabled)
 	return erts_alcu_fix_alloc_shrink(tspec->allctr[ix], flgs);
@@ -71,6 +71,11 @@
 #define ERTS_ALCU_FIX_MAX_LIST_SZ 1000
 #define ERTS_ALC_FIX_MAX_SHRINK_OPS 30
 
+/* Block cache limits */
+#define ERTS_ALCU_BLK_CACHE_MAX_LIST_SZ 1000
+#define ERTS_ALCU_BLK_CACHE_MAX_SIZE (256*1024)
+#define ERTS_ALCU_BLK_CACHE_TRIM_OPS 4096
+
 #define ALLOC_ZERO_EQ_NULL 0
 
 #ifndef ERTS_MSEG_FLG_2POW
@@ -100,6 +105,9 @@ static Uint sys_alloc_carrier_size;
 #if HAVE_ERTS_MSEG
 static Uint max_mseg_carriers;
 #endif
+#if defined(ERTS_SMP) && defined(ERTS_HAVE_MEM_DISCARD) && HAVE_ERTS_MSEG
+static UWord mseg_discard_unit;
+#endif
 static int allow_sys_alloc_carriers;
 
 #define ONE_GIGA (1000000000)
@@ -724,8 +732,6 @@ static void dealloc_block(Allctr_t *, void *, ErtsAlcFixList_t *, int);
 
 /* internal data... */
 
-#if 0
-
 static ERTS_INLINE void *
 internal_alloc(UWord size)
 {
@@ -735,6 +741,8 @@ internal_alloc(UWord size)
     return res;
 }
 
+#if 0
+
 static ERTS_INLINE void *
 internal_realloc(void *ptr, UWord size)
 {
@@ -744,14 +752,14 @@ internal_realloc(void *ptr, UWord size)
     return res;
 }
 
+#endif
+
 static ERTS_INLINE void
 internal_free(void *ptr)
 {
     erts_sys_free(0, NULL, ptr);
 }
 
-#endif
-
 #ifdef ARCH_32
 
 /*
@@ -2165,6 +2173,99 @@ set_new_allctr_abandon_limit(Allctr_t *allctr);
 static void
 abandon_carrier(Allctr_t *allctr, Carrier_t *crr);
 
+/*
+ * Pages of free blocks in pooled carriers are returned to the OS.
+ * Abandoned carriers are sparsely used, and their free blocks are not
+ * needed until some instance fetches the carrier from the pool, so
+ * there is no point in keeping them resident in the meantime. This is
+ * done when we have exclusive access to the carrier anyway; when it is
+ * abandoned and when the owning instance frees a block in it. The
+ * header, the free tree/list node and the footer of the free block
+ * are kept.
+ *
+ * When abandoning, free blocks larger than ERTS_ALCU_MIN_DISCARD_SIZE
+ * are discarded. When freeing, the free blocks that the freed block
+ * is coalesced with have already been discarded, so only the pages of
+ * the freed block are, together with the header and footer pages of
+ * the neighbours that are now inside the coalesced block. That is,
+ * each page is discarded once while the carrier is pooled.
+ *
+ * Memory is discarded in units of the pages backing the carrier; of
+ * the huge pages if mseg_alloc maps carriers with huge pages. Carriers
+ * that may be backed by explicit huge pages are not discarded at all
+ * (see erts_mem_discard_unit()).
+ */
+
+#define ERTS_ALCU_MIN_DISCARD_SIZE (64*1024)
+
+#define DISCARD_FLOOR(X, U) (((UWord) (X)) & ~((U) - 1))
+#define DISCARD_CEILING(X, U) DISCARD_FLOOR(((UWord) (X)) + (U) - 1, (U))
+
+#ifdef ERTS_HAVE_MEM_DISCARD
+static ERTS_INLINE UWord
+carrier_discard_unit(Carrier_t *crr)
+{
+#if HAVE_ERTS_MSEG
+    if (IS_MSEG_CARRIER(crr))
+	return mseg_discard_unit;
+#endif
+    return ERTS_PAGEALIGNED_SIZE;
+}
+#endif
+
+/*
+ * Discard the pages of free block 'blk' that are within [from, to);
+ * 'unit' is the carrier_discard_unit() of its carrier.
+ */
+static ERTS_INLINE void
+discard_free_blk_range(Allctr_t *allctr, Block_t *blk, UWord blk_sz,
+		       char *from, char *to, UWord unit)
+{
+#ifdef ERTS_HAVE_MEM_DISCARD
+    char *start, *end;
+
+    if (!unit)
+	return;
+    start = ((char *) blk) + allctr->min_block_size;
+    if (start < from)
+	start = from;
+    end = ((char *) blk) + blk_sz - sizeof(FreeBlkFtr_t);
+    if (end > to)
+	end = to;
+    start = (char *) DISCARD_CEILING(start, unit);
+    end = (char *) DISCARD_FLOOR(end, unit);
+    if (start < end)
+	erts_mem_discard(start, (UWord) (end - start));
+#endif
+}
+
+static ERTS_INLINE void
+discard_free_blk(Allctr_t *allctr, Block_t *blk, UWord blk_sz, UWord unit)
+{
+    if (blk_sz >= ERTS_ALCU_MIN_DISCARD_SIZE)
+	discard_free_blk_range(allctr, blk, blk_sz,
+			       (char *) blk, ((char *) blk) + blk_sz, unit);
+}
+
+static void
+discard_carrier_free_blks(Allctr_t *allctr, Carrier_t *crr)
+{
+#ifdef ERTS_HAVE_MEM_DISCARD
+    Block_t *blk = MBC_TO_FIRST_BLK(allctr, crr);
+    UWord unit = carrier_discard_unit(crr);
+
+    if (!unit)
+	return;
+    while (1) {
+	if (IS_FREE_BLK(blk))
+	    discard_free_blk(allctr, blk, MBC_FBLK_SZ(blk), unit);
+	if (IS_LAST_BLK(blk))
+	    break;
+	blk = NXT_BLK(blk);
+    }
+#endif
+}
+
 
 static ERTS_INLINE void
 check_abandon_carrier(Allctr_t *allctr, Block_t *fblk, Carrier_t **busy_pcrr_pp)
@@ -2227,6 +2328,146 @@ erts_alcu_check_delayed_dealloc(Allctr_t *allctr,
     handle_delayed_dealloc((Allctr), (Locked), 1, 			\
 			   ERTS_ALCU_DD_OPS_LIM_LOW, NULL, NULL, NULL)
 
+/*
+ * Block cache.
+ *
+ * Instances that are only accessed by one thread (the scheduler
+ * specific instances of thread preferred allocators) may keep a small
+ * number of freed multiblock carrier blocks of each small block size
+ * in a cache instead of returning them to their carriers. Allocation
+ * of a block of the same size is then just a list operation that
+ * neither takes any lock nor touches the free block tree. Blocks
+ * freed by other threads arrive in batches through the delayed
+ * dealloc queue and are cached in the same way.
+ *
+ * A cached block is still an allocated block as far as the carrier
+ * and its statistics are concerned. Blocks in carriers currently in
+ * the carrier pool are never cached. Every
+ * ERTS_ALCU_BLK_CACHE_TRIM_OPS cache operation, the blocks that have
+ * not been needed since the previous trim are returned to their
+ * carriers, so the cache adapts to the allocation pattern of the
+ * thread.
+ */
+
+#define ERTS_ALCU_BLK_CACHE_IX(A, BSZ) \
+    (((BSZ) - (A)->min_block_size) / sizeof(Unit_t))
+
+static void blk_cache_trim(Allctr_t *allctr, int flush);
+
+static ERTS_INLINE void *
+blk_cache_alloc(Allctr_t *allctr, Uint blk_sz)
+{
+    ErtsAlcBlkCacheList_t *bc;
+    void *res;
+
+    ASSERT(blk_sz <= allctr->blk_cache.max_blk_sz);
+    bc = &allctr->blk_cache.lists[ERTS_ALCU_BLK_CACHE_IX(allctr, blk_sz)];
+    res = bc->list;
+    if (!res)
+	INC_CC(allctr->blk_cache.misses);
+    else {
+	INC_CC(allctr->blk_cache.hits);
+	bc->list = *((void **) res);
+	bc->list_size--;
+	if (bc->min_list_size > bc->list_size)
+	    bc->min_list_size = bc->list_size;
+	allctr->blk_cache.blocks--;
+	allctr->blk_cache.blocks_size -= blk_sz;
+	ASSERT(MBC_ABLK_SZ(UMEM2BLK(res)) == blk_sz);
+    }
+    if (--allctr->blk_cache.ops <= 0)
+	blk_cache_trim(allctr, 0);
+    return res;
+}
+
+static ERTS_INLINE int
+blk_cache_free(Allctr_t *allctr, void *p, Carrier_t **busy_pcrr_pp)
+{
+    ErtsAlcBlkCacheList_t *bc;
+    Uint blk_sz;
+
+    if (!allctr->blk_cache.max_blk_sz)
+	return 0;
+    if (busy_pcrr_pp && *busy_pcrr_pp)
+	return 0;
+    blk_sz = MBC_ABLK_SZ(UMEM2BLK(p));
+    if (blk_sz > allctr->blk_cache.max_blk_sz)
+	return 0;
+    bc = &allctr->blk_cache.lists[ERTS_ALCU_BLK_CACHE_IX(allctr, blk_sz)];
+    if (bc->list_size >= ERTS_ALCU_BLK_CACHE_MAX_LIST_SZ
+	|| allctr->blk_cache.blocks_size >= ERTS_ALCU_BLK_CACHE_MAX_SIZE)
+	return 0;
+    *((void **) p) = bc->list;
+    bc->list = p;
+    bc->list_size++;
+    allctr->blk_cache.blocks++;
+    allctr->blk_cache.blocks_size += blk_sz;
+    if (--allctr->blk_cache.ops <= 0)
+	blk_cache_trim(allctr, 0);
+    return 1;
+}
+
+static void
+blk_cache_dealloc(Allctr_t *allctr, void *ptr)
+{
+#ifdef ERTS_SMP
+    if (ERTS_ALC_IS_CPOOL_ENABLED(allctr)) {
+	Carrier_t *busy_pcrr_p;
+	Allctr_t *used_allctr;
+	used_allctr = get_used_allctr(allctr, ERTS_ALC_TS_PREF_LOCK_NO, ptr,
+				      NULL, &busy_pcrr_p);
+	if (used_allctr == allctr) {
+	    mbc_free(allctr, ptr, &busy_pcrr_p);
+	    clear_busy_pool_carrier(allctr, busy_pcrr_p);
+	}
+	else {
+	    /* Carrier migrated; need to redirect block to new owner... */
+	    int cinit = used_allctr->dd.ix - allctr->dd.ix;
+
+	    ERTS_ALC_CPOOL_ASSERT(!busy_pcrr_p);
+
+	    DEC_CC(allctr->calls.this_free);
+	    if (ddq_enqueue(&used_allctr->dd.q, ptr, cinit))
+		erts_alloc_notify_delayed_dealloc(used_allctr->ix);
+	}
+	return;
+    }
+#endif
+    mbc_free(allctr, ptr, NULL);
+}
+
+static void
+blk_cache_trim(Allctr_t *allctr, int flush)
+{
+    int ix;
+
+    allctr->blk_cache.ops = ERTS_ALCU_BLK_CACHE_TRIM_OPS;
+
+    for (ix = 0; ix < allctr->blk_cache.no_lists; ix++) {
+	ErtsAlcBlkCacheList_t *bc = &allctr->blk_cache.lists[ix];
+	int n = flush ? bc->list_size : bc->min_list_size;
+	while (n-- > 0) {
+	    void *ptr = bc->list;
+	    ASSERT(ptr);
+	    bc->list = *((void **) ptr);
+	    bc->list_size--;
+	    allctr->blk_cache.blocks--;
+	    allctr->blk_cache.blocks_size -= MBC_ABLK_SZ(UMEM2BLK(ptr));
+	    blk_cache_dealloc(allctr, ptr);
+	}
+	bc->min_list_size = bc->list_size;
+    }
+}
+
+void
+erts_alcu_flush_block_cache(Allctr_t *allctr)
+{
+    if (allctr->blk_cache.max_blk_sz) {
+	ERTS_ALCU_DBG_CHK_THR_ACCESS(allctr);
+	blk_cache_trim(allctr, 1);
+    }
+}
+
 static void
 dealloc_block(Allctr_t *allctr, void *ptr, ErtsAlcFixList_t *fix, int dec_cc_on_redirect)
 {
@@ -2247,11 +2488,13 @@ dealloc_block(Allctr_t *allctr, void *ptr, ErtsAlcFixList_t *fix, int dec_cc_on_
 #endif
     }
 #ifndef ERTS_SMP
-    else
+    else if (!blk_cache_free(allctr, ptr, NULL))
 	mbc_free(allctr, ptr, NULL);
 #else
-    else if (!ERTS_ALC_IS_CPOOL_ENABLED(allctr))
-	mbc_free(allctr, ptr, NULL);
+    else if (!ERTS_ALC_IS_CPOOL_ENABLED(allctr)) {
+	if (!blk_cache_free(allctr, ptr, NULL))
+	    mbc_free(allctr, ptr, NULL);
+    }
     else {
 	Carrier_t *busy_pcrr_p;
 	Allctr_t *used_allctr;
@@ -2264,7 +2507,8 @@ dealloc_block(Allctr_t *allctr, void *ptr, ErtsAlcFixList_t *fix, int dec_cc_on_
 		    fix->u.cpool.used--;
 		fix->u.cpool.allocated--;
 	    }
-	    mbc_free(allctr, ptr, &busy_pcrr_p);
+	    if (!blk_cache_free(allctr, ptr, &busy_pcrr_p))
+		mbc_free(allctr, ptr, &busy_pcrr_p);
 	    clear_busy_pool_carrier(allctr, busy_pcrr_p);
 	}
 	else {
@@ -2450,6 +2694,10 @@ mbc_free(Allctr_t *allctr, void *p, Carrier_t **busy_pcrr_pp)
     Block_t *blk;
     Block_t *nxt_blk;
     Carrier_t *crr;
+#if defined(ERTS_SMP) && defined(ERTS_HAVE_MEM_DISCARD)
+    char *freed_start, *freed_end;
+    UWord discard_unit;
+#endif
 
     ASSERT(p);
 
@@ -2468,6 +2716,15 @@ mbc_free(Allctr_t *allctr, void *p, Carrier_t **busy_pcrr_pp)
 
     is_first_blk = IS_MBC_FIRST_ABLK(allctr, blk);
     is_last_blk = IS_LAST_BLK(blk);
+#if defined(ERTS_SMP) && defined(ERTS_HAVE_MEM_DISCARD)
+    /* Including the footer page of a free block before it, and the
+     * header page of a free block after it */
+    discard_unit = carrier_discard_unit(crr);
+    freed_start = (char *) DISCARD_FLOOR((char *) blk, discard_unit);
+    freed_end = (char *) DISCARD_CEILING(((char *) blk) + blk_sz
+					 + allctr->min_block_size,
+					 discard_unit);
+#endif
 
     if (IS_PREV_BLK_FREE(blk)) {
 	ASSERT(!is_first_blk); 
@@ -2528,6 +2785,11 @@ mbc_free(Allctr_t *allctr, void *p, Carrier_t **busy_pcrr_pp)
 	(*allctr->link_free_block)(allctr, blk);
 	HARD_CHECK_BLK_CARRIER(allctr, blk);
 #ifdef ERTS_SMP
+#ifdef ERTS_HAVE_MEM_DISCARD
+	if (busy_pcrr_pp && *busy_pcrr_pp)
+	    discard_free_blk_range(allctr, blk, blk_sz,
+				   freed_start, freed_end, discard_unit);
+#endif
 	check_abandon_carrier(allctr, blk, busy_pcrr_pp);
 #endif
     }
@@ -3640,6 +3902,8 @@ abandon_carrier(Allctr_t *allctr, Carrier_t *crr)
     max_size = (erts_aint_t) allctr->largest_fblk_in_mbc(allctr, crr);
     erts_atomic_set_nob(&crr->cpool.max_size, max_size);
 
+    discard_carrier_free_blks(allctr, crr);
+
     cpool_insert(allctr, crr);
 
     set_new_allctr_abandon_limit(allctr);
@@ -4240,6 +4504,7 @@ static struct {
     Eterm smbcs;
     Eterm mbcgs;
     Eterm acul;
+    Eterm bcs;
 
 #if HAVE_ERTS_MSEG
     Eterm mmc;
@@ -4277,6 +4542,10 @@ static struct {
     Eterm mseg_dealloc;
     Eterm mseg_realloc;
 #endif
+
+    Eterm block_cache;
+    Eterm hits;
+    Eterm misses;
 #ifdef DEBUG
     Eterm end_of_atoms;
 #endif
@@ -4330,6 +4599,7 @@ init_atoms(Allctr_t *allctr)
 	AM_INIT(smbcs);
 	AM_INIT(mbcgs);
 	AM_INIT(acul);
+	AM_INIT(bcs);
 
 #if HAVE_ERTS_MSEG
 	AM_INIT(mmc);
@@ -4368,6 +4638,10 @@ init_atoms(Allctr_t *allctr)
 	AM_INIT(mseg_realloc);
 #endif
 
+	AM_INIT(block_cache);
+	AM_INIT(hits);
+	AM_INIT(misses);
+
 #ifdef DEBUG
 	for (atom = (Eterm *) &am; atom < &am.end_of_atoms; atom++) {
 	    ASSERT(*atom != THE_NON_VALUE);
@@ -4881,6 +5155,49 @@ info_calls(Allctr_t *allctr,
     return res;
 }
 
+static Eterm
+info_blk_cache(Allctr_t *allctr,
+	       int *print_to_p,
+	       void *print_to_arg,
+	       Uint **hpp,
+	       Uint *szp)
+{
+    Eterm res = THE_NON_VALUE;
+
+    if (print_to_p) {
+	int to = *print_to_p;
+	void *arg = print_to_arg;
+	erts_print(to, arg, "block_cache blocks: %bpu\n",
+		   allctr->blk_cache.blocks);
+	erts_print(to, arg, "block_cache blocks size: %bpu\n",
+		   allctr->blk_cache.blocks_size);
+	erts_print(to, arg, "block_cache hits: %b64u\n",
+		   allctr->blk_cache.hits);
+	erts_print(to, arg, "block_cache misses: %b64u\n",
+		   allctr->blk_cache.misses);
+    }
+
+    if (hpp || szp) {
+	res = NIL;
+	add_3tup(hpp, szp, &res,
+		 am.misses,
+		 bld_unstable_uint(hpp, szp, ERTS_ALC_CC_GIGA_VAL(allctr->blk_cache.misses)),
+		 bld_unstable_uint(hpp, szp, ERTS_ALC_CC_VAL(allctr->blk_cache.misses)));
+	add_3tup(hpp, szp, &res,
+		 am.hits,
+		 bld_unstable_uint(hpp, szp, ERTS_ALC_CC_GIGA_VAL(allctr->blk_cache.hits)),
+		 bld_unstable_uint(hpp, szp, ERTS_ALC_CC_VAL(allctr->blk_cache.hits)));
+	add_2tup(hpp, szp, &res,
+		 am.blocks_size,
+		 bld_unstable_uint(hpp, szp, allctr->blk_cache.blocks_size));
+	add_2tup(hpp, szp, &res,
+		 am.blocks,
+		 bld_unstable_uint(hpp, szp, allctr->blk_cache.blocks));
+    }
+
+    return res;
+}
+
 static Eterm
 info_options(Allctr_t *allctr,
              int *print_to_p,
@@ -4890,6 +5207,7 @@ info_options(Allctr_t *allctr,
 {
     Eterm res = THE_NON_VALUE;
     int acul;
+    Uint bcs;
 
     if (!allctr) {
 	if (print_to_p)
@@ -4906,6 +5224,7 @@ info_options(Allctr_t *allctr,
 #else
     acul = 0;
 #endif
+    bcs = allctr->blk_cache.bcs;
 
     if (print_to_p) {
 	char topt[21]; /* Enough for any 64-bit integer */
@@ -4933,7 +5252,8 @@ info_options(Allctr_t *allctr,
 		   "option lmbcs: %beu\n"
 		   "option smbcs: %beu\n"
 		   "option mbcgs: %beu\n"
-		   "option acul: %d\n",
+		   "option acul: %d\n"
+		   "option bcs: %beu\n",
 		   topt,
 		   allctr->ramv ? "true" : "false",
 		   allctr->sbc_threshold,
@@ -4951,13 +5271,17 @@ info_options(Allctr_t *allctr,
 		   allctr->largest_mbc_size,
 		   allctr->smallest_mbc_size,
 		   allctr->mbc_growth_stages,
-		   acul);
+		   acul,
+		   bcs);
     }
 
     res = (*allctr->info_options)(allctr, "option ", print_to_p, print_to_arg,
 				  hpp, szp);
 
     if (hpp || szp) {
+	add_2tup(hpp, szp, &res,
+		 am.bcs,
+		 bld_uint(hpp, szp, bcs));
 	add_2tup(hpp, szp, &res,
 		 am.acul,
 		 bld_uint(hpp, szp, (UWord) acul));
@@ -5202,6 +5526,7 @@ erts_alcu_info(Allctr_t *allctr,
 	       Uint *szp)
 {
     Eterm res, sett, mbcs, sbcs, calls, fix = THE_NON_VALUE;
+    Eterm blk_cache = THE_NON_VALUE;
 #ifdef ERTS_SMP
     Eterm mbcs_pool;
 #endif
@@ -5259,10 +5584,14 @@ erts_alcu_info(Allctr_t *allctr,
     sbcs = info_carriers(allctr, &allctr->sbcs, "sbcs ", print_to_p,
 			 print_to_arg, hpp, szp);
     calls = info_calls(allctr, print_to_p, print_to_arg, hpp, szp);
+    if (allctr->blk_cache.max_blk_sz)
+	blk_cache = info_blk_cache(allctr, print_to_p, print_to_arg, hpp, szp);
 
     if (hpp || szp) {
 	res = NIL;
 
+	if (allctr->blk_cache.max_blk_sz)
+	    add_2tup(hpp, szp, &res, am.block_cache, blk_cache);
 	add_2tup(hpp, szp, &res, am.calls, calls);
 	add_2tup(hpp, szp, &res, am.sbcs, sbcs);
 #ifdef ERTS_SMP
@@ -5321,6 +5650,10 @@ erts_alcu_current_size(Allctr_t *allctr, AllctrSize_t *size, ErtsAlcUFixInfo_t *
     }
 #endif
 
+    /* Cached blocks are not in use */
+    if (size->blocks >= allctr->blk_cache.blocks_size)
+	size->blocks -= allctr->blk_cache.blocks_size;
+
     if (fi) {
 	int ix;
 	for (ix = 0; ix < fisz; ix++) {
@@ -5349,6 +5682,249 @@ erts_alcu_current_size(Allctr_t *allctr, AllctrSize_t *size, ErtsAlcUFixInfo_t *
 
 /* ----------------------------------------------------------------------- */
 
+/*
+ * Allocation profiler.
+ *
+ * When enabled by erlang:system_flag(alloc_profile, N), every N:th
+ * allocation or reallocation made through an alloc_util instance is
+ * sampled. A sample is attributed to the allocation type
+ * and to the allocation site, which is the function that the current
+ * process executes as far as it can be determined without walking
+ * the stack (compare process_info(Pid, current_function)), the atom
+ * 'port' if a port is executing, or 'undefined'. BIFs set
+ * p->current, and the binary construction instructions update p->i
+ * (SET_ALLOC_SITE() in beam_emu.c); other allocations made from the
+ * emulator loop may be attributed to a function executed earlier.
+ *
+ * Samples are aggregated into a fixed size table, so that sampling
+ * never allocates memory. Sites that do not fit in the table are
+ * accounted per type with the site 'other'. The per instance
+ * countdown is protected the same way as the rest of the instance.
+ */
+
+#define ERTS_ALCU_PROF_TAB_SIZE		4096	/* Must be a power of 2 */
+#define ERTS_ALCU_PROF_MAX_PROBES	32
+#define ERTS_ALCU_PROF_IDLE_COUNT	1024	/* Checks when disabled */
+
+typedef struct {
+    Uint count;		/* 0 if unused */
+    Uint bytes;
+    Eterm mod;		/* am_undefined, am_port, or module */
+    Eterm func;
+    Uint arity;
+    ErtsAlcType_t alloc_no;
+    ErtsAlcType_t type_no;
+} ErtsAlcuProfEntry_t;
+
+static struct {
+    erts_atomic_t interval;
+    erts_mtx_t mtx;
+    Uint used;
+    ErtsAlcuProfEntry_t tab[ERTS_ALCU_PROF_TAB_SIZE];
+    ErtsAlcuProfEntry_t other[ERTS_ALC_N_MAX + 1];
+} alloc_prof;
+
+static void
+alloc_profile_init(void)
+{
+    erts_atomic_init_nob(&alloc_prof.interval, 0);
+    erts_mtx_init(&alloc_prof.mtx, "alcu_alloc_profile");
+    alloc_prof.used = 0;
+    sys_memzero((void *) alloc_prof.tab, sizeof(alloc_prof.tab));
+    sys_memzero((void *) alloc_prof.other, sizeof(alloc_prof.other));
+}
+
+static ERTS_INLINE Uint
+alloc_profile_hash(ErtsAlcType_t type_no, Eterm mod, Eterm func, Uint arity)
+{
+    Uint h = (Uint) type_no;
+    h = h*31 + (Uint) atom_val(mod);
+    h = h*31 + (is_atom(func) ? (Uint) atom_val(func) : 0);
+    h = h*31 + arity;
+    return h ^ (h >> 11);
+}
+
+static void
+alloc_profile_sample(Allctr_t *allctr, ErtsAlcType_t type_no,
+		     Uint size, Sint interval)
+{
+    ErtsSchedulerData *esdp = erts_get_scheduler_data();
+    ErtsAlcuProfEntry_t *ep;
+    Eterm mod = am_undefined, func = THE_NON_VALUE;
+    Uint arity = 0, ix, i;
+
+    allctr->prof_countdown = interval;
+
+    if (esdp && esdp->current_process) {
+	Process *p = esdp->current_process;
+	BeamInstr *mfa = p->current;
+	if (!mfa) {
+	    FunctionInfo fi;
+	    erts_lookup_function_info(&fi, p->i, 0);
+	    mfa = fi.current;
+	}
+	if (mfa) {
+	    mod = (Eterm) mfa[0];
+	    func = (Eterm) mfa[1];
+	    arity = (Uint) mfa[2];
+	}
+    }
+    else if (esdp && esdp->current_port)
+	mod = am_port;
+
+    ix = alloc_profile_hash(type_no, mod, func, arity);
+
+    erts_mtx_lock(&alloc_prof.mtx);
+
+    for (i = 0; i < ERTS_ALCU_PROF_MAX_PROBES; i++) {
+	ep = &alloc_prof.tab[(ix + i) & (ERTS_ALCU_PROF_TAB_SIZE - 1)];
+	if (!ep->count) {
+	    ep->mod = mod;
+	    ep->func = func;
+	    ep->arity = arity;
+	    ep->alloc_no = allctr->alloc_no;
+	    ep->type_no = type_no;
+	    alloc_prof.used++;
+	    goto found;
+	}
+	if (ep->type_no == type_no
+	    && ep->alloc_no == allctr->alloc_no
+	    && ep->mod == mod
+	    && ep->func == func
+	    && ep->arity == arity)
+	    goto found;
+    }
+
+    ep = &alloc_prof.other[type_no];
+    ep->alloc_no = allctr->alloc_no;
+    ep->type_no = type_no;
+
+found:
+    ep->count++;
+    ep->bytes += size;
+
+    erts_mtx_unlock(&alloc_prof.mtx);
+}
+
+#define ERTS_ALCU_PROF_CHECK(Allctr, TypeNo, Size)			\
+do {									\
+    if (--(Allctr)->prof_countdown < 0) {				\
+	Sint interval__ = (Sint) erts_atomic_read_nob(&alloc_prof.interval); \
+	if (interval__)							\
+	    alloc_profile_sample((Allctr), (TypeNo), (Size), interval__ - 1); \
+	else								\
+	    (Allctr)->prof_countdown = ERTS_ALCU_PROF_IDLE_COUNT;	\
+    }									\
+} while (0)
+
+/*
+ * Set the sampling interval; 0 disables the profiler. Previously
+ * collected samples are thrown away. Returns the old interval.
+ */
+Uint
+erts_alcu_set_alloc_profile(Uint interval)
+{
+    Uint old;
+    erts_mtx_lock(&alloc_prof.mtx);
+    old = (Uint) erts_atomic_xchg_nob(&alloc_prof.interval,
+				      (erts_aint_t) interval);
+    sys_memzero((void *) alloc_prof.tab, sizeof(alloc_prof.tab));
+    sys_memzero((void *) alloc_prof.other, sizeof(alloc_prof.other));
+    alloc_prof.used = 0;
+    erts_mtx_unlock(&alloc_prof.mtx);
+    return old;
+}
+
+Uint
+erts_alcu_get_alloc_profile(void)
+{
+    return (Uint) erts_atomic_read_nob(&alloc_prof.interval);
+}
+
+/*
+ * Returns a list of {Allocator, Type, Site, Count, Bytes} where Count
+ * and Bytes are the sampled number of allocations and bytes scaled by
+ * the sampling interval.
+ */
+Eterm
+erts_alcu_alloc_profile_info(void *proc)
+{
+    Process *p = (Process *) proc;
+    ErtsAlcuProfEntry_t *ents;
+    Uint n, i, interval, sz;
+    Uint *hp;
+#ifdef DEBUG
+    Uint *hp_end;
+#endif
+    Eterm res;
+
+    ents = erts_alloc(ERTS_ALC_T_TMP,
+		      sizeof(ErtsAlcuProfEntry_t)
+		      * (ERTS_ALCU_PROF_TAB_SIZE + ERTS_ALC_N_MAX + 1));
+
+    n = 0;
+    erts_mtx_lock(&alloc_prof.mtx);
+    interval = (Uint) erts_atomic_read_nob(&alloc_prof.interval);
+    for (i = 0; i < ERTS_ALCU_PROF_TAB_SIZE; i++) {
+	if (alloc_prof.tab[i].count)
+	    ents[n++] = alloc_prof.tab[i];
+    }
+    for (i = 0; i <= ERTS_ALC_N_MAX; i++) {
+	if (alloc_prof.other[i].count) {
+	    ents[n] = alloc_prof.other[i];
+	    ents[n].mod = am_other;
+	    ents[n].func = THE_NON_VALUE;
+	    n++;
+	}
+    }
+    erts_mtx_unlock(&alloc_prof.mtx);
+
+    if (!interval)
+	interval = 1;
+
+    sz = 0;
+    for (i = 0; i < n; i++) {
+	sz += 2 + 6;
+	if (is_value(ents[i].func))
+	    sz += 4;
+	erts_bld_uint(NULL, &sz, ents[i].count * interval);
+	erts_bld_uint(NULL, &sz, ents[i].bytes * interval);
+    }
+
+    hp = HAlloc(p, sz);
+#ifdef DEBUG
+    hp_end = hp + sz;
+#endif
+    res = NIL;
+    for (i = 0; i < n; i++) {
+	char *alc = (char *) ERTS_ALC_A2AD(ents[i].alloc_no);
+	char *type = (char *) ERTS_ALC_N2TD(ents[i].type_no);
+	Eterm site, count, bytes, tpl;
+	if (is_value(ents[i].func)) {
+	    site = TUPLE3(hp, ents[i].mod, ents[i].func,
+			  make_small(ents[i].arity));
+	    hp += 4;
+	}
+	else
+	    site = ents[i].mod;
+	count = erts_bld_uint(&hp, NULL, ents[i].count * interval);
+	bytes = erts_bld_uint(&hp, NULL, ents[i].bytes * interval);
+	tpl = TUPLE5(hp,
+		     am_atom_put(alc, sys_strlen(alc)),
+		     am_atom_put(type, sys_strlen(type)),
+		     site, count, bytes);
+	hp += 6;
+	res = CONS(hp, tpl, res);
+	hp += 2;
+    }
+    ASSERT(hp == hp_end);
+
+    erts_free(ERTS_ALC_T_TMP, ents);
+    return res;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static ERTS_INLINE void *
 do_erts_alcu_alloc(ErtsAlcType_t type, void *extra, Uint size)
 {
@@ -5371,6 +5947,8 @@ do_erts_alcu_alloc(ErtsAlcType_t type, void *extra, Uint size)
 
     INC_CC(allctr->calls.this_alloc);
 
+    ERTS_ALCU_PROF_CHECK(allctr, type, size);
+
     if (allctr->fix) {
 	if (ERTS_ALC_IS_CPOOL_ENABLED(allctr))
 	    return fix_cpool_alloc(allctr, type, size);
@@ -5383,8 +5961,17 @@ do_erts_alcu_alloc(ErtsAlcType_t type, void *extra, Uint size)
 	blk = create_carrier(allctr, size, CFLG_SBC);
 	res = blk ? BLK2UMEM(blk) : NULL;
     }
-    else
+    else {
+	if (allctr->blk_cache.max_blk_sz) {
+	    Uint blk_sz = UMEMSZ2BLKSZ(allctr, size);
+	    if (blk_sz <= allctr->blk_cache.max_blk_sz) {
+		res = blk_cache_alloc(allctr, blk_sz);
+		if (res)
+		    return res;
+	    }
+	}
 	res = mbc_alloc(allctr, size);
+    }
 
     return res;
 }
@@ -5518,7 +6105,7 @@ do_erts_alcu_free(ErtsAlcType_t type, void *extra, void *p,
 	    Block_t *blk = UMEM2BLK(p);
 	    if (IS_SBC_BLK(blk))
 		destroy_carrier(allctr, blk, NULL);
-	    else
+	    else if (!blk_cache_free(allctr, p, busy_pcrr_pp))
 		mbc_free(allctr, p, busy_pcrr_pp);
 	}
     }
@@ -5634,6 +6221,8 @@ do_erts_alcu_realloc(ErtsAlcType_t type,
     }
 #endif
 
+    ERTS_ALCU_PROF_CHECK(allctr, type, size);
+
     INC_CC(allctr->calls.this_realloc);
     
     blk = UMEM2BLK(p);
@@ -6195,6 +6784,27 @@ erts_alcu_start(Allctr_t *allctr, AllctrInit_t *init)
 
     }
 
+    allctr->prof_countdown = 0;
+
+    allctr->blk_cache.bcs = init->bcs;
+    allctr->blk_cache.max_blk_sz = 0;
+    if (init->bcs && !init->ts && !init->fix
+	&& init->bcs < allctr->sbc_threshold) {
+	Uint ix;
+	allctr->blk_cache.max_blk_sz = UMEMSZ2BLKSZ(allctr, init->bcs);
+	allctr->blk_cache.no_lists
+	    = ERTS_ALCU_BLK_CACHE_IX(allctr, allctr->blk_cache.max_blk_sz) + 1;
+	allctr->blk_cache.lists
+	    = internal_alloc(sizeof(ErtsAlcBlkCacheList_t)
+			     * allctr->blk_cache.no_lists);
+	for (ix = 0; ix < allctr->blk_cache.no_lists; ix++) {
+	    allctr->blk_cache.lists[ix].list = NULL;
+	    allctr->blk_cache.lists[ix].list_size = 0;
+	    allctr->blk_cache.lists[ix].min_list_size = 0;
+	}
+	allctr->blk_cache.ops = ERTS_ALCU_BLK_CACHE_TRIM_OPS;
+    }
+
     if (init->fix) {
 	int i;
 	allctr->fix = init->fix;
@@ -6241,6 +6851,12 @@ erts_alcu_stop(Allctr_t *allctr)
 {
     allctr->stopped = 1;
 
+    if (allctr->blk_cache.lists) {
+	internal_free(allctr->blk_cache.lists);
+	allctr->blk_cache.max_blk_sz = 0;
+	allctr->blk_cache.lists = NULL;
+    }
+
     while (allctr->sbc_list.first)
 	destroy_carrier(allctr, SBC2BLK(allctr, allctr->sbc_list.first), NULL);
     while (allctr->mbc_list.first)
@@ -6275,12 +6891,16 @@ erts_alcu_init(AlcUInit_t *init)
     sys_alloc_carrier_size = ((init->ycs + 4095) / 4096) * 4096;
 #endif
     allow_sys_alloc_carriers = init->sac;
+#if defined(ERTS_SMP) && defined(ERTS_HAVE_MEM_DISCARD) && HAVE_ERTS_MSEG
+    mseg_discard_unit = erts_mseg_discard_unit();
+#endif
 
 #ifdef DEBUG
     carrier_alignment = sizeof(Unit_t);
 #endif
 
     erts_mtx_init(&init_atoms_mtx, "alcu_init_atoms");
+    alloc_profile_init();
 
     atoms_initialized = 0;
     initialized = 1;
@@ -64,6 +64,7 @@ typedef struct {
     UWord smbcs;
     UWord mbcgs;
     int acul;
+    UWord bcs;
 
     void *fix;
     size_t *fix_type_size;
@@ -118,6 +119,7 @@ typedef struct {
     1024*1024,		/* (bytes)  smbcs:  smallest mbc size            */\
     10,			/* (amount) mbcgs:  mbc growth stages            */\
     0,			/* (%)      acul:  abandon carrier utilization limit */\
+    0,			/* (bytes)  bcs:   block cache size              */\
     /* --- Data not options -------------------------------------------- */\
     NULL,		/* (ptr)    fix                                  */\
     NULL		/* (ptr)    fix_type_size                        */\
@@ -151,6 +153,7 @@ typedef struct {
     128*1024,		/* (bytes)  smbcs:  smallest mbc size            */\
     10,			/* (amount) mbcgs:  mbc growth stages            */\
     0,			/* (%)      acul:  abandon carrier utilization limit */\
+    0,			/* (bytes)  bcs:   block cache size              */\
     /* --- Data not options -------------------------------------------- */\
     NULL,		/* (ptr)    fix                                  */\
     NULL		/* (ptr)    fix_type_size                        */\
@@ -189,6 +192,10 @@ void    erts_alcu_current_size(Allctr_t *, AllctrSize_t *,
 void    erts_alcu_check_delayed_dealloc(Allctr_t *, int, int *, ErtsThrPrgrVal *, int *);
 #endif
 erts_aint32_t erts_alcu_fix_alloc_shrink(Allctr_t *, erts_aint32_t);
+void	erts_alcu_flush_block_cache(Allctr_t *);
+Uint	erts_alcu_set_alloc_profile(Uint);
+Uint	erts_alcu_get_alloc_profile(void);
+Eterm	erts_alcu_alloc_profile_info(void *);
 
 #ifdef ARCH_32
 extern UWord erts_literal_vspace_map[];
@@ -496,6 +503,12 @@ typedef struct {
     } u;
 } ErtsAlcFixList_t;
 
+typedef struct {
+    void *list;
+    int list_size;
+    int min_list_size;
+} ErtsAlcBlkCacheList_t;
+
 struct Allctr_t_ {
 #ifdef ERTS_SMP
     struct {
@@ -619,6 +632,22 @@ struct Allctr_t_ {
     int			fix_shrink_scheduled;
     ErtsAlcFixList_t	*fix;
 
+    /* Cache of small blocks; only used by single threaded instances */
+    struct {
+	Uint			bcs;		/* option */
+	Uint			max_blk_sz;	/* 0 if disabled */
+	Uint			no_lists;
+	ErtsAlcBlkCacheList_t	*lists;
+	int			ops;
+	UWord			blocks;
+	UWord			blocks_size;
+	CallCounter_t		hits;
+	CallCounter_t		misses;
+    } blk_cache;
+
+    /* Allocations left until next allocation profiler sample */
+    Sint		prof_countdown;
+
 #ifdef USE_THREADS
     /* Mutex for this allocator */
     erts_mtx_t		mutex;
@@ -610,7 +610,8 @@ static Eterm pi_args[] = {
     am_current_location,
     am_current_stacktrace,
     am_message_queue_data,
-    am_garbage_collection_info
+    am_garbage_collection_info,
+    am_message_queue_limit
 };
 
 #define ERTS_PI_ARGS ((int) (sizeof(pi_args)/sizeof(Eterm)))
@@ -661,6 +662,7 @@ pi_arg2ix(Eterm arg)
     case am_current_stacktrace:			return 31;
     case am_message_queue_data:			return 32;
     case am_garbage_collection_info:		return 33;
+    case am_message_queue_limit:		return 34;
     default:					return -1;
     }
 }
@@ -1374,6 +1376,14 @@ process_info_aux(Process *BIF_P,
 	break;
     }
 
+    case am_message_queue_limit: {
+	Uint hsz = 3;
+	(void) erts_message_queue_limit_map(rp, NULL, &hsz);
+	hp = HAlloc(BIF_P, hsz);
+	res = erts_message_queue_limit_map(rp, &hp, NULL);
+	break;
+    }
+
     case am_max_heap_size: {
 	Uint hsz = 3;
 	(void) erts_max_heap_size_map(MAX_HEAP_SIZE_GET(rp),
@@ -1816,6 +1826,16 @@ info_1_tuple(Process* BIF_P,	/* Pointer to current process. */
 	default:
 	    goto badarg;
 	}
+    } else if (ERTS_IS_ATOM_STR("dist_atom_cache", sel) && arity == 2) {
+	Eterm res = erts_dist_atom_cache_info(BIF_P, *tp);
+	if (is_non_value(res))
+	    goto badarg;
+	return res;
+    } else if (ERTS_IS_ATOM_STR("dist_stats", sel) && arity == 2) {
+	Eterm res = erts_dist_stats_info(BIF_P, *tp);
+	if (is_non_value(res))
+	    goto badarg;
+	return res;
     } else if (ERTS_IS_ATOM_STR("internal_cpu_topology", sel) && arity == 2) {
 	return erts_get_cpu_topology_term(BIF_P, *tp);
     } else if (ERTS_IS_ATOM_STR("cpu_topology", sel) && arity == 2) {
@@ -2348,6 +2368,9 @@ BIF_RETTYPE system_info_1(BIF_ALIST_1)
     else if (BIF_ARG_1 == am_alloc_util_allocators) {
 	BIF_RET(erts_alloc_util_allocators((void *) BIF_P));
     }
+    else if (BIF_ARG_1 == am_alloc_profile) {
+	BIF_RET(erts_alcu_alloc_profile_info((void *) BIF_P));
+    }
     else if (BIF_ARG_1 == am_elib_malloc) {
 	/* To be removed in R15 */
         BIF_RET(am_false);
@@ -2775,6 +2798,26 @@ BIF_RETTYPE system_info_1(BIF_ALIST_1)
 	hp = hsz ? HAlloc(BIF_P, hsz) : NULL;
 	res = erts_bld_uint(&hp, NULL, erts_dist_buf_busy_limit);
 	BIF_RET(res);
+    } else if (ERTS_IS_ATOM_STR("dist_compress_threshold", BIF_ARG_1)) {
+	Uint hsz = 0;
+
+ 	(void) erts_bld_uint(NULL, &hsz, erts_dist_compress_threshold);
+	hp = hsz ? HAlloc(BIF_P, hsz) : NULL;
+	res = erts_bld_uint(&hp, NULL, erts_dist_compress_threshold);
+	BIF_RET(res);
+    } else if (ERTS_IS_ATOM_STR("shared_terms", BIF_ARG_1)) {
+#ifdef ERTS_NEW_PURGE_STRATEGY
+	BIF_RET(am_reference);
+#else
+	BIF_RET(am_copy);
+#endif
+    } else if (ERTS_IS_ATOM_STR("dist_bin_ref_threshold", BIF_ARG_1)) {
+	Uint hsz = 0;
+
+ 	(void) erts_bld_uint(NULL, &hsz, erts_dist_bin_ref_threshold);
+	hp = hsz ? HAlloc(BIF_P, hsz) : NULL;
+	res = erts_bld_uint(&hp, NULL, erts_dist_bin_ref_threshold);
+	BIF_RET(res);
     } else if (ERTS_IS_ATOM_STR("delayed_node_table_gc", BIF_ARG_1)) {
 	Uint hsz = 0;
 	Uint dntgc = erts_delayed_node_table_gc();
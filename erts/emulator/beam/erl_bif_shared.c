@@ -0,0 +1,356 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * Shared terms.
+ *
+ * erlang:publish_shared/1 copies a term once into a literal area and
+ * returns a handle to it. The handle is a magic binary, so sending it
+ * only copies a ProcBin, and the garbage collector keeps track of it
+ * in the off heap list just as for any other binary. The copy keeps
+ * the sharing of subterms in the published term.
+ *
+ * With the new purge strategy erlang:shared_term/1 returns the
+ * published term itself without copying it; since it lives in a
+ * literal area it is never copied by the garbage collector either.
+ * When the last handle to a term in an area goes away the area is
+ * passed on to the literal area collector which, as for the literals
+ * of a purged module, makes every process that still refers to it
+ * copy what it refers to before the area is freed. Without the new
+ * purge strategy there is no literal area collector, so
+ * erlang:shared_term/1 copies the term to the heap of the caller
+ * instead, and the area is freed as soon as the last handle is gone.
+ *
+ * Handing an area over to the collector costs a scan of all
+ * processes. Small terms are therefore packed together into areas of
+ * ERTS_SHARED_TERM_AREA_SZ words which are handed over once all their
+ * terms have been released, while larger terms get an area of their
+ * own.
+ *
+ * The copies are made in one go and do not yield. The sharing
+ * preserving copy marks the source term while its size is calculated
+ * and restores it while copying, so the caller cannot be scheduled
+ * out (and garbage collected) in between. The cost is charged as
+ * reductions afterwards, as for a message send; the documentation
+ * warns against publishing large terms from latency sensitive
+ * processes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include "sys.h"
+#include "erl_vm.h"
+#include "global.h"
+#include "erl_process.h"
+#include "error.h"
+#include "bif.h"
+#include "erl_binary.h"
+#include "beam_load.h"
+
+#ifdef ERTS_NEW_PURGE_STRATEGY
+#define SHARED_TERMS_ALC_TYPE		ERTS_ALC_T_LITERAL
+#else
+/*
+ * Not in the literal range, since the terms are to be copied,
+ * sharing preserved, to the heaps of the processes using them.
+ */
+#define SHARED_TERMS_ALC_TYPE		ERTS_ALC_T_SHARED_TERM_AREA
+#endif
+
+#define ERTS_SHARED_TERM_AREA_SZ	(8*1024)
+#define ERTS_SHARED_TERM_MAX_PACKED_SZ	(ERTS_SHARED_TERM_AREA_SZ/8)
+
+typedef struct {
+    /* Terms in the area, plus one while terms are packed into it */
+    erts_refc_t refc;
+    int packed;
+    ErtsLiteralArea *literal_area;
+} ErtsSharedTermArea;
+
+typedef struct {
+    ErtsSharedTermArea *area;
+    Eterm term;
+} ErtsSharedTerm;
+
+static struct {
+    erts_smp_mtx_t mtx;
+    ErtsSharedTermArea *area;	/* area being packed */
+    Eterm *top;
+    Eterm *limit;
+#ifdef ERTS_SMP
+    erts_smp_atomic32_t release_sched;
+#endif
+} shared_terms;
+
+void
+erts_init_shared_terms(void)
+{
+    erts_smp_mtx_init(&shared_terms.mtx, "shared_terms");
+    shared_terms.area = NULL;
+    shared_terms.top = NULL;
+    shared_terms.limit = NULL;
+#ifdef ERTS_SMP
+    erts_smp_atomic32_init_nob(&shared_terms.release_sched, 0);
+#endif
+}
+
+static ErtsSharedTermArea *
+create_area(Uint size, int packed)
+{
+    ErtsSharedTermArea *ap;
+    ErtsLiteralArea *la;
+
+    ap = erts_alloc(ERTS_ALC_T_SHARED_TERM_AREA, sizeof(ErtsSharedTermArea));
+    la = erts_alloc(SHARED_TERMS_ALC_TYPE, ERTS_LITERAL_AREA_ALLOC_SIZE(size));
+    la->end = &la->start[0] + size;
+    la->off_heap = NULL;
+    erts_refc_init(&ap->refc, 1);
+    ap->packed = packed;
+    ap->literal_area = la;
+    return ap;
+}
+
+static void
+release_area(void *vap)
+{
+    ErtsSharedTermArea *ap = (ErtsSharedTermArea *) vap;
+    ErtsLiteralArea *la = ap->literal_area;
+
+    erts_free(ERTS_ALC_T_SHARED_TERM_AREA, ap);
+#ifdef ERTS_NEW_PURGE_STRATEGY
+    erts_queue_release_literals(NULL, la);
+#else
+    {
+	struct erl_off_heap_header *oh;
+	for (oh = la->off_heap; oh; oh = oh->next) {
+	    Binary *bptr = ((ProcBin *) oh)->val;
+	    ASSERT(thing_subtag(oh->thing_word) == REFC_BINARY_SUBTAG);
+	    if (erts_refc_dectest(&bptr->refc, 0) == 0)
+		erts_bin_free(bptr);
+	}
+	erts_free(SHARED_TERMS_ALC_TYPE, la);
+    }
+#endif
+}
+
+#ifdef ERTS_NEW_PURGE_STRATEGY
+/*
+ * The scheduler to hand an area over to the collector. The current
+ * one if we are on an ordinary scheduler, otherwise spread the work
+ * over all schedulers.
+ */
+static int
+release_scheduler(void)
+{
+#ifdef ERTS_SMP
+    ErtsSchedulerData *esdp = erts_get_scheduler_data();
+    Uint32 no;
+
+    if (esdp && !ERTS_SCHEDULER_IS_DIRTY(esdp))
+	return (int) esdp->no;
+    no = (Uint32) erts_smp_atomic32_inc_read_nob(&shared_terms.release_sched);
+    return (int) (no % (Uint32) erts_no_schedulers) + 1;
+#else
+    return 1;
+#endif
+}
+#endif
+
+static void
+area_dec_refc(ErtsSharedTermArea *ap)
+{
+    if (erts_refc_dectest(&ap->refc, 0) > 0)
+	return;
+#ifdef ERTS_NEW_PURGE_STRATEGY
+    /*
+     * We may be called from any thread and with any locks held, so
+     * let a scheduler hand the area over to the collector.
+     */
+    erts_schedule_misc_aux_work(release_scheduler(), release_area,
+				(void *) ap);
+#else
+    release_area((void *) ap);
+#endif
+}
+
+/*
+ * Reserve size words for a term in an area. Returns the area, with a
+ * reference for the term, and where to put the term in *hpp.
+ */
+static ErtsSharedTermArea *
+reserve_term_space(Uint size, Eterm **hpp)
+{
+    ErtsSharedTermArea *ap, *full = NULL;
+
+    if (size > ERTS_SHARED_TERM_MAX_PACKED_SZ) {
+	ap = create_area(size, 0);
+	*hpp = &ap->literal_area->start[0];
+	return ap;
+    }
+
+    erts_smp_mtx_lock(&shared_terms.mtx);
+    if (!shared_terms.area || shared_terms.limit - shared_terms.top < size) {
+	full = shared_terms.area;
+	shared_terms.area = create_area(ERTS_SHARED_TERM_AREA_SZ, 1);
+	shared_terms.top = &shared_terms.area->literal_area->start[0];
+	shared_terms.limit = shared_terms.area->literal_area->end;
+    }
+    ap = shared_terms.area;
+    erts_refc_inc(&ap->refc, 2);
+    *hpp = shared_terms.top;
+    shared_terms.top += size;
+    erts_smp_mtx_unlock(&shared_terms.mtx);
+
+    /* No more terms will be packed into it... */
+    if (full)
+	area_dec_refc(full);
+
+    return ap;
+}
+
+/*
+ * Only refc binaries are allowed among the off heap data of a
+ * literal area; see erts_release_literal_area().
+ */
+static int
+is_literal_off_heap(struct erl_off_heap_header *oh)
+{
+    for (; oh; oh = oh->next) {
+	if (thing_subtag(oh->thing_word) != REFC_BINARY_SUBTAG)
+	    return 0;
+    }
+    return 1;
+}
+
+/* Add the off heap data of a term to the area it was copied into */
+static void
+add_off_heap(ErtsSharedTermArea *ap, ErlOffHeap *ohp)
+{
+    struct erl_off_heap_header *last;
+
+    if (!ohp->first)
+	return;
+    for (last = ohp->first; last->next; last = last->next)
+	;
+    if (ap->packed)
+	erts_smp_mtx_lock(&shared_terms.mtx);
+    last->next = ap->literal_area->off_heap;
+    ap->literal_area->off_heap = ohp->first;
+    if (ap->packed)
+	erts_smp_mtx_unlock(&shared_terms.mtx);
+}
+
+static void
+shared_term_destructor(Binary *bp)
+{
+    ErtsSharedTerm *stp = (ErtsSharedTerm *) ERTS_MAGIC_BIN_DATA(bp);
+
+    if (stp->area)
+	area_dec_refc(stp->area);
+}
+
+static ErtsSharedTerm *
+get_shared_term(Eterm handle)
+{
+    Binary *bp;
+
+    if (!ERTS_TERM_IS_MAGIC_BINARY(handle))
+	return NULL;
+    bp = ((ProcBin *) binary_val(handle))->val;
+    if (ERTS_MAGIC_BIN_DESTRUCTOR(bp) != shared_term_destructor)
+	return NULL;
+    return (ErtsSharedTerm *) ERTS_MAGIC_BIN_DATA(bp);
+}
+
+BIF_RETTYPE publish_shared_1(BIF_ALIST_1)
+{
+    Binary *bp;
+    ErtsSharedTerm *stp;
+    Eterm *hp;
+
+    bp = erts_create_magic_binary(sizeof(ErtsSharedTerm),
+				  shared_term_destructor);
+    stp = (ErtsSharedTerm *) ERTS_MAGIC_BIN_DATA(bp);
+    stp->area = NULL;
+    stp->term = BIF_ARG_1;
+
+    if (!is_immed(BIF_ARG_1)) {
+	ErtsSharedTermArea *ap;
+	erts_shcopy_t info;
+	ErlOffHeap oh;
+	Uint size;
+
+	INITIALIZE_SHCOPY(info);
+	/* The area may not refer to literals of other areas... */
+	info.copy_literals = 1;
+	size = erts_copy_calculate(BIF_ARG_1, &info);
+	ap = reserve_term_space(size, &hp);
+	ERTS_INIT_OFF_HEAP(&oh);
+	stp->term = erts_copy_perform(BIF_ARG_1, size, &info, &hp, &oh);
+	DESTROY_SHCOPY(info);
+
+	if (!is_literal_off_heap(oh.first)) {
+	    erts_cleanup_offheap(&oh);
+	    if (ap->packed)
+		area_dec_refc(ap);
+	    else {
+		/* Never seen by anyone; no need for the collector */
+		erts_free(SHARED_TERMS_ALC_TYPE, ap->literal_area);
+		erts_free(ERTS_ALC_T_SHARED_TERM_AREA, ap);
+	    }
+	    erts_bin_free(bp);
+	    BIF_ERROR(BIF_P, BADARG);
+	}
+	add_off_heap(ap, &oh);
+	stp->area = ap;
+	BUMP_REDS(BIF_P, size / 16);
+    }
+
+    hp = HAlloc(BIF_P, PROC_BIN_SIZE);
+    BIF_RET(erts_mk_magic_binary_term(&hp, &MSO(BIF_P), bp));
+}
+
+BIF_RETTYPE shared_term_1(BIF_ALIST_1)
+{
+    ErtsSharedTerm *stp = get_shared_term(BIF_ARG_1);
+#ifndef ERTS_NEW_PURGE_STRATEGY
+    erts_shcopy_t info;
+    Eterm res, *hp;
+    Uint size;
+#endif
+
+    if (!stp)
+	BIF_ERROR(BIF_P, BADARG);
+#ifdef ERTS_NEW_PURGE_STRATEGY
+    BIF_RET(stp->term);
+#else
+    if (is_immed(stp->term))
+	BIF_RET(stp->term);
+    /* No literal area collector; the caller gets a copy... */
+    INITIALIZE_SHCOPY(info);
+    size = erts_copy_calculate(stp->term, &info);
+    hp = HAlloc(BIF_P, size);
+    res = erts_copy_perform(stp->term, size, &info, &hp, &MSO(BIF_P));
+    DESTROY_SHCOPY(info);
+    BUMP_REDS(BIF_P, size / 16);
+    BIF_RET(res);
+#endif
+}
@@ -1498,6 +1498,7 @@ BIF_RETTYPE ets_new_2(BIF_ALIST_2)
 
     tb->common.fixations = NULL;
     tb->common.compress = is_compressed;
+    erts_smp_atomic32_init_nob(&tb->common.shared_terms, 0);
 
 #ifdef DEBUG
     cret = 
@@ -2989,6 +2990,7 @@ void init_db(ErtsDbSpinCount db_spin_count)
     meta_pid_to_tab->common.slot   = -1;
     meta_pid_to_tab->common.meth   = &db_hash;
     meta_pid_to_tab->common.compress = 0;
+    erts_smp_atomic32_init_nob(&meta_pid_to_tab->common.shared_terms, 0);
 
     erts_refc_init(&meta_pid_to_tab->common.ref, 0);
     /* Neither rwlock or fixlock used
@@ -3020,6 +3022,7 @@ void init_db(ErtsDbSpinCount db_spin_count)
     meta_pid_to_fixed_tab->common.slot   = -1;
     meta_pid_to_fixed_tab->common.meth   = &db_hash;
     meta_pid_to_fixed_tab->common.compress = 0;
+    erts_smp_atomic32_init_nob(&meta_pid_to_fixed_tab->common.shared_terms, 0);
 
     erts_refc_init(&meta_pid_to_fixed_tab->common.ref, 0);
     /* Neither rwlock or fixlock used
@@ -2160,13 +2160,20 @@ restart:
 	    if (in_flags & ERTS_PAM_COPY_RESULT) {
 		Uint sz;
 		Eterm* top;
-		sz = size_object(term);
-		top = HAllocX(build_proc, sz, HEAP_XTRA);
 		if (in_flags & ERTS_PAM_CONTIGUOUS_TUPLE) {
+		    /* term is the tuple of a DbTerm, which may share
+		       subterms; copy the block as it is */
+		    DbTerm* dbterm;
 		    ASSERT(is_tuple(term));
+		    dbterm = (DbTerm*) (((char*) tuple_val(term))
+					- offsetof(DbTerm,tpl));
+		    sz = dbterm->size;
+		    top = HAllocX(build_proc, sz, HEAP_XTRA);
 		    *esp++ = copy_shallow(tuple_val(term), sz, &top, &MSO(build_proc));
 		}
 		else {
+		    sz = size_object(term);
+		    top = HAllocX(build_proc, sz, HEAP_XTRA);
 		    *esp++ = copy_struct(term, sz, &top, &MSO(build_proc));
 		}
 	    }
@@ -2716,7 +2723,9 @@ void db_do_update_element(DbUpdateHandle* handle,
 	    handle->flags |= DB_MUST_RESIZE;
 	    oldval = handle->dbterm->tpl[position];
 	}
-	else {
+	else if (!erts_smp_atomic32_read_nob(&handle->tb->common.shared_terms)) {
+	    /* the old value may be shared within the object unless
+	       the table only holds flat copies */
 	    if (is_boxed(newval)) {
 		newp = boxed_val(newval);
 		switch (*newp & _TAG_HEADER_MASK) {
@@ -2749,6 +2758,17 @@ void db_do_update_element(DbUpdateHandle* handle,
     /* Not possible for simple memcpy or dbterm is already non-contiguous, */
     /* need to realloc... */
 
+    if (!handle->tb->common.compress) {
+	erts_smp_atomic32_t *shared = &handle->tb->common.shared_terms;
+	if (erts_smp_atomic32_read_nob(shared)
+	    || (is_not_immed(newval) && erts_shcopy_probe(newval))) {
+	    /* Flat sizes are meaningless (and may be huge) for shared
+	       terms; db_finalize_resize() calculates the new size */
+	    erts_smp_atomic32_set_nob(shared, 1);
+	    goto size_unknown;
+	}
+    }
+
     newval_sz = is_immed(newval) ? 0 : size_object(newval);
 new_size_set:
 
@@ -2757,7 +2777,8 @@ both_size_set:
 
     handle->new_size = handle->new_size - oldval_sz + newval_sz;
 
-    /* write new value in old dbterm, finalize will make a flat copy */
+size_unknown:
+    /* write new value in old dbterm, finalize will make the copy */
     handle->dbterm->tpl[position] = newval;
     handle->flags |= DB_MUST_RESIZE;
 }
@@ -2897,8 +2918,18 @@ void* db_store_term(DbTableCommon *tb, DbTerm* old, Uint offset, Eterm obj)
     byte* basep;
     DbTerm* newp;
     Eterm* top;
-    int size = size_object(obj);
+    Uint size;
     ErlOffHeap tmp_offheap;
+    erts_shcopy_t info;
+
+    /* Objects with shared subterms are stored with the sharing
+       intact. Literals must always be copied into the table. */
+    INITIALIZE_SHCOPY(info);
+    info.copy_literals = 1;
+    size = erts_copy_calculate(obj, &info);
+    if (info.shared) {
+	erts_smp_atomic32_set_nob(&tb->shared_terms, 1);
+    }
 
     if (old != 0) {
 	basep = ((byte*) old) - offset;
@@ -2924,7 +2955,8 @@ void* db_store_term(DbTableCommon *tb, DbTerm* old, Uint offset, Eterm obj)
     newp->size = size;
     top = newp->tpl;
     tmp_offheap.first  = NULL;
-    copy_struct(obj, size, &top, &tmp_offheap);
+    erts_copy_perform(obj, size, &info, &top, &tmp_offheap);
+    DESTROY_SHCOPY(info);
     newp->first_oh = tmp_offheap.first;
 #ifdef DEBUG_CLONE
     newp->debug_clone = NULL;
@@ -2978,12 +3010,27 @@ void db_finalize_resize(DbUpdateHandle* handle, Uint offset)
 {
     DbTable* tbl = handle->tb;
     DbTerm* newDbTerm;
-    Uint alloc_sz = offset +
-	(tbl->common.compress ?
-	 db_size_dbterm_comp(&tbl->common, make_tuple(handle->dbterm->tpl)) :
-	 sizeof(DbTerm)+sizeof(Eterm)*(handle->new_size-1));
-    byte* newp = erts_db_alloc(ERTS_ALC_T_DB_TERM, tbl, alloc_sz);
+    Uint alloc_sz;
+    byte* newp;
     byte* oldp = *(handle->bp);
+    erts_shcopy_t info;
+
+    INITIALIZE_SHCOPY(info);
+    info.copy_literals = 1;
+    info.shared = 0;
+    if (tbl->common.compress) {
+	alloc_sz = offset +
+	    db_size_dbterm_comp(&tbl->common, make_tuple(handle->dbterm->tpl));
+    }
+    else {
+	/* new_size is only the flat size of the updated object */
+	if (erts_smp_atomic32_read_nob(&tbl->common.shared_terms)) {
+	    handle->new_size = erts_copy_calculate(make_tuple(handle->dbterm->tpl),
+						   &info);
+	}
+	alloc_sz = offset + sizeof(DbTerm)+sizeof(Eterm)*(handle->new_size-1);
+    }
+    newp = erts_db_alloc(ERTS_ALC_T_DB_TERM, tbl, alloc_sz);
 
     sys_memcpy(newp, oldp, offset);  /* copy only hash/tree header */
     *(handle->bp) = newp;
@@ -2993,8 +3040,6 @@ void db_finalize_resize(DbUpdateHandle* handle, Uint offset)
     newDbTerm->debug_clone = NULL;
 #endif
 
-    /* make a flat copy */
-
     if (tbl->common.compress) {
 	copy_to_comp(&tbl->common, make_tuple(handle->dbterm->tpl),
 		     newDbTerm, alloc_sz);
@@ -3008,7 +3053,9 @@ void db_finalize_resize(DbUpdateHandle* handle, Uint offset)
 	tmp_offheap.first = NULL;
 
 	{
-	    copy_struct(make_tuple(tpl), handle->new_size, &top, &tmp_offheap);
+	    erts_copy_perform(make_tuple(tpl), handle->new_size, &info,
+			      &top, &tmp_offheap);
+	    DESTROY_SHCOPY(info);
 	    newDbTerm->first_oh = tmp_offheap.first;
 	    ASSERT((byte*)top == (newp + alloc_sz));
 	}
@@ -233,6 +233,8 @@ typedef struct db_table_common {
     } time;
     DbFixation* fixations;    /* List of processes who have done safe_fixtable,
                                  "local" fixations not included. */ 
+    erts_smp_atomic32_t shared_terms; /* Some object has been stored
+                                         preserving shared subterms */
     /* All 32-bit fields */
     Uint32 status;            /* bit masks defined  below */
     int slot;                 /* slot index in meta_main_tab */
@@ -47,6 +47,7 @@
 #include "erl_async.h"
 #include "erl_ptab.h"
 #include "erl_bif_unique.h"
+#include "erl_check_io.h"
 #define ERTS_WANT_TIMER_WHEEL_API
 #include "erl_time.h"
 
@@ -379,6 +380,7 @@ erl_init(int ncpu,
     erts_init_bif_chksum();
     erts_init_bif_binary();
     erts_init_bif_re();
+    erts_init_shared_terms();
     erts_init_unicode(); /* after RE to get access to PCRE unicode */
     erts_init_external();
     erts_init_map();
@@ -588,6 +590,8 @@ void erts_usage(void)
 
     /*    erts_fprintf(stderr, "-i module  set the boot module (default init)\n"); */
 
+    erts_fprintf(stderr, "-IOp number    set number of pollsets, valid range is [1-%d]\n",
+		 ERTS_MAX_NO_OF_POLLSETS);
     erts_fprintf(stderr, "-K boolean     enable or disable kernel poll\n");
     erts_fprintf(stderr, "-n[s|a|d]      Control behavior of signals to ports\n");
     erts_fprintf(stderr, "               Note that this flag is deprecated!\n");
@@ -664,6 +668,10 @@ void erts_usage(void)
     erts_fprintf(stderr, "               see error_logger documentation for details\n");
     erts_fprintf(stderr, "-zdbbl size    set the distribution buffer busy limit in kilobytes\n");
     erts_fprintf(stderr, "               valid range is [1-%d]\n", INT_MAX/1024);
+    erts_fprintf(stderr, "-zdbrt size    set the distribution binary reference threshold in kilobytes\n");
+    erts_fprintf(stderr, "               valid range is [0-%d]\n", INT_MAX/1024);
+    erts_fprintf(stderr, "-zdct size     set the distribution compression threshold in kilobytes\n");
+    erts_fprintf(stderr, "               valid range is [0-%d]\n", INT_MAX/1024);
     erts_fprintf(stderr, "-zdntgc time   set delayed node table gc in seconds\n");
     erts_fprintf(stderr, "               valid values are infinity or intergers in the range [0-%d]\n",
 		 ERTS_NODE_TAB_DELAY_GC_MAX);
@@ -879,6 +887,27 @@ early_init(int *argc, char **argv) /*
 		    }
 		    break;
 		}
+		case 'I':
+		    if (has_prefix("Op", argv[i]+2)) {
+			/* set number of pollsets */
+			char *arg = get_arg(argv[i]+4, argv[i+1], &i);
+			int no_pollsets = atoi(arg);
+			if (no_pollsets < 1
+			    || no_pollsets > ERTS_MAX_NO_OF_POLLSETS) {
+			    erts_fprintf(stderr,
+					 "bad number of pollsets %s\n",
+					 arg);
+			    erts_usage();
+			}
+#if defined(ERTS_SMP) && !defined(__WIN32__)
+			/* Only one pollset in the non-smp emulator and
+			   on Windows */
+			erts_no_pollsets = no_pollsets;
+#endif
+			VERBOSE(DEBUG_SYSTEM, ("using %d pollset(s)\n",
+					       erts_no_pollsets));
+		    }
+		    break;
 		case 'S' :
 		    if (argv[i][2] == 'P') {
 			int ptot, ponln;
@@ -1165,15 +1194,18 @@ early_init(int *argc, char **argv) /*
      * * Unmanaged threads that need to register:
      * ** Async threads (see erl_async.c)
      * ** Dirty scheduler threads
+     * ** Poll threads (see erl_check_io.c)
      */
     erts_thr_progress_init(no_schedulers,
 			   no_schedulers+2,
 #ifndef ERTS_DIRTY_SCHEDULERS
-			   erts_async_max_threads
+			   erts_async_max_threads +
+			   erts_no_pollsets - 1
 #else
 			   erts_async_max_threads +
 			   erts_no_dirty_cpu_schedulers +
-			   erts_no_dirty_io_schedulers
+			   erts_no_dirty_io_schedulers +
+			   erts_no_pollsets - 1
 #endif
 			   );
 #endif
@@ -1224,6 +1256,8 @@ early_init(int *argc, char **argv) /*
     erts_ets_realloc_always_moves = 0;
     erts_ets_always_compress = 0;
     erts_dist_buf_busy_limit = ERTS_DE_BUSY_LIMIT;
+    erts_dist_compress_threshold = ERTS_DIST_COMPRESS_THRESHOLD;
+    erts_dist_bin_ref_threshold = ERTS_DIST_BIN_REF_THRESHOLD;
 
     return ncpu;
 }
@@ -1712,6 +1746,15 @@ erl_start(int argc, char **argv)
 	    }
 	    break;
 
+	case 'I': /* Was handled in early_init() just read past it */
+	    if (has_prefix("Op", argv[i]+2))
+		(void) get_arg(argv[i]+4, argv[i+1], &i);
+	    else {
+		erts_fprintf(stderr, "bad I/O flag %s\n", argv[i]);
+		erts_usage();
+	    }
+	    break;
+
 	case 'S' : /* Was handled in early_init() just read past it */
 	    if (argv[i][2] == 'D') {
 		char* type = argv[i]+3;
@@ -2122,6 +2165,28 @@ erl_start(int argc, char **argv)
 		    erts_dist_buf_busy_limit = new_limit*1024;
 		}
 	    }
+	    else if (has_prefix("dbrt", sub_param)) {
+		int new_threshold;
+		arg = get_arg(sub_param+4, argv[i+1], &i);
+		new_threshold = atoi(arg);
+		if (new_threshold < 0 || INT_MAX/1024 < new_threshold) {
+		    erts_fprintf(stderr, "Invalid dbrt threshold: %d\n", new_threshold);
+		    erts_usage();
+		} else {
+		    erts_dist_bin_ref_threshold = new_threshold*1024;
+		}
+	    }
+	    else if (has_prefix("dct", sub_param)) {
+		int new_threshold;
+		arg = get_arg(sub_param+3, argv[i+1], &i);
+		new_threshold = atoi(arg);
+		if (new_threshold < 0 || INT_MAX/1024 < new_threshold) {
+		    erts_fprintf(stderr, "Invalid dct threshold: %d\n", new_threshold);
+		    erts_usage();
+		} else {
+		    erts_dist_compress_threshold = new_threshold*1024;
+		}
+	    }
 	    else if (has_prefix("dntgc", sub_param)) {
 		long secs;
 
@@ -113,6 +113,7 @@ static erts_lc_lock_order_t erts_lock_order[] = {
     {	"export_tab",				NULL			},
     {	"fun_tab",				NULL			},
     {	"environ",				NULL			},
+    {	"shared_terms",				NULL			},
 #ifdef ERTS_NEW_PURGE_STRATEGY
     {	"release_literal_areas",		NULL			},
 #endif
@@ -189,6 +190,7 @@ static erts_lc_lock_order_t erts_lock_order[] = {
 #ifdef ERTS_SMP
     {	"os_monotonic_time",			NULL			},
 #endif
+    {	"alcu_alloc_profile",			NULL			},
     {	"erts_alloc_hard_debug",		NULL			},
     {	"hard_dbg_mseg",		        NULL	                },
     {	"erts_mmap",				NULL			}
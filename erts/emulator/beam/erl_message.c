@@ -31,6 +31,7 @@
 #include "erl_message.h"
 #include "erl_process.h"
 #include "erl_binary.h"
+#include "erl_map.h"
 #include "dtrace-wrapper.h"
 #include "beam_bp.h"
 
@@ -39,6 +40,34 @@ ERTS_SCHED_PREF_QUICK_ALLOC_IMPL(message_ref,
 				 ERL_MESSAGE_BUF_SZ,
 				 ERTS_ALC_T_MSG_REF)
 
+/*
+ * Small messages are allocated from scheduler specific pools, one
+ * per size class. A message freed by another thread than the
+ * scheduler that allocated it is passed back to the pool of that
+ * scheduler. When a pool is exhausted, or the allocating thread is
+ * not a scheduler, the message is allocated in the ordinary way,
+ * still rounded up to the size class.
+ */
+ERTS_SCHED_PREF_QUICK_ALLOC_IMPL(tiny_fix_sz_msg,
+				 ErtsTinyFixSzMessage,
+				 2048,
+				 ERTS_ALC_T_MSG)
+
+ERTS_SCHED_PREF_QUICK_ALLOC_IMPL(small_fix_sz_msg,
+				 ErtsSmallFixSzMessage,
+				 1024,
+				 ERTS_ALC_T_MSG)
+
+ERTS_SCHED_PREF_QUICK_ALLOC_IMPL(medium_fix_sz_msg,
+				 ErtsMediumFixSzMessage,
+				 512,
+				 ERTS_ALC_T_MSG)
+
+ERTS_SCHED_PREF_QUICK_ALLOC_IMPL(large_fix_sz_msg,
+				 ErtsLargeFixSzMessage,
+				 256,
+				 ERTS_ALC_T_MSG)
+
 #if defined(DEBUG) && 0
 #define HARD_DEBUG
 #else
@@ -49,6 +78,10 @@ void
 init_message(void)
 {
     init_message_ref_alloc();
+    init_tiny_fix_sz_msg_alloc();
+    init_small_fix_sz_msg_alloc();
+    init_medium_fix_sz_msg_alloc();
+    init_large_fix_sz_msg_alloc();
 }
 
 void *erts_alloc_message_ref(void)
@@ -61,6 +94,45 @@ void erts_free_message_ref(void *mp)
     message_ref_free((ErtsMessageRef *) mp);
 }
 
+ErtsMessage *erts_alloc_fix_sz_message(Uint sz, Uint *alloc_szp)
+{
+    ASSERT(sz <= ERTS_LARGE_FIX_MSG_SZ);
+    if (sz <= ERTS_TINY_FIX_MSG_SZ) {
+	*alloc_szp = ERTS_TINY_FIX_MSG_SZ;
+	return (ErtsMessage *) tiny_fix_sz_msg_alloc();
+    }
+    if (sz <= ERTS_SMALL_FIX_MSG_SZ) {
+	*alloc_szp = ERTS_SMALL_FIX_MSG_SZ;
+	return (ErtsMessage *) small_fix_sz_msg_alloc();
+    }
+    if (sz <= ERTS_MEDIUM_FIX_MSG_SZ) {
+	*alloc_szp = ERTS_MEDIUM_FIX_MSG_SZ;
+	return (ErtsMessage *) medium_fix_sz_msg_alloc();
+    }
+    *alloc_szp = ERTS_LARGE_FIX_MSG_SZ;
+    return (ErtsMessage *) large_fix_sz_msg_alloc();
+}
+
+/*
+ * The size class is found from hfrag.alloc_size. A message that has
+ * been shrunk by erts_realloc_shrink_message() to a small size does
+ * not belong to any pool; the pool free functions detect this and
+ * fall back on erts_free().
+ */
+void erts_free_fix_sz_message(ErtsMessage *mp)
+{
+    Uint sz = mp->hfrag.alloc_size;
+    ASSERT(sz <= ERTS_LARGE_FIX_MSG_SZ);
+    if (sz <= ERTS_TINY_FIX_MSG_SZ)
+	tiny_fix_sz_msg_free((ErtsTinyFixSzMessage *) mp);
+    else if (sz <= ERTS_SMALL_FIX_MSG_SZ)
+	small_fix_sz_msg_free((ErtsSmallFixSzMessage *) mp);
+    else if (sz <= ERTS_MEDIUM_FIX_MSG_SZ)
+	medium_fix_sz_msg_free((ErtsMediumFixSzMessage *) mp);
+    else
+	large_fix_sz_msg_free((ErtsLargeFixSzMessage *) mp);
+}
+
 /* Allocate message buffer (size in words) */
 ErlHeapFragment*
 new_message_buffer(Uint size)
@@ -207,7 +279,7 @@ erts_cleanup_messages(ErtsMessage *msgp)
 	ErlHeapFragment *bp;
 	if (is_non_value(ERL_MESSAGE_TERM(mp))) {
 	    if (is_not_immed(ERL_MESSAGE_TOKEN(mp))) {
-		bp = (ErlHeapFragment *) mp->data.dist_ext->ext_endp;
+		bp = erts_dist_ext_trailer(mp->data.dist_ext);
 		erts_cleanup_offheap(&bp->off_heap);
 	    }
 	    if (mp->data.dist_ext)
@@ -369,7 +441,150 @@ erts_queue_dist_message(Process *rcvr,
     }
 }
 
-/* Add messages last in message queue */
+#ifdef ERTS_SMP
+
+/*
+ * Detach all messages in the lock free in queue, and append them
+ * in the order they were sent to the in queue. If 'close' is set,
+ * the lock free in queue is closed, i.e., subsequent senders will
+ * drop their messages instead of pushing them.
+ *
+ * Caller must hold the msgq lock of the process.
+ */
+void
+erts_msgq_lf_fetch(Process *p, int close)
+{
+    ErtsMessage *mp, *first, **last;
+    erts_aint_t head;
+    Sint len;
+
+    ERTS_SMP_LC_ASSERT(ERTS_PROC_LOCK_MSGQ & erts_proc_lc_my_proc_locks(p));
+
+    head = erts_smp_atomic_xchg_acqb(&p->msg_inq.lf_first,
+				     (close
+				      ? ERTS_MSGQ_LF_CLOSED
+				      : ERTS_MSGQ_LF_EMPTY));
+    if (head == ERTS_MSGQ_LF_EMPTY || head == ERTS_MSGQ_LF_CLOSED)
+	return;
+
+    /* The stack is in reverse send order; reverse it... */
+    mp = (ErtsMessage *) head;
+    first = NULL;
+    last = &mp->next;
+    len = 0;
+    while (mp) {
+	ErtsMessage *next = mp->next;
+	mp->next = first;
+	first = mp;
+	mp = next;
+	len++;
+    }
+
+    erts_smp_atomic_add_nob(&p->msg_inq.lf_len, (erts_aint_t) -len);
+    LINK_MESSAGE_IMPL(p, first, last, len, msg_inq);
+}
+
+/*
+ * Push messages onto the lock free in queue of the receiver.
+ * Returns the number of messages on the lock free in queue after
+ * the push, or zero if the messages were dropped since the receiver
+ * has closed its lock free in queue (it is exiting).
+ */
+static Sint
+lf_enqueue_messages(Process *receiver, ErtsMessage *first, Uint len)
+{
+    erts_smp_atomic_t *lfq = &receiver->msg_inq.lf_first;
+    ErtsMessage *mp = first;
+    erts_aint_t head = erts_smp_atomic_read_nob(lfq);
+    Uint pushed = 0;
+    Sint lf_len;
+
+    while (pushed < len) {
+	ErtsMessage *next = mp->next;
+	while (1) {
+	    erts_aint_t act;
+	    if (head == ERTS_MSGQ_LF_CLOSED) {
+		mp->next = next;
+		erts_cleanup_messages(mp);
+		if (pushed)
+		    erts_smp_atomic_add_nob(&receiver->msg_inq.lf_len,
+					    (erts_aint_t) pushed);
+		return 0;
+	    }
+	    mp->next = (ErtsMessage *) head;
+	    act = erts_smp_atomic_cmpxchg_mb(lfq, (erts_aint_t) mp, head);
+	    if (act == head)
+		break;
+	    head = act;
+	}
+	head = (erts_aint_t) mp;
+	mp = next;
+	pushed++;
+    }
+
+    lf_len = (Sint) erts_smp_atomic_add_read_nob(&receiver->msg_inq.lf_len,
+						 (erts_aint_t) len);
+    /* The receiver may already have detached what we pushed... */
+    return lf_len < (Sint) len ? (Sint) len : lf_len;
+}
+
+#endif
+
+/* Internal result of msgq_limit_check(); message should be dropped */
+#define ERTS_MSGQ_LIMIT_RES_DROP (-3)
+
+static ERTS_INLINE Uint
+msgq_limit_qlen(Process *p)
+{
+    /* Unlocked reads; only used as an estimate... */
+    Uint qlen = (Uint) p->msg.len;
+#ifdef ERTS_SMP
+    Sint lf_len = (Sint) erts_smp_atomic_read_nob(&p->msg_inq.lf_len);
+    qlen += (Uint) p->msg_inq.len;
+    if (lf_len > 0)
+	qlen += (Uint) lf_len;
+#endif
+    return qlen;
+}
+
+/*
+ * Check the message queue limit of the receiver. Called with the
+ * msgq lock of the receiver locked, before 'len' messages are
+ * added to the queue. The signal and suspend policies only apply
+ * when the sender handles the result ('sender_acts'); other senders
+ * must not consume the busy flag, or the sender that the limit is
+ * meant for is never signaled.
+ */
+static ERTS_INLINE Sint
+msgq_limit_check(Process *receiver, Uint len, int sender_acts)
+{
+    ErtsMsgqLimit *limit = &receiver->msg.limit;
+    Uint qlen = msgq_limit_qlen(receiver);
+
+    switch (limit->policy) {
+    case ERTS_MSGQ_LIMIT_DROP:
+	return qlen + len > limit->max_len ? ERTS_MSGQ_LIMIT_RES_DROP : 0;
+    case ERTS_MSGQ_LIMIT_SIGNAL:
+	if (!sender_acts || qlen + len < limit->max_len)
+	    return 0;
+	/* Only signal the sender that hits the limit... */
+	if (erts_smp_atomic32_xchg_mb(&limit->busy, 1))
+	    return 0;
+	return ERTS_MSGQ_LIMIT_RES_SIGNAL;
+    case ERTS_MSGQ_LIMIT_SUSPEND:
+	if (!sender_acts || qlen + len < limit->max_len)
+	    return 0;
+	return ERTS_MSGQ_LIMIT_RES_SUSPEND;
+    default:
+	ERTS_INTERNAL_ERROR("Invalid message queue limit policy");
+	return 0;
+    }
+}
+
+/*
+ * Add messages last in message queue. Only returns the negative
+ * ERTS_MSGQ_LIMIT_RES_* results if 'sender_acts' is set.
+ */
 static Sint
 queue_messages(Process* receiver,
                erts_aint32_t *receiver_state,
@@ -377,10 +592,11 @@ queue_messages(Process* receiver,
                ErtsMessage* first,
                ErtsMessage** last,
                Uint len,
-               Eterm from)
+               Eterm from,
+               int sender_acts)
 {
     ErtsTracingEvent* te;
-    Sint res;
+    Sint res, limit_res = 0;
     int locked_msgq = 0;
     erts_aint32_t state;
 
@@ -395,6 +611,35 @@ queue_messages(Process* receiver,
                        receiver_locks == erts_proc_lc_my_proc_locks(receiver));
 #endif
 
+    if (!(receiver_locks & (ERTS_PROC_LOCK_MAIN|ERTS_PROC_LOCK_MSGQ))) {
+	if (receiver_state)
+	    state = *receiver_state;
+	else
+	    state = erts_smp_atomic32_read_nob(&receiver->state);
+
+	if ((state & ERTS_PSFLG_OFF_HEAP_MSGQ)
+	    && !IS_TRACED_FL(receiver, F_TRACE_RECEIVE)
+	    && !receiver->msg.limit.max_len) {
+	    /*
+	     * Off heap message queue; enqueue without taking
+	     * the msgq lock so that senders to a busy receiver
+	     * won't serialize on it...
+	     */
+	    if (state & (ERTS_PSFLG_EXITING|ERTS_PSFLG_PENDING_EXIT))
+		goto exiting;
+	    res = lf_enqueue_messages(receiver, first, len);
+	    if (!res)
+		return 0;
+	    erts_proc_notify_new_message(receiver, receiver_locks);
+	    /*
+	     * Unlocked reads of the locked parts of the queue; the
+	     * result is only used as an estimate when punishing the
+	     * sender...
+	     */
+	    return res + (Sint) receiver->msg.len + (Sint) receiver->msg_inq.len;
+	}
+    }
+
     if (!(receiver_locks & ERTS_PROC_LOCK_MSGQ)) {
 	if (erts_smp_proc_trylock(receiver, ERTS_PROC_LOCK_MSGQ) == EBUSY) {
             ErtsProcLocks need_locks;
@@ -431,6 +676,23 @@ queue_messages(Process* receiver,
 	return 0;
     }
 
+    /*
+     * Only ordinary messages sent by other processes count
+     * against the message queue limit; never messages sent
+     * by the runtime system.
+     */
+    if (receiver->msg.limit.max_len
+	&& is_pid(from)
+	&& from != receiver->common.id) {
+	limit_res = msgq_limit_check(receiver, len, sender_acts);
+	if (limit_res == ERTS_MSGQ_LIMIT_RES_DROP) {
+	    if (locked_msgq)
+		erts_smp_proc_unlock(receiver, ERTS_PROC_LOCK_MSGQ);
+	    erts_cleanup_messages(first);
+	    return 0;
+	}
+    }
+
     res = receiver->msg.len;
 #ifdef ERTS_SMP
     if (receiver_locks & ERTS_PROC_LOCK_MAIN) {
@@ -493,25 +755,26 @@ queue_messages(Process* receiver,
 #else
     erts_proc_notify_new_message(receiver, 0);
 #endif
-    return res;
+    return limit_res ? limit_res : res;
 }
 
 static Sint
 queue_message(Process* receiver,
               erts_aint32_t *receiver_state,
               ErtsProcLocks receiver_locks,
-              ErtsMessage* mp, Eterm msg, Eterm from)
+              ErtsMessage* mp, Eterm msg, Eterm from,
+              int sender_acts)
 {
     ERL_MESSAGE_TERM(mp) = msg;
     return queue_messages(receiver, receiver_state, receiver_locks,
-                          mp, &mp->next, 1, from);
+                          mp, &mp->next, 1, from, sender_acts);
 }
 
 Sint
 erts_queue_message(Process* receiver, ErtsProcLocks receiver_locks,
                    ErtsMessage* mp, Eterm msg, Eterm from)
 {
-    return queue_message(receiver, NULL, receiver_locks, mp, msg, from);
+    return queue_message(receiver, NULL, receiver_locks, mp, msg, from, 0);
 }
 
 
@@ -521,7 +784,7 @@ erts_queue_messages(Process* receiver, ErtsProcLocks receiver_locks,
                     Eterm from)
 {
     return queue_messages(receiver, NULL, receiver_locks,
-                          first, last, len, from);
+                          first, last, len, from, 0);
 }
 
 void
@@ -694,9 +957,7 @@ erts_send_message(Process* sender,
     Eterm utag = NIL;
 #endif
     erts_aint32_t receiver_state;
-#ifdef SHCOPY_SEND
     erts_shcopy_t info;
-#endif
 
 #ifdef USE_VM_PROBES
     *sender_name = *receiver_name = '\0';
@@ -737,12 +998,8 @@ erts_send_message(Process* sender,
         }
 #endif
 
-#ifdef SHCOPY_SEND
         INITIALIZE_SHCOPY(info);
-        msize = copy_shared_calculate(message, &info);
-#else
-        msize = size_object(message);
-#endif
+        msize = erts_copy_calculate(message, &info);
         mp = erts_alloc_message_heap_state(receiver,
                                            &receiver_state,
                                            receiver_locks,
@@ -754,14 +1011,8 @@ erts_send_message(Process* sender,
                                            &hp,
                                            &ohp);
 
-#ifdef SHCOPY_SEND
-	if (is_not_immed(message))
-            message = copy_shared_perform(message, msize, &info, &hp, ohp);
+        message = erts_copy_perform(message, msize, &info, &hp, ohp);
         DESTROY_SHCOPY(info);
-#else
-	if (is_not_immed(message))
-            message = copy_struct(message, msize, &hp, ohp);
-#endif
 	if (is_immed(stoken))
 	    token = stoken;
 	else
@@ -792,26 +1043,16 @@ erts_send_message(Process* sender,
 	    msize = 0;
 	}
 	else {
-#ifdef SHCOPY_SEND
             INITIALIZE_SHCOPY(info);
-            msize = copy_shared_calculate(message, &info);
-#else
-            msize = size_object(message);
-#endif
+            msize = erts_copy_calculate(message, &info);
 	    mp = erts_alloc_message_heap_state(receiver,
 					       &receiver_state,
 					       receiver_locks,
 					       msize,
 					       &hp,
 					       &ohp);
-#ifdef SHCOPY_SEND
-            if (is_not_immed(message))
-                message = copy_shared_perform(message, msize, &info, &hp, ohp);
+            message = erts_copy_perform(message, msize, &info, &hp, ohp);
             DESTROY_SHCOPY(info);
-#else
-            if (is_not_immed(message))
-                message = copy_struct(message, msize, &hp, ohp);
-#endif
 	}
 #ifdef USE_VM_PROBES
         DTRACE6(message_send, sender_name, receiver_name,
@@ -827,7 +1068,8 @@ erts_send_message(Process* sender,
 			&receiver_state,
 			*receiver_locks,
 			mp, message,
-                        sender->common.id);
+                        sender->common.id,
+			flags & ERTS_SND_FLG_MSGQ_LIMIT);
 
     return res;
 }
@@ -852,29 +1094,19 @@ erts_deliver_exit_message(Eterm from, Process *to, ErtsProcLocks *to_locksp,
     Eterm temptoken;
     ErtsMessage* mp;
     ErlOffHeap *ohp;
-#ifdef SHCOPY_SEND
     erts_shcopy_t info;
-#endif
 
     if (have_seqtrace(token)) {
 	ASSERT(is_tuple(token));
 	sz_token = size_object(token);
 	sz_from = size_object(from);
-#ifdef SHCOPY_SEND
         INITIALIZE_SHCOPY(info);
-        sz_reason = copy_shared_calculate(reason, &info);
-#else
-	sz_reason = size_object(reason);
-#endif
+        sz_reason = erts_copy_calculate(reason, &info);
 	mp = erts_alloc_message_heap(to, to_locksp,
 				     sz_reason + sz_from + sz_token + 4,
 				     &hp, &ohp);
-#ifdef SHCOPY_SEND
-        mess = copy_shared_perform(reason, sz_reason, &info, &hp, ohp);
+        mess = erts_copy_perform(reason, sz_reason, &info, &hp, ohp);
         DESTROY_SHCOPY(info);
-#else
-	mess = copy_struct(reason, sz_reason, &hp, ohp);
-#endif
 	from_copy = copy_struct(from, sz_from, &hp, ohp);
 	save = TUPLE3(hp, am_EXIT, from_copy, mess);
 	hp += 4;
@@ -885,21 +1117,13 @@ erts_deliver_exit_message(Eterm from, Process *to, ErtsProcLocks *to_locksp,
 	erts_queue_message(to, *to_locksp, mp, save, am_system);
     } else {
 	sz_from = IS_CONST(from) ? 0 : size_object(from);
-#ifdef SHCOPY_SEND
         INITIALIZE_SHCOPY(info);
-        sz_reason = copy_shared_calculate(reason, &info);
-#else
-	sz_reason = size_object(reason);
-#endif
+        sz_reason = erts_copy_calculate(reason, &info);
 	mp = erts_alloc_message_heap(to, to_locksp,
 				     sz_reason+sz_from+4, &hp, &ohp);
 
-#ifdef SHCOPY_SEND
-        mess = copy_shared_perform(reason, sz_reason, &info, &hp, ohp);
+        mess = erts_copy_perform(reason, sz_reason, &info, &hp, ohp);
         DESTROY_SHCOPY(info);
-#else
-	mess = copy_struct(reason, sz_reason, &hp, ohp);
-#endif
 	from_copy = (IS_CONST(from)
 		     ? from
 		     : copy_struct(from, sz_from, &hp, ohp));
@@ -1181,6 +1405,198 @@ change_to_off_heap:
     return res;
 }
 
+/*
+ * Message queue limit.
+ *
+ * process_flag(message_queue_limit, Limit) puts an upper limit on the
+ * number of messages from other processes that may be queued. When
+ * the limit is reached, depending on the policy, new messages are
+ * either dropped, the sender is sent a {message_queue_limit, Pid}
+ * message, or a local sender is suspended (like a sender to a busy
+ * port) until the receiver has drained its queue to the low watermark.
+ */
+
+Eterm
+erts_message_queue_limit_map(Process *p, Eterm **hpp, Uint *szp)
+{
+    ErtsMsgqLimit *limit = &p->msg.limit;
+    Eterm low, size, policy, keys, *hp;
+    flatmap_t *mp;
+
+    low = erts_bld_uint(hpp, szp, limit->low_len);
+    size = erts_bld_uint(hpp, szp, limit->max_len);
+    if (szp)
+	*szp += 4 + MAP_HEADER_FLATMAP_SZ + 3;
+    if (!hpp)
+	return THE_NON_VALUE;
+
+    switch (limit->policy) {
+    case ERTS_MSGQ_LIMIT_DROP:		policy = am_drop; break;
+    case ERTS_MSGQ_LIMIT_SIGNAL:	policy = am_signal; break;
+    default:				policy = am_suspend; break;
+    }
+
+    hp = *hpp;
+    keys = TUPLE3(hp, am_low_watermark, am_policy, am_size);
+    hp += 4;
+    mp = (flatmap_t*) hp;
+    mp->thing_word = MAP_HEADER_FLATMAP;
+    mp->size = 3;
+    mp->keys = keys;
+    hp += MAP_HEADER_FLATMAP_SZ;
+    *hp++ = low;
+    *hp++ = policy;
+    *hp++ = size;
+    *hpp = hp;
+    return make_flatmap(mp);
+}
+
+Eterm
+erts_change_message_queue_limit(Process *c_p, Eterm new_limit)
+{
+    ErtsMsgqLimit *limit = &c_p->msg.limit;
+    int policy = ERTS_MSGQ_LIMIT_SUSPEND;
+    Uint max_len, low_len, sz = 0;
+    int have_low = 0;
+    Eterm res, *hp;
+
+    if (is_map(new_limit)) {
+	const Eterm *size = erts_maps_get(am_size, new_limit);
+	const Eterm *low = erts_maps_get(am_low_watermark, new_limit);
+	const Eterm *pol = erts_maps_get(am_policy, new_limit);
+
+	/* size is mandatory */
+	if (!size || !term_to_Uint(*size, &max_len))
+	    return THE_NON_VALUE;
+	if (low) {
+	    if (!term_to_Uint(*low, &low_len))
+		return THE_NON_VALUE;
+	    have_low = 1;
+	}
+	if (pol) {
+	    switch (*pol) {
+	    case am_drop:	policy = ERTS_MSGQ_LIMIT_DROP; break;
+	    case am_signal:	policy = ERTS_MSGQ_LIMIT_SIGNAL; break;
+	    case am_suspend:	policy = ERTS_MSGQ_LIMIT_SUSPEND; break;
+	    default:		return THE_NON_VALUE;
+	    }
+	}
+    }
+    else if (!term_to_Uint(new_limit, &max_len))
+	return THE_NON_VALUE;
+
+    if (!have_low)
+	low_len = max_len / 2;
+    else if (low_len > max_len)
+	return THE_NON_VALUE;
+
+    (void) erts_message_queue_limit_map(c_p, NULL, &sz);
+    hp = HAlloc(c_p, sz);
+    res = erts_message_queue_limit_map(c_p, &hp, NULL);
+
+    erts_smp_proc_lock(c_p, ERTS_PROC_LOCK_MSGQ);
+    limit->max_len = max_len;
+    limit->low_len = low_len;
+    limit->policy = policy;
+    erts_smp_proc_unlock(c_p, ERTS_PROC_LOCK_MSGQ);
+
+    /* Senders suspended on the old limit are let go... */
+    erts_msgq_limit_release(c_p);
+
+    return res;
+}
+
+/*
+ * Clear the busy state and resume all senders suspended on
+ * the message queue limit of 'p'.
+ */
+void
+erts_msgq_limit_release(Process *p)
+{
+    ErtsProcList *suspended;
+
+    erts_smp_proc_lock(p, ERTS_PROC_LOCK_MSGQ);
+    erts_smp_atomic32_set_nob(&p->msg.limit.busy, 0);
+    suspended = p->msg.limit.suspended;
+    p->msg.limit.suspended = NULL;
+    erts_smp_proc_unlock(p, ERTS_PROC_LOCK_MSGQ);
+
+    if (suspended) {
+	erts_proclist_fetch(&suspended, NULL);
+	erts_resume_processes(suspended);
+    }
+}
+
+/* Called by the receiver when it has removed a message from its queue */
+void
+erts_msgq_limit_dequeued(Process *c_p)
+{
+    ErtsMsgqLimit *limit = &c_p->msg.limit;
+
+    /*
+     * Order the update of the queue length before the read of the
+     * busy flag. Pairs with the barrier in erts_msgq_limit_exceeded().
+     */
+    ERTS_THR_MEMORY_BARRIER;
+    if (erts_smp_atomic32_read_nob(&limit->busy)
+	&& msgq_limit_qlen(c_p) <= limit->low_len)
+	erts_msgq_limit_release(c_p);
+}
+
+/*
+ * Called by a local sender that got a message queue limit result
+ * when sending to 'rp'. The sender should only have its main lock
+ * locked. Returns non-zero if the sender was suspended, in which
+ * case it has to yield.
+ */
+int
+erts_msgq_limit_exceeded(Process *c_p, Process *rp, Sint res)
+{
+    ErtsMsgqLimit *limit = &rp->msg.limit;
+    ErtsProcList *plp;
+    erts_aint32_t state;
+
+    ERTS_SMP_LC_ASSERT(ERTS_PROC_LOCK_MAIN == erts_proc_lc_my_proc_locks(c_p));
+    ASSERT(c_p != rp);
+
+    if (res == ERTS_MSGQ_LIMIT_RES_SIGNAL) {
+	ErtsProcLocks c_p_locks = ERTS_PROC_LOCK_MAIN;
+	ErlOffHeap *ohp;
+	ErtsMessage *mp;
+	Eterm *hp, msg;
+
+	mp = erts_alloc_message_heap(c_p, &c_p_locks, 3, &hp, &ohp);
+	msg = TUPLE2(hp, am_message_queue_limit, rp->common.id);
+	erts_queue_message(c_p, c_p_locks, mp, msg, am_system);
+	c_p_locks &= ~ERTS_PROC_LOCK_MAIN;
+	if (c_p_locks)
+	    erts_smp_proc_unlock(c_p, c_p_locks);
+	return 0;
+    }
+
+    ASSERT(res == ERTS_MSGQ_LIMIT_RES_SUSPEND);
+
+    plp = erts_proclist_create(c_p);
+    erts_suspend(c_p, ERTS_PROC_LOCK_MAIN, NULL);
+
+    erts_smp_proc_lock(rp, ERTS_PROC_LOCK_MSGQ);
+    erts_proclist_store_last(&limit->suspended, plp);
+    erts_smp_atomic32_set_mb(&limit->busy, 1);
+    state = erts_smp_atomic32_read_nob(&rp->state);
+    erts_smp_proc_unlock(rp, ERTS_PROC_LOCK_MSGQ);
+
+    /*
+     * The receiver may have drained its queue, removed the limit,
+     * or started to exit, before we were enqueued...
+     */
+    if ((state & (ERTS_PSFLG_EXITING|ERTS_PSFLG_PENDING_EXIT))
+	|| !limit->max_len
+	|| msgq_limit_qlen(rp) <= limit->low_len)
+	erts_msgq_limit_release(rp);
+
+    return 1;
+}
+
 int
 erts_decode_dist_message(Process *proc, ErtsProcLocks proc_locks,
 			 ErtsMessage *msgp, int force_off_heap)
@@ -1255,6 +1671,61 @@ erts_decode_dist_message(Process *proc, ErtsProcLocks proc_locks,
     return 1;
 }
 
+#define ERTS_DIST_MSG_YIELD_DECODE_SIZE (64*1024)
+
+/*
+ * Decode a distribution message for the currently executing process
+ * which holds its main lock. Messages larger than
+ * ERTS_DIST_MSG_YIELD_DECODE_SIZE when uncompressed are uncompressed
+ * and decoded into heap fragments in steps of about *redsp reductions;
+ * -1 is returned when the process should yield and call again. Otherwise the return value is as for
+ * erts_decode_dist_message().
+ */
+int
+erts_decode_dist_message_yielding(Process *proc, ErtsMessage *msgp,
+				  Sint *redsp)
+{
+    ErtsDistExternal *edep = msgp->data.dist_ext;
+    ErtsHeapFactory factory;
+    Eterm msg;
+    int res;
+
+    if (!edep->decode
+	&& erts_dist_ext_data_size(edep) < ERTS_DIST_MSG_YIELD_DECODE_SIZE)
+	return erts_decode_dist_message(proc, ERTS_PROC_LOCK_MAIN, msgp, 0);
+
+    res = erts_decode_dist_ext_yielding(&factory, edep, &msg, redsp);
+    if (res == 0)
+	return -1;
+
+    if (is_not_immed(ERL_MESSAGE_TOKEN(msgp))) {
+	ErlHeapFragment *heap_frag = erts_dist_ext_trailer(edep);
+	if (res > 0) {
+	    Eterm *hp = erts_produce_heap(&factory, heap_frag->used_size, 0);
+	    ERL_MESSAGE_TOKEN(msgp) = copy_struct(ERL_MESSAGE_TOKEN(msgp),
+						  heap_frag->used_size,
+						  &hp,
+						  factory.off_heap);
+	}
+	erts_cleanup_offheap(&heap_frag->off_heap);
+    }
+
+    erts_free_dist_ext_copy(edep);
+    msgp->data.attached = NULL;
+
+    if (res < 0) {
+	ERL_MESSAGE_TOKEN(msgp) = NIL;
+	return 0;
+    }
+
+    ERL_MESSAGE_TERM(msgp) = msg;
+    erts_factory_trim_and_close(&factory, msgp->m,
+				ERL_MESSAGE_REF_ARRAY_SZ);
+    msgp->data.heap_frag = factory.heap_frags;
+
+    return 1;
+}
+
 /*
  * ERTS_INSPECT_MSGQ_KEEP_OH_MSGS == 0 will move off heap messages
  * into the heap of the inspected process if off_heap_message_queue
@@ -1388,6 +1859,284 @@ erts_prep_msgq_for_inspection(Process *c_p, Process *rp,
     return tot_heap_size;
 }
 
+/*
+ * Reference index of the private message queue.
+ *
+ * The compiler precedes a receive statement that only can match out
+ * messages containing a specific reference as first or second element
+ * of a tuple (typically {Ref, Reply} and {'DOWN', Ref, ...}) with a
+ * recv_ref/1 instruction. In order to avoid scanning the whole message
+ * queue in such receives, a process with a long message queue keeps an
+ * index of the messages that contain an internal reference in any of
+ * these positions.
+ *
+ * All messages preceding the 'frontier' slot have been indexed. An
+ * index entry refers to the slot (the next pointer) pointing to the
+ * message, i.e. the value the save pointer should be set to in order
+ * to continue the receive at the message. Entries in a bucket are kept
+ * in message queue order, so the first entry found for a reference
+ * refers to the first message in the queue containing it.
+ */
+
+#define ERTS_MSGQ_REF_IX_MIN_QLEN 16
+#define ERTS_MSGQ_REF_IX_MAX_SCAN 1000
+#define ERTS_MSGQ_REF_IX_INIT_SIZE 64
+
+typedef struct erts_msgq_ref_ix_entry ErtsMsgqRefIxEntry;
+struct erts_msgq_ref_ix_entry {
+    ErtsMsgqRefIxEntry *next;
+    ErtsMessage **slot;
+    Eterm ref[REF_THING_SIZE];
+};
+
+struct erts_msgq_ref_ix {
+    ErtsMessage **frontier;
+    Uint size;
+    Uint no_entries;
+    ErtsMsgqRefIxEntry **bucket;
+};
+
+static ERTS_INLINE Uint
+msgq_ref_ix_hash(ErtsMsgqRefIndex *ix, Eterm ref)
+{
+    Uint32 *num = internal_ref_numbers(ref);
+    return ((Uint) num[0] ^ ((Uint) num[1] << 7)) & (ix->size - 1);
+}
+
+static ERTS_INLINE int
+msgq_ref_ix_keys(ErtsMessage *mp, Eterm *keys)
+{
+    Eterm msg = ERL_MESSAGE_TERM(mp);
+    Eterm *tp;
+    int n = 0;
+
+    if (is_non_value(msg) || is_not_tuple(msg))
+	return 0;
+    tp = tuple_val(msg);
+    if (arityval(*tp) >= 1 && is_internal_ref(tp[1]))
+	keys[n++] = tp[1];
+    if (arityval(*tp) >= 2 && is_internal_ref(tp[2]))
+	keys[n++] = tp[2];
+    return n;
+}
+
+static ErtsMsgqRefIxEntry **
+msgq_ref_ix_find_slot(ErtsMsgqRefIndex *ix, Eterm ref, ErtsMessage **slot)
+{
+    ErtsMsgqRefIxEntry **epp = &ix->bucket[msgq_ref_ix_hash(ix, ref)];
+    while (*epp) {
+	if ((*epp)->slot == slot && eq(make_internal_ref((*epp)->ref), ref))
+	    return epp;
+	epp = &(*epp)->next;
+    }
+    return NULL;
+}
+
+static void
+msgq_ref_ix_grow(ErtsMsgqRefIndex *ix)
+{
+    ErtsMsgqRefIxEntry **old = ix->bucket;
+    Uint old_size = ix->size, i;
+
+    ix->size *= 2;
+    ix->bucket = erts_alloc(ERTS_ALC_T_MSGQ_REF_IX,
+			    sizeof(ErtsMsgqRefIxEntry *)*ix->size);
+    sys_memzero(ix->bucket, sizeof(ErtsMsgqRefIxEntry *)*ix->size);
+
+    /* Moving the entries in order keeps them in queue order... */
+    for (i = 0; i < old_size; i++) {
+	ErtsMsgqRefIxEntry *ep = old[i];
+	while (ep) {
+	    ErtsMsgqRefIxEntry *next = ep->next, **epp;
+	    epp = &ix->bucket[msgq_ref_ix_hash(ix, make_internal_ref(ep->ref))];
+	    while (*epp)
+		epp = &(*epp)->next;
+	    ep->next = NULL;
+	    *epp = ep;
+	    ep = next;
+	}
+    }
+    erts_free(ERTS_ALC_T_MSGQ_REF_IX, old);
+}
+
+/* Index the message at the frontier, and advance the frontier */
+static void
+msgq_ref_ix_index_msg(ErtsMsgqRefIndex *ix)
+{
+    ErtsMessage *mp = *ix->frontier;
+    Eterm keys[2];
+    int i, n = msgq_ref_ix_keys(mp, keys);
+
+    for (i = 0; i < n; i++) {
+	ErtsMsgqRefIxEntry *ep, **epp;
+	Uint sz = thing_arityval(*internal_ref_val(keys[i])) + 1;
+
+	ASSERT(sz <= REF_THING_SIZE);
+	ep = erts_alloc(ERTS_ALC_T_MSGQ_REF_IX, sizeof(ErtsMsgqRefIxEntry));
+	ep->next = NULL;
+	ep->slot = ix->frontier;
+	sys_memcpy(ep->ref, internal_ref_val(keys[i]), sz*sizeof(Eterm));
+
+	epp = &ix->bucket[msgq_ref_ix_hash(ix, keys[i])];
+	while (*epp)
+	    epp = &(*epp)->next;
+	*epp = ep;
+	ix->no_entries++;
+    }
+
+    ix->frontier = &mp->next;
+
+    if (ix->no_entries > 2*ix->size)
+	msgq_ref_ix_grow(ix);
+}
+
+/*
+ * Called by the recv_ref instruction. Returns the position (slot) of
+ * the first message that may contain 'ref' as first or second tuple
+ * element, or NULL if the whole queue should be scanned.
+ */
+ErtsMessage **
+erts_msgq_ref_ix_lookup(ErlMessageQueue *msgq, Eterm ref)
+{
+    ErtsMsgqRefIndex *ix = msgq->ref_ix;
+    ErtsMsgqRefIxEntry *ep;
+    int scan;
+
+    ASSERT(is_internal_ref(ref));
+
+    if (msgq->save != &msgq->first)
+	return NULL;
+
+    if (!ix) {
+	if (msgq->len < ERTS_MSGQ_REF_IX_MIN_QLEN)
+	    return NULL;
+	ix = erts_alloc(ERTS_ALC_T_MSGQ_REF_IX, sizeof(ErtsMsgqRefIndex));
+	ix->frontier = &msgq->first;
+	ix->size = ERTS_MSGQ_REF_IX_INIT_SIZE;
+	ix->no_entries = 0;
+	ix->bucket = erts_alloc(ERTS_ALC_T_MSGQ_REF_IX,
+				sizeof(ErtsMsgqRefIxEntry *)*ix->size);
+	sys_memzero(ix->bucket, sizeof(ErtsMsgqRefIxEntry *)*ix->size);
+	msgq->ref_ix = ix;
+    }
+
+    /*
+     * Extend the index towards the end of the queue. Distribution
+     * messages that haven't been decoded yet cannot be inspected; the
+     * receive will decode them and the frontier will move past them
+     * when they are saved.
+     */
+    for (scan = 0; scan < ERTS_MSGQ_REF_IX_MAX_SCAN; scan++) {
+	ErtsMessage *mp = *ix->frontier;
+	if (!mp || is_non_value(ERL_MESSAGE_TERM(mp)))
+	    break;
+	msgq_ref_ix_index_msg(ix);
+    }
+
+    ep = ix->bucket[msgq_ref_ix_hash(ix, ref)];
+    while (ep) {
+	if (eq(make_internal_ref(ep->ref), ref))
+	    return ep->slot;
+	ep = ep->next;
+    }
+
+    /* No message before the frontier contains the reference */
+    return ix->frontier;
+}
+
+/* The message at the save pointer is about to be saved */
+void
+erts_msgq_ref_ix_save(ErlMessageQueue *msgq)
+{
+    ErtsMsgqRefIndex *ix = msgq->ref_ix;
+    ASSERT(ix);
+    if (msgq->save == ix->frontier)
+	msgq_ref_ix_index_msg(ix);
+}
+
+/* The slot pointing to the message at 'oldpp' is moving to 'newpp' */
+void
+erts_msgq_ref_ix_move_slot(ErlMessageQueue *msgq,
+			   ErtsMessage **newpp,
+			   ErtsMessage **oldpp)
+{
+    ErtsMsgqRefIndex *ix = msgq->ref_ix;
+    ErtsMessage *mp;
+    Eterm keys[2];
+    int i, n;
+
+    ASSERT(ix);
+    if (ix->frontier == oldpp) {
+	/* Message not indexed */
+	ix->frontier = newpp;
+	return;
+    }
+
+    mp = *oldpp;
+    if (!mp)
+	return;
+    n = msgq_ref_ix_keys(mp, keys);
+    for (i = 0; i < n; i++) {
+	ErtsMsgqRefIxEntry **epp = msgq_ref_ix_find_slot(ix, keys[i], oldpp);
+	if (epp)
+	    (*epp)->slot = newpp;
+    }
+}
+
+/* The message at the save pointer is about to be unlinked */
+void
+erts_msgq_ref_ix_unlink(ErlMessageQueue *msgq, ErtsMessage *mp)
+{
+    ErtsMsgqRefIndex *ix = msgq->ref_ix;
+    Eterm keys[2];
+    int i, n;
+
+    ASSERT(ix);
+    ASSERT(*msgq->save == mp);
+
+    if (msgq->len <= 1) {
+	/* Queue will be empty; drop the index */
+	erts_msgq_ref_ix_destroy(msgq);
+	return;
+    }
+
+    n = msgq_ref_ix_keys(mp, keys);
+    for (i = 0; i < n; i++) {
+	ErtsMsgqRefIxEntry **epp = msgq_ref_ix_find_slot(ix, keys[i],
+							 msgq->save);
+	if (epp) {
+	    ErtsMsgqRefIxEntry *ep = *epp;
+	    *epp = ep->next;
+	    erts_free(ERTS_ALC_T_MSGQ_REF_IX, ep);
+	    ix->no_entries--;
+	}
+    }
+
+    erts_msgq_ref_ix_move_slot(msgq, msgq->save, &mp->next);
+}
+
+void
+erts_msgq_ref_ix_destroy(ErlMessageQueue *msgq)
+{
+    ErtsMsgqRefIndex *ix = msgq->ref_ix;
+    Uint i;
+
+    if (!ix)
+	return;
+
+    for (i = 0; i < ix->size; i++) {
+	ErtsMsgqRefIxEntry *ep = ix->bucket[i];
+	while (ep) {
+	    ErtsMsgqRefIxEntry *next = ep->next;
+	    erts_free(ERTS_ALC_T_MSGQ_REF_IX, ep);
+	    ep = next;
+	}
+    }
+    erts_free(ERTS_ALC_T_MSGQ_REF_IX, ix->bucket);
+    erts_free(ERTS_ALC_T_MSGQ_REF_IX, ix);
+    msgq->ref_ix = NULL;
+}
+
 void erts_factory_proc_init(ErtsHeapFactory* factory,
 			    Process* p)
 {
@@ -160,6 +160,34 @@ struct erl_mesg {
 /* Size of default message buffer (erl_message.c) */
 #define ERL_MESSAGE_BUF_SZ 500
 
+typedef struct erts_msgq_ref_ix ErtsMsgqRefIndex;
+
+/* Policies for process_flag(message_queue_limit, _) */
+#define ERTS_MSGQ_LIMIT_DROP		0
+#define ERTS_MSGQ_LIMIT_SIGNAL		1
+#define ERTS_MSGQ_LIMIT_SUSPEND		2
+
+/*
+ * Results from erts_send_message() with ERTS_SND_FLG_MSGQ_LIMIT when
+ * the message queue limit of the receiver was reached. Ordinary
+ * results are non-negative. Other ways of queueing messages never
+ * return these; they only drop messages under the drop policy.
+ */
+#define ERTS_MSGQ_LIMIT_RES_SIGNAL	(-1)
+#define ERTS_MSGQ_LIMIT_RES_SUSPEND	(-2)
+
+typedef struct {
+    Uint max_len;		/* 0 if no limit */
+    Uint low_len;		/* Low watermark */
+    int policy;
+    /*
+     * Set when the limit has been reached, and cleared when the
+     * queue has been drained below the low watermark.
+     */
+    erts_smp_atomic32_t busy;
+    struct ErtsProcList_ *suspended; /* Protected by the msgq lock */
+} ErtsMsgqLimit;
+
 typedef struct {
     ErtsMessage* first;
     ErtsMessage** last;  /* point to the last next pointer */
@@ -172,6 +200,11 @@ typedef struct {
      */
     BeamInstr* mark;		/* address to rec_loop/2 instruction */
     ErtsMessage** saved_last;	/* saved last pointer */
+
+    /* Used by the recv_ref/1 instruction (see erl_message.c) */
+    ErtsMsgqRefIndex *ref_ix;
+
+    ErtsMsgqLimit limit;
 } ErlMessageQueue;
 
 #ifdef ERTS_SMP
@@ -180,8 +213,31 @@ typedef struct {
     ErtsMessage* first;
     ErtsMessage** last;  /* point to the last next pointer */
     Sint len;            /* queue length */
+
+    /*
+     * Lock free part of the in queue. Senders to a process with
+     * off heap message queue data push messages onto this stack
+     * without taking the msgq lock. The receiver detaches the whole
+     * stack (while holding the msgq lock), reverses it, and appends
+     * it to the in queue above. All messages on the stack are younger
+     * than all messages in the in queue above.
+     */
+    erts_smp_atomic_t lf_first;
+    /*
+     * Number of messages on the lock free stack. Senders add to it
+     * after pushing, and the receiver subtracts what it detaches, so
+     * it may be momentarily negative...
+     */
+    erts_smp_atomic_t lf_len;
 } ErlMessageInQueue;
 
+#define ERTS_MSGQ_LF_EMPTY ((erts_aint_t) 0)
+#define ERTS_MSGQ_LF_CLOSED ((erts_aint_t) 1)
+
+#define ERTS_MSGQ_LF_HAVE_MSGS(p)                                       \
+    ((UWord) erts_smp_atomic_read_nob(&(p)->msg_inq.lf_first)           \
+     > (UWord) ERTS_MSGQ_LF_CLOSED)
+
 typedef struct erl_trace_message_queue__ {
     struct erl_trace_message_queue__ *next; /* point to the next receiver */
     Eterm receiver;
@@ -215,12 +271,23 @@ typedef struct erl_trace_message_queue__ {
         LINK_MESSAGE_IMPL(p, first_msg, last_msg, len, msg);            \
     } while (0)
 
+/* Move messages in lock free in queue to in queue */
+#define ERTS_SMP_MSGQ_LF_FETCH(p)                       \
+    do {                                                \
+        if (ERTS_MSGQ_LF_HAVE_MSGS(p))                  \
+            erts_msgq_lf_fetch(p, 0);                   \
+    } while (0)
+
 /* Add message last_msg in message queue */
-#define LINK_MESSAGE(p, first_msg, last_msg, len)       \
-    LINK_MESSAGE_IMPL(p, first_msg, last_msg, len, msg_inq)
+#define LINK_MESSAGE(p, first_msg, last_msg, len)                       \
+    do {                                                                \
+        ERTS_SMP_MSGQ_LF_FETCH(p);                                      \
+        LINK_MESSAGE_IMPL(p, first_msg, last_msg, len, msg_inq);        \
+    } while (0)
 
 #define ERTS_SMP_MSGQ_MV_INQ2PRIVQ(p)                   \
     do {                                                \
+        ERTS_SMP_MSGQ_LF_FETCH(p);                      \
         if (p->msg_inq.first) {                         \
             *p->msg.last = p->msg_inq.first;            \
             p->msg.last = p->msg_inq.last;              \
@@ -233,6 +300,7 @@ typedef struct erl_trace_message_queue__ {
 
 #else
 
+#define ERTS_SMP_MSGQ_LF_FETCH(p)
 #define ERTS_SMP_MSGQ_MV_INQ2PRIVQ(p)
 
 /* Add message last_msg in message queue */
@@ -246,11 +314,15 @@ typedef struct erl_trace_message_queue__ {
 /* Unlink current message */
 #define UNLINK_MESSAGE(p,msgp) do { \
      ErtsMessage* __mp = (msgp)->next; \
+     if ((p)->msg.ref_ix) \
+         erts_msgq_ref_ix_unlink(&(p)->msg, (msgp)); \
      *(p)->msg.save = __mp; \
      (p)->msg.len--; \
      if (__mp == NULL) \
          (p)->msg.last = (p)->msg.save; \
      (p)->msg.mark = 0; \
+     if ((p)->msg.limit.max_len) \
+         erts_msgq_limit_dequeued((p)); \
 } while(0)
 
 /* Reset message save point (after receive match) */
@@ -258,10 +330,15 @@ typedef struct erl_trace_message_queue__ {
      (p)->msg.save = &(p)->msg.first
 
 /* Save current message */
-#define SAVE_MESSAGE(p) \
-     (p)->msg.save = &(*(p)->msg.save)->next
+#define SAVE_MESSAGE(p) do { \
+     if ((p)->msg.ref_ix) \
+         erts_msgq_ref_ix_save(&(p)->msg); \
+     (p)->msg.save = &(*(p)->msg.save)->next; \
+} while(0)
 
 #define ERTS_SND_FLG_NO_SEQ_TRACE		(((unsigned) 1) << 0)
+/* The sender handles the ERTS_MSGQ_LIMIT_RES_* results */
+#define ERTS_SND_FLG_MSGQ_LIMIT			(((unsigned) 1) << 1)
 
 #define ERTS_HEAP_FRAG_SIZE(DATA_WORDS) \
    (sizeof(ErlHeapFragment) - sizeof(Eterm) + (DATA_WORDS)*sizeof(Eterm))
@@ -310,11 +387,28 @@ void erts_save_message_in_proc(Process *p, ErtsMessage *msg);
 Sint erts_move_messages_off_heap(Process *c_p);
 Sint erts_complete_off_heap_message_queue_change(Process *c_p);
 Eterm erts_change_message_queue_management(Process *c_p, Eterm new_state);
+Eterm erts_change_message_queue_limit(Process *c_p, Eterm new_limit);
+Eterm erts_message_queue_limit_map(Process *p, Eterm **hpp, Uint *szp);
+void erts_msgq_limit_dequeued(Process *c_p);
+void erts_msgq_limit_release(Process *p);
+int erts_msgq_limit_exceeded(Process *c_p, Process *rp, Sint res);
 
 int erts_decode_dist_message(Process *, ErtsProcLocks, ErtsMessage *, int);
+int erts_decode_dist_message_yielding(Process *, ErtsMessage *, Sint *);
 
 void erts_cleanup_messages(ErtsMessage *mp);
 
+ErtsMessage **erts_msgq_ref_ix_lookup(ErlMessageQueue *msgq, Eterm ref);
+void erts_msgq_ref_ix_save(ErlMessageQueue *msgq);
+void erts_msgq_ref_ix_unlink(ErlMessageQueue *msgq, ErtsMessage *mp);
+void erts_msgq_ref_ix_move_slot(ErlMessageQueue *msgq,
+				ErtsMessage **newpp,
+				ErtsMessage **oldpp);
+void erts_msgq_ref_ix_destroy(ErlMessageQueue *msgq);
+#ifdef ERTS_SMP
+void erts_msgq_lf_fetch(Process *p, int close);
+#endif
+
 typedef struct {
     Uint size;
     ErtsMessage *msgp;
@@ -328,12 +422,23 @@ Uint erts_prep_msgq_for_inspection(Process *c_p,
 void *erts_alloc_message_ref(void);
 void erts_free_message_ref(void *);
 
-#define ERTS_SMALL_FIX_MSG_SZ 10
-#define ERTS_MEDIUM_FIX_MSG_SZ 20
-#define ERTS_LARGE_FIX_MSG_SZ 30
+/*
+ * Messages with at most ERTS_LARGE_FIX_MSG_SZ heap words are
+ * allocated in one of these size classes from scheduler specific
+ * pools, see erts_alloc_fix_sz_message().
+ */
+#define ERTS_TINY_FIX_MSG_SZ 8
+#define ERTS_SMALL_FIX_MSG_SZ 16
+#define ERTS_MEDIUM_FIX_MSG_SZ 32
+#define ERTS_LARGE_FIX_MSG_SZ 64
+
+ErtsMessage *erts_alloc_fix_sz_message(Uint sz, Uint *alloc_szp);
+void erts_free_fix_sz_message(ErtsMessage *mp);
 
-void *erts_alloc_small_message(void);
-void erts_free_small_message(void *mp);
+typedef struct {
+    ErtsMessage m;
+    Eterm data[ERTS_TINY_FIX_MSG_SZ-1];
+} ErtsTinyFixSzMessage;
 
 typedef struct {
     ErtsMessage m;
@@ -393,12 +498,21 @@ ERTS_GLB_FORCE_INLINE ErtsMessage *erts_alloc_message(Uint sz, Eterm **hpp)
 	return mp;
     }
 
-    mp = erts_alloc(ERTS_ALC_T_MSG,
-		    sizeof(ErtsMessage) + (sz - 1)*sizeof(Eterm));
+    if (sz <= ERTS_LARGE_FIX_MSG_SZ) {
+	Uint alloc_sz;
+	mp = erts_alloc_fix_sz_message(sz, &alloc_sz);
+	ERTS_INIT_MESSAGE(mp);
+	mp->data.attached = ERTS_MSG_COMBINED_HFRAG;
+	ERTS_INIT_HEAP_FRAG(&mp->hfrag, sz, alloc_sz);
+    }
+    else {
+	mp = erts_alloc(ERTS_ALC_T_MSG,
+			sizeof(ErtsMessage) + (sz - 1)*sizeof(Eterm));
 
-    ERTS_INIT_MESSAGE(mp);
-    mp->data.attached = ERTS_MSG_COMBINED_HFRAG;
-    ERTS_INIT_HEAP_FRAG(&mp->hfrag, sz, sz);
+	ERTS_INIT_MESSAGE(mp);
+	mp->data.attached = ERTS_MSG_COMBINED_HFRAG;
+	ERTS_INIT_HEAP_FRAG(&mp->hfrag, sz, sz);
+    }
 
     if (hpp)
 	*hpp = &mp->hfrag.mem[0];
@@ -422,14 +536,16 @@ erts_shrink_message(ErtsMessage *mp, Uint sz, Eterm *brefs, Uint brefs_size)
 		ASSERT(is_non_value(brefs[i]) || is_immed(brefs[i]));
 	}
 #endif
-	erts_free(ERTS_ALC_T_MSG, mp);
+	erts_free_message(mp);
 	return nmp;
     }
 
     ASSERT(mp->data.attached == ERTS_MSG_COMBINED_HFRAG);
     ASSERT(mp->hfrag.used_size >= sz);
 
-    if (sz >= (mp->hfrag.alloc_size - mp->hfrag.alloc_size / 16)) {
+    /* Pooled messages are never reallocated */
+    if (mp->hfrag.alloc_size <= ERTS_LARGE_FIX_MSG_SZ
+	|| sz >= (mp->hfrag.alloc_size - mp->hfrag.alloc_size / 16)) {
 	mp->hfrag.used_size = sz;
 	return mp;
     }
@@ -441,6 +557,8 @@ ERTS_GLB_FORCE_INLINE void erts_free_message(ErtsMessage *mp)
 {
     if (mp->data.attached != ERTS_MSG_COMBINED_HFRAG)
 	erts_free_message_ref(mp);
+    else if (mp->hfrag.alloc_size <= ERTS_LARGE_FIX_MSG_SZ)
+	erts_free_fix_sz_message(mp);
     else
 	erts_free(ERTS_ALC_T_MSG, mp);
 }
@@ -480,6 +598,8 @@ erts_msgq_update_internal_pointers(ErlMessageQueue *msgq,
 				   ErtsMessage **newpp,
 				   ErtsMessage **oldpp)
 {
+    if (msgq->ref_ix)
+	erts_msgq_ref_ix_move_slot(msgq, newpp, oldpp);
     if (msgq->save == oldpp)
 	msgq->save = newpp;
     if (msgq->last == oldpp)
@@ -82,18 +82,72 @@ dist_table_cmp(void *dep1, void *dep2)
 	    ? 0 : 1);
 }
 
+/* The per scheduler statistics follow the entry, cache line aligned */
+#define DIST_ENTRY_SIZE \
+  (sizeof(DistEntry) + ERTS_CACHE_LINE_SIZE-1 \
+   + (erts_no_schedulers + 1)*sizeof(ErtsAlignedDistSchedStats))
+
+static void
+init_dist_stats(ErtsDistStats *stats)
+{
+    Uint ix;
+    int i;
+    erts_smp_atomic_init_nob(&stats->out_msgs, 0);
+    erts_smp_atomic_init_nob(&stats->out_bytes, 0);
+    erts_smp_atomic_init_nob(&stats->busy_count, 0);
+    erts_smp_atomic64_init_nob(&stats->busy_time, 0);
+    for (ix = 0; ix <= erts_no_schedulers; ix++) {
+	ErtsDistSchedStats *sst = &stats->sched[ix].s;
+	erts_smp_atomic_init_nob(&sst->in_msgs, 0);
+	erts_smp_atomic_init_nob(&sst->in_bytes, 0);
+	erts_smp_atomic_init_nob(&sst->max_queue, 0);
+	erts_smp_atomic_init_nob(&sst->sends, 0);
+	erts_smp_atomic64_init_nob(&sst->encode_time, 0);
+	for (i = 0; i < ERTS_DIST_STAT_SIZE_BUCKETS; i++)
+	    erts_smp_atomic_init_nob(&sst->size_hist[i], 0);
+    }
+}
+
+static void
+reset_dist_stats(ErtsDistStats *stats)
+{
+    Uint ix;
+    int i;
+    erts_smp_atomic_set_nob(&stats->out_msgs, 0);
+    erts_smp_atomic_set_nob(&stats->out_bytes, 0);
+    erts_smp_atomic_set_nob(&stats->busy_count, 0);
+    erts_smp_atomic64_set_nob(&stats->busy_time, 0);
+    for (ix = 0; ix <= erts_no_schedulers; ix++) {
+	ErtsDistSchedStats *sst = &stats->sched[ix].s;
+	erts_smp_atomic_set_nob(&sst->in_msgs, 0);
+	erts_smp_atomic_set_nob(&sst->in_bytes, 0);
+	erts_smp_atomic_set_nob(&sst->max_queue, 0);
+	erts_smp_atomic_set_nob(&sst->sends, 0);
+	erts_smp_atomic64_set_nob(&sst->encode_time, 0);
+	for (i = 0; i < ERTS_DIST_STAT_SIZE_BUCKETS; i++)
+	    erts_smp_atomic_set_nob(&sst->size_hist[i], 0);
+    }
+}
+
 static void*
 dist_table_alloc(void *dep_tmpl)
 {
     Eterm chnl_nr;
     Eterm sysname;
     DistEntry *dep;
+    UWord sched_stats;
+    int ix;
     erts_smp_rwmtx_opt_t rwmtx_opt = ERTS_SMP_RWMTX_OPT_DEFAULT_INITER;
     rwmtx_opt.type = ERTS_SMP_RWMTX_TYPE_FREQUENT_READ;
 
     sysname = ((DistEntry *) dep_tmpl)->sysname;
     chnl_nr = make_small((Uint) atom_val(sysname));
-    dep = (DistEntry *) erts_alloc(ERTS_ALC_T_DIST_ENTRY, sizeof(DistEntry));
+    dep = (DistEntry *) erts_alloc(ERTS_ALC_T_DIST_ENTRY, DIST_ENTRY_SIZE);
+    sched_stats = (UWord) (dep + 1);
+    if (sched_stats & ERTS_CACHE_LINE_MASK)
+	sched_stats = ((sched_stats & ~ERTS_CACHE_LINE_MASK)
+		       + ERTS_CACHE_LINE_SIZE);
+    dep->stats.sched = (ErtsAlignedDistSchedStats *) sched_stats;
 
     dist_entries++;
 
@@ -112,20 +166,31 @@ dist_table_alloc(void *dep_tmpl)
     dep->nlinks				= NULL;
     dep->monitors			= NULL;
 
-    erts_smp_mtx_init_x(&dep->qlock, "dist_entry_out_queue", chnl_nr);
-    dep->qflgs				= 0;
-    dep->qsize				= 0;
-    dep->out_queue.first		= NULL;
-    dep->out_queue.last			= NULL;
-    dep->suspended			= NULL;
-
-    dep->finalized_out_queue.first	= NULL;
-    dep->finalized_out_queue.last	= NULL;
+    dep->no_chnls			= 1;
+    for (ix = 0; ix < ERTS_DIST_MAX_CHANNELS; ix++) {
+	ErtsDistChannel *chnl = &dep->chnl[ix];
+	chnl->cid			= NIL;
+	chnl->pending			= 0;
+	erts_smp_mtx_init_x(&chnl->qlock, "dist_entry_out_queue", chnl_nr);
+	erts_smp_atomic32_init_nob(&chnl->qflgs, 0);
+	erts_smp_atomic_init_nob(&chnl->qsize, 0);
+	erts_smp_atomic_init_nob(&chnl->in_queue, (erts_aint_t) NULL);
+	chnl->out_queue.first		= NULL;
+	chnl->out_queue.last		= NULL;
+	chnl->suspended			= NULL;
+
+	chnl->finalized_out_queue.first	= NULL;
+	chnl->finalized_out_queue.last	= NULL;
+
+	erts_smp_atomic_init_nob(&chnl->dist_cmd_scheduled, 0);
+	erts_port_task_handle_init(&chnl->dist_cmd);
+	chnl->send			= NULL;
+	chnl->cache			= NULL;
+	chnl->fragments			= NULL;
+	chnl->busy_since		= 0;
+    }
 
-    erts_smp_atomic_init_nob(&dep->dist_cmd_scheduled, 0);
-    erts_port_task_handle_init(&dep->dist_cmd);
-    dep->send				= NULL;
-    dep->cache				= NULL;
+    init_dist_stats(&dep->stats);
 
     /* Link in */
 
@@ -147,6 +212,7 @@ static void
 dist_table_free(void *vdep)
 {
     DistEntry *dep = (DistEntry *) vdep;
+    int ix;
 
     ASSERT(is_nil(dep->cid));
     ASSERT(dep->nlinks == NULL);
@@ -172,10 +238,14 @@ dist_table_free(void *vdep)
     ASSERT(erts_no_of_not_connected_dist_entries > 0);
     erts_no_of_not_connected_dist_entries--;
 
-    ASSERT(!dep->cache);
     erts_smp_rwmtx_destroy(&dep->rwmtx);
     erts_smp_mtx_destroy(&dep->lnk_mtx);
-    erts_smp_mtx_destroy(&dep->qlock);
+    for (ix = 0; ix < ERTS_DIST_MAX_CHANNELS; ix++) {
+	ASSERT(is_nil(dep->chnl[ix].cid));
+	ASSERT(!dep->chnl[ix].cache);
+	ASSERT(!dep->chnl[ix].fragments);
+	erts_smp_mtx_destroy(&dep->chnl[ix].qlock);
+    }
 
 #ifdef DEBUG
     sys_memset(vdep, 0x77, sizeof(DistEntry));
@@ -369,7 +439,7 @@ erts_dist_table_size(void)
 #endif
 
     res = (hash_table_sz(&erts_dist_table)
-	   + dist_entries*sizeof(DistEntry)
+	   + dist_entries*DIST_ENTRY_SIZE
 	   + erts_dist_cache_size());
     if (lock)
 	erts_smp_rwmtx_runlock(&erts_dist_table_rwmtx);
@@ -419,6 +489,8 @@ erts_set_dist_entry_not_connected(DistEntry *dep)
     dep->flags = 0;
     dep->prev = NULL;
     dep->cid = NIL;
+    dep->chnl[0].cid = NIL;
+    dep->no_chnls = 1;
 
     dep->next = erts_not_connected_dist_entries;
     if(erts_not_connected_dist_entries) {
@@ -455,9 +527,12 @@ erts_set_dist_entry_connected(DistEntry *dep, Eterm cid, Uint flags)
     ASSERT(erts_no_of_not_connected_dist_entries > 0);
     erts_no_of_not_connected_dist_entries--;
 
+    reset_dist_stats(&dep->stats);
+
     dep->status |= ERTS_DE_SFLG_CONNECTED;
     dep->flags = flags;
     dep->cid = cid;
+    dep->chnl[0].cid = cid;
     dep->connection_id++;
     dep->connection_id &= ERTS_DIST_EXT_CON_ID_MASK;
     dep->prev = NULL;
@@ -1339,6 +1414,10 @@ setup_reference_table(void)
 		proc->msg.first,
 #ifdef ERTS_SMP
 		proc->msg_inq.first,
+		(ERTS_MSGQ_LF_HAVE_MSGS(proc)
+		 ? ((ErtsMessage *)
+		    erts_smp_atomic_read_nob(&proc->msg_inq.lf_first))
+		 : NULL),
 #endif
 		proc->msg_frag};
 
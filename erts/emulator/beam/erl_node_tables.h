@@ -81,6 +81,18 @@ struct ErtsDistOutputBuf_ {
     ErtsDistOutputBuf *next;
     byte *extp;
     byte *ext_endp;
+    /* Binaries that the message refers to instead of containing them */
+    struct ErtsExtBinRefs_ *bin_refs;
+    /*
+     * A fragment of a large message carries its fragment header in
+     * data and refers to its part of the message in payload. The
+     * message data starts at payload_p and includes the binaries
+     * referred to by the payload.
+     */
+    ErtsDistOutputBuf *payload;
+    byte *payload_p;
+    Uint payload_offset;
+    Uint payload_size;
     byte data[1];
 };
 
@@ -103,6 +115,80 @@ struct ErtsProcList_;
 
 struct erl_link;
 
+/*
+ * A connection to another node may consist of several channels, each
+ * one with a port of its own. Channel 0 is the port passed in the
+ * call to setnode/3 that connects the node; outgoing signals are
+ * spread over the channels by sender so that signals between a pair
+ * of processes always are passed over the same channel.
+ */
+#define ERTS_DIST_MAX_CHANNELS 8
+
+typedef struct ErtsDistChannel_ {
+    Eterm cid;			/* Port of the channel, NIL == free */
+    int pending;		/* Registered, but not yet part of a
+				   connection */
+
+    /*
+     * Senders push encoded buffers on in_queue and add to qsize
+     * without locking; the port moves them to out_queue in order.
+     * Decrements of qsize, changes of qflgs, out_queue and the list
+     * of suspended processes are protected by qlock.
+     */
+    erts_smp_mtx_t qlock;
+    erts_smp_atomic32_t qflgs;
+    erts_smp_atomic_t qsize;
+    erts_smp_atomic_t in_queue;	/* Last enqueued buffer first */
+    ErtsDistOutputQueue out_queue;
+    struct ErtsProcList_ *suspended;
+
+    ErtsDistOutputQueue finalized_out_queue;
+    erts_smp_atomic_t dist_cmd_scheduled;
+    ErtsPortTaskHandle dist_cmd;
+
+    Uint (*send)(Port *prt, ErtsDistOutputBuf *obuf);
+
+    struct cache* cache;	/* The atom cache */
+
+    struct ErtsDistFragments_ *fragments; /* Incoming fragmented messages */
+
+    ErtsMonotonicTime busy_since; /* Protected by qlock */
+} ErtsDistChannel;
+
+/* Message size histogram buckets; < 64 bytes, < 128 bytes, ..., >= 1 MB */
+#define ERTS_DIST_STAT_SIZE_BUCKETS 16
+
+/*
+ * Statistics of the current connection of a dist entry, see
+ * erlang:system_info({dist_stats, Node}). Updated and read without
+ * locking, and reset when the connection is set up. The counters
+ * updated for each message are kept per scheduler, and summed (or,
+ * for max_queue, maxed) when read, so that senders on different
+ * schedulers do not contend on them. Only its scheduler updates a
+ * slot; slot 0 is shared by other threads and updated atomically.
+ */
+typedef struct {
+    erts_smp_atomic_t in_msgs;
+    erts_smp_atomic_t in_bytes;
+    erts_smp_atomic_t max_queue;
+    erts_smp_atomic_t sends;		/* For sampling of encode_time */
+    erts_smp_atomic64_t encode_time;	/* Nanoseconds */
+    erts_smp_atomic_t size_hist[ERTS_DIST_STAT_SIZE_BUCKETS];
+} ErtsDistSchedStats;
+
+typedef union {
+    ErtsDistSchedStats s;
+    char align[ERTS_ALC_CACHE_LINE_ALIGN_SIZE(sizeof(ErtsDistSchedStats))];
+} ErtsAlignedDistSchedStats;
+
+typedef struct {
+    erts_smp_atomic_t out_msgs;
+    erts_smp_atomic_t out_bytes;
+    erts_smp_atomic_t busy_count;
+    erts_smp_atomic64_t busy_time;	/* Nanoseconds */
+    ErtsAlignedDistSchedStats *sched;	/* erts_no_schedulers+1 slots */
+} ErtsDistStats;
+
 typedef struct dist_entry_ {
     HashBucket hash_bucket;     /* Hash bucket */
     struct dist_entry_ *next;	/* Next entry in dist_table (not sorted) */
@@ -118,6 +204,7 @@ typedef struct dist_entry_ {
     Uint32 flags;		/* Distribution flags, like hidden, 
 				   atom cache etc. */
     unsigned long version;	/* Protocol version */
+    int no_chnls;		/* Channels used by the connection */
 
 
     erts_smp_mtx_t lnk_mtx;     /* Protects node_links, nlinks, and
@@ -132,19 +219,9 @@ typedef struct dist_entry_ {
     ErtsLink *nlinks;           /* Link tree with subtrees */
     ErtsMonitor *monitors;      /* Monitor tree */
 
-    erts_smp_mtx_t qlock;       /* Protects qflgs and out_queue */
-    Uint32 qflgs;
-    Sint qsize;
-    ErtsDistOutputQueue out_queue;
-    struct ErtsProcList_ *suspended;
+    ErtsDistChannel chnl[ERTS_DIST_MAX_CHANNELS];
 
-    ErtsDistOutputQueue finalized_out_queue;
-    erts_smp_atomic_t dist_cmd_scheduled;
-    ErtsPortTaskHandle dist_cmd;
-
-    Uint (*send)(Port *prt, ErtsDistOutputBuf *obuf);
-
-    struct cache* cache;	/* The atom cache */
+    ErtsDistStats stats;
 } DistEntry;
 
 typedef struct erl_node_ {
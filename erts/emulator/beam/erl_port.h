@@ -174,6 +174,7 @@ struct _erl_drv_port {
 
     ErlIOQueue ioq;              /* driver accessible i/o queue */
     DistEntry *dist_entry;       /* Dist entry used in DISTRIBUTION */
+    ErtsDistChannel *dist_chnl;  /* Channel of dist_entry used */
     char *name;		         /* String used in the open */
     erts_driver_t* drv_ptr;
     UWord drv_data;
@@ -92,6 +92,23 @@ static void chk_task_queues(Port *pp, ErtsPortTask *execq, int processing_busy_q
 
 erts_smp_atomic_t erts_port_task_outstanding_io_tasks;
 
+/*
+ * Only the I/O tasks of pollset 0, which is polled by the schedulers,
+ * are counted in erts_port_task_outstanding_io_tasks. The poll thread
+ * of any other pollset is woken when an I/O task of its pollset has
+ * been executed or aborted, so that it can poll for the events of
+ * that fd again.
+ */
+typedef union {
+    struct {
+	void (*wakeup)(void *);
+	void *arg;
+    } data;
+    char align__[ERTS_CACHE_LINE_SIZE];
+} ErtsPollsetIoTasks;
+
+static ErtsPollsetIoTasks *pollset_io_tasks;
+
 #define ERTS_PT_STATE_SCHEDULED		0
 #define ERTS_PT_STATE_ABORTED		1
 #define ERTS_PT_STATE_EXECUTING		2
@@ -598,6 +615,46 @@ reset_executed_io_task_handle(ErtsPortTask *ptp)
     }
 }
 
+static ERTS_INLINE int
+io_task_pollset_ix(ErtsPortTask *ptp)
+{
+    return erts_check_io_pollset_ix(ptp->u.alive.td.io.event);
+}
+
+static ERTS_INLINE void
+inc_outstanding_io_tasks(int ix)
+{
+    if (ix == 0)
+	erts_smp_atomic_inc_relb(&erts_port_task_outstanding_io_tasks);
+}
+
+static ERTS_INLINE void
+dec_outstanding_io_tasks(int ix, erts_aint_t no)
+{
+    if (ix == 0) {
+	ASSERT(erts_smp_atomic_read_nob(&erts_port_task_outstanding_io_tasks)
+	       >= no);
+	erts_smp_atomic_add_relb(&erts_port_task_outstanding_io_tasks, -no);
+    }
+    else {
+	ErtsPollsetIoTasks *piotp = &pollset_io_tasks[ix];
+	ASSERT(piotp->data.wakeup);
+	(*piotp->data.wakeup)(piotp->data.arg);
+    }
+}
+
+static ERTS_INLINE void
+executed_io_task(ErtsPortTask *ptp, int *ixp, erts_aint_t *nop)
+{
+    int ix = io_task_pollset_ix(ptp);
+    if (*nop && ix != *ixp) {
+	dec_outstanding_io_tasks(*ixp, *nop);
+	*nop = 0;
+    }
+    *ixp = ix;
+    (*nop)++;
+}
+
 static ERTS_INLINE void
 set_handle(ErtsPortTask *ptp, ErtsPortTaskHandle *pthp)
 {
@@ -1322,9 +1379,7 @@ erts_port_task_abort(ErtsPortTaskHandle *pthp)
 	    case ERTS_PORT_TASK_INPUT:
 	    case ERTS_PORT_TASK_OUTPUT:
 	    case ERTS_PORT_TASK_EVENT:
-		ASSERT(erts_smp_atomic_read_nob(
-			   &erts_port_task_outstanding_io_tasks) > 0);
-		erts_smp_atomic_dec_relb(&erts_port_task_outstanding_io_tasks);
+		dec_outstanding_io_tasks(io_task_pollset_ix(ptp), 1);
 		break;
 	    default:
 		break;
@@ -1484,7 +1539,7 @@ erts_port_task_schedule(Eterm id,
 	va_start(argp, type);
 	ptp->u.alive.td.io.event = va_arg(argp, ErlDrvEvent);
 	va_end(argp);
-	erts_smp_atomic_inc_relb(&erts_port_task_outstanding_io_tasks);
+	inc_outstanding_io_tasks(io_task_pollset_ix(ptp));
 	break;
     }
     case ERTS_PORT_TASK_EVENT: {
@@ -1493,7 +1548,7 @@ erts_port_task_schedule(Eterm id,
 	ptp->u.alive.td.io.event = va_arg(argp, ErlDrvEvent);
 	ptp->u.alive.td.io.event_data = va_arg(argp, ErlDrvEventData);
 	va_end(argp);
-	erts_smp_atomic_inc_relb(&erts_port_task_outstanding_io_tasks);
+	inc_outstanding_io_tasks(io_task_pollset_ix(ptp));
 	break;
     }
     case ERTS_PORT_TASK_PROC_SIG: {
@@ -1628,8 +1683,18 @@ fail:
     if (ns_pthlp)
 	erts_free(ERTS_ALC_T_PT_HNDL_LIST, ns_pthlp);
 
-    if (ptp)
+    if (ptp) {
+	switch (type) {
+	case ERTS_PORT_TASK_INPUT:
+	case ERTS_PORT_TASK_OUTPUT:
+	case ERTS_PORT_TASK_EVENT:
+	    dec_outstanding_io_tasks(io_task_pollset_ix(ptp), 1);
+	    break;
+	default:
+	    break;
+	}
 	port_task_free(ptp);
+    }
 
     return -1;
 }
@@ -1680,6 +1745,7 @@ erts_port_task_execute(ErtsRunQueue *runq, Port **curr_port_pp)
     int vreds = 0;
     int reds = 0;
     erts_aint_t io_tasks_executed = 0;
+    int io_tasks_ix = 0;
     int fpe_was_unmasked;
     erts_aint32_t state;
     int active;
@@ -1782,7 +1848,7 @@ erts_port_task_execute(ErtsRunQueue *runq, Port **curr_port_pp)
 	    (*pp->drv_ptr->ready_input)((ErlDrvData) pp->drv_data,
 					ptp->u.alive.td.io.event);
 	    reset_executed_io_task_handle(ptp);
-	    io_tasks_executed++;
+	    executed_io_task(ptp, &io_tasks_ix, &io_tasks_executed);
 	    break;
 	case ERTS_PORT_TASK_OUTPUT:
 	    reds = ERTS_PORT_REDS_OUTPUT;
@@ -1792,7 +1858,7 @@ erts_port_task_execute(ErtsRunQueue *runq, Port **curr_port_pp)
 	    (*pp->drv_ptr->ready_output)((ErlDrvData) pp->drv_data,
 					 ptp->u.alive.td.io.event);
 	    reset_executed_io_task_handle(ptp);
-	    io_tasks_executed++;
+	    executed_io_task(ptp, &io_tasks_ix, &io_tasks_executed);
 	    break;
 	case ERTS_PORT_TASK_EVENT:
 	    reds = ERTS_PORT_REDS_EVENT;
@@ -1803,7 +1869,7 @@ erts_port_task_execute(ErtsRunQueue *runq, Port **curr_port_pp)
 				  ptp->u.alive.td.io.event,
 				  ptp->u.alive.td.io.event_data);
 	    reset_executed_io_task_handle(ptp);
-	    io_tasks_executed++;
+	    executed_io_task(ptp, &io_tasks_ix, &io_tasks_executed);
 	    break;
 	case ERTS_PORT_TASK_PROC_SIG: {
 	    ErtsProc2PortSigData *sigdp = &ptp->u.alive.td.psig.data;
@@ -1870,12 +1936,8 @@ erts_port_task_execute(ErtsRunQueue *runq, Port **curr_port_pp)
     ERTS_MSACC_POP_STATE_M();
 
 
-    if (io_tasks_executed) {
-	ASSERT(erts_smp_atomic_read_nob(&erts_port_task_outstanding_io_tasks)
-	       >= io_tasks_executed);
-	erts_smp_atomic_add_relb(&erts_port_task_outstanding_io_tasks,
-				 -1*io_tasks_executed);
-    }
+    if (io_tasks_executed)
+	dec_outstanding_io_tasks(io_tasks_ix, io_tasks_executed);
 
 #ifdef ERTS_SMP
     ASSERT(runq == (ErtsRunQueue *) erts_smp_atomic_read_nob(&pp->run_queue));
@@ -2194,14 +2256,43 @@ erts_dequeue_port(ErtsRunQueue *rq)
 
 #endif
 
+#ifdef ERTS_SMP
+
+/*
+ * Called by the poll thread of pollset ix before it starts polling.
+ * wakeup(arg) is called each time I/O tasks of the pollset have been
+ * executed or aborted.
+ */
+void
+erts_port_task_set_io_wakeup(int ix, void (*wakeup)(void *), void *arg)
+{
+    ErtsPollsetIoTasks *piotp = &pollset_io_tasks[ix];
+
+    ASSERT(ix > 0 && ix < erts_no_pollsets);
+
+    piotp->data.arg = arg;
+    piotp->data.wakeup = wakeup;
+}
+
+#endif
+
 /*
  * Initialize the module.
  */
 void
 erts_port_task_init(void)
 {
+    int i;
+
     erts_smp_atomic_init_nob(&erts_port_task_outstanding_io_tasks,
 			     (erts_aint_t) 0);
+    pollset_io_tasks = erts_alloc_permanent_cache_aligned(
+	ERTS_ALC_T_PT_IO_DATA,
+	sizeof(ErtsPollsetIoTasks) * erts_no_pollsets);
+    for (i = 0; i < erts_no_pollsets; i++) {
+	pollset_io_tasks[i].data.wakeup = NULL;
+	pollset_io_tasks[i].data.arg = NULL;
+    }
     init_port_task_alloc();
     init_busy_caller_table_alloc();
 }
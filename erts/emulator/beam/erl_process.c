@@ -11376,10 +11376,8 @@ erl_create_process(Process* parent, /* Parent of process (default group leader).
     erts_aint32_t state = 0;
     erts_aint32_t prio = (erts_aint32_t) PRIORITY_NORMAL;
     ErtsProcLocks locks = ERTS_PROC_LOCKS_ALL;
-#ifdef SHCOPY_SPAWN
     erts_shcopy_t info;
     INITIALIZE_SHCOPY(info);
-#endif
 
     erts_smp_proc_lock(parent, ERTS_PROC_LOCKS_ALL_MINOR);
 
@@ -11434,11 +11432,7 @@ erl_create_process(Process* parent, /* Parent of process (default group leader).
 	   || (erts_smp_atomic32_read_nob(&p->state)
 	       & ERTS_PSFLG_OFF_HEAP_MSGQ));
 
-#ifdef SHCOPY_SPAWN
-    arg_size = copy_shared_calculate(args, &info);
-#else
-    arg_size = size_object(args);
-#endif
+    arg_size = erts_copy_calculate(args, &info);
     heap_need = arg_size;
 
     p->flags = flags;
@@ -11515,12 +11509,8 @@ erl_create_process(Process* parent, /* Parent of process (default group leader).
     p->max_arg_reg = sizeof(p->def_arg_reg)/sizeof(p->def_arg_reg[0]);
     p->arg_reg[0] = mod;
     p->arg_reg[1] = func;
-#ifdef SHCOPY_SPAWN
-    p->arg_reg[2] = copy_shared_perform(args, arg_size, &info, &p->htop, &p->off_heap);
+    p->arg_reg[2] = erts_copy_perform(args, arg_size, &info, &p->htop, &p->off_heap);
     DESTROY_SHCOPY(info);
-#else
-    p->arg_reg[2] = copy_struct(args, arg_size, &p->htop, &p->off_heap);
-#endif
     p->arity = 3;
 
     p->fvalue = NIL;
@@ -11554,10 +11544,18 @@ erl_create_process(Process* parent, /* Parent of process (default group leader).
     p->msg.last = &p->msg.first;
     p->msg.save = &p->msg.first;
     p->msg.len = 0;
+    p->msg.ref_ix = NULL;
+    p->msg.limit.max_len = 0;
+    p->msg.limit.low_len = 0;
+    p->msg.limit.policy = ERTS_MSGQ_LIMIT_SUSPEND;
+    erts_smp_atomic32_init_nob(&p->msg.limit.busy, 0);
+    p->msg.limit.suspended = NULL;
 #ifdef ERTS_SMP
     p->msg_inq.first = NULL;
     p->msg_inq.last = &p->msg_inq.first;
     p->msg_inq.len = 0;
+    erts_smp_atomic_init_nob(&p->msg_inq.lf_first, ERTS_MSGQ_LF_EMPTY);
+    erts_smp_atomic_init_nob(&p->msg_inq.lf_len, 0);
 #endif
     p->bif_timers = NULL;
 #ifdef ERTS_BTM_ACCESSOR_SUPPORT
@@ -11759,6 +11757,12 @@ void erts_init_empty_process(Process *p)
     p->msg.last = &p->msg.first;
     p->msg.save = &p->msg.first;
     p->msg.len = 0;
+    p->msg.ref_ix = NULL;
+    p->msg.limit.max_len = 0;
+    p->msg.limit.low_len = 0;
+    p->msg.limit.policy = ERTS_MSGQ_LIMIT_SUSPEND;
+    erts_smp_atomic32_init_nob(&p->msg.limit.busy, 0);
+    p->msg.limit.suspended = NULL;
     p->bif_timers = NULL;
 #ifdef ERTS_BTM_ACCESSOR_SUPPORT
     p->accessor_bif_timers = NULL;
@@ -11816,6 +11820,8 @@ void erts_init_empty_process(Process *p)
     p->msg_inq.first = NULL;
     p->msg_inq.last = &p->msg_inq.first;
     p->msg_inq.len = 0;
+    erts_smp_atomic_init_nob(&p->msg_inq.lf_first, ERTS_MSGQ_LF_EMPTY);
+    erts_smp_atomic_init_nob(&p->msg_inq.lf_len, 0);
     p->suspendee = NIL;
     p->pending_suspenders = NULL;
     p->pending_exit.reason = THE_NON_VALUE;
@@ -12004,6 +12010,8 @@ delete_process(Process* p)
     /* free all pending messages */
     erts_cleanup_messages(p->msg.first);
     p->msg.first = NULL;
+    erts_msgq_ref_ix_destroy(&p->msg);
+    ASSERT(!p->msg.limit.suspended);
 
     ASSERT(!p->nodes_monitors);
     ASSERT(!p->suspend_monitors);
@@ -12222,21 +12230,14 @@ send_exit_message(Process *to, ErtsProcLocks *to_locksp,
     ErlOffHeap *ohp;
     Eterm* hp;
     Eterm mess;
-#ifdef SHCOPY_SEND
     erts_shcopy_t info;
-#endif
 
     if (!have_seqtrace(token)) {
-#ifdef SHCOPY_SEND
         INITIALIZE_SHCOPY(info);
-        term_size = copy_shared_calculate(exit_term, &info);
+        term_size = erts_copy_calculate(exit_term, &info);
 	mp = erts_alloc_message_heap(to, to_locksp, term_size, &hp, &ohp);
-        mess = copy_shared_perform(exit_term, term_size, &info, &hp, ohp);
+        mess = erts_copy_perform(exit_term, term_size, &info, &hp, ohp);
         DESTROY_SHCOPY(info);
-#else
-	mp = erts_alloc_message_heap(to, to_locksp, term_size, &hp, &ohp);
-	mess = copy_struct(exit_term, term_size, &hp, ohp);
-#endif
 	erts_queue_message(to, *to_locksp, mp, mess, am_system);
     } else {
 	Eterm temp_token;
@@ -12244,16 +12245,11 @@ send_exit_message(Process *to, ErtsProcLocks *to_locksp,
 
 	ASSERT(is_tuple(token));
 	sz_token = size_object(token);
-#ifdef SHCOPY_SEND
         INITIALIZE_SHCOPY(info);
-        term_size = copy_shared_calculate(exit_term, &info);
+        term_size = erts_copy_calculate(exit_term, &info);
 	mp = erts_alloc_message_heap(to, to_locksp, term_size+sz_token, &hp, &ohp);
-        mess = copy_shared_perform(exit_term, term_size, &info, &hp, ohp);
+        mess = erts_copy_perform(exit_term, term_size, &info, &hp, ohp);
         DESTROY_SHCOPY(info);
-#else
-	mp = erts_alloc_message_heap(to, to_locksp, term_size+sz_token, &hp, &ohp);
-	mess = copy_struct(exit_term, term_size, &hp, ohp);
-#endif
 	/* the trace token must in this case be updated by the caller */
 	seq_trace_output(token, mess, SEQ_TRACE_SEND, to->common.id, to);
 	temp_token = copy_struct(token, sz_token, &hp, ohp);
@@ -12634,6 +12630,7 @@ static void doit_exit_monitor(ErtsMonitor *mon, void *vpcontext)
 						     (rmon->name != NIL
 						      ? rmon->name
 						      : rmon->pid),
+						     rmon->pid,
 						     mon->ref,
 						     pcontext->reason);
 			ASSERT(code == ERTS_DSIG_SEND_OK);
@@ -12839,6 +12836,8 @@ erts_do_exit_process(Process* p, Eterm reason)
 
     cancel_suspend_of_suspendee(p, ERTS_PROC_LOCKS_ALL); 
 
+    /* Senders that haven't seen the exiting flag will drop their messages */
+    erts_msgq_lf_fetch(p, 1);
     ERTS_SMP_MSGQ_MV_INQ2PRIVQ(p);
 #endif
 
@@ -12861,6 +12860,11 @@ erts_do_exit_process(Process* p, Eterm reason)
 
     erts_smp_proc_unlock(p, ERTS_PROC_LOCKS_ALL_MINOR);
 
+    /* Resume senders suspended on our message queue limit */
+    if (p->msg.limit.max_len
+	|| erts_smp_atomic32_read_nob(&p->msg.limit.busy))
+	erts_msgq_limit_release(p);
+
     if (IS_TRACED_FL(p,F_TRACE_PROCS))
         trace_proc(p, ERTS_PROC_LOCK_MAIN, p, am_exit, reason);
 
@@ -13094,7 +13098,7 @@ erts_continue_exit_process(Process *p)
     erts_smp_proc_unlock(p, ERTS_PROC_LOCKS_ALL);
 
     if (dep) {
-	erts_do_net_exits(dep, reason);
+	erts_do_net_exits(dep, NULL, reason);
     }
 
     /*
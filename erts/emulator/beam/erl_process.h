@@ -1923,15 +1923,41 @@ ErtsSchedulerData *erts_get_scheduler_data(void)
 void erts_schedule_process(Process *, erts_aint32_t, ErtsProcLocks);
 
 ERTS_GLB_INLINE void erts_proc_notify_new_message(Process *p, ErtsProcLocks locks);
+ERTS_GLB_INLINE void erts_proc_wait_deactivate(Process *p);
 #if ERTS_GLB_INLINE_INCL_FUNC_DEF
 ERTS_GLB_INLINE void
 erts_proc_notify_new_message(Process *p, ErtsProcLocks locks)
 {
-    /* No barrier needed, due to msg lock */
+    /*
+     * No barrier needed, due to msg lock, or due to the full
+     * barrier when pushing onto the lock free in queue.
+     */
     erts_aint32_t state = erts_smp_atomic32_read_nob(&p->state);
     if (!(state & ERTS_PSFLG_ACTIVE))
 	erts_schedule_process(p, state, locks);
 }
+
+/*
+ * Clear the active flag of the currently executing process which
+ * is about to wait for messages. Caller holds the msgq lock.
+ */
+ERTS_GLB_INLINE void
+erts_proc_wait_deactivate(Process *p)
+{
+#ifdef ERTS_SMP
+    erts_smp_atomic32_read_band_mb(&p->state, ~ERTS_PSFLG_ACTIVE);
+    /*
+     * Senders pushing onto the lock free in queue do not take
+     * the msgq lock. A sender that pushed a message after we
+     * fetched the in queue, but saw the active flag still set,
+     * won't schedule us; reactivate ourselves in that case...
+     */
+    if (ERTS_MSGQ_LF_HAVE_MSGS(p))
+	erts_smp_atomic32_read_bor_relb(&p->state, ERTS_PSFLG_ACTIVE);
+#else
+    erts_smp_atomic32_read_band_relb(&p->state, ~ERTS_PSFLG_ACTIVE);
+#endif
+}
 #endif
 
 #if defined(ERTS_SMP) && defined(ERTS_ENABLE_LOCK_CHECK)
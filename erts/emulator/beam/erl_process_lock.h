@@ -123,7 +123,8 @@ typedef struct erts_proc_lock_t_ {
 /*
  * Message queue lock:
  *   Protects the following fields in the process structure:
- *   * msg_inq
+ *   * msg_inq (senders may push onto msg_inq.lf_first without
+ *     the lock, but only the lock holder may detach it)
  */
 #define ERTS_PROC_LOCK_MSGQ		(((ErtsProcLocks) 1) << 2)
 
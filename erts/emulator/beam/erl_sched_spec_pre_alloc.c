@@ -79,8 +79,6 @@ erts_sspa_create(size_t blk_sz, int pa_size)
     for (cix = 0; cix < erts_no_schedulers; cix++) {
 	erts_sspa_chunk_t *chnk = erts_sspa_cix2chunk(data, cix);
 	erts_sspa_chunk_header_t *chdr = &chnk->aligned.header;
-	erts_sspa_blk_t *blk;
-	int i;
 
 	erts_atomic_init_nob(&chdr->tail.data.last, (erts_aint_t) &chdr->tail.data.marker);
 	erts_atomic_init_nob(&chdr->tail.data.marker.next_atmc, ERTS_AINT_NULL);
@@ -97,17 +95,12 @@ erts_sspa_create(size_t blk_sz, int pa_size)
 	chdr->head.next.um_refc_ix = 1;
 	chdr->head.next.unref_end = &chdr->tail.data.marker;
 
-	p = &chnk->data[0];
-	chdr->local.first = (erts_sspa_blk_t *) p;
-	blk = (erts_sspa_blk_t *) p;
-	for (i = 0; i < no_blocks_per_chunk; i++) {
-	    blk = (erts_sspa_blk_t *) p;
-	    p += blk_sz;
-	    blk->next_ptr = (erts_sspa_blk_t *) p;
-	}
-
-	blk->next_ptr = NULL;
-	chdr->local.last = blk;
+	/* Blocks are carved out of the chunk when first needed */
+	chdr->local.first = NULL;
+	chdr->local.last = NULL;
+	chdr->local.unused = &chnk->data[0];
+	chdr->local.unused_end = &chnk->data[0] + blk_sz*no_blocks_per_chunk;
+	chdr->local.blk_sz = (int) blk_sz;
 	chdr->local.cnt = no_blocks_per_chunk;
 	chdr->local.lim = no_blocks_per_chunk / 3;
 
@@ -68,9 +68,17 @@ union erts_sspa_blk_t_ {
     erts_sspa_blk_t *next_ptr;
 };
 
+/*
+ * Blocks that never have been used are handed out from the
+ * [unused, unused_end) part of the chunk, so that the memory of a
+ * chunk is not touched until it is needed. 'cnt' includes them.
+ */
 typedef struct {
     erts_sspa_blk_t *first;
     erts_sspa_blk_t *last;
+    char *unused;
+    char *unused_end;
+    int blk_sz;
     int cnt;
     int lim;
 } erts_sspa_local_freelist_t;
@@ -132,6 +140,8 @@ check_local_list(erts_sspa_chunk_header_t *chdr)
     int n = 0;
     for (blk = chdr->local.first; blk; blk = blk->next_ptr)
 	n++;
+    n += (int) ((chdr->local.unused_end - chdr->local.unused)
+		/ chdr->local.blk_sz);
     ASSERT(n == chdr->local.cnt);
 }
 #endif
@@ -195,6 +205,12 @@ erts_sspa_alloc(erts_sspa_data_t *data, int cix)
 	    chdr->local.last = NULL;
 	ERTS_SSPA_DBG_CHK_LCL(chdr);
     }
+    else if (chdr->local.unused < chdr->local.unused_end) {
+	res = (erts_sspa_blk_t *) chdr->local.unused;
+	chdr->local.unused += chdr->local.blk_sz;
+	chdr->local.cnt--;
+	ERTS_SSPA_DBG_CHK_LCL(chdr);
+    }
     if (chdr->local.cnt <= chdr->local.lim)
 	return (char *) erts_sspa_process_remote_frees(chdr, res);
     else if (chdr->head.no_thr_progress_check < ERTS_SSPA_FORCE_THR_CHECK_PROGRESS)
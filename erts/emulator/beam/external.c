@@ -113,7 +113,7 @@ static Sint decoded_size(byte *ep, byte* endp, int internal_tags, struct B2TCont
 static BIF_RETTYPE term_to_binary_trap_1(BIF_ALIST_1);
 
 static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint flags, 
-				     Binary *context_b);
+				     int iovec, Binary *context_b);
 
 static Uint encode_size_struct2(ErtsAtomCacheMap *, Eterm, unsigned);
 struct TTBSizeContext_;
@@ -276,6 +276,7 @@ erts_finalize_atom_cache_map(ErtsAtomCacheMap *acmp, Uint32 dflags)
     if (acmp) {
 	int utf8_atoms = (int) (dflags & DFLAG_UTF8_ATOMS);
 	int long_atoms = 0; /* !0 if one or more atoms are longer than 255. */
+	int cix_sz = (dflags & DFLAG_LARGE_ATOM_CACHE) ? 2 : 1;
 	int i;
 	int sz;
 	int fix_sz
@@ -301,7 +302,7 @@ erts_finalize_atom_cache_map(ErtsAtomCacheMap *acmp, Uint32 dflags)
 	    if (!long_atoms && len > 255)
 		long_atoms = 1;
 	    /* Enough for a new atom cache value */
-	    sz += 1 /* cix */ + 1 /* length */ + len /* text */;
+	    sz += cix_sz + 1 /* length */ + len /* text */;
 	}
 	if (long_atoms) {
 	    acmp->long_atoms = 1;
@@ -366,6 +367,50 @@ byte *erts_encode_ext_dist_header_setup(byte *ctl_ext, ErtsAtomCacheMap *acmp)
     }
 }
 
+/*
+ * Find the output cache index to use for 'atom'. The cache is
+ * ERTS_ATOM_CACHE_WAYS-way set associative; on a miss the least
+ * recently used entry of the set is replaced. Entries referred to by
+ * the message currently being finalized (stamped with the current
+ * clock) are never replaced, since the receiver applies all header
+ * entries of a message before decoding it. If all ways of a set are
+ * taken by the current message the following sets are probed.
+ */
+static ERTS_INLINE int
+out_cache_lookup(ErtsAtomCache *cache, Eterm atom, int *hitp)
+{
+    int nsets = cache->size / ERTS_ATOM_CACHE_WAYS;
+    int set = (int) (atom_val(atom) % nsets);
+    int victim = -1;
+
+    while (1) {
+	int cix = set*ERTS_ATOM_CACHE_WAYS;
+	int end = cix + ERTS_ATOM_CACHE_WAYS;
+	for (; cix < end; cix++) {
+	    if (cache->out_arr[cix] == atom) {
+		ASSERT(cache->out_used[cix] != cache->clock);
+		cache->out_used[cix] = cache->clock;
+		cache->out_hits++;
+		*hitp = 1;
+		return cix;
+	    }
+	    if (cache->out_used[cix] != cache->clock
+		&& (victim < 0
+		    || cache->out_used[cix] < cache->out_used[victim]))
+		victim = cix;
+	}
+	if (victim >= 0)
+	    break;
+	/* Cannot happen more than ERTS_MAX_INTERNAL_ATOM_CACHE_ENTRIES times */
+	set = (set + 1) % nsets;
+    }
+    cache->out_arr[victim] = atom;
+    cache->out_used[victim] = cache->clock;
+    cache->out_misses++;
+    *hitp = 0;
+    return victim;
+}
+
 byte *erts_encode_ext_dist_header_finalize(byte *ext, ErtsAtomCache *cache, Uint32 dflags)
 {
     byte *ip;
@@ -404,7 +449,7 @@ byte *erts_encode_ext_dist_header_finalize(byte *ext, ErtsAtomCache *cache, Uint
 			      ERTS_MAX_INTERNAL_ATOM_CACHE_ENTRIES)-1)
 			 / sizeof(Uint32))+1];
 	register Uint32 flgs;
-	int iix, flgs_bytes, flgs_buf_ix, used_half_bytes;
+	int iix, flgs_bytes, flgs_buf_ix, used_half_bytes, wide_ix;
 #ifdef DEBUG
 	int tot_used_half_bytes;
 #endif
@@ -421,9 +466,11 @@ byte *erts_encode_ext_dist_header_finalize(byte *ext, ErtsAtomCache *cache, Uint
 #ifdef DEBUG
 	tot_used_half_bytes = used_half_bytes;
 #endif
+	wide_ix = ERTS_ATOM_CACHE_WIDE_IX(cache);
+	cache->clock++;
 	iix = ci-1;
 	while (iix >= 0) {
-	    int cix;
+	    int cix, hit;
 	    Eterm atom;
 
 	    if (used_half_bytes != 8)
@@ -434,18 +481,28 @@ byte *erts_encode_ext_dist_header_finalize(byte *ext, ErtsAtomCache *cache, Uint
 		used_half_bytes = 0;
 	    }
 
+	    /*
+	     * The cache index chosen by the atom cache map is only used
+	     * for deduplication within the message; the actual output
+	     * cache index is decided here.
+	     */
 	    ip = &instr_buf[0] + (2+4)*iix;
-	    cix = (int) get_int16(&ip[0]);
-	    ASSERT(0 <= cix && cix < ERTS_ATOM_CACHE_SIZE);
 	    atom = make_atom((Uint) get_int32(&ip[2]));
-	    if (cache->out_arr[cix] == atom) {
-		--ep;
-		put_int8(cix, ep);
-		flgs |= ((cix >> 8) & 7);
+	    cix = out_cache_lookup(cache, atom, &hit);
+	    ASSERT(0 <= cix && cix < cache->size);
+	    if (hit) {
+		if (wide_ix) {
+		    ep -= 2;
+		    put_int16(cix, ep);
+		}
+		else {
+		    --ep;
+		    put_int8(cix, ep);
+		    flgs |= ((cix >> 8) & 7);
+		}
 	    }
 	    else {
 		Atom *a;
-		cache->out_arr[cix] = atom;
 		a = atom_tab(atom_val(atom));
 		if (utf8_atoms) {
 		    sz = a->len;
@@ -467,9 +524,16 @@ byte *erts_encode_ext_dist_header_finalize(byte *ext, ErtsAtomCache *cache, Uint
 		    --ep;
 		    put_int8(sz, ep);
 		}
-		--ep;
-		put_int8(cix, ep);
-		flgs |= (8 | ((cix >> 8) & 7));
+		if (wide_ix) {
+		    ep -= 2;
+		    put_int16(cix, ep);
+		    flgs |= 8;
+		}
+		else {
+		    --ep;
+		    put_int8(cix, ep);
+		    flgs |= (8 | ((cix >> 8) & 7));
+		}
 	    }
 	    iix--;
 	    used_half_bytes++;
@@ -599,6 +663,7 @@ erts_make_dist_ext_copy(ErtsDistExternal *edep, Uint xsize)
     size_t align_sz;
     size_t dist_ext_sz;
     size_t ext_sz;
+    size_t copy_sz;
     byte *ep;
     ErtsDistExternal *new_edep;
 
@@ -607,23 +672,48 @@ erts_make_dist_ext_copy(ErtsDistExternal *edep, Uint xsize)
     ASSERT(edep->ext_endp >= edep->extp);
     ext_sz = edep->ext_endp - edep->extp;
 
-    align_sz = ERTS_EXTRA_DATA_ALIGN_SZ(dist_ext_sz + ext_sz);
+    /*
+     * Large messages received in a binary are not copied; the copy
+     * refers to the data in the binary instead.
+     */
+    if (!edep->binp || !ERTS_DIST_BIN_REF(edep->binp, ext_sz)) {
+	copy_sz = ext_sz;
+    }
+    else {
+	copy_sz = 0;
+    }
+
+    align_sz = ERTS_EXTRA_DATA_ALIGN_SZ(dist_ext_sz + copy_sz);
 
     new_edep = erts_alloc(ERTS_ALC_T_EXT_TERM_DATA,
-			  dist_ext_sz + ext_sz + align_sz + xsize);
+			  dist_ext_sz + copy_sz + align_sz + xsize);
 
     ep = (byte *) new_edep;
     sys_memcpy((void *) ep, (void *) edep, dist_ext_sz);
     ep += dist_ext_sz;
     if (new_edep->dep)
 	erts_refc_inc(&new_edep->dep->refc, 1);
-    new_edep->extp = ep;
-    new_edep->ext_endp = ep + ext_sz;
     new_edep->heap_size = -1;
-    sys_memcpy((void *) ep, (void *) edep->extp, ext_sz);
+    /* The data may be replaced when uncompressed; remember the trailer */
+    new_edep->trailer = (void *) (ep + copy_sz + align_sz);
+    if (copy_sz) {
+	new_edep->binp = NULL;
+	new_edep->extp = ep;
+	new_edep->ext_endp = ep + ext_sz;
+	sys_memcpy((void *) ep, (void *) edep->extp, ext_sz);
+    }
+    else
+	erts_refc_inc(&new_edep->binp->refc, 2);
     return new_edep;
 }
 
+void
+erts_release_dist_ext_binary(Binary *bp)
+{
+    if (erts_refc_dectest(&bp->refc, 0) == 0)
+	erts_bin_free(bp);
+}
+
 int
 erts_prepare_dist_ext(ErtsDistExternal *edep,
 		      byte *ext,
@@ -646,6 +736,8 @@ erts_prepare_dist_ext(ErtsDistExternal *edep,
 
     edep->heap_size = -1;
     edep->ext_endp = ext+size;
+    edep->binp = NULL;
+    edep->decode = NULL;
 
     if (size < 2)
 	ERTS_EXT_FAIL;
@@ -702,6 +794,7 @@ erts_prepare_dist_ext(ErtsDistExternal *edep,
 	ep++;
 	if (no_atoms) {
 	    int long_atoms = 0;
+	    int wide_ix = ERTS_ATOM_CACHE_WIDE_IX(cache);
 #ifdef DEBUG
 	    byte *flgs_buf = ep;
 #endif
@@ -770,25 +863,28 @@ erts_prepare_dist_ext(ErtsDistExternal *edep,
 		       == (((flgs_buf[byte_ix]
 			     & (((byte) 3) << bit_ix)) >> bit_ix) & 3));
 
-		CHKSIZE(1);
-		cix = (int) ((flgs & 7) << 8);
+		if (wide_ix) {
+		    CHKSIZE(2);
+		    cix = (int) get_int16(ep);
+		    ep += 2;
+		}
+		else {
+		    CHKSIZE(1);
+		    cix = (int) (((flgs & 7) << 8) | get_int8(ep));
+		    ep++;
+		}
+		if (cix >= cache->size)
+		    ERTS_EXT_HDR_FAIL;
 		if ((flgs & 8) == 0) {
 		    /* atom already cached */
-		    cix += (int) get_int8(ep);
-		    if (cix >= ERTS_ATOM_CACHE_SIZE)
-			ERTS_EXT_HDR_FAIL;
-		    ep++;
 		    atom = cache->in_arr[cix];
 		    if (!is_atom(atom))
 			ERTS_EXT_HDR_FAIL;
+		    cache->in_hits++;
 		    edep->attab.atom[tix] = atom;
 		}
 		else {
 		    /* new cached atom */
-		    cix += (int) get_int8(ep);
-		    if (cix >= ERTS_ATOM_CACHE_SIZE)
-			ERTS_EXT_HDR_FAIL;
-		    ep++;
 		    if (long_atoms) {
 			CHKSIZE(2);
 			len = get_int16(ep);
@@ -810,6 +906,7 @@ erts_prepare_dist_ext(ErtsDistExternal *edep,
 			ERTS_EXT_HDR_FAIL;
 		    ep += len;
 		    cache->in_arr[cix] = atom;
+		    cache->in_misses++;
 		    edep->attab.atom[tix] = atom;
 		}
 		flgs >>= 4;
@@ -893,6 +990,61 @@ bad_dist_ext(ErtsDistExternal *edep)
     }
 }
 
+/*
+ * A message compressed by the sender (see dist.c) is uncompressed into
+ * a binary that replaces the data of the dist ext copy, so that large
+ * binaries in the message can refer to it as to a received binary.
+ */
+
+static Binary *
+dist_ext_uncompress_alloc(ErtsDistExternal *edep, Uint *sizep)
+{
+    Binary *bin;
+    Uint size;
+
+    if (edep->ext_endp - edep->extp < 1+4)
+	return NULL;
+    size = get_int32(edep->extp + 1);
+    if (size == 0)
+	return NULL;
+    bin = erts_bin_drv_alloc_fnf(size);
+    if (bin)
+	erts_refc_init(&bin->refc, 1);
+    *sizep = size;
+    return bin;
+}
+
+static void
+dist_ext_uncompress_done(ErtsDistExternal *edep, Binary *bin)
+{
+    if (edep->binp)
+	erts_release_dist_ext_binary(edep->binp);
+    edep->binp = bin;
+    edep->extp = (byte *) bin->orig_bytes;
+    edep->ext_endp = edep->extp + bin->orig_size;
+}
+
+static int
+dist_ext_uncompress(ErtsDistExternal *edep)
+{
+    Uint size;
+    uLongf dlen;
+    Binary *bin = dist_ext_uncompress_alloc(edep, &size);
+
+    if (!bin)
+	return -1;
+    dlen = (uLongf) size;
+    if (erl_zlib_uncompress((byte *) bin->orig_bytes, &dlen,
+			    edep->extp + 1+4,
+			    edep->ext_endp - (edep->extp + 1+4)) != Z_OK
+	|| dlen != size) {
+	erts_bin_free(bin);
+	return -1;
+    }
+    dist_ext_uncompress_done(edep, bin);
+    return 0;
+}
+
 Sint
 erts_decode_dist_ext_size(ErtsDistExternal *edep)
 {
@@ -904,6 +1056,8 @@ erts_decode_dist_ext_size(ErtsDistExternal *edep)
     if (edep->flags & ERTS_DIST_EXT_DFLAG_HDR) {
 	if (*edep->extp == VERSION_MAGIC)
 	    goto fail;
+	if (*edep->extp == COMPRESSED && dist_ext_uncompress(edep) < 0)
+	    goto fail;
 	ep = edep->extp;
     }
     else
@@ -954,6 +1108,11 @@ erts_decode_dist_ext(ErtsHeapFactory* factory,
     if (edep->flags & ERTS_DIST_EXT_DFLAG_HDR) {
 	if (*ep == VERSION_MAGIC)
 	    goto error;
+	if (*ep == COMPRESSED) {
+	    if (dist_ext_uncompress(edep) < 0)
+		goto error;
+	    ep = edep->extp;
+	}
     }
     else
 #endif
@@ -1030,6 +1189,8 @@ BIF_RETTYPE erts_debug_dist_ext_to_term_2(BIF_ALIST_2)
     ede.flags = ERTS_DIST_EXT_ATOM_TRANS_TAB;
     ede.dep = NULL;
     ede.heap_size = -1;
+    ede.binp = NULL;
+    ede.decode = NULL;
     
     if (is_not_tuple(BIF_ARG_1))
 	goto badarg;
@@ -1074,17 +1235,28 @@ BIF_RETTYPE erts_debug_dist_ext_to_term_2(BIF_ALIST_2)
     BIF_ERROR(BIF_P, BADARG);
 }
 
+/* A term_to_iovec/1,2 result that is a single binary */
+static ERTS_INLINE Eterm
+ttb_iovec_one(Process *p, Eterm bin)
+{
+    Eterm *hp = HAlloc(p, 2);
+    return CONS(hp, bin, NIL);
+}
+
 static BIF_RETTYPE term_to_binary_trap_1(BIF_ALIST_1)
 {
     Eterm *tp = tuple_val(BIF_ARG_1);
     Eterm Term = tp[1];
     Eterm bt = tp[2];
     Binary *bin = ((ProcBin *) binary_val(bt))->val;
-    Eterm res = erts_term_to_binary_int(BIF_P, Term, 0, 0,bin);
+    TTBContext *context = ERTS_MAGIC_BIN_DATA(bin);
+    Eterm res = erts_term_to_binary_int(BIF_P, Term, 0, 0, 0, bin);
     if (is_tuple(res)) {
 	ASSERT(BIF_P->flags & F_DISABLE_GC);
 	BIF_TRAP1(&term_to_binary_trap_export,BIF_P,res);
     } else {
+	if (context->iovec && is_binary(res))
+	    res = ttb_iovec_one(BIF_P, res);
         if (erts_set_gc_state(BIF_P, 1)
             || MSO(BIF_P).overhead > BIN_VHEAP_SZ(BIF_P))
             ERTS_BIF_YIELD_RETURN(BIF_P, res);
@@ -1097,7 +1269,7 @@ HIPE_WRAPPER_BIF_DISABLE_GC(term_to_binary, 1)
 
 BIF_RETTYPE term_to_binary_1(BIF_ALIST_1)
 {
-    Eterm res = erts_term_to_binary_int(BIF_P, BIF_ARG_1, 0, TERM_TO_BINARY_DFLAGS, NULL);
+    Eterm res = erts_term_to_binary_int(BIF_P, BIF_ARG_1, 0, TERM_TO_BINARY_DFLAGS, 0, NULL);
     if (is_tuple(res)) {
 	erts_set_gc_state(BIF_P, 0);
 	BIF_TRAP1(&term_to_binary_trap_export,BIF_P,res);
@@ -1107,16 +1279,15 @@ BIF_RETTYPE term_to_binary_1(BIF_ALIST_1)
     }
 }
 
-HIPE_WRAPPER_BIF_DISABLE_GC(term_to_binary, 2)
-
-BIF_RETTYPE term_to_binary_2(BIF_ALIST_2)
+/*
+ * Parse the options of term_to_binary/2 and term_to_iovec/2. Returns
+ * 0 if they are invalid.
+ */
+static int
+ttb_options(Eterm Flags, int *levelp, Uint *flagsp)
 {
-    Process* p = BIF_P;
-    Eterm Term = BIF_ARG_1;
-    Eterm Flags = BIF_ARG_2;
     int level = 0;
     Uint flags = TERM_TO_BINARY_DFLAGS;
-    Eterm res;
 
     while (is_list(Flags)) {
 	Eterm arg = CAR(list_val(Flags));
@@ -1145,20 +1316,80 @@ BIF_RETTYPE term_to_binary_2(BIF_ALIST_2)
 	    }
 	} else {
 	error:
-	    BIF_ERROR(p, BADARG);
+	    return 0;
 	}
 	Flags = CDR(list_val(Flags));
     }
     if (is_not_nil(Flags)) {
 	goto error;
     }
+    *levelp = level;
+    *flagsp = flags;
+    return 1;
+}
+
+HIPE_WRAPPER_BIF_DISABLE_GC(term_to_binary, 2)
 
-    res = erts_term_to_binary_int(p, Term, level, flags, NULL);
+BIF_RETTYPE term_to_binary_2(BIF_ALIST_2)
+{
+    int level;
+    Uint flags;
+    Eterm res;
+
+    if (!ttb_options(BIF_ARG_2, &level, &flags))
+	BIF_ERROR(BIF_P, BADARG);
+
+    res = erts_term_to_binary_int(BIF_P, BIF_ARG_1, level, flags, 0, NULL);
     if (is_tuple(res)) {
-	erts_set_gc_state(p, 0);
+	erts_set_gc_state(BIF_P, 0);
+	BIF_TRAP1(&term_to_binary_trap_export,BIF_P,res);
+    } else {
+	ASSERT(!(BIF_P->flags & F_DISABLE_GC));
+	BIF_RET(res);
+    }
+}
+
+/*
+ * term_to_iovec/1,2 encode like term_to_binary/1,2 but return a list
+ * of binaries in which large refc binaries of the term are
+ * referred to instead of copied.
+ */
+
+HIPE_WRAPPER_BIF_DISABLE_GC(term_to_iovec, 1)
+
+BIF_RETTYPE term_to_iovec_1(BIF_ALIST_1)
+{
+    Eterm res = erts_term_to_binary_int(BIF_P, BIF_ARG_1, 0, TERM_TO_BINARY_DFLAGS, 1, NULL);
+    if (is_tuple(res)) {
+	erts_set_gc_state(BIF_P, 0);
 	BIF_TRAP1(&term_to_binary_trap_export,BIF_P,res);
     } else {
 	ASSERT(!(BIF_P->flags & F_DISABLE_GC));
+	if (is_binary(res))
+	    res = ttb_iovec_one(BIF_P, res);
+	BIF_RET(res);
+    }
+}
+
+HIPE_WRAPPER_BIF_DISABLE_GC(term_to_iovec, 2)
+
+BIF_RETTYPE term_to_iovec_2(BIF_ALIST_2)
+{
+    int level;
+    Uint flags;
+    Eterm res;
+
+    if (!ttb_options(BIF_ARG_2, &level, &flags))
+	BIF_ERROR(BIF_P, BADARG);
+
+    res = erts_term_to_binary_int(BIF_P, BIF_ARG_1, level, flags, 1, NULL);
+    if (is_tuple(res)) {
+	erts_set_gc_state(BIF_P, 0);
+	BIF_TRAP1(&term_to_binary_trap_export,BIF_P,res);
+    } else {
+	ASSERT(!(BIF_P->flags & F_DISABLE_GC));
+	if (is_binary(res))
+	    res = ttb_iovec_one(BIF_P, res);
 	BIF_RET(res);
     }
 }
@@ -1203,6 +1434,7 @@ typedef struct {
     z_stream stream;
     byte* dbytes;
     Uint dleft;
+    Binary *dbin; /* Uncompressed dist message, see dist_ext_uncompress_start() */
 } B2TUncompressContext;
 
 typedef struct B2TContext_t {
@@ -1546,6 +1778,7 @@ static BIF_RETTYPE binary_to_term_int(Process* p, Uint32 flags, Eterm bin, Binar
         case B2TDecodeBinary: {
 	    ErtsDistExternal fakedep;
             fakedep.flags = ctx->flags;
+            fakedep.binp = NULL;
             dec_term(&fakedep, NULL, NULL, NULL, ctx);
             break;
 	}
@@ -1647,6 +1880,195 @@ error:
     BIF_ERROR(BIF_P, BADARG);
 }
 
+/*
+ * Decode the message of a received distribution message copy (see
+ * erts_make_dist_ext_copy()) into heap fragments, using at most about
+ * *redsp reductions per call. Returns 1 with the term in *objp and
+ * its heap fragments in *factory when done, 0 if it has to be called
+ * again, and -1 if the message is bad. *redsp is decremented by the
+ * reductions used. The state of an unfinished decode is kept in the
+ * dist ext copy and is released together with it.
+ */
+int
+erts_decode_dist_ext_yielding(ErtsHeapFactory *factory,
+			      ErtsDistExternal *edep,
+			      Eterm *objp,
+			      Sint *redsp)
+{
+    SWord initial_reds = (SWord) (*redsp * B2T_BYTES_PER_REDUCTION);
+    B2TContext *ctx = edep->decode;
+
+    if (initial_reds <= 0)
+	initial_reds = 1;
+
+    if (!ctx) {
+	byte *ep = edep->extp;
+
+	if (ep >= edep->ext_endp)
+	    goto error;
+#ifndef ERTS_DEBUG_USE_DIST_SEP
+	if (edep->flags & ERTS_DIST_EXT_DFLAG_HDR) {
+	    if (*ep == VERSION_MAGIC)
+		goto error;
+	}
+	else
+#endif
+	{
+	    if (*ep != VERSION_MAGIC)
+		goto error;
+	    ep++;
+	}
+
+	ctx = erts_alloc(ERTS_ALC_T_DIST_DECODE, sizeof(B2TContext));
+	ctx->aligned_alloc = NULL;
+	ctx->b2ts.extp = ep;
+	ctx->b2ts.exttmp = 0;
+	ctx->b2ts.extsize = edep->ext_endp - ep;
+	ctx->flags = edep->flags;
+	ctx->heap_size = edep->heap_size;
+	ctx->state = edep->heap_size >= 0 ? B2TDecodeInit : B2TSizeInit;
+	if ((edep->flags & ERTS_DIST_EXT_DFLAG_HDR) && *ep == COMPRESSED) {
+	    Uint size;
+	    Binary *bin = dist_ext_uncompress_alloc(edep, &size);
+	    if (!bin) {
+		erts_free(ERTS_ALC_T_DIST_DECODE, ctx);
+		goto error;
+	    }
+	    if (erl_zlib_inflate_start(&ctx->u.uc.stream, ep + 1+4,
+				       edep->ext_endp - (ep + 1+4)) != Z_OK) {
+		erts_bin_free(bin);
+		erts_free(ERTS_ALC_T_DIST_DECODE, ctx);
+		goto error;
+	    }
+	    ctx->u.uc.dbin = bin;
+	    ctx->u.uc.dbytes = (byte *) bin->orig_bytes;
+	    ctx->u.uc.dleft = size;
+	    ctx->state = B2TUncompressChunk;
+	}
+	edep->decode = ctx;
+    }
+    ctx->reds = initial_reds;
+
+    do {
+	switch (ctx->state) {
+	case B2TUncompressChunk: {
+	    Binary *bin = ctx->u.uc.dbin;
+	    uLongf chunk = ctx->reds;
+	    int zret;
+
+	    if (chunk > ctx->u.uc.dleft)
+		chunk = ctx->u.uc.dleft;
+	    zret = erl_zlib_inflate_chunk(&ctx->u.uc.stream,
+					  ctx->u.uc.dbytes, &chunk);
+	    ctx->u.uc.dbytes += chunk;
+	    ctx->u.uc.dleft -= chunk;
+	    if (zret == Z_OK && ctx->u.uc.dleft > 0) {
+		ctx->reds = 0;
+	    }
+	    else if (erl_zlib_inflate_finish(&ctx->u.uc.stream) == Z_OK
+		     && zret == Z_STREAM_END
+		     && ctx->u.uc.dleft == 0) {
+		ctx->reds -= chunk;
+		dist_ext_uncompress_done(edep, bin);
+		ctx->b2ts.extp = edep->extp;
+		ctx->b2ts.extsize = edep->ext_endp - edep->extp;
+		ctx->state = B2TSizeInit;
+	    }
+	    else {
+		erts_bin_free(bin);
+		ctx->state = B2TBadArg;
+	    }
+	    break;
+	}
+	case B2TSizeInit:
+	    ctx->u.sc.ep = NULL;
+	    ctx->state = B2TSize;
+	    /*fall through*/
+	case B2TSize:
+	    ctx->heap_size = decoded_size(ctx->b2ts.extp,
+					  ctx->b2ts.extp + ctx->b2ts.extsize,
+					  0, ctx);
+	    break;
+
+	case B2TDecodeInit:
+	    edep->heap_size = ctx->heap_size;
+	    ctx->u.dc.ep = ctx->b2ts.extp;
+	    ctx->u.dc.res = (Eterm) (UWord) NULL;
+	    ctx->u.dc.next = &ctx->u.dc.res;
+	    erts_factory_heap_frag_init(&ctx->u.dc.factory,
+					new_message_buffer(ctx->heap_size));
+	    ctx->u.dc.flat_maps.wstart = NULL;
+	    ctx->u.dc.hamt_array.pstart = NULL;
+	    ctx->state = B2TDecode;
+	    /*fall through*/
+	case B2TDecode:
+	case B2TDecodeList:
+	case B2TDecodeTuple:
+	case B2TDecodeString:
+	case B2TDecodeBinary:
+	    dec_term(edep, NULL, NULL, NULL, ctx);
+	    break;
+
+	case B2TDecodeFail:
+	case B2TBadArg:
+	    *redsp -= (initial_reds - ctx->reds) / B2T_BYTES_PER_REDUCTION;
+	    edep->decode = NULL;
+	    b2t_destroy_context(ctx);
+	    erts_free(ERTS_ALC_T_DIST_DECODE, ctx);
+	    goto error;
+
+	case B2TDone:
+	    *redsp -= (initial_reds - ctx->reds) / B2T_BYTES_PER_REDUCTION;
+	    *factory = ctx->u.dc.factory;
+	    *objp = ctx->u.dc.res;
+	    edep->extp = ctx->u.dc.ep;
+	    edep->decode = NULL;
+	    b2t_destroy_context(ctx);
+	    erts_free(ERTS_ALC_T_DIST_DECODE, ctx);
+	    return 1;
+
+	default:
+	    ASSERT(!"Unknown state in dist decode");
+	}
+    } while (ctx->reds > 0 || ctx->state >= B2TDone);
+
+    *redsp = 0;
+    return 0;
+
+ error:
+    bad_dist_ext(edep);
+    return -1;
+}
+
+void
+erts_abort_dist_ext_decode(ErtsDistExternal *edep)
+{
+    B2TContext *ctx = edep->decode;
+
+    if (ctx->state == B2TUncompressChunk)
+	erts_bin_free(ctx->u.uc.dbin);
+    if (ctx->state >= B2TDecode && ctx->state < B2TDone) {
+	erts_factory_undo(&ctx->u.dc.factory);
+	if (ctx->u.dc.flat_maps.wstart)
+	    erts_free(ctx->u.dc.flat_maps.alloc_type,
+		      ctx->u.dc.flat_maps.wstart);
+    }
+    edep->decode = NULL;
+    b2t_destroy_context(ctx);
+    erts_free(ERTS_ALC_T_DIST_DECODE, ctx);
+}
+
+/* Size of the data of a dist ext copy once uncompressed */
+Uint
+erts_dist_ext_data_size(ErtsDistExternal *edep)
+{
+    if ((edep->flags & ERTS_DIST_EXT_DFLAG_HDR)
+	&& edep->ext_endp - edep->extp >= 1+4
+	&& edep->extp[0] == COMPRESSED)
+	return (Uint) get_int32(edep->extp + 1);
+    return edep->ext_endp - edep->extp;
+}
+
 Eterm
 external_size_1(BIF_ALIST_1)
 {
@@ -1705,6 +2127,118 @@ external_size_2(BIF_ALIST_2)
     }
 }
 
+/*
+ * Immediates that are encoded and decoded directly when they appear in
+ * runs of list, tuple or map elements, instead of one at a time through
+ * the stacks of the encoder and decoder.
+ */
+#define IS_ENC_IMMED(X) (is_small(X) || is_atom(X) || is_nil(X))
+
+static ERTS_INLINE byte *
+enc_small(Sint val, byte *ep)
+{
+    /* From R14B we no longer restrict INTEGER_EXT to 28 bits,
+     * as done earlier for backward compatibility reasons. */
+    if ((Uint)val < 256) {
+	*ep++ = SMALL_INTEGER_EXT;
+	put_int8(val, ep);
+	ep++;
+    } else if (sizeof(Sint) == 4 || IS_SSMALL32(val)) {
+	*ep++ = INTEGER_EXT;
+	put_int32(val, ep);
+	ep += 4;
+    } else {
+	DeclareTmpHeapNoproc(tmp_big,2);
+	Eterm big;
+	Uint n;
+	UseTmpHeapNoproc(2);
+	big = small_to_big(val, tmp_big);
+	*ep++ = SMALL_BIG_EXT;
+	n = big_bytes(big);
+	ASSERT(n < 256);
+	put_int8(n, ep);
+	ep += 1;
+	*ep++ = big_sign(big);
+	ep = big_to_bytes(big, ep);
+	UnUseTmpHeapNoproc(2);
+    }
+    return ep;
+}
+
+static ERTS_INLINE byte *
+enc_immed(ErtsAtomCacheMap *acmp, Eterm obj, byte *ep, Uint32 dflags)
+{
+    ASSERT(IS_ENC_IMMED(obj));
+    if (is_small(obj))
+	return enc_small(signed_val(obj), ep);
+    if (is_atom(obj))
+	return enc_atom(acmp, obj, ep, dflags);
+    *ep++ = NIL_EXT;
+    return ep;
+}
+
+static ERTS_INLINE Uint
+enc_small_size(Sint val)
+{
+    if ((Uint)val < 256)
+	return 1 + 1;			/* SMALL_INTEGER_EXT */
+    else if (sizeof(Sint) == 4 || IS_SSMALL32(val))
+	return 1 + 4;			/* INTEGER_EXT */
+    else {
+	DeclareTmpHeapNoproc(tmp_big,2);
+	Uint i;
+	UseTmpHeapNoproc(2);
+	i = big_bytes(small_to_big(val, tmp_big));
+	UnUseTmpHeapNoproc(2);
+	return 1 + 1 + 1 + i;		/* SMALL_BIG_EXT */
+    }
+}
+
+static ERTS_INLINE Uint
+enc_atom_size(ErtsAtomCacheMap *acmp, Eterm atom, unsigned dflags)
+{
+    Uint result;
+
+    if (dflags & DFLAG_INTERNAL_TAGS) {
+	if (atom_val(atom) >= (1<<16)) {
+	    return 1 + 3;
+	}
+	else {
+	    return 1 + 2;
+	}
+    }
+    else {
+	Atom *a = atom_tab(atom_val(atom));
+	int alen;
+	if ((dflags & DFLAG_UTF8_ATOMS) || a->latin1_chars < 0) {
+	    alen = a->len;
+	    result = 1 + 1 + alen;
+	    if (alen > 255) {
+		result++; /* ATOM_UTF8_EXT (not small) */
+	    }
+	}
+	else {
+	    alen = a->latin1_chars;
+	    result = 1 + 1 + alen;
+	    if (alen > 255 || !(dflags & DFLAG_SMALL_ATOM_TAGS))
+		result++; /* ATOM_EXT (not small) */
+	}
+	insert_acache_map(acmp, atom, dflags);
+	return result;
+    }
+}
+
+static ERTS_INLINE Uint
+enc_immed_size(ErtsAtomCacheMap *acmp, Eterm obj, unsigned dflags)
+{
+    ASSERT(IS_ENC_IMMED(obj));
+    if (is_small(obj))
+	return enc_small_size(signed_val(obj));
+    if (is_atom(obj))
+	return enc_atom_size(acmp, obj, dflags);
+    return 1;				/* NIL_EXT */
+}
+
 static Eterm
 erts_term_to_binary_simple(Process* p, Eterm Term, Uint size, int level, Uint flags)
 {
@@ -1788,6 +2322,237 @@ erts_term_to_binary(Process* p, Eterm Term, int level, Uint flags) {
     return erts_term_to_binary_simple(p, Term, size, level, flags);
 }
 
+/*
+ * Single pass encoding of flat terms; immediates, and lists, tuples and
+ * flatmaps of immediates. The term is encoded into a buffer that grows
+ * as needed, instead of first computing its size. The buffer starts out
+ * on the C stack and is moved into a binary if it outgrows it.
+ */
+
+#define TTB_FLAT_DEF_BUF_SIZE 256
+
+/*
+ * Lists are encoded before it is known whether they are flat, so only
+ * this many elements are tried before leaving the list to the general
+ * path, which can trap, instead of throwing away the work done on a
+ * long list.
+ */
+#define TTB_FLAT_MAX_LIST_LEN 4096
+
+typedef struct {
+    byte *ep;
+    byte *endp;
+    byte *bytes;
+    Binary *bin;
+    byte def_buf[TTB_FLAT_DEF_BUF_SIZE];
+} TTBFlatBuf;
+
+static void
+ttb_flat_grow(TTBFlatBuf *fb, Uint need)
+{
+    Uint used = fb->ep - fb->bytes;
+    Uint size = 2 * (fb->endp - fb->bytes);
+
+    if (size < used + need)
+	size = used + need;
+    if (!fb->bin) {
+	fb->bin = erts_bin_nrml_alloc(size);
+	sys_memcpy(fb->bin->orig_bytes, fb->bytes, used);
+    }
+    else {
+	fb->bin = erts_bin_realloc(fb->bin, size);
+    }
+    fb->bytes = (byte *) fb->bin->orig_bytes;
+    fb->ep = fb->bytes + used;
+    fb->endp = fb->bytes + size;
+}
+
+#define TTB_FLAT_RESERVE(FB, NEED)				\
+    do {							\
+	if ((FB)->endp - (FB)->ep < (NEED))			\
+	    ttb_flat_grow((FB), (NEED));			\
+    } while (0)
+
+static ERTS_INLINE void
+ttb_flat_immed(TTBFlatBuf *fb, Eterm obj, Uint32 dflags)
+{
+    TTB_FLAT_RESERVE(fb, enc_immed_size(NULL, obj, dflags));
+    fb->ep = enc_immed(NULL, obj, fb->ep, dflags);
+}
+
+/*
+ * Turn the 'len' string bytes following the STRING_EXT header at
+ * 'hdr_offset' into SMALL_INTEGER_EXT list elements, making room for a
+ * LIST_EXT header.
+ */
+static void
+ttb_flat_string_to_list(TTBFlatBuf *fb, Uint hdr_offset, Uint len)
+{
+    byte *src, *dst;
+
+    TTB_FLAT_RESERVE(fb, len + 2);
+    src = fb->bytes + hdr_offset + 1 + 2 + len;
+    dst = fb->bytes + hdr_offset + 1 + 4 + 2*len;
+    fb->ep = dst;
+    while (len-- > 0) {
+	*--dst = *--src;
+	*--dst = SMALL_INTEGER_EXT;
+    }
+}
+
+/*
+ * Returns THE_NON_VALUE if Term is not flat, or has more elements than
+ * *redsp allows to be encoded without yielding, or is a list longer
+ * than TTB_FLAT_MAX_LIST_LEN. *redsp is decremented
+ * by the number of elements looked at, but is left positive.
+ */
+static Eterm
+term_to_binary_flat(Process *p, Eterm Term, Uint32 dflags, Sint *redsp)
+{
+    TTBFlatBuf fb;
+    Sint reds = *redsp;
+    Uint size;
+    Eterm res;
+
+    fb.bytes = fb.ep = fb.def_buf;
+    fb.endp = fb.def_buf + TTB_FLAT_DEF_BUF_SIZE;
+    fb.bin = NULL;
+
+    *fb.ep++ = VERSION_MAGIC;
+
+    if (IS_ENC_IMMED(Term)) {
+	ttb_flat_immed(&fb, Term, dflags);
+    }
+    else if (is_list(Term)) {
+	Uint hdr_offset = fb.ep - fb.bytes;
+	Eterm obj = Term;
+	Uint len = 0;
+	int is_str = 1;
+
+	/* Optimistically encode a string; see is_external_string() */
+	fb.ep += 1 + 2;
+	while (is_list(obj)) {
+	    Eterm *cons = list_val(obj);
+	    Eterm hd = CAR(cons);
+
+	    if (!IS_ENC_IMMED(hd) || reds <= 1
+		|| len >= TTB_FLAT_MAX_LIST_LEN)
+		goto not_flat;
+	    reds--;
+	    if (is_str) {
+		if (is_byte(hd) && len < MAX_STRING_LEN - 1) {
+		    TTB_FLAT_RESERVE(&fb, 1);
+		    *fb.ep++ = unsigned_val(hd);
+		    len++;
+		    obj = CDR(cons);
+		    continue;
+		}
+		ttb_flat_string_to_list(&fb, hdr_offset, len);
+		is_str = 0;
+	    }
+	    ttb_flat_immed(&fb, hd, dflags);
+	    len++;
+	    obj = CDR(cons);
+	}
+	if (!IS_ENC_IMMED(obj))
+	    goto not_flat;
+	if (is_str && is_nil(obj)) {
+	    byte *hdr = fb.bytes + hdr_offset;
+	    *hdr++ = STRING_EXT;
+	    put_int16(len, hdr);
+	}
+	else {
+	    byte *hdr;
+	    if (is_str)
+		ttb_flat_string_to_list(&fb, hdr_offset, len);
+	    hdr = fb.bytes + hdr_offset;
+	    *hdr++ = LIST_EXT;
+	    put_int32(len, hdr);
+	    ttb_flat_immed(&fb, obj, dflags);
+	}
+    }
+    else if (is_tuple(Term)) {
+	Eterm *ptr = tuple_val(Term);
+	Uint arity = arityval(*ptr);
+	Uint i;
+
+	/* Check before encoding; records are rarely flat */
+	if (arity >= reds)
+	    goto not_flat;
+	for (i = 1; i <= arity; i++) {
+	    if (!IS_ENC_IMMED(ptr[i]))
+		goto not_flat;
+	}
+	reds -= arity;
+
+	TTB_FLAT_RESERVE(&fb, 1 + 4);
+	if (arity <= 0xff) {
+	    *fb.ep++ = SMALL_TUPLE_EXT;
+	    put_int8(arity, fb.ep);
+	    fb.ep += 1;
+	} else {
+	    *fb.ep++ = LARGE_TUPLE_EXT;
+	    put_int32(arity, fb.ep);
+	    fb.ep += 4;
+	}
+	while (arity-- > 0)
+	    ttb_flat_immed(&fb, *++ptr, dflags);
+    }
+    else if (is_flatmap(Term)) {
+	flatmap_t *mp = (flatmap_t *) flatmap_val(Term);
+	Uint n = flatmap_get_size(mp);
+	Eterm *kptr = flatmap_get_keys(mp);
+	Eterm *vptr = flatmap_get_values(mp);
+	Uint i;
+
+	if (2*n >= reds)
+	    goto not_flat;
+	for (i = 0; i < n; i++) {
+	    if (!IS_ENC_IMMED(kptr[i]) || !IS_ENC_IMMED(vptr[i]))
+		goto not_flat;
+	}
+	reds -= 2*n;
+
+	TTB_FLAT_RESERVE(&fb, 1 + 4);
+	*fb.ep++ = MAP_EXT;
+	put_int32(n, fb.ep);
+	fb.ep += 4;
+	while (n-- > 0) {
+	    ttb_flat_immed(&fb, *kptr++, dflags);
+	    ttb_flat_immed(&fb, *vptr++, dflags);
+	}
+    }
+    else {
+	goto not_flat;
+    }
+
+    *redsp = reds;
+    size = fb.ep - fb.bytes;
+    if (!fb.bin)
+	res = new_binary(p, fb.bytes, size);
+    else {
+	Binary *bin = erts_bin_realloc(fb.bin, size);
+	ProcBin *pb = (ProcBin *) HAlloc(p, PROC_BIN_SIZE);
+	erts_refc_init(&bin->refc, 1);
+	pb->thing_word = HEADER_PROC_BIN;
+	pb->size = size;
+	pb->next = MSO(p).first;
+	MSO(p).first = (struct erl_off_heap_header*)pb;
+	pb->val = bin;
+	pb->bytes = (byte*) bin->orig_bytes;
+	pb->flags = 0;
+	OH_OVERHEAD(&(MSO(p)), pb->size / sizeof(Eterm));
+	res = make_binary(pb);
+    }
+    return res;
+
+ not_flat:
+    if (fb.bin)
+	erts_bin_free(fb.bin);
+    *redsp = reds;
+    return THE_NON_VALUE;
+}
+
 /* Define EXTREME_TTB_TRAPPING for testing in dist.h */
 
 #ifndef EXTREME_TTB_TRAPPING
@@ -1808,6 +2573,10 @@ static void ttb_context_destructor(Binary *context_bin)
 	    break;
 	case TTBEncode:
 	    DESTROY_SAVED_WSTACK(&context->s.ec.wstack);
+	    if (context->s.ec.bin_refs != NULL) {
+		erts_free_ext_bin_refs(context->s.ec.bin_refs);
+		context->s.ec.bin_refs = NULL;
+	    }
 	    if (context->s.ec.result_bin != NULL) { /* Set to NULL if ever made alive! */
 		ASSERT(erts_refc_read(&(context->s.ec.result_bin->refc),0) == 0);
 		erts_bin_free(context->s.ec.result_bin);
@@ -1833,8 +2602,79 @@ static void ttb_context_destructor(Binary *context_bin)
     }
 }
 
+/*
+ * Build the list of binaries of a term encoded into result_bin with
+ * the binaries in refs referred to. The parts of result_bin between
+ * the referred binaries are sub binaries of it.
+ */
+static Eterm
+ttb_iovec(Process *p, Binary *result_bin, Uint size, ErtsExtBinRefs *refs)
+{
+    Eterm *hp;
+    Eterm res = NIL;
+    Eterm orig;
+    ProcBin *pb;
+    Uint end = size;
+    Uint i;
+
+    hp = HAlloc(p, (PROC_BIN_SIZE
+		    + refs->n * (PROC_BIN_SIZE + 2)
+		    + (refs->n + 1) * (ERL_SUB_BIN_SIZE + 2)));
+
+    pb = (ProcBin *) hp;
+    hp += PROC_BIN_SIZE;
+    pb->thing_word = HEADER_PROC_BIN;
+    pb->size = size;
+    pb->next = MSO(p).first;
+    MSO(p).first = (struct erl_off_heap_header*) pb;
+    pb->val = result_bin;
+    pb->bytes = (byte*) result_bin->orig_bytes;
+    pb->flags = 0;
+    OH_OVERHEAD(&(MSO(p)), pb->size / sizeof(Eterm));
+    erts_refc_inc(&result_bin->refc, 1);
+    orig = make_binary(pb);
+
+    i = refs->n;
+    while (1) {
+	Uint start = i > 0 ? refs->ref[i-1].offset : 0;
+	if (end > start) {
+	    ErlSubBin *sb = (ErlSubBin *) hp;
+	    hp += ERL_SUB_BIN_SIZE;
+	    sb->thing_word = HEADER_SUB_BIN;
+	    sb->size = end - start;
+	    sb->offs = start;
+	    sb->orig = orig;
+	    sb->bitoffs = 0;
+	    sb->bitsize = 0;
+	    sb->is_writable = 0;
+	    res = CONS(hp, make_binary(sb), res);
+	    hp += 2;
+	}
+	if (i == 0)
+	    break;
+	i--;
+	/* The reference to the binary is passed on to the ProcBin */
+	pb = (ProcBin *) hp;
+	hp += PROC_BIN_SIZE;
+	pb->thing_word = HEADER_PROC_BIN;
+	pb->size = refs->ref[i].size;
+	pb->next = MSO(p).first;
+	MSO(p).first = (struct erl_off_heap_header*) pb;
+	pb->val = refs->ref[i].bin;
+	pb->bytes = refs->ref[i].bytes;
+	pb->flags = 0;
+	OH_OVERHEAD(&(MSO(p)), pb->size / sizeof(Eterm));
+	res = CONS(hp, make_binary(pb), res);
+	hp += 2;
+	end = start;
+    }
+
+    erts_free(ERTS_ALC_T_EXT_BIN_REFS, refs);
+    return res;
+}
+
 static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint flags, 
-				     Binary *context_b) 
+				     int iovec, Binary *context_b) 
 {
     Eterm *hp;
     Eterm res;
@@ -1869,12 +2709,23 @@ static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint fla
 
 
     if (context_b == NULL) {
+	if (level == 0) {
+	    res = term_to_binary_flat(p, Term, flags, &reds);
+	    if (is_value(res)) {
+		BUMP_REDS(p, (initial_reds - reds) / TERM_TO_BINARY_LOOP_FACTOR);
+		return res;
+	    }
+	}
 	/* Setup enough to get started */
 	context->state = TTBSize;
 	context->alive = 1;
+	context->iovec = iovec;
 	context->s.sc.wstack.wstart = NULL;
 	context->s.sc.flags = flags;
 	context->s.sc.level = level;
+	/* A compressed term is returned as one binary */
+	context->s.sc.iovec = iovec && level == 0;
+	context->s.sc.bin_refs = 0;
     } else {
 	context = ERTS_MAGIC_BIN_DATA(context_b);
     }	    
@@ -1887,6 +2738,7 @@ static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint fla
 		Binary *result_bin;
 		int level;
 		Uint flags;
+		Uint bin_refs;
 		/* Try for fast path */
 		if (encode_size_struct_int(&context->s.sc, NULL, Term,
 					   context->s.sc.flags, &reds, &size) < 0) {
@@ -1898,7 +2750,8 @@ static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint fla
 		/* Move these to next state */
 		flags = context->s.sc.flags;
 		level = context->s.sc.level;
-		if (size <=  ERL_ONHEAP_BIN_LIMIT) {
+		bin_refs = context->s.sc.bin_refs;
+		if (size <=  ERL_ONHEAP_BIN_LIMIT && !bin_refs) {
 		    /* Finish in one go */
 		    res = erts_term_to_binary_simple(p, Term, size, 
 						     level, flags);
@@ -1915,6 +2768,11 @@ static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint fla
 		context->s.ec.level = level;
 		context->s.ec.wstack.wstart = NULL;
 		context->s.ec.result_bin = result_bin;
+		context->s.ec.bin_refs = NULL;
+		if (bin_refs) {
+		    context->s.ec.bin_refs = erts_alloc_ext_bin_refs(bin_refs);
+		    context->s.ec.bin_refs->base = (byte *) result_bin->orig_bytes;
+		}
 		break;
 	    }
 	case TTBEncode:
@@ -1933,6 +2791,17 @@ static Eterm erts_term_to_binary_int(Process* p, Eterm Term, int level, Uint fla
 		result_bin = erts_bin_realloc(context->s.ec.result_bin,real_size);
 		level = context->s.ec.level;
 		BUMP_REDS(p, (initial_reds - reds) / TERM_TO_BINARY_LOOP_FACTOR);
+		if (context->s.ec.bin_refs) {
+		    ErtsExtBinRefs *refs = context->s.ec.bin_refs;
+		    context->s.ec.result_bin = NULL;
+		    context->s.ec.bin_refs = NULL;
+		    context->alive = 0;
+		    res = ttb_iovec(p, result_bin, real_size, refs);
+		    if (context_b && erts_refc_read(&context_b->refc,0) == 0) {
+			erts_bin_free(context_b);
+		    }
+		    return res;
+		}
 		if (level == 0 || real_size < 6) { /* We are done */
 		    ProcBin* pb;
 		return_normal:
@@ -2369,6 +3238,52 @@ enc_term(ErtsAtomCacheMap *acmp, Eterm obj, byte* ep, Uint32 dflags,
     return res;
 }
 
+/*
+ * Returns the ProcBin of a binary that is referred to instead of
+ * copied when encoding into an I/O vector, or NULL.
+ */
+static ERTS_INLINE ProcBin *
+ext_bin_ref(Eterm obj)
+{
+    ProcBin *pb = (ProcBin *) binary_val(obj);
+
+    if (binary_size(obj) < ERTS_EXT_BIN_REF_MIN)
+	return NULL;
+    if (pb->thing_word == HEADER_SUB_BIN) {
+	ErlSubBin *sb = (ErlSubBin *) pb;
+	if (sb->bitoffs || sb->bitsize)
+	    return NULL;
+	pb = (ProcBin *) binary_val(sb->orig);
+    }
+    return pb->thing_word == HEADER_PROC_BIN ? pb : NULL;
+}
+
+ErtsExtBinRefs *
+erts_alloc_ext_bin_refs(Uint n)
+{
+    ErtsExtBinRefs *refs;
+
+    ASSERT(n > 0);
+    refs = erts_alloc(ERTS_ALC_T_EXT_BIN_REFS,
+		      sizeof(ErtsExtBinRefs) + (n-1)*sizeof(ErtsExtBinRef));
+    refs->base = NULL;
+    refs->size = 0;
+    refs->n = 0;
+    return refs;
+}
+
+void
+erts_free_ext_bin_refs(ErtsExtBinRefs *refs)
+{
+    Uint i;
+
+    for (i = 0; i < refs->n; i++) {
+	if (erts_refc_dectest(&refs->ref[i].bin->refc, 0) == 0)
+	    erts_bin_free(refs->ref[i].bin);
+    }
+    erts_free(ERTS_ALC_T_EXT_BIN_REFS, refs);
+}
+
 static int
 enc_term_int(TTBEncodeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj, byte* ep, Uint32 dflags,
 	     struct erl_off_heap_header** off_heap, Sint *reds, byte **res)
@@ -2411,6 +3326,15 @@ enc_term_int(TTBEncodeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj, byte* ep,
 		Eterm* cons = list_val(obj);
 		Eterm tl;
 
+		/* Encode a run of immediate elements directly */
+		while (IS_ENC_IMMED(CAR(cons)) && (!ctx || r > 1)) {
+		    ep = enc_immed(acmp, CAR(cons), ep, dflags);
+		    r--;
+		    obj = CDR(cons);
+		    if (is_not_list(obj))
+			goto L_jump_start; /* The tail */
+		    cons = list_val(obj);
+		}
 		obj = CAR(cons);
 		tl = CDR(cons);
 		WSTACK_PUSH2(s, (is_list(tl) ? ENC_ONE_CONS : ENC_TERM),
@@ -2498,34 +3422,7 @@ enc_term_int(TTBEncodeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj, byte* ep,
 	    break;
 
 	case SMALL_DEF:
-	    {
-		/* From R14B we no longer restrict INTEGER_EXT to 28 bits,
-		 * as done earlier for backward compatibility reasons. */
-		Sint val = signed_val(obj);
-
-		if ((Uint)val < 256) {
-		    *ep++ = SMALL_INTEGER_EXT;
-		    put_int8(val, ep);
-		    ep++;
-		} else if (sizeof(Sint) == 4 || IS_SSMALL32(val)) {
-		    *ep++ = INTEGER_EXT;
-		    put_int32(val, ep);
-		    ep += 4;
-		} else {
-		    DeclareTmpHeapNoproc(tmp_big,2);
-		    Eterm big;
-		    UseTmpHeapNoproc(2);
-		    big = small_to_big(val, tmp_big);
-		    *ep++ = SMALL_BIG_EXT;
-		    n = big_bytes(big);
-		    ASSERT(n < 256);
-		    put_int8(n, ep);
-		    ep += 1;
-		    *ep++ = big_sign(big);
-		    ep = big_to_bytes(big, ep);
-		    UnUseTmpHeapNoproc(2);
-		}
-	    }
+	    ep = enc_small(signed_val(obj), ep);
 	    break;
 
 	case BIG_DEF:
@@ -2650,6 +3547,13 @@ enc_term_int(TTBEncodeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj, byte* ep,
 		put_int32(i, ep);
 		ep += 4;
 	    }
+	    /* Encode a leading run of immediate elements directly */
+	    while (i > 0 && IS_ENC_IMMED(*ptr) && (!ctx || r > 1)) {
+		ep = enc_immed(acmp, *ptr, ep, dflags);
+		ptr++;
+		i--;
+		r--;
+	    }
 	    if (i > 0) {
 		WSTACK_PUSH2(s, ENC_LAST_ARRAY_ELEMENT+i-1, (UWord)ptr);
 	    }
@@ -2667,8 +3571,18 @@ enc_term_int(TTBEncodeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj, byte* ep,
 		    Eterm *kptr = flatmap_get_keys(mp);
 		    Eterm *vptr = flatmap_get_values(mp);
 
-		    WSTACK_PUSH4(s, (UWord)kptr, (UWord)vptr,
-				 ENC_MAP_PAIR, size);
+		    /* Encode a leading run of immediate pairs directly */
+		    while (size > 0 && IS_ENC_IMMED(*kptr)
+			   && IS_ENC_IMMED(*vptr) && (!ctx || r > 2)) {
+			ep = enc_immed(acmp, *kptr++, ep, dflags);
+			ep = enc_immed(acmp, *vptr++, ep, dflags);
+			size--;
+			r -= 2;
+		    }
+		    if (size > 0) {
+			WSTACK_PUSH4(s, (UWord)kptr, (UWord)vptr,
+				     ENC_MAP_PAIR, size);
+		    }
 		}
 	    } else {
 		Eterm hdr;
@@ -2779,10 +3693,27 @@ enc_term_int(TTBEncodeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj, byte* ep,
 		}
 		if (bitsize == 0) {
 		    /* Plain old byte-sized binary. */
+		    ProcBin *pb;
 		    *ep++ = BINARY_EXT;
 		    j = binary_size(obj);
 		    put_int32(j, ep);
 		    ep += 4;
+		    if (ctx && ctx->bin_refs && (pb = ext_bin_ref(obj))) {
+			ErtsExtBinRefs *refs = ctx->bin_refs;
+			ErtsExtBinRef *ref = &refs->ref[refs->n++];
+			if (pb->flags) {
+			    char* before_realloc = pb->val->orig_bytes;
+			    erts_emasculate_writable_binary(pb);
+			    bytes += (pb->val->orig_bytes - before_realloc);
+			}
+			erts_refc_inc(&pb->val->refc, 2);
+			ref->offset = ep - refs->base;
+			ref->bin = pb->val;
+			ref->bytes = bytes;
+			ref->size = j;
+			refs->size += j;
+			break;
+		    }
 		    data_dst = ep;
 		    ep += j;
 		} else if (dflags & DFLAG_BIT_BINARIES) {
@@ -2969,6 +3900,39 @@ struct dec_term_hamt
 /* Decode term from external format into *objp.
 ** On failure calls erts_factory_undo() and returns NULL
 */
+/*
+ * Decode an immediate that dec_term() stores directly when it appears
+ * in a run of list, tuple or map elements. Returns a pointer past it,
+ * or NULL if ep does not start with such a term.
+ */
+static ERTS_INLINE byte *
+dec_immed(ErtsDistExternal *edep, byte *ep, Eterm *objp)
+{
+    switch (*ep) {
+    case SMALL_INTEGER_EXT:
+	*objp = make_small(get_int8(ep+1));
+	return ep + 2;
+#if defined(ARCH_64)
+    case INTEGER_EXT: {
+	Sint sn = get_int32(ep+1);
+	*objp = make_small(sn);
+	return ep + 5;
+    }
+#endif
+    case NIL_EXT:
+	*objp = NIL;
+	return ep + 1;
+    case ATOM_CACHE_REF:
+    case ATOM_EXT:
+    case SMALL_ATOM_EXT:
+    case ATOM_UTF8_EXT:
+    case SMALL_ATOM_UTF8_EXT:
+	return dec_atom(edep, ep, objp);
+    default:
+	return NULL;
+    }
+}
+
 static byte*
 dec_term(ErtsDistExternal *edep,
 	 ErtsHeapFactory* factory,
@@ -3205,6 +4169,16 @@ dec_term_atom_common:
 	tuple_loop:
 	    *objp = make_tuple(hp);
 	    *hp++ = make_arityval(n);
+	    /* Decode a leading run of immediate elements directly */
+	    while (n > 0 && reds > 1) {
+		byte *immed_ep = dec_immed(edep, ep, hp);
+		if (!immed_ep)
+		    break;
+		ep = immed_ep;
+		hp++;
+		n--;
+		reds--;
+	    }
 	    hp += n;
             objp = hp - 1;
             if (ctx) {
@@ -3233,6 +4207,25 @@ dec_term_atom_common:
 		break;
 	    }
 	    *objp = make_list(hp);
+	    /* Decode a leading run of immediate elements directly */
+	    while (reds > 1) {
+		byte *immed_ep = dec_immed(edep, ep, hp);
+		if (!immed_ep)
+		    break;
+		ep = immed_ep;
+		hp[1] = make_list(hp+2);
+		hp += 2;
+		reds--;
+		if (--n == 0) {
+		    /* The tail */
+		    objp = hp - 1;
+		    *objp = (Eterm) next;
+		    next = objp;
+		    break;
+		}
+	    }
+	    if (n == 0)
+		break;
             hp += 2 * n;
 	    objp = hp - 2;
 	    objp[0] = (Eterm) (objp+1);
@@ -3493,6 +4486,23 @@ dec_term_atom_common:
 		    hp += heap_bin_size(n);
 		    sys_memcpy(hb->data, ep, n);
 		    *objp = make_binary(hb);
+		} else if (edep && edep->binp
+			   && ERTS_DIST_BIN_REF(edep->binp, n)) {
+		    /* Refer to the data in the received binary */
+		    Binary* dbin = edep->binp;
+		    ProcBin* pb;
+		    erts_refc_inc(&dbin->refc, 2);
+		    pb = (ProcBin *) hp;
+		    hp += PROC_BIN_SIZE;
+		    pb->thing_word = HEADER_PROC_BIN;
+		    pb->size = n;
+		    pb->next = factory->off_heap->first;
+		    factory->off_heap->first = (struct erl_off_heap_header*)pb;
+		    OH_OVERHEAD(factory->off_heap, pb->size / sizeof(Eterm));
+		    pb->val = dbin;
+		    pb->bytes = ep;
+		    pb->flags = 0;
+		    *objp = make_binary(pb);
 		} else {
 		    Binary* dbin = erts_bin_nrml_alloc(n);
 		    ProcBin* pb;
@@ -3661,7 +4671,27 @@ dec_term_atom_common:
                     mp->keys       = keys;
                     *objp          = make_flatmap(mp);
 
-                    for (n = size; n; n--) {
+                    /* Decode a leading run of immediate pairs directly */
+                    n = size;
+                    if (n) {
+                        Eterm *kp = tuple_val(keys) + 1;
+                        Eterm *vp = flatmap_get_values(mp);
+                        while (n && reds > 2) {
+                            byte *immed_ep = dec_immed(edep, ep, kp);
+                            if (!immed_ep)
+                                break;
+                            immed_ep = dec_immed(edep, immed_ep, vp);
+                            if (!immed_ep)
+                                break;
+                            ep = immed_ep;
+                            kp++;
+                            vp++;
+                            n--;
+                            reds -= 2;
+                        }
+                    }
+
+                    for ( ; n; n--) {
                         *vptr = (Eterm) next;
                         *kptr = (Eterm) vptr;
                         next  = kptr;
@@ -4038,49 +5068,10 @@ encode_size_struct_int(TTBSizeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj,
 	    result++;
 	    break;
 	case ATOM_DEF:
-	    if (dflags & DFLAG_INTERNAL_TAGS) {
-		if (atom_val(obj) >= (1<<16)) {
-		    result += 1 + 3;
-		}
-		else {
-		    result += 1 + 2;
-		}
-	    }
-	    else {
-		Atom *a = atom_tab(atom_val(obj));
-		int alen;
-		if ((dflags & DFLAG_UTF8_ATOMS) || a->latin1_chars < 0) {
-		    alen = a->len;
-		    result += 1 + 1 + alen;
-		    if (alen > 255) {
-			result++; /* ATOM_UTF8_EXT (not small) */
-		    }
-		}
-		else {
-		    alen = a->latin1_chars;
-		    result += 1 + 1 + alen;
-		    if (alen > 255 || !(dflags & DFLAG_SMALL_ATOM_TAGS))
-			result++; /* ATOM_EXT (not small) */
-		}
-		insert_acache_map(acmp, obj, dflags);
-	    }
+	    result += enc_atom_size(acmp, obj, dflags);
 	    break;
 	case SMALL_DEF:
-	    {
-		Sint val = signed_val(obj);
-
-		if ((Uint)val < 256)
-		    result += 1 + 1;		/* SMALL_INTEGER_EXT */
-		else if (sizeof(Sint) == 4 || IS_SSMALL32(val))
-		    result += 1 + 4;		/* INTEGER_EXT */
-		else {
-		    DeclareTmpHeapNoproc(tmp_big,2);
-		    UseTmpHeapNoproc(2);
-		    i = big_bytes(small_to_big(val, tmp_big));
-		    result += 1 + 1 + 1 + i;	/* SMALL_BIG_EXT */
-		    UnUseTmpHeapNoproc(2);
-		}
-	    }
+	    result += enc_small_size(signed_val(obj));
 	    break;
 	case BIG_DEF:
 	    i = big_bytes(obj);
@@ -4122,9 +5113,7 @@ encode_size_struct_int(TTBSizeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj,
 		result += m + 2 + 1;
 	    } else {
 		result += 5;
-		WSTACK_PUSH2(s, (UWord)CDR(list_val(obj)), (UWord)LIST_TAIL_OP);
-		obj = CAR(list_val(obj));
-		continue; /* big loop */
+		goto size_list;
 	    }
 	    break;
 	case TUPLE_DEF:
@@ -4136,14 +5125,22 @@ encode_size_struct_int(TTBSizeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj,
 		} else {
 		    result += 1 + 4;
 		}
+		ptr++;
+		/* Size a leading run of immediate elements directly */
+		while (arity > 0 && IS_ENC_IMMED(*ptr) && (!ctx || r > 1)) {
+		    result += enc_immed_size(acmp, *ptr, dflags);
+		    ptr++;
+		    arity--;
+		    r--;
+		}
 		if (arity > 1) {
-		    WSTACK_PUSH2(s, (UWord) (ptr + 2),
+		    WSTACK_PUSH2(s, (UWord) (ptr + 1),
 				    (UWord) TERM_ARRAY_OP(arity-1));
 		}
                 else if (arity == 0) {
 		    break;
                 }
-		obj = ptr[1];
+		obj = ptr[0];
 		continue; /* big loop */
 	    }
 	case MAP_DEF:
@@ -4151,12 +5148,23 @@ encode_size_struct_int(TTBSizeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj,
 		flatmap_t *mp = (flatmap_t*)flatmap_val(obj);
 		Uint size = flatmap_get_size(mp);
 
+		Eterm *kptr = flatmap_get_keys(mp);
+		Eterm *vptr = flatmap_get_values(mp);
+
 		result += 1 + 4; /* tag + 4 bytes size */
 
+		/* Size a leading run of immediate pairs directly */
+		while (size > 0 && IS_ENC_IMMED(*kptr) && IS_ENC_IMMED(*vptr)
+		       && (!ctx || r > 2)) {
+		    result += enc_immed_size(acmp, *kptr++, dflags);
+		    result += enc_immed_size(acmp, *vptr++, dflags);
+		    size--;
+		    r -= 2;
+		}
                 if (size) {
-		    WSTACK_PUSH4(s, (UWord) flatmap_get_values(mp),
+		    WSTACK_PUSH4(s, (UWord) vptr,
 				    (UWord) TERM_ARRAY_OP(size),
-		                    (UWord) flatmap_get_keys(mp),
+		                    (UWord) kptr,
 				    (UWord) TERM_ARRAY_OP(size));
 		}
 	    } else {
@@ -4205,6 +5213,11 @@ encode_size_struct_int(TTBSizeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj,
 	    }
 	    break;
 	case BINARY_DEF:
+	    if (ctx && ctx->iovec && ext_bin_ref(obj)) {
+		result += 1 + 4;
+		ctx->bin_refs++;
+		break;
+	    }
 	    if (dflags & DFLAG_INTERNAL_TAGS) {
 		ProcBin* pb = (ProcBin*) binary_val(obj);
 		Uint sub_extra = 0;
@@ -4282,11 +5295,19 @@ encode_size_struct_int(TTBSizeContext* ctx, ErtsAtomCacheMap *acmp, Eterm obj,
             switch (obj) {
 	    case LIST_TAIL_OP:
 		obj = (Eterm) WSTACK_POP(s);
-		if (is_list(obj)) {
+	    size_list:
+		/* Size a run of immediate elements directly */
+		while (is_list(obj)) {
 		    Eterm* cons = list_val(obj);
 
-		    WSTACK_PUSH2(s, (UWord)CDR(cons), (UWord)LIST_TAIL_OP);
-		    obj = CAR(cons);
+		    if (!IS_ENC_IMMED(CAR(cons)) || (ctx && r <= 1)) {
+			WSTACK_PUSH2(s, (UWord)CDR(cons), (UWord)LIST_TAIL_OP);
+			obj = CAR(cons);
+			break;
+		    }
+		    result += enc_immed_size(acmp, CAR(cons), dflags);
+		    obj = CDR(cons);
+		    r--;
 		}
 		break;
 
@@ -4501,6 +5522,14 @@ init_done:
 	    ADDTERMS(n);
 	    terms++;
 	    heap_size += 2 * n;
+	    /* Skip a leading run of small integer elements directly */
+	    while (n > 0 && endp - ep >= 2 && ep[0] == SMALL_INTEGER_EXT
+		   && (!ctx || reds > 1)) {
+		ep += 2;
+		n--;
+		terms--;
+		reds--;
+	    }
 	    break;
 	case SMALL_TUPLE_EXT:
 	    CHKSIZE(1);
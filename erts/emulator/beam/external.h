@@ -58,6 +58,8 @@
 #define SMALL_ATOM_UTF8_EXT 'w'
 
 #define DIST_HEADER       'D'
+#define DIST_FRAG_HEADER  'E'
+#define DIST_FRAG_CONT    'F'
 #define ATOM_CACHE_REF    'R'
 #define ATOM_INTERNAL_REF2 'I'
 #define ATOM_INTERNAL_REF3 'K'
@@ -86,12 +88,33 @@
 #include "erl_node_tables.h"
 
 #define ERTS_ATOM_CACHE_SIZE 2048
+/* Cache size used towards nodes supporting DFLAG_LARGE_ATOM_CACHE */
+#define ERTS_LARGE_ATOM_CACHE_SIZE 8192
+/* Number of ways in each set of the output atom cache */
+#define ERTS_ATOM_CACHE_WAYS 8
 
+/*
+ * The output cache is set associative with LRU replacement within
+ * each set; the input cache is just indexed by whatever the other
+ * node tells us. Both are only accessed by the port owning the
+ * channel (out when finalizing, in when preparing), so the counters
+ * are plain integers read dirty by erlang:system_info/1.
+ */
 typedef struct cache {
-    Eterm in_arr[ERTS_ATOM_CACHE_SIZE];
-    Eterm out_arr[ERTS_ATOM_CACHE_SIZE];
+    int size;
+    Uint64 clock;
+    Uint out_hits;
+    Uint out_misses;
+    Uint in_hits;
+    Uint in_misses;
+    Eterm *in_arr;
+    Eterm *out_arr;
+    Uint64 *out_used;
 } ErtsAtomCache;
 
+/* Cache indices are sent as two bytes in large caches */
+#define ERTS_ATOM_CACHE_WIDE_IX(C) ((C)->size > ERTS_ATOM_CACHE_SIZE)
+
 typedef struct {
     int hdr_sz;
     int sz;
@@ -130,6 +153,9 @@ typedef struct {
     byte *ext_endp;
     Sint heap_size;
     Uint32 flags;
+    struct binary *binp;	/* Binary holding extp..ext_endp, if any */
+    struct B2TContext_t *decode; /* State of an unfinished decode, if any */
+    void *trailer;		/* Extra data of a copy */
     ErtsAtomTranslationTable attab;
 } ErtsDistExternal;
 
@@ -153,6 +179,29 @@ typedef struct {
     Uint heap_size;
 } ErtsBinary2TermState;
 
+/*
+ * A term can be encoded into an I/O vector, in which case refc
+ * binaries of at least ERTS_EXT_BIN_REF_MIN bytes are referred to
+ * instead of copied into the encoded data. The encoder then records
+ * where in the encoded data each of them belongs, and holds a
+ * reference to each until the refs are released.
+ */
+#define ERTS_EXT_BIN_REF_MIN 1024
+
+typedef struct {
+    Uint offset;		/* Offset in encoded data, from base */
+    struct binary *bin;
+    byte *bytes;
+    Uint size;
+} ErtsExtBinRef;
+
+typedef struct ErtsExtBinRefs_ {
+    byte *base;			/* Start of the encoded data */
+    Uint size;			/* Total size of the binaries */
+    Uint n;
+    ErtsExtBinRef ref[1];
+} ErtsExtBinRefs;
+
 
 /* -------------------------------------------------------------------------- */
 
@@ -184,11 +233,16 @@ ERTS_GLB_INLINE void erts_free_dist_ext_copy(ErtsDistExternal *);
 ERTS_GLB_INLINE void *erts_dist_ext_trailer(ErtsDistExternal *);
 ErtsDistExternal *erts_make_dist_ext_copy(ErtsDistExternal *, Uint);
 void *erts_dist_ext_trailer(ErtsDistExternal *);
+void erts_release_dist_ext_binary(struct binary *);
 void erts_destroy_dist_ext_copy(ErtsDistExternal *);
 int erts_prepare_dist_ext(ErtsDistExternal *, byte *, Uint,
 			  DistEntry *, ErtsAtomCache *);
 Sint erts_decode_dist_ext_size(ErtsDistExternal *);
 Eterm erts_decode_dist_ext(ErtsHeapFactory* factory, ErtsDistExternal *);
+int erts_decode_dist_ext_yielding(ErtsHeapFactory *, ErtsDistExternal *,
+				  Eterm *, Sint *);
+void erts_abort_dist_ext_decode(ErtsDistExternal *);
+Uint erts_dist_ext_data_size(ErtsDistExternal *);
 
 Sint erts_decode_ext_size(byte*, Uint);
 Sint erts_decode_ext_size_ets(byte*, Uint);
@@ -197,6 +251,9 @@ Eterm erts_decode_ext_ets(ErtsHeapFactory*, byte*);
 
 Eterm erts_term_to_binary(Process* p, Eterm Term, int level, Uint flags);
 
+ErtsExtBinRefs *erts_alloc_ext_bin_refs(Uint);
+void erts_free_ext_bin_refs(ErtsExtBinRefs *);
+
 Sint erts_binary2term_prepare(ErtsBinary2TermState *, byte *, Sint);
 void erts_binary2term_abort(ErtsBinary2TermState *);
 Eterm erts_binary2term_create(ErtsBinary2TermState *, ErtsHeapFactory*);
@@ -225,16 +282,18 @@ erts_free_dist_ext_copy(ErtsDistExternal *edep)
 {
     if (edep->dep)
 	erts_deref_dist_entry(edep->dep);
+    if (edep->decode)
+	erts_abort_dist_ext_decode(edep);
+    if (edep->binp)
+	erts_release_dist_ext_binary(edep->binp);
     erts_free(ERTS_ALC_T_EXT_TERM_DATA, edep);
 }
 
 ERTS_GLB_INLINE void *
 erts_dist_ext_trailer(ErtsDistExternal *edep)
 {
-    void *res = (void *) (edep->ext_endp
-			  + ERTS_EXTRA_DATA_ALIGN_SZ(edep->ext_endp));
-    ASSERT((((UWord) res) % sizeof(Uint)) == 0);
-    return res;
+    ASSERT((((UWord) edep->trailer) % sizeof(Uint)) == 0);
+    return edep->trailer;
 }
 
 #endif
@@ -1022,6 +1022,7 @@ extern erts_smp_atomic_t erts_copy_literal_area__;
 
 #ifdef ERTS_NEW_PURGE_STRATEGY
 extern Process *erts_literal_area_collector;
+void erts_queue_release_literals(Process *c_p, ErtsLiteralArea *literals);
 #endif
 #ifdef ERTS_DIRTY_SCHEDULERS
 extern Process *erts_dirty_process_code_checker;
@@ -1083,14 +1084,14 @@ __decl_noreturn void __noreturn erts_exit(int n, char*, ...);
 __decl_noreturn void __noreturn erts_flush_async_exit(int n, char*, ...);
 void erl_error(char*, va_list);
 
-/* This controls whether sharing-preserving copy is used by Erlang */
-
-#ifdef SHCOPY
-#define SHCOPY_SEND
-#define SHCOPY_SPAWN
-#endif
-
-/* The persistent state while the sharing-preserving copier works */
+/*
+ * The persistent state while the sharing-preserving copier works.
+ *
+ * Messages, spawn arguments and ETS objects are copied with
+ * erts_copy_calculate()/erts_copy_perform(), which only preserve
+ * sharing if the term has any. Configuring with
+ * --enable-sharing-preserving (SHCOPY) makes them always do so.
+ */
 
 typedef struct {
     Eterm  queue_default[DEF_EQUEUE_SIZE];
@@ -1106,6 +1107,8 @@ typedef struct {
     Uint literal_size;
     Eterm *range_ptr;
     Uint  range_sz;
+    int shared;         /* set by erts_copy_calculate() */
+    int copy_literals;  /* copy all literals, not only those being purged */
 } erts_shcopy_t;
 
 #define INITIALIZE_SHCOPY(info)                         \
@@ -1115,6 +1118,8 @@ do {                                                    \
     info.bitstore_start = info.bitstore_default;        \
     info.shtable_start = info.shtable_default;          \
     info.literal_size = 0;                              \
+    info.shared = 1;                                    \
+    info.copy_literals = 0;                             \
     if (larea__) {					\
 	info.range_ptr = &larea__->start[0];		\
 	info.range_sz = larea__->end - info.range_ptr;	\
@@ -1145,6 +1150,9 @@ Eterm copy_object_x(Eterm, Process*, Uint);
 Uint size_object(Eterm);
 Uint copy_shared_calculate(Eterm, erts_shcopy_t*);
 Eterm copy_shared_perform(Eterm, Uint, erts_shcopy_t*, Eterm**, ErlOffHeap*);
+int erts_shcopy_probe(Eterm);
+Uint erts_copy_calculate(Eterm, erts_shcopy_t*);
+Eterm erts_copy_perform(Eterm, Uint, erts_shcopy_t*, Eterm**, ErlOffHeap*);
 
 Uint size_shared(Eterm);
 
@@ -1160,12 +1168,13 @@ void erts_move_multi_frags(Eterm** hpp, ErlOffHeap*, ErlHeapFragment* first,
 extern void erts_delete_nodes_monitors(Process *, ErtsProcLocks);
 extern Eterm erts_monitor_nodes(Process *, Eterm, Eterm);
 extern Eterm erts_processes_monitoring_nodes(Process *);
-extern int erts_do_net_exits(DistEntry*, Eterm);
+extern int erts_do_net_exits(DistEntry*, ErtsDistChannel*, Eterm);
 extern int distribution_info(int, void *);
 extern int is_node_name_atom(Eterm a);
 
 extern int erts_net_message(Port *, DistEntry *,
-			    byte *, ErlDrvSizeT, byte *, ErlDrvSizeT);
+			    byte *, ErlDrvSizeT, byte *, ErlDrvSizeT,
+			    Binary *);
 
 extern void init_dist(void);
 extern int stop_dist(void);
@@ -1305,6 +1314,8 @@ Sint erts_re_set_loop_limit(Sint limit);
 /* erl_bif_binary.c */
 void erts_init_bif_binary(void);
 Sint erts_binary_set_loop_limit(Sint limit);
+/* erl_bif_shared.c */
+void erts_init_shared_terms(void);
 
 /* external.c */
 void erts_init_external(void);
@@ -395,6 +395,7 @@ static Port *create_port(char *name,
     prt->bytes_in = 0;
     prt->bytes_out = 0;
     prt->dist_entry = NULL;
+    prt->dist_chnl = NULL;
     ERTS_PORT_INIT_CONNECTED(prt, pid);
     prt->common.u.alive.reg = NULL;
     ERTS_PTMR_INIT(prt);
@@ -4410,9 +4411,10 @@ erts_deliver_port_exit(Port *prt, Eterm from, Eterm reason, int send_closed,
    DRV_MONITOR_UNLOCK_PDL(prt);
 
    if ((state & ERTS_PORT_SFLG_DISTRIBUTION) && prt->dist_entry) {
-       erts_do_net_exits(prt->dist_entry, modified_reason);
+       erts_do_net_exits(prt->dist_entry, prt->dist_chnl, modified_reason);
        erts_deref_dist_entry(prt->dist_entry);
        prt->dist_entry = NULL;
+       prt->dist_chnl = NULL;
        erts_atomic32_read_band_relb(&prt->state,
 				    ~ERTS_PORT_SFLG_DISTRIBUTION);
    }
@@ -6741,7 +6743,8 @@ int driver_output_binary(ErlDrvPort ix, char* hbuf, ErlDrvSizeT hlen,
 	return erts_net_message(prt,
 				prt->dist_entry,
 				(byte*) hbuf, hlen,
-				(byte*) (bin->orig_bytes+offs), len);
+				(byte*) (bin->orig_bytes+offs), len,
+				ErlDrvBinary2Binary(bin));
     }
     else
 	deliver_bin_message(prt, ERTS_PORT_GET_CONNECTED(prt), 
@@ -6782,12 +6785,14 @@ int driver_output2(ErlDrvPort ix, char* hbuf, ErlDrvSizeT hlen,
 	    return erts_net_message(prt,
 				    prt->dist_entry,
 				    NULL, 0,
-				    (byte*) hbuf, hlen);
+				    (byte*) hbuf, hlen,
+				    NULL);
 	else
 	    return erts_net_message(prt,
 				    prt->dist_entry,
 				    (byte*) hbuf, hlen,
-				    (byte*) buf, len);
+				    (byte*) buf, len,
+				    NULL);
     }
     else if (state & ERTS_PORT_SFLG_LINEBUF_IO)
 	deliver_linebuf_message(prt, state, ERTS_PORT_GET_CONNECTED(prt),
@@ -601,6 +601,7 @@ __decl_noreturn void __noreturn erts_exit(int n, char*, ...);
 	     __FILE__, __LINE__, __func__, What)
 
 Eterm erts_check_io_info(void *p);
+void erts_late_init_check_io(void);
 
 /* Size of misc memory allocated from system dependent code */
 Uint erts_sys_misc_mem_sz(void);
@@ -271,6 +271,8 @@ noproc_primop_interface_1(nbif_atomic_inc, hipe_atomic_inc)
  */
 gc_bif_interface_1(nbif_term_to_binary_1, hipe_wrapper_term_to_binary_1)
 gc_bif_interface_2(nbif_term_to_binary_2, hipe_wrapper_term_to_binary_2)
+gc_bif_interface_1(nbif_term_to_iovec_1, hipe_wrapper_term_to_iovec_1)
+gc_bif_interface_2(nbif_term_to_iovec_2, hipe_wrapper_term_to_iovec_2)
 gc_bif_interface_1(nbif_binary_to_term_1, hipe_wrapper_binary_to_term_1)
 gc_bif_interface_2(nbif_binary_to_term_2, hipe_wrapper_binary_to_term_2)
 gc_bif_interface_1(nbif_binary_to_list_1, hipe_wrapper_binary_to_list_1)
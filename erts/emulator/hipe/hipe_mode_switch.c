@@ -526,8 +526,7 @@ Process *hipe_mode_switch(Process *p, unsigned cmd, Eterm reg[])
 #endif
 	  p->i = hipe_beam_pc_resume;
 	  p->arity = 0;
-	  erts_smp_atomic32_read_band_relb(&p->state,
-					   ~ERTS_PSFLG_ACTIVE);
+	  erts_proc_wait_deactivate(p);
 	  erts_smp_proc_unlock(p, ERTS_PROC_LOCKS_MSG_RECEIVE);
       do_schedule:
 	  {
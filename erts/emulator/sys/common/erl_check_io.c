@@ -94,10 +94,12 @@ typedef char EventStateFlags;
 
 #define GET_FD(fd) fd
 
-static struct pollset_info
+struct pollset_info
 {
     ErtsPollSet ps;
+    int ix;
     erts_smp_atomic_t in_poll_wait;        /* set while doing poll */
+    erts_smp_atomic_t check_io_time;       /* erts_check_io_time of last poll */
     struct {
 	int six; /* start index */
 	int eix; /* end index */
@@ -109,8 +111,34 @@ static struct pollset_info
     struct removed_fd* removed_list;       /* list of deselected fd's*/
     erts_smp_spinlock_t removed_list_lock;
 #endif
-}pollset;
-#define NUM_OF_POLLSETS 1
+#ifdef ERTS_SMP
+    erts_tid_t tid;                        /* poll thread (ix > 0) */
+#endif
+};
+
+/*
+ * Pollset 0 is polled by the schedulers via erts_check_io(), the others
+ * by one poll thread each. See erts_check_io_pollset_ix() for which
+ * pollset an fd belongs to.
+ */
+static union {
+    struct pollset_info psi;
+    char align__[ERTS_ALC_CACHE_LINE_ALIGN_SIZE(sizeof(struct pollset_info))];
+} *pollsetv;
+
+/*
+ * A poll thread does not wait for the I/O tasks it has scheduled, so
+ * the events of fds with active I/O tasks are taken out of its pollset
+ * until the tasks have executed. Otherwise it would get the same events
+ * over and over again. The schedulers poll pollset 0 between executing
+ * tasks, and only defer events where the poll implementation requires
+ * it (ERTS_CIO_DEFER_ACTIVE_EVENTS).
+ */
+#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#  define ERTS_CIO_DEFER_EVENTS(PSI) 1
+#elif ERTS_CIO_MAY_DEFER_EVENTS
+#  define ERTS_CIO_DEFER_EVENTS(PSI) ((PSI)->ix > 0)
+#endif
 
 typedef struct {
 #ifndef ERTS_SYS_CONTINOUS_FD_NUMBERS
@@ -234,6 +262,12 @@ static void steal_pending_stop_select(erts_dsprintf_buf_t*, ErlDrvPort,
 ERTS_SCHED_PREF_QUICK_ALLOC_IMPL(removed_fd, struct removed_fd, 64, ERTS_ALC_T_FD_LIST)
 #endif
 
+static ERTS_INLINE struct pollset_info *
+fd_pollset(ErtsSysFdType fd)
+{
+    return &pollsetv[erts_check_io_pollset_ix((ErlDrvEvent) fd)].psi;
+}
+
 static ERTS_INLINE void
 init_iotask(ErtsIoTask *io_task)
 {
@@ -241,12 +275,17 @@ init_iotask(ErtsIoTask *io_task)
     erts_smp_atomic_init_nob(&io_task->executed_time, ~((erts_aint_t) 0));
 }
 
+/*
+ * erts_check_io_time is shared by all pollsets and only grows, so a
+ * task executed after the current poll of its pollset began has an
+ * executed_time at or above current_cio_time.
+ */
 static ERTS_INLINE int
 is_iotask_active(ErtsIoTask *io_task, erts_aint_t current_cio_time)
 {    
     if (erts_port_task_is_scheduled(&io_task->task))
 	return 1;
-    if (erts_smp_atomic_read_nob(&io_task->executed_time) == current_cio_time)
+    if (erts_smp_atomic_read_nob(&io_task->executed_time) >= current_cio_time)
 	return 1;
     return 0;
 }
@@ -281,7 +320,7 @@ alloc_drv_event_data(void)
     dep->port = NIL;
     dep->data = NULL;
     dep->removed_events = 0;
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
     dep->deferred_events = 0;
 #endif
     init_iotask(&dep->iotask);
@@ -530,7 +569,8 @@ deselect(ErtsDrvEventState *state, int mode)
 	}
     }
 
-    state->events = ERTS_CIO_POLL_CTL(pollset.ps, state->fd, rm_events, 0, &do_wake);
+    state->events = ERTS_CIO_POLL_CTL(fd_pollset(state->fd)->ps, state->fd,
+				      rm_events, 0, &do_wake);
 
     if (!(state->events)) {
 	switch (state->type) {
@@ -554,7 +594,7 @@ deselect(ErtsDrvEventState *state, int mode)
 	    
 	state->type = ERTS_EV_TYPE_NONE;
 	state->flags &= ~ERTS_EV_FLAG_USED;
-	remember_removed(state, &pollset);
+	remember_removed(state, fd_pollset(state->fd));
     }
 }
 
@@ -575,7 +615,8 @@ check_fd_cleanup(ErtsDrvEventState *state,
 
     ERTS_SMP_LC_ASSERT(erts_smp_lc_mtx_is_locked(fd_mtx(state->fd)));
 
-    current_cio_time = erts_smp_atomic_read_acqb(&erts_check_io_time);
+    current_cio_time =
+	erts_smp_atomic_read_acqb(&fd_pollset(state->fd)->check_io_time);
     *free_select = NULL;
     if (state->driver.select
 	&& (state->type != ERTS_EV_TYPE_DRV_SEL)
@@ -613,7 +654,7 @@ check_fd_cleanup(ErtsDrvEventState *state,
 
 static ERTS_INLINE int
 check_cleanup_active_fd(ErtsSysFdType fd,
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
 			ErtsPollControlEntry *pce,
 			int *pce_ix,
 #endif
@@ -626,7 +667,7 @@ check_cleanup_active_fd(ErtsSysFdType fd,
 #if ERTS_CIO_HAVE_DRV_EVENT
     void *free_event = NULL;
 #endif
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
     ErtsPollEvents evon = 0, evoff = 0;
 #endif
 
@@ -640,43 +681,41 @@ check_cleanup_active_fd(ErtsSysFdType fd,
 #endif
     {
 	if (state->driver.select) {
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
-	    if (is_iotask_active(&state->driver.select->iniotask, current_cio_time)) {
-		active = 1;
-		if ((state->events & ERTS_POLL_EV_IN)
-		    && !(state->flags & ERTS_EV_FLAG_DEFER_IN_EV)) {
-		    evoff |= ERTS_POLL_EV_IN;
-		    state->flags |= ERTS_EV_FLAG_DEFER_IN_EV;
+#if ERTS_CIO_MAY_DEFER_EVENTS
+	    if (pce) {
+		if (is_iotask_active(&state->driver.select->iniotask, current_cio_time)) {
+		    active = 1;
+		    if ((state->events & ERTS_POLL_EV_IN)
+			&& !(state->flags & ERTS_EV_FLAG_DEFER_IN_EV)) {
+			evoff |= ERTS_POLL_EV_IN;
+			state->flags |= ERTS_EV_FLAG_DEFER_IN_EV;
+		    }
 		}
-	    }
-	    else if (state->flags & ERTS_EV_FLAG_DEFER_IN_EV) {
-		if (state->events & ERTS_POLL_EV_IN)
-		    evon |= ERTS_POLL_EV_IN;
-		state->flags &= ~ERTS_EV_FLAG_DEFER_IN_EV;
-	    }
-	    if (is_iotask_active(&state->driver.select->outiotask, current_cio_time)) {
-		active = 1;
-		if ((state->events & ERTS_POLL_EV_OUT)
-		    && !(state->flags & ERTS_EV_FLAG_DEFER_OUT_EV)) {
-		    evoff |= ERTS_POLL_EV_OUT;
-		    state->flags |= ERTS_EV_FLAG_DEFER_OUT_EV;
+		else if (state->flags & ERTS_EV_FLAG_DEFER_IN_EV) {
+		    if (state->events & ERTS_POLL_EV_IN)
+			evon |= ERTS_POLL_EV_IN;
+		    state->flags &= ~ERTS_EV_FLAG_DEFER_IN_EV;
+		}
+		if (is_iotask_active(&state->driver.select->outiotask, current_cio_time)) {
+		    active = 1;
+		    if ((state->events & ERTS_POLL_EV_OUT)
+			&& !(state->flags & ERTS_EV_FLAG_DEFER_OUT_EV)) {
+			evoff |= ERTS_POLL_EV_OUT;
+			state->flags |= ERTS_EV_FLAG_DEFER_OUT_EV;
+		    }
+		}
+		else if (state->flags & ERTS_EV_FLAG_DEFER_OUT_EV) {
+		    if (state->events & ERTS_POLL_EV_OUT)
+			evon |= ERTS_POLL_EV_OUT;
+		    state->flags &= ~ERTS_EV_FLAG_DEFER_OUT_EV;
 		}
 	    }
-	    else if (state->flags & ERTS_EV_FLAG_DEFER_OUT_EV) {
-		if (state->events & ERTS_POLL_EV_OUT)
-		    evon |= ERTS_POLL_EV_OUT;
-		state->flags &= ~ERTS_EV_FLAG_DEFER_OUT_EV;
-	    }
-	    if (active)
-		(void) 0;
 	    else
-#else
+#endif
 	    if (is_iotask_active(&state->driver.select->iniotask, current_cio_time)
 		|| is_iotask_active(&state->driver.select->outiotask, current_cio_time))
 		active = 1;
-	    else
-#endif
-		if (state->type != ERTS_EV_TYPE_DRV_SEL) {
+	    if (!active && state->type != ERTS_EV_TYPE_DRV_SEL) {
 		free_select = state->driver.select;
 		state->driver.select = NULL;
 	    }
@@ -685,9 +724,9 @@ check_cleanup_active_fd(ErtsSysFdType fd,
 #if ERTS_CIO_HAVE_DRV_EVENT
 	if (state->driver.event) {
 	    if (is_iotask_active(&state->driver.event->iotask, current_cio_time)) {
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
 		ErtsPollEvents evs = state->events & ~state->driver.event->deferred_events;
-		if (evs) {
+		if (pce && evs) {
 		    evoff |= evs;
 		    state->driver.event->deferred_events |= evs;
 		}
@@ -698,7 +737,7 @@ check_cleanup_active_fd(ErtsSysFdType fd,
 		free_event = state->driver.event;
 		state->driver.event = NULL;
 	    }
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
 	    else {
 		ErtsPollEvents evs = state->events & state->driver.event->deferred_events;
 		if (evs) {
@@ -727,7 +766,7 @@ check_cleanup_active_fd(ErtsSysFdType fd,
 	free_drv_event_data(free_event);
 #endif
 
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
     if (evoff) {
 	ErtsPollControlEntry *pcep = &pce[(*pce_ix)++];
 	pcep->fd = fd;
@@ -746,16 +785,19 @@ check_cleanup_active_fd(ErtsSysFdType fd,
 }
 
 static void
-check_cleanup_active_fds(erts_aint_t current_cio_time)
+check_cleanup_active_fds(struct pollset_info *psi,
+			 erts_aint_t current_cio_time)
 {
-    int six = pollset.active_fd.six;
-    int eix = pollset.active_fd.eix;
-    erts_aint32_t no = erts_smp_atomic32_read_dirty(&pollset.active_fd.no);
-    int size = pollset.active_fd.size;
+    int six = psi->active_fd.six;
+    int eix = psi->active_fd.eix;
+    erts_aint32_t no = erts_smp_atomic32_read_dirty(&psi->active_fd.no);
+    int size = psi->active_fd.size;
     int ix = six;
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
     /* every fd might add two entries */
-    Uint pce_sz = 2*sizeof(ErtsPollControlEntry)*no;
+    Uint pce_sz = (ERTS_CIO_DEFER_EVENTS(psi)
+		   ? 2*sizeof(ErtsPollControlEntry)*no
+		   : 0);
     ErtsPollControlEntry *pctrl_entries = (pce_sz
 					   ? erts_alloc(ERTS_ALC_T_TMP, pce_sz)
 					   : NULL);
@@ -763,13 +805,13 @@ check_cleanup_active_fds(erts_aint_t current_cio_time)
 #endif
 
     while (ix != eix) {
-	ErtsSysFdType fd = pollset.active_fd.array[ix];
+	ErtsSysFdType fd = psi->active_fd.array[ix];
 	int nix = ix + 1;
 	if (nix >= size)
 	    nix = 0;
 	ASSERT(fd != ERTS_SYS_FD_INVALID);
 	if (!check_cleanup_active_fd(fd,
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
 				     pctrl_entries,
 				     &pctrl_ix,
 #endif
@@ -777,14 +819,14 @@ check_cleanup_active_fds(erts_aint_t current_cio_time)
 	    no--;
 	    if (ix == six) {
 #ifdef DEBUG
-		pollset.active_fd.array[ix] = ERTS_SYS_FD_INVALID;
+		psi->active_fd.array[ix] = ERTS_SYS_FD_INVALID;
 #endif
 		six = nix;
 	    }
 	    else {
-		pollset.active_fd.array[ix] = pollset.active_fd.array[six];
+		psi->active_fd.array[ix] = psi->active_fd.array[six];
 #ifdef DEBUG
-		pollset.active_fd.array[six] = ERTS_SYS_FD_INVALID;
+		psi->active_fd.array[six] = ERTS_SYS_FD_INVALID;
 #endif
 		six++;
 		if (six >= size)
@@ -794,54 +836,54 @@ check_cleanup_active_fds(erts_aint_t current_cio_time)
 	ix = nix;
     }
 
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
     ASSERT(pctrl_ix <= pce_sz/sizeof(ErtsPollControlEntry));
     if (pctrl_ix)
-	ERTS_CIO_POLL_CTLV(pollset.ps, pctrl_entries, pctrl_ix);
+	ERTS_CIO_POLL_CTLV(psi->ps, pctrl_entries, pctrl_ix);
     if (pctrl_entries)
 	erts_free(ERTS_ALC_T_TMP, pctrl_entries);
 #endif
 
-    pollset.active_fd.six = six;
-    pollset.active_fd.eix = eix;
-    erts_smp_atomic32_set_relb(&pollset.active_fd.no, no);
+    psi->active_fd.six = six;
+    psi->active_fd.eix = eix;
+    erts_smp_atomic32_set_relb(&psi->active_fd.no, no);
 }
 
 static ERTS_INLINE void
-add_active_fd(ErtsSysFdType fd)
+add_active_fd(struct pollset_info *psi, ErtsSysFdType fd)
 {
-    int eix = pollset.active_fd.eix;
-    int size = pollset.active_fd.size;
+    int eix = psi->active_fd.eix;
+    int size = psi->active_fd.size;
     
 
-    pollset.active_fd.array[eix] = fd;
+    psi->active_fd.array[eix] = fd;
 
-    erts_smp_atomic32_set_relb(&pollset.active_fd.no,
-			       (erts_smp_atomic32_read_dirty(&pollset.active_fd.no)
+    erts_smp_atomic32_set_relb(&psi->active_fd.no,
+			       (erts_smp_atomic32_read_dirty(&psi->active_fd.no)
 				+ 1));
 
     eix++;
     if (eix >= size)
 	eix = 0;
-    if (pollset.active_fd.six == eix) {
-	pollset.active_fd.six = 0;
+    if (psi->active_fd.six == eix) {
+	psi->active_fd.six = 0;
 	eix = size;
 	size += ERTS_ACTIVE_FD_INC;
-	pollset.active_fd.array = erts_realloc(ERTS_ALC_T_ACTIVE_FD_ARR,
-					       pollset.active_fd.array,
+	psi->active_fd.array = erts_realloc(ERTS_ALC_T_ACTIVE_FD_ARR,
+					       psi->active_fd.array,
 					       sizeof(ErtsSysFdType)*size);
-	pollset.active_fd.size = size;
+	psi->active_fd.size = size;
 #ifdef DEBUG
 	{
 	    int i;
 	    for (i = eix + 1; i < size; i++)
-		pollset.active_fd.array[i] = ERTS_SYS_FD_INVALID;
+		psi->active_fd.array[i] = ERTS_SYS_FD_INVALID;
 	}
 #endif
 
     }
 
-    pollset.active_fd.eix = eix;
+    psi->active_fd.eix = eix;
 }
 
 int
@@ -857,6 +899,7 @@ ERTS_CIO_EXPORT(driver_select)(ErlDrvPort ix,
     ErtsPollEvents ctl_events = (ErtsPollEvents) 0;
     ErtsPollEvents new_events, old_events;
     ErtsDrvEventState *state;
+    struct pollset_info *psi;
     int wake_poller;
     int ret;
 #if ERTS_CIO_HAVE_DRV_EVENT
@@ -872,6 +915,8 @@ ERTS_CIO_EXPORT(driver_select)(ErlDrvPort ix,
 
     ERTS_SMP_LC_ASSERT(erts_lc_is_port_locked(prt));
 
+    psi = fd_pollset(fd);
+
 #ifdef ERTS_SYS_CONTINOUS_FD_NUMBERS
     if ((unsigned)fd >= (unsigned)erts_smp_atomic_read_nob(&drv_ev_state_len)) {
 	if (fd < 0) {
@@ -959,7 +1004,7 @@ ERTS_CIO_EXPORT(driver_select)(ErlDrvPort ix,
 	wake_poller = 1;
     }
 
-    new_events = ERTS_CIO_POLL_CTL(pollset.ps, state->fd, ctl_events, on, &wake_poller);
+    new_events = ERTS_CIO_POLL_CTL(psi->ps, state->fd, ctl_events, on, &wake_poller);
 
     if (new_events & (ERTS_POLL_EV_ERR|ERTS_POLL_EV_NVAL)) {
 	if (state->type == ERTS_EV_TYPE_DRV_SEL && !state->events) {
@@ -1009,7 +1054,7 @@ ERTS_CIO_EXPORT(driver_select)(ErlDrvPort ix,
 		}
 		if (new_events == 0) {
 		    if (old_events != 0) {
-			remember_removed(state, &pollset);
+			remember_removed(state, psi);
 		    }		    
 		    if ((mode & ERL_DRV_USE) || !(state->flags & ERTS_EV_FLAG_USED)) {
 			state->type = ERTS_EV_TYPE_NONE;
@@ -1084,6 +1129,7 @@ ERTS_CIO_EXPORT(driver_event)(ErlDrvPort ix,
     ErtsPollEvents remove_events;
     Eterm id = erts_drvport2id(ix);
     ErtsDrvEventState *state;
+    struct pollset_info *psi = fd_pollset(fd);
     int do_wake = 0;
     int ret;
 #if ERTS_CIO_HAVE_DRV_EVENT
@@ -1151,14 +1197,14 @@ ERTS_CIO_EXPORT(driver_event)(ErlDrvPort ix,
     }
 
     if (add_events) {
-	events = ERTS_CIO_POLL_CTL(pollset.ps, state->fd, add_events, 1, &do_wake);
+	events = ERTS_CIO_POLL_CTL(psi->ps, state->fd, add_events, 1, &do_wake);
 	if (events & (ERTS_POLL_EV_ERR|ERTS_POLL_EV_NVAL)) {
 	    ret = -1;
 	    goto done;
 	}
     }
     if (remove_events) {
-	events = ERTS_CIO_POLL_CTL(pollset.ps, state->fd, remove_events, 0, &do_wake);
+	events = ERTS_CIO_POLL_CTL(psi->ps, state->fd, remove_events, 0, &do_wake);
 	if (events & (ERTS_POLL_EV_ERR|ERTS_POLL_EV_NVAL)) {
 	    ret = -1;
 	    goto done;
@@ -1186,7 +1232,7 @@ ERTS_CIO_EXPORT(driver_event)(ErlDrvPort ix,
 	    state->driver.event->removed_events = (ErtsPollEvents) 0;
 	}
 	state->type = ERTS_EV_TYPE_NONE;
-	remember_removed(state, &pollset);
+	remember_removed(state, psi);
     }
     state->events = events;
     ASSERT(event_data ? events == event_data->events : events == 0); 
@@ -1518,7 +1564,8 @@ io_task_schedule_allowed(ErtsDrvEventState *state,
 }
 
 static ERTS_INLINE void
-iready(Eterm id, ErtsDrvEventState *state, erts_aint_t current_cio_time)
+iready(struct pollset_info *psi, Eterm id, ErtsDrvEventState *state,
+       erts_aint_t current_cio_time)
 {
     if (io_task_schedule_allowed(state,
 				 ERTS_PORT_TASK_INPUT,
@@ -1531,12 +1578,13 @@ iready(Eterm id, ErtsDrvEventState *state, erts_aint_t current_cio_time)
 				    (ErlDrvEvent) state->fd) != 0) {
 	    stale_drv_select(id, state, ERL_DRV_READ);
 	}
-	add_active_fd(state->fd);
+	add_active_fd(psi, state->fd);
     }
 }
 
 static ERTS_INLINE void
-oready(Eterm id, ErtsDrvEventState *state, erts_aint_t current_cio_time)
+oready(struct pollset_info *psi, Eterm id, ErtsDrvEventState *state,
+       erts_aint_t current_cio_time)
 {
     if (io_task_schedule_allowed(state,
 				 ERTS_PORT_TASK_OUTPUT,
@@ -1549,14 +1597,14 @@ oready(Eterm id, ErtsDrvEventState *state, erts_aint_t current_cio_time)
 				    (ErlDrvEvent) state->fd) != 0) {
 	    stale_drv_select(id, state, ERL_DRV_WRITE);
 	}
-	add_active_fd(state->fd);
+	add_active_fd(psi, state->fd);
     }
 }
 
 #if ERTS_CIO_HAVE_DRV_EVENT
 static ERTS_INLINE void
-eready(Eterm id, ErtsDrvEventState *state, ErlDrvEventData event_data,
-       erts_aint_t current_cio_time)
+eready(struct pollset_info *psi, Eterm id, ErtsDrvEventState *state,
+       ErlDrvEventData event_data, erts_aint_t current_cio_time)
 {
     if (io_task_schedule_allowed(state,
 				 ERTS_PORT_TASK_EVENT,
@@ -1570,7 +1618,7 @@ eready(Eterm id, ErtsDrvEventState *state, ErlDrvEventData event_data,
 				    event_data) != 0) {
 	    stale_drv_select(id, state, 0);
 	}
-	add_active_fd(state->fd);
+	add_active_fd(psi, state->fd);
     }
 }
 #endif
@@ -1581,82 +1629,86 @@ static void bad_fd_in_pollset( ErtsDrvEventState *, Eterm, Eterm, ErtsPollEvents
 void
 ERTS_CIO_EXPORT(erts_check_io_async_sig_interrupt)(void)
 {
-    ERTS_CIO_POLL_AS_INTR(pollset.ps);
+    ERTS_CIO_POLL_AS_INTR(pollsetv[0].psi.ps);
 }
 #endif
 
 void
 ERTS_CIO_EXPORT(erts_check_io_interrupt)(int set)
 {
-    ERTS_CIO_POLL_INTR(pollset.ps, set);
+    ERTS_CIO_POLL_INTR(pollsetv[0].psi.ps, set);
 }
 
 void
 ERTS_CIO_EXPORT(erts_check_io_interrupt_timed)(int set,
 					       ErtsMonotonicTime timeout_time)
 {
-    ERTS_CIO_POLL_INTR_TMD(pollset.ps, set, timeout_time);
+    ERTS_CIO_POLL_INTR_TMD(pollsetv[0].psi.ps, set, timeout_time);
 }
 
-void
-ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
+/*
+ * Poll one pollset and schedule I/O tasks for the events found.
+ * Schedulers poll pollset 0 and pass their scheduler data, poll
+ * threads pass NULL and wait until an event arrives.
+ */
+static void
+check_io_pollset(struct pollset_info *psi, ErtsSchedulerData *esdp,
+		 int do_wait)
 {
     ErtsPollResFd *pollres;
     int pollres_len;
     ErtsMonotonicTime timeout_time;
     int poll_ret, i;
     erts_aint_t current_cio_time;
-    ErtsSchedulerData *esdp = erts_get_scheduler_data();
-
-    ASSERT(esdp);
 
  restart:
 
 #ifdef ERTS_BREAK_REQUESTED
-    if (ERTS_BREAK_REQUESTED)
+    if (esdp && ERTS_BREAK_REQUESTED)
 	erts_do_break_handling();
 #endif
 
     /* Figure out timeout value */
-    timeout_time = (do_wait
-		    ? erts_check_next_timeout_time(esdp)
-		    : ERTS_POLL_NO_TIMEOUT /* poll only */);
+    if (!do_wait)
+	timeout_time = ERTS_POLL_NO_TIMEOUT; /* poll only */
+    else if (esdp)
+	timeout_time = erts_check_next_timeout_time(esdp);
+    else
+	timeout_time = ERTS_MONOTONIC_TIME_MAX;
 
     /*
-     * No need for an atomic inc op when incrementing
-     * erts_check_io_time, since only one thread can
-     * check io at a time.
+     * erts_check_io_time is shared by all pollsets, which are polled
+     * concurrently, so it has to be incremented atomically.
      */
-    current_cio_time = erts_smp_atomic_read_dirty(&erts_check_io_time);
-    current_cio_time++;
-    erts_smp_atomic_set_relb(&erts_check_io_time, current_cio_time);
+    current_cio_time = erts_smp_atomic_inc_read_relb(&erts_check_io_time);
+    erts_smp_atomic_set_relb(&psi->check_io_time, current_cio_time);
 
-    check_cleanup_active_fds(current_cio_time);
+    check_cleanup_active_fds(psi, current_cio_time);
 
 #ifdef ERTS_ENABLE_LOCK_CHECK
     erts_lc_check_exact(NULL, 0); /* No locks should be locked */
 #endif
 
-    pollres_len = erts_smp_atomic32_read_dirty(&pollset.active_fd.no) + ERTS_CHECK_IO_POLL_RES_LEN;
+    pollres_len = erts_smp_atomic32_read_dirty(&psi->active_fd.no) + ERTS_CHECK_IO_POLL_RES_LEN;
 
     pollres = erts_alloc(ERTS_ALC_T_TMP, sizeof(ErtsPollResFd)*pollres_len);
 
-    erts_smp_atomic_set_nob(&pollset.in_poll_wait, 1);
+    erts_smp_atomic_set_nob(&psi->in_poll_wait, 1);
 
-    poll_ret = ERTS_CIO_POLL_WAIT(pollset.ps, pollres, &pollres_len, timeout_time);
+    poll_ret = ERTS_CIO_POLL_WAIT(psi->ps, pollres, &pollres_len, timeout_time);
 
 #ifdef ERTS_ENABLE_LOCK_CHECK
     erts_lc_check_exact(NULL, 0); /* No locks should be locked */
 #endif
 
 #ifdef ERTS_BREAK_REQUESTED
-    if (ERTS_BREAK_REQUESTED)
+    if (esdp && ERTS_BREAK_REQUESTED)
 	erts_do_break_handling();
 #endif
 
     if (poll_ret != 0) {
-	erts_smp_atomic_set_nob(&pollset.in_poll_wait, 0);
-	forget_removed(&pollset);
+	erts_smp_atomic_set_nob(&psi->in_poll_wait, 0);
+	forget_removed(psi);
 	erts_free(ERTS_ALC_T_TMP, pollres);
 	if (poll_ret == EAGAIN) {
 	    goto restart;
@@ -1717,15 +1769,15 @@ ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
 		if ((revents & ERTS_POLL_EV_IN)
 		    || (!(revents & ERTS_POLL_EV_OUT)
 			&& state->events & ERTS_POLL_EV_IN)) {
-		    iready(state->driver.select->inport, state, current_cio_time);
+		    iready(psi, state->driver.select->inport, state, current_cio_time);
 		}
 		else if (state->events & ERTS_POLL_EV_OUT) {
-		    oready(state->driver.select->outport, state, current_cio_time);
+		    oready(psi, state->driver.select->outport, state, current_cio_time);
 		}
 	    }
 	    else if (revents & (ERTS_POLL_EV_IN|ERTS_POLL_EV_OUT)) {
 		if (revents & ERTS_POLL_EV_OUT) {
-		    oready(state->driver.select->outport, state, current_cio_time);
+		    oready(psi, state->driver.select->outport, state, current_cio_time);
 		}
 		/* Someone might have deselected input since revents
 		   was read (true also on the non-smp emulator since
@@ -1733,7 +1785,7 @@ ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
 		   revents... */
 		revents &= ~(~state->events & ERTS_POLL_EV_IN);
 		if (revents & ERTS_POLL_EV_IN) {
-		    iready(state->driver.select->inport, state, current_cio_time);
+		    iready(psi, state->driver.select->inport, state, current_cio_time);
 		}
 	    }
 	    else if (revents & ERTS_POLL_EV_NVAL) {
@@ -1741,7 +1793,7 @@ ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
 				  state->driver.select->inport,
 				  state->driver.select->outport,
 				  state->events);
-		add_active_fd(state->fd);
+		add_active_fd(psi, state->fd);
 	    }
 	    break;
 	}
@@ -1759,7 +1811,8 @@ ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
 	    if (revents) {
 		event_data->events = state->events;
 		event_data->revents = revents;
-		eready(state->driver.event->port, state, event_data, current_cio_time);
+		eready(psi, state->driver.event->port, state, event_data,
+		       current_cio_time);
 	    }
 	    break;
 	}
@@ -1777,7 +1830,7 @@ ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
 			  (int) state->type);
 	    ASSERT(0);
 	    deselect(state, 0);
-	    add_active_fd(state->fd);
+	    add_active_fd(psi, state->fd);
 	    break;
 	}
 	}
@@ -1788,9 +1841,95 @@ ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
 #endif
     }
 
-    erts_smp_atomic_set_nob(&pollset.in_poll_wait, 0);
+    erts_smp_atomic_set_nob(&psi->in_poll_wait, 0);
     erts_free(ERTS_ALC_T_TMP, pollres);
-    forget_removed(&pollset);
+    forget_removed(psi);
+}
+
+void
+ERTS_CIO_EXPORT(erts_check_io)(int do_wait)
+{
+    ErtsSchedulerData *esdp = erts_get_scheduler_data();
+
+    ASSERT(esdp);
+
+    check_io_pollset(&pollsetv[0].psi, esdp, do_wait);
+}
+
+#ifdef ERTS_SMP
+
+static void
+poll_thread_wakeup(void *vtse)
+{
+    erts_tse_set((erts_tse_t *) vtse);
+}
+
+/*
+ * Each pollset but the first is polled by a poll thread of its own.
+ * The thread does not wait for the I/O tasks it schedules; the events
+ * of their fds are deferred instead (see ERTS_CIO_DEFER_EVENTS()), and
+ * the thread is woken when a task has executed so that it can poll for
+ * them again.
+ */
+static void
+poll_thread_io_task_done(void *vpsi)
+{
+    struct pollset_info *psi = (struct pollset_info *) vpsi;
+    ERTS_CIO_POLL_INTR(psi->ps, 1);
+}
+
+static void *
+poll_thread(void *vpsi)
+{
+    struct pollset_info *psi = (struct pollset_info *) vpsi;
+    erts_tse_t *tse = erts_tse_fetch();
+    ErtsThrPrgrCallbacks callbacks;
+    ERTS_MSACC_DECLARE_CACHE();
+
+    callbacks.arg = (void *) tse;
+    callbacks.wakeup = poll_thread_wakeup;
+    callbacks.prepare_wait = NULL;
+    callbacks.wait = NULL;
+
+    erts_thr_progress_register_unmanaged_thread(&callbacks);
+
+    erts_msacc_init_thread("poll", psi->ix, 0);
+    ERTS_MSACC_UPDATE_CACHE();
+    ERTS_MSACC_SET_STATE_CACHED(ERTS_MSACC_STATE_CHECK_IO);
+
+    while (1) {
+	/*
+	 * Clear the wakeup of the previous poll, as the schedulers
+	 * do before they poll, or we would never block again.
+	 */
+	ERTS_CIO_POLL_INTR(psi->ps, 0);
+	check_io_pollset(psi, NULL, 1);
+    }
+
+    return NULL;
+}
+
+#endif
+
+void
+ERTS_CIO_EXPORT(erts_late_init_check_io)(void)
+{
+#ifdef ERTS_SMP
+    erts_thr_opts_t thr_opts = ERTS_THR_OPTS_DEFAULT_INITER;
+    char thr_name[16];
+    int i;
+
+    thr_opts.detached = 1;
+    thr_opts.name = thr_name;
+
+    for (i = 1; i < erts_no_pollsets; i++) {
+	struct pollset_info *psi = &pollsetv[i].psi;
+	erts_snprintf(thr_opts.name, 16, "poll_%d", i);
+	erts_port_task_set_io_wakeup(i, poll_thread_io_task_done,
+				     (void *) psi);
+	erts_thr_create(&psi->tid, poll_thread, (void *) psi, &thr_opts);
+    }
+#endif
 }
 
 static void
@@ -1905,32 +2044,50 @@ static void drv_ev_state_free(void *des)
 void
 ERTS_CIO_EXPORT(erts_init_check_io)(void)
 {
+    int j;
+
     erts_smp_atomic_init_nob(&erts_check_io_time, 0);
-    erts_smp_atomic_init_nob(&pollset.in_poll_wait, 0);
 
     ERTS_CIO_POLL_INIT();
-    pollset.ps = ERTS_CIO_NEW_POLLSET();
-
-    pollset.active_fd.six = 0;
-    pollset.active_fd.eix = 0;
-    erts_smp_atomic32_init_nob(&pollset.active_fd.no, 0);
-    pollset.active_fd.size = ERTS_ACTIVE_FD_INC;
-    pollset.active_fd.array = erts_alloc(ERTS_ALC_T_ACTIVE_FD_ARR,
-					 sizeof(ErtsSysFdType)*ERTS_ACTIVE_FD_INC);
+
+#ifdef ERTS_SMP
+    init_removed_fd_alloc();
+#endif
+
+    pollsetv = erts_alloc_permanent_cache_aligned(ERTS_ALC_T_POLLSET_INFO,
+						  sizeof(*pollsetv)
+						  * erts_no_pollsets);
+
+    for (j = 0; j < erts_no_pollsets; j++) {
+	struct pollset_info *psi = &pollsetv[j].psi;
+
+	psi->ix = j;
+	erts_smp_atomic_init_nob(&psi->in_poll_wait, 0);
+	erts_smp_atomic_init_nob(&psi->check_io_time, 0);
+	psi->ps = ERTS_CIO_NEW_POLLSET();
+
+	psi->active_fd.six = 0;
+	psi->active_fd.eix = 0;
+	erts_smp_atomic32_init_nob(&psi->active_fd.no, 0);
+	psi->active_fd.size = ERTS_ACTIVE_FD_INC;
+	psi->active_fd.array = erts_alloc(ERTS_ALC_T_ACTIVE_FD_ARR,
+					  sizeof(ErtsSysFdType)*ERTS_ACTIVE_FD_INC);
 #ifdef DEBUG
-    {
-	int i;
-	for (i = 0; i < ERTS_ACTIVE_FD_INC; i++)
-	    pollset.active_fd.array[i] = ERTS_SYS_FD_INVALID;
-    }
+	{
+	    int i;
+	    for (i = 0; i < ERTS_ACTIVE_FD_INC; i++)
+		psi->active_fd.array[i] = ERTS_SYS_FD_INVALID;
+	}
 #endif
 
+#ifdef ERTS_SMP
+	psi->removed_list = NULL;
+	erts_smp_spinlock_init(&psi->removed_list_lock,
+			       "pollset_rm_list");
+#endif
+    }
 
 #ifdef ERTS_SMP
-    init_removed_fd_alloc();
-    pollset.removed_list = NULL;
-    erts_smp_spinlock_init(&pollset.removed_list_lock,
-			   "pollset_rm_list");
     {
 	int i;
 	for (i=0; i<DRV_EV_STATE_LOCK_CNT; i++) {
@@ -1977,10 +2134,13 @@ ERTS_CIO_EXPORT(erts_check_io_max_files)(void)
 Uint
 ERTS_CIO_EXPORT(erts_check_io_size)(void)
 {
-    Uint res;
+    Uint res = 0;
     ErtsPollInfo pi;
-    ERTS_CIO_POLL_INFO(pollset.ps, &pi);
-    res = pi.memory_size;
+    int i;
+    for (i = 0; i < erts_no_pollsets; i++) {
+	ERTS_CIO_POLL_INFO(pollsetv[i].psi.ps, &pi);
+	res += pi.memory_size;
+    }
 #ifdef ERTS_SYS_CONTINOUS_FD_NUMBERS
     res += sizeof(ErtsDrvEventState) * erts_smp_atomic_read_nob(&drv_ev_state_len);
 #else
@@ -2001,28 +2161,39 @@ Eterm
 ERTS_CIO_EXPORT(erts_check_io_info)(void *proc)
 {
     Process *p = (Process *) proc;
-    Eterm tags[16], values[16], res;
-    Uint sz, *szp, *hp, **hpp, memory_size;
+    Eterm tags[20], values[20], res;
+    Uint sz, *szp, *hp, **hpp, memory_size = 0;
+    Uint poll_set_size = 0, fallback_poll_set_size = 0, pending_updates = 0;
     Sint i;
+    int j, active_fds = 0;
     ErtsPollInfo pi;
-    erts_aint_t cio_time = erts_smp_atomic_read_acqb(&erts_check_io_time);
-    int active_fds = (int) erts_smp_atomic32_read_acqb(&pollset.active_fd.no);
 
-    while (1) {
-	erts_aint_t post_cio_time;
-	int post_active_fds;
+    for (j = 0; j < erts_no_pollsets; j++) {
+	struct pollset_info *psi = &pollsetv[j].psi;
+	erts_aint_t cio_time = erts_smp_atomic_read_acqb(&psi->check_io_time);
+	int psi_active_fds = (int) erts_smp_atomic32_read_acqb(&psi->active_fd.no);
 
-	ERTS_CIO_POLL_INFO(pollset.ps, &pi);
+	while (1) {
+	    erts_aint_t post_cio_time;
+	    int post_active_fds;
 
-	post_cio_time = erts_smp_atomic_read_mb(&erts_check_io_time);
-	post_active_fds = (int) erts_smp_atomic32_read_acqb(&pollset.active_fd.no);
-	if (cio_time == post_cio_time && active_fds == post_active_fds)
-	    break;
-	cio_time = post_cio_time;
-	active_fds = post_active_fds;
+	    ERTS_CIO_POLL_INFO(psi->ps, &pi);
+
+	    post_cio_time = erts_smp_atomic_read_mb(&psi->check_io_time);
+	    post_active_fds = (int) erts_smp_atomic32_read_acqb(&psi->active_fd.no);
+	    if (cio_time == post_cio_time && psi_active_fds == post_active_fds)
+		break;
+	    cio_time = post_cio_time;
+	    psi_active_fds = post_active_fds;
+	}
+
+	memory_size += pi.memory_size;
+	poll_set_size += (Uint) pi.poll_set_size;
+	fallback_poll_set_size += (Uint) pi.fallback_poll_set_size;
+	pending_updates += (Uint) pi.pending_updates;
+	active_fds += psi_active_fds;
     }
 
-    memory_size = pi.memory_size;
 #ifdef ERTS_SYS_CONTINOUS_FD_NUMBERS
     memory_size += sizeof(ErtsDrvEventState) * erts_smp_atomic_read_nob(&drv_ev_state_len);
 #else
@@ -2061,11 +2232,11 @@ ERTS_CIO_EXPORT(erts_check_io_info)(void *proc)
     values[i++] = erts_bld_uint(hpp, szp, memory_size);
 
     tags[i] = erts_bld_atom(hpp, szp, "total_poll_set_size");
-    values[i++] = erts_bld_uint(hpp, szp, (Uint) pi.poll_set_size);
+    values[i++] = erts_bld_uint(hpp, szp, poll_set_size);
 
     if (pi.fallback) {
 	tags[i] = erts_bld_atom(hpp, szp, "fallback_poll_set_size");
-	values[i++] = erts_bld_uint(hpp, szp, (Uint) pi.fallback_poll_set_size);
+	values[i++] = erts_bld_uint(hpp, szp, fallback_poll_set_size);
     }
 
     tags[i] = erts_bld_atom(hpp, szp, "lazy_updates");
@@ -2073,7 +2244,7 @@ ERTS_CIO_EXPORT(erts_check_io_info)(void *proc)
 
     if (pi.lazy_updates) {
 	tags[i] = erts_bld_atom(hpp, szp, "pending_updates");
-	values[i++] = erts_bld_uint(hpp, szp, (Uint) pi.pending_updates);
+	values[i++] = erts_bld_uint(hpp, szp, pending_updates);
     }
 
     tags[i] = erts_bld_atom(hpp, szp, "batch_updates");
@@ -2088,6 +2259,9 @@ ERTS_CIO_EXPORT(erts_check_io_info)(void *proc)
     tags[i] = erts_bld_atom(hpp, szp, "active_fds");
     values[i++] = erts_bld_uint(hpp, szp, (Uint) active_fds);
 
+    tags[i] = erts_bld_atom(hpp, szp, "pollsets");
+    values[i++] = erts_bld_uint(hpp, szp, (Uint) erts_no_pollsets);
+
 #ifdef ERTS_POLL_COUNT_AVOIDED_WAKEUPS
     tags[i] = erts_bld_atom(hpp, szp, "no_avoided_wakeups");
     values[i++] = erts_bld_uint(hpp, szp, (Uint) pi.no_avoided_wakeups);
@@ -2416,7 +2590,20 @@ ERTS_CIO_EXPORT(erts_check_io_debug)(ErtsCheckIoDebugInfo *ciodip)
 
 #ifdef ERTS_SYS_CONTINOUS_FD_NUMBERS
     counters.epep = erts_alloc(ERTS_ALC_T_TMP, sizeof(ErtsPollEvents)*max_fds);
-    ERTS_POLL_EXPORT(erts_poll_get_selected_events)(pollset.ps, counters.epep, max_fds);
+    ERTS_POLL_EXPORT(erts_poll_get_selected_events)(pollsetv[0].psi.ps,
+						    counters.epep, max_fds);
+    if (erts_no_pollsets > 1) {
+	ErtsPollEvents *epep = erts_alloc(ERTS_ALC_T_TMP,
+					  sizeof(ErtsPollEvents)*max_fds);
+	int i;
+	for (i = 1; i < erts_no_pollsets; i++) {
+	    ERTS_POLL_EXPORT(erts_poll_get_selected_events)(pollsetv[i].psi.ps,
+							    epep, max_fds);
+	    for (fd = 0; fd < max_fds; fd++)
+		counters.epep[fd] |= epep[fd];
+	}
+	erts_free(ERTS_ALC_T_TMP, (void *) epep);
+    }
     counters.internal_fds = 0;
 #endif
     counters.used_fds = 0;
@@ -54,6 +54,8 @@ void erts_check_io_kp(int);
 void erts_check_io_nkp(int);
 void erts_init_check_io_kp(void);
 void erts_init_check_io_nkp(void);
+void erts_late_init_check_io_kp(void);
+void erts_late_init_check_io_nkp(void);
 int erts_check_io_debug_kp(ErtsCheckIoDebugInfo *);
 int erts_check_io_debug_nkp(ErtsCheckIoDebugInfo *);
 
@@ -73,6 +75,10 @@ void erts_init_check_io(void);
 #endif
 
 extern erts_smp_atomic_t erts_check_io_time;
+extern int erts_no_pollsets;
+
+/* Max number of pollsets (+IOp) */
+#define ERTS_MAX_NO_OF_POLLSETS 1024
 
 typedef struct {
     ErtsPortTaskHandle task;
@@ -80,6 +86,7 @@ typedef struct {
 } ErtsIoTask;
 
 ERTS_GLB_INLINE void erts_io_notify_port_task_executed(ErtsPortTaskHandle *pthp);
+ERTS_GLB_INLINE int erts_check_io_pollset_ix(ErlDrvEvent event);
 
 #if ERTS_GLB_INLINE_INCL_FUNC_DEF
 
@@ -91,6 +98,18 @@ erts_io_notify_port_task_executed(ErtsPortTaskHandle *pthp)
     erts_smp_atomic_set_relb(&itp->executed_time, ci_time);
 }
 
+/*
+ * The pollset that an fd belongs to. Fds are spread over the pollsets
+ * by their number, which the operating system hands out densely.
+ */
+ERTS_GLB_INLINE int
+erts_check_io_pollset_ix(ErlDrvEvent event)
+{
+    if (erts_no_pollsets == 1)
+	return 0;
+    return (int) (((UWord) event) % ((UWord) erts_no_pollsets));
+}
+
 #endif
 
 #endif /*  ERL_CHECK_IO_H__ */
@@ -114,6 +133,16 @@ erts_io_notify_port_task_executed(ErtsPortTaskHandle *pthp)
 #  define ERTS_CIO_DEFER_ACTIVE_EVENTS 0
 #endif
 
+/*
+ * The pollsets polled by poll threads (+IOp) always defer the events
+ * of fds with active I/O tasks, see ERTS_CIO_DEFER_EVENTS().
+ */
+#if ERTS_CIO_DEFER_ACTIVE_EVENTS || defined(ERTS_SMP)
+#  define ERTS_CIO_MAY_DEFER_EVENTS 1
+#else
+#  define ERTS_CIO_MAY_DEFER_EVENTS 0
+#endif
+
 /*
  * ErtsDrvEventDataState is used by driver_event() which is almost never
  * used. We allocate ErtsDrvEventDataState separate since we dont wan't
@@ -124,7 +153,7 @@ typedef struct {
     Eterm port;
     ErlDrvEventData data;
     ErtsPollEvents removed_events;
-#if ERTS_CIO_DEFER_ACTIVE_EVENTS
+#if ERTS_CIO_MAY_DEFER_EVENTS
     ErtsPollEvents deferred_events;
 #endif
     ErtsIoTask iotask;
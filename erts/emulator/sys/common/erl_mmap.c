@@ -301,6 +301,8 @@ struct ErtsMemMapper_ {
     int supercarrier;
     int no_os_mmap;
     int executable;   /* is client a native code allocator? */
+    int hugepages;    /* ERTS_MMAP_HP_* */
+    UWord hugepage_size;
     /*
      * Super unaligned area is located above super aligned
      * area. That is, `sa.bot` is beginning of the super
@@ -1327,6 +1329,82 @@ os_mremap(void *ptr, UWord old_size, UWord new_size, int try_superalign)
 }
 #endif
 
+#if HAVE_MMAP && (defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE))
+#  define ERTS_HAVE_OS_HUGEPAGES 1
+
+#define ERTS_MMAP_DEFAULT_HUGEPAGE_SIZE (UWORD_CONSTANT(2)*1024*1024)
+
+static UWord
+os_hugepage_size(void)
+{
+    UWord size = 0;
+#ifdef __linux__
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (f) {
+	char line[128];
+	unsigned long kb;
+	while (fgets(line, sizeof(line), f)) {
+	    if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+		size = ((UWord) kb)*1024;
+		break;
+	    }
+	}
+	fclose(f);
+    }
+#endif
+    if (!size)
+	size = ERTS_MMAP_DEFAULT_HUGEPAGE_SIZE;
+    return size;
+}
+
+/*
+ * Map a segment backed by huge pages. 'size' is a multiple of the
+ * huge page size. Explicit huge pages are taken from the pool that
+ * the system administrator has set aside; when the pool is exhausted
+ * (or explicit huge pages are not wanted) we fall back on a huge page
+ * aligned mapping that we advise the kernel to back with transparent
+ * huge pages. The advice is only a hint, so the kernel may still use
+ * normal pages for it.
+ */
+static void *
+os_mmap_hugepages(ErtsMemMapper *mm, UWord size)
+{
+    const UWord inv_mask = mm->hugepage_size - 1;
+    char *ptr, *seg;
+    UWord sz;
+
+#ifdef MAP_HUGETLB
+    if (mm->hugepages == ERTS_MMAP_HP_EXPLICIT) {
+	const int prot = mm->executable ? ERTS_MMAP_PROT_EXEC : ERTS_MMAP_PROT;
+	void *res = mmap(NULL, size, prot, ERTS_MMAP_FLAGS|MAP_HUGETLB,
+			 ERTS_MMAP_FD, 0);
+	if (res != MAP_FAILED) {
+	    ERTS_MMAP_ASSERT((((UWord) res) & inv_mask) == 0);
+	    return res;
+	}
+    }
+#endif
+
+    ptr = os_mmap(NULL, size + mm->hugepage_size, 0, mm->executable);
+    if (!ptr)
+	return NULL;
+
+    seg = (char *) ((((UWord) ptr) + inv_mask) & ~inv_mask);
+    sz = (UWord) (seg - ptr);
+    if (sz)
+	os_munmap(ptr, sz);
+    sz = mm->hugepage_size - sz;
+    if (sz)
+	os_munmap(seg + size, sz);
+
+#ifdef MADV_HUGEPAGE
+    (void) madvise(seg, size, MADV_HUGEPAGE);
+#endif
+    return seg;
+}
+
+#endif /* HAVE_MMAP && (MAP_HUGETLB || MADV_HUGEPAGE) */
+
 #ifdef ERTS_HAVE_OS_PHYSICAL_MEMORY_RESERVATION
 #if HAVE_MMAP
 
@@ -1357,6 +1435,21 @@ os_reserve_physical(char *ptr, UWord size, int exec)
     return 1;
 }
 
+#ifdef MADV_HUGEPAGE
+/*
+ * Reserving physical memory replaces the mapping, so the advice
+ * has to be given again each time.
+ */
+static int
+os_reserve_physical_hugepages(char *ptr, UWord size, int exec)
+{
+    if (!os_reserve_physical(ptr, size, exec))
+	return 0;
+    (void) madvise(ptr, size, MADV_HUGEPAGE);
+    return 1;
+}
+#endif
+
 static void
 os_unreserve_physical(char *ptr, UWord size)
 {
@@ -1673,6 +1766,15 @@ erts_mmap(ErtsMemMapper* mm, Uint32 flags, UWord *sizep)
 	}
 	else {
 	    asize = ERTS_SUPERALIGNED_CEILING(*sizep);
+#ifdef ERTS_HAVE_OS_HUGEPAGES
+	    if (mm->hugepages
+		&& (asize & (mm->hugepage_size - 1)) == 0) {
+		seg = os_mmap_hugepages(mm, asize);
+		if (!seg)
+		    goto failure;
+		goto os_success;
+	    }
+#endif
 	    seg = os_mmap(NULL, asize, 1, mm->executable);
 	    if (!seg)
 		goto failure;
@@ -1699,6 +1801,9 @@ erts_mmap(ErtsMemMapper* mm, Uint32 flags, UWord *sizep)
 	    }
 	}
 
+#ifdef ERTS_HAVE_OS_HUGEPAGES
+    os_success:
+#endif
 	ERTS_MMAP_OP_LCK(seg, *sizep, asize);
 	ERTS_MMAP_SIZE_OS_INC(asize);
 	*sizep = asize;
@@ -2108,6 +2213,53 @@ int erts_mmap_in_supercarrier(ErtsMemMapper* mm, void *ptr)
     return ERTS_MMAP_IN_SUPERCARRIER(ptr);
 }
 
+#ifdef ERTS_HAVE_MEM_DISCARD
+/*
+ * Give the physical memory of a page aligned range back to the OS
+ * while keeping the range mapped. The pages read as zero the next
+ * time they are touched.
+ */
+void erts_mem_discard(char *ptr, UWord size)
+{
+    int res;
+    ERTS_MMAP_ASSERT(ERTS_IS_PAGEALIGNED(ptr));
+    ERTS_MMAP_ASSERT(ERTS_IS_PAGEALIGNED(size));
+    res = madvise(ptr, size, MADV_DONTNEED);
+    ERTS_MMAP_ASSERT(res == 0);
+    (void) res;
+}
+
+/*
+ * The unit, in size and alignment, in which memory mapped by 'mm' is
+ * to be discarded, or zero if it cannot be discarded. Discarding part
+ * of a transparent huge page splits it into normal pages, and explicit
+ * huge pages cannot be discarded at all on many kernels (EINVAL).
+ * Since we fall back on transparent huge pages when the pool of
+ * explicit ones is exhausted, we do not know which kind a segment got.
+ */
+UWord erts_mem_discard_unit(ErtsMemMapper* mm)
+{
+    switch (mm->hugepages) {
+    case ERTS_MMAP_HP_EXPLICIT:
+	return 0;
+    case ERTS_MMAP_HP_TRANSPARENT:
+	return mm->hugepage_size;
+    default:
+	return ERTS_PAGEALIGNED_SIZE;
+    }
+}
+#endif
+
+/*
+ * Size of the huge pages used for super aligned segments, or zero
+ * if huge pages are not used. Super aligned segments of a multiple
+ * of this size are mapped with huge pages.
+ */
+UWord erts_mmap_hugepage_size(ErtsMemMapper* mm)
+{
+    return mm->hugepages ? mm->hugepage_size : 0;
+}
+
 static struct {
     Eterm options;
     Eterm total;
@@ -2127,6 +2279,10 @@ static struct {
     Eterm sco;
     Eterm scrpm;
     Eterm scrfsd;
+    Eterm hp;
+    Eterm none;
+    Eterm transparent;
+    Eterm explicit;
 
     int is_initialized;
     erts_mtx_t init_mutex;
@@ -2161,6 +2317,10 @@ static void init_atoms(void)
         AM_INIT(sco);
         AM_INIT(scrpm);
         AM_INIT(scrfsd);
+        AM_INIT(hp);
+        AM_INIT(none);
+        AM_INIT(transparent);
+        AM_INIT(explicit);
         am.is_initialized = 1;
     }
     erts_mtx_unlock(&am.init_mutex);
@@ -2206,6 +2366,23 @@ erts_mmap_init(ErtsMemMapper* mm, ErtsMMapInit *init, int executable)
     mm->unreserve_physical = unreserve_noop;
     mm->executable = executable;
 
+    mm->hugepages = ERTS_MMAP_HP_NONE;
+    mm->hugepage_size = 0;
+#ifdef ERTS_HAVE_OS_HUGEPAGES
+    if (init->hp != ERTS_MMAP_HP_NONE) {
+	UWord hpsz = os_hugepage_size();
+	/* Huge pages need to fit the alignment of super aligned carriers */
+	if ((hpsz & (hpsz - 1)) == 0 && hpsz >= ERTS_SUPERALIGNED_SIZE) {
+#ifdef MAP_HUGETLB
+	    mm->hugepages = init->hp;
+#else
+	    mm->hugepages = ERTS_MMAP_HP_TRANSPARENT;
+#endif
+	    mm->hugepage_size = hpsz;
+	}
+    }
+#endif
+
 #if HAVE_MMAP && !defined(MAP_ANON)
     mm->mmap_fd = open("/dev/zero", O_RDWR);
     if (mm->mmap_fd < 0)
@@ -2251,6 +2428,10 @@ erts_mmap_init(ErtsMemMapper* mm, ErtsMMapInit *init, int executable)
 	if (!init->scrpm) {
 	    start = os_mmap_virtual(NULL, sz, executable);
 	    mm->reserve_physical = os_reserve_physical;
+#ifdef MADV_HUGEPAGE
+	    if (mm->hugepages)
+		mm->reserve_physical = os_reserve_physical_hugepages;
+#endif
 	    mm->unreserve_physical = os_unreserve_physical;
 	    virtual_map = 1;
 	}
@@ -2261,7 +2442,15 @@ erts_mmap_init(ErtsMemMapper* mm, ErtsMMapInit *init, int executable)
 	     * The whole supercarrier will by physically
 	     * reserved all the time.
 	     */
-	    start = os_mmap(NULL, sz, 1, executable);
+#ifdef ERTS_HAVE_OS_HUGEPAGES
+	    if (mm->hugepages) {
+		sz = ((sz + mm->hugepage_size - 1)
+		      & ~(mm->hugepage_size - 1));
+		start = os_mmap_hugepages(mm, sz);
+	    }
+	    else
+#endif
+		start = os_mmap(NULL, sz, 1, executable);
 	}
 	if (!start)
 	    erts_exit(1,
@@ -2493,6 +2682,11 @@ Eterm erts_mmap_info_options(ErtsMemMapper* mm,
     const UWord scs = mm->sua.top - mm->sa.bot;
     const Eterm sco = mm->no_os_mmap ? am_true : am_false;
     const Eterm scrpm = (mm->reserve_physical == reserve_noop) ? am_true : am_false;
+    const char *hp_str = (mm->hugepages == ERTS_MMAP_HP_EXPLICIT
+			  ? "explicit"
+			  : (mm->hugepages == ERTS_MMAP_HP_TRANSPARENT
+			     ? "transparent"
+			     : "none"));
     Eterm res = THE_NON_VALUE;
 
     if (print_to_p) {
@@ -2504,6 +2698,7 @@ Eterm erts_mmap_info_options(ErtsMemMapper* mm,
             erts_print(to, arg, "%sscrpm: %T\n", prefix, scrpm);
             erts_print(to, arg, "%sscrfsd: %beu\n", prefix, mm->desc.reserved);
         }
+        erts_print(to, arg, "%shp: %s\n", prefix, hp_str);
     }
 
     if (hpp || szp) {
@@ -2512,6 +2707,12 @@ Eterm erts_mmap_info_options(ErtsMemMapper* mm,
         }
 
         res = NIL;
+        add_2tup(hpp, szp, &res, am.hp,
+                 (mm->hugepages == ERTS_MMAP_HP_EXPLICIT
+                  ? am.explicit
+                  : (mm->hugepages == ERTS_MMAP_HP_TRANSPARENT
+                     ? am.transparent
+                     : am.none)));
         if (mm->supercarrier) {
             add_2tup(hpp, szp, &res, am.scrfsd,
                      erts_bld_uint(hpp,szp, mm->desc.reserved));
@@ -69,6 +69,10 @@
 
 extern UWord erts_page_inv_mask;
 
+#define ERTS_MMAP_HP_NONE		0
+#define ERTS_MMAP_HP_TRANSPARENT	1
+#define ERTS_MMAP_HP_EXPLICIT		2
+
 typedef struct {
     struct {
 	char *start;
@@ -82,20 +86,23 @@ typedef struct {
     int sco;    /* super carrier only? */
     UWord scrfsd; /* super carrier reserved free segment descriptors */
     int scrpm; /* super carrier reserve physical memory */
+    int hp;    /* huge pages (ERTS_MMAP_HP_*) */
 }ErtsMMapInit;
 
 #define ERTS_MMAP_INIT_DEFAULT_INITER \
-    {{NULL, NULL}, {NULL, NULL}, 0, 1, (1 << 16), 1}
+    {{NULL, NULL}, {NULL, NULL}, 0, 1, (1 << 16), 1, ERTS_MMAP_HP_NONE}
 
 #define ERTS_LITERAL_VIRTUAL_AREA_SIZE (UWORD_CONSTANT(1)*1024*1024*1024)
 
 #define ERTS_MMAP_INIT_LITERAL_INITER \
-    {{NULL, NULL}, {NULL, NULL}, ERTS_LITERAL_VIRTUAL_AREA_SIZE, 1, (1 << 10), 0}
+    {{NULL, NULL}, {NULL, NULL}, ERTS_LITERAL_VIRTUAL_AREA_SIZE, 1, (1 << 10), 0, \
+     ERTS_MMAP_HP_NONE}
 
 #define ERTS_HIPE_EXEC_VIRTUAL_AREA_SIZE (UWORD_CONSTANT(512)*1024*1024)
 
 #define ERTS_MMAP_INIT_HIPE_EXEC_INITER \
-    {{NULL, NULL}, {NULL, NULL}, ERTS_HIPE_EXEC_VIRTUAL_AREA_SIZE, 1, (1 << 10), 0}
+    {{NULL, NULL}, {NULL, NULL}, ERTS_HIPE_EXEC_VIRTUAL_AREA_SIZE, 1, (1 << 10), 0, \
+     ERTS_MMAP_HP_NONE}
 
 
 #define ERTS_SUPERALIGNED_SIZE \
@@ -140,6 +147,13 @@ void erts_munmap(ErtsMemMapper*, Uint32 flags, void *ptr, UWord size);
 void *erts_mremap(ErtsMemMapper*, Uint32 flags, void *ptr, UWord old_size, UWord *sizep);
 int erts_mmap_in_supercarrier(ErtsMemMapper*, void *ptr);
 void erts_mmap_init(ErtsMemMapper*, ErtsMMapInit*, int executable);
+UWord erts_mmap_hugepage_size(ErtsMemMapper*);
+
+#if defined(MADV_DONTNEED)
+#  define ERTS_HAVE_MEM_DISCARD 1
+void erts_mem_discard(char *ptr, UWord size);
+UWord erts_mem_discard_unit(ErtsMemMapper*);
+#endif
 struct erts_mmap_info_struct
 {
     UWord sizes[6];
@@ -100,6 +100,36 @@ static const int debruijn[32] = {
 
 static int atoms_initialized;
 
+/*
+ * Huge page size when huge pages are enabled, otherwise zero. Super
+ * aligned (multiblock carrier) segments of at least this size are
+ * mapped with huge pages by erts_mmap(), and are therefore never cut
+ * down below it; with explicit huge pages munmap() of part of a huge
+ * page fails.
+ */
+static UWord hugepage_seg_size;
+
+#define MSEG_IS_HUGEPAGE_SEG(SZ) \
+    (hugepage_seg_size && (SZ) >= hugepage_seg_size)
+
+/*
+ * Total size of all segments currently mapped by all mseg allocator
+ * instances, including cached segments. When it exceeds
+ * 'mapped_size_limit' freed segments are not cached, and cached
+ * segments are destroyed, so that the memory of carriers that have
+ * become empty is given back to the OS.
+ */
+static erts_atomic_t mapped_size;
+static UWord mapped_size_limit;
+
+#define MSEG_MAPPED_SIZE_INC(SZ) \
+    ((void) erts_atomic_add_nob(&mapped_size, (erts_aint_t) (SZ)))
+#define MSEG_MAPPED_SIZE_DEC(SZ) \
+    ((void) erts_atomic_add_nob(&mapped_size, -((erts_aint_t) (SZ))))
+#define MSEG_IS_OVER_SIZE_LIMIT() \
+    (mapped_size_limit \
+     && ((UWord) erts_atomic_read_nob(&mapped_size)) > mapped_size_limit)
+
 const ErtsMsegOpt_t erts_mseg_default_opt = {
     1,			/* Use cache		     */
     1,			/* Preserv data		     */
@@ -293,6 +323,8 @@ mseg_create(ErtsMsegAllctr_t *ma, Uint flags, UWord *sizep)
 	mmap_flags |= ERTS_MMAPFLG_SUPERALIGNED;
 
     seg = erts_mmap(&erts_dflt_mmapper, mmap_flags, sizep);
+    if (seg)
+	MSEG_MAPPED_SIZE_INC(*sizep);
 
 #ifdef ERTS_PRINT_ERTS_MMAP
     erts_fprintf(stderr, "%p = erts_mmap(%s, {%bpu, %bpu});\n", seg,
@@ -313,6 +345,7 @@ mseg_destroy(ErtsMsegAllctr_t *ma, Uint flags, void *seg_p, UWord size) {
 	 mmap_flags |= ERTS_MMAPFLG_SUPERALIGNED;
 
     erts_munmap(&erts_dflt_mmapper, mmap_flags, seg_p, size);
+    MSEG_MAPPED_SIZE_DEC(size);
 #ifdef ERTS_PRINT_ERTS_MMAP
     erts_fprintf(stderr, "erts_munmap(%s, %p, %bpu);\n",
 		 (mmap_flags & ERTS_MMAPFLG_SUPERALIGNED) ? "sa" : "sua",
@@ -334,6 +367,10 @@ mseg_recreate(ErtsMsegAllctr_t *ma, Uint flags, void *old_seg, UWord old_size, U
 	mmap_flags |= ERTS_MMAPFLG_SUPERALIGNED;
 
     new_seg = erts_mremap(&erts_dflt_mmapper, mmap_flags, old_seg, old_size, sizep);
+    if (new_seg) {
+	MSEG_MAPPED_SIZE_DEC(old_size);
+	MSEG_MAPPED_SIZE_INC(*sizep);
+    }
 
 #ifdef ERTS_PRINT_ERTS_MMAP
     erts_fprintf(stderr, "%p = erts_mremap(%s, %p, %bpu, {%bpu, %bpu});\n",
@@ -477,6 +514,8 @@ static ERTS_INLINE void *cache_get_segment(ErtsMsegAllctr_t *ma, UWord *size_p,
 		continue;
 
 	    c = erts_circleq_head(&(ma->cache_powered_node[i]));
+	    if (MSEG_IS_HUGEPAGE_SEG(c->size) && !MSEG_IS_HUGEPAGE_SEG(size))
+		break;
 	    erts_circleq_remove(c);
 
 	    ASSERT(IS_2POW(c->size));
@@ -640,12 +679,16 @@ static Uint mseg_check_cache(ErtsMsegAllctr_t *ma) {
  * - Check if we have some cache we can purge
  */
 
+static void mseg_drop_all_cache(ErtsMsegAllctr_t *ma);
+
 static void mseg_cache_check(ErtsMsegAllctr_t *ma) {
     Uint empty_cache = 1;
 
     ERTS_MSEG_LOCK(ma);
 
-    if (mseg_check_cache(ma))
+    if (MSEG_IS_OVER_SIZE_LIMIT())
+	mseg_drop_all_cache(ma);
+    else if (mseg_check_cache(ma))
         empty_cache = 0;
 
     /* If all MemKinds caches are empty,
@@ -679,9 +722,9 @@ void erts_mseg_cache_check(void) {
  */
 
 
-static void mseg_clear_cache(ErtsMsegAllctr_t *ma) {
+static void mseg_drop_all_cache(ErtsMsegAllctr_t *ma) {
     int i;
-    ERTS_MSEG_LOCK(ma);
+
     ERTS_DBG_MA_CHK_THR_ACCESS(ma);
 
     /* drop pow2 caches */
@@ -698,7 +741,11 @@ static void mseg_clear_cache(ErtsMsegAllctr_t *ma) {
 
     ASSERT(erts_circleq_is_empty(&(ma->cache_unpowered_node)));
     ASSERT(ma->cache_size == 0);
+}
 
+static void mseg_clear_cache(ErtsMsegAllctr_t *ma) {
+    ERTS_MSEG_LOCK(ma);
+    mseg_drop_all_cache(ma);
     INC_CC(ma, clear_cache);
     ERTS_MSEG_UNLOCK(ma);
 }
@@ -753,9 +800,15 @@ mseg_dealloc(ErtsMsegAllctr_t *ma, ErtsAlcType_t atype, void *seg, UWord size,
 {
     ERTS_MSEG_DEALLOC_STAT(ma,size);
 
-    if (opt->cache && cache_bless_segment(ma, seg, size, flags)) {
-	schedule_cache_check(ma);
-	goto done;
+    if (opt->cache) {
+	if (!MSEG_IS_OVER_SIZE_LIMIT()) {
+	    if (cache_bless_segment(ma, seg, size, flags)) {
+		schedule_cache_check(ma);
+		goto done;
+	    }
+	}
+	else if (ma->cache_size > 0)
+	    mseg_drop_all_cache(ma);
     }
 
     if (erts_mtrace_enabled)
@@ -816,7 +869,13 @@ mseg_realloc(ErtsMsegAllctr_t *ma, ErtsAlcType_t atype, void *seg,
 	}
     }
     else if (new_size < old_size) {
-	UWord shrink_sz = old_size - new_size;
+	UWord shrink_sz;
+
+	if (MSEG_FLG_IS_2POW(flags)
+	    && MSEG_IS_HUGEPAGE_SEG(old_size)
+	    && !MSEG_IS_HUGEPAGE_SEG(new_size))
+	    new_size = hugepage_seg_size;
+	shrink_sz = old_size - new_size;
 
 	/* +M<S>rsbcst <ratio> */
 	if (shrink_sz < opt->abs_shrink_th
@@ -852,6 +911,7 @@ static struct {
     Eterm amcbf;
     Eterm rmcbf;
     Eterm mcs;
+    Eterm msl;
 
     Eterm memkind;
     Eterm name;
@@ -908,6 +968,7 @@ init_atoms(ErtsMsegAllctr_t *ma)
 	AM_INIT(amcbf);
 	AM_INIT(rmcbf);
 	AM_INIT(mcs);
+	AM_INIT(msl);
 
 	AM_INIT(status);
 	AM_INIT(cached_segments);
@@ -1004,6 +1065,7 @@ info_options(ErtsMsegAllctr_t *ma,
 	erts_print(to, arg, "%samcbf: %beu\n", prefix, ma->abs_max_cache_bad_fit);
 	erts_print(to, arg, "%srmcbf: %beu\n", prefix, ma->rel_max_cache_bad_fit);
 	erts_print(to, arg, "%smcs: %beu\n", prefix, ma->max_cache_size);
+	erts_print(to, arg, "%smsl: %bpu\n", prefix, mapped_size_limit);
     }
 
     if (hpp || szp) {
@@ -1011,6 +1073,9 @@ info_options(ErtsMsegAllctr_t *ma,
 	if (!atoms_initialized)
 	    init_atoms(ma);
 
+	add_2tup(hpp, szp, &res,
+		 am.msl,
+		 bld_uint(hpp, szp, mapped_size_limit));
 	add_2tup(hpp, szp, &res,
 		 am.mcs,
 		 bld_uint(hpp, szp, ma->max_cache_size));
@@ -1356,6 +1421,15 @@ erts_mseg_unit_size(void)
     return MSEG_ALIGNED_SIZE;
 }
 
+#ifdef ERTS_HAVE_MEM_DISCARD
+/* See erts_mem_discard_unit() */
+UWord
+erts_mseg_discard_unit(void)
+{
+    return erts_mem_discard_unit(&erts_dflt_mmapper);
+}
+#endif
+
 
 static void mem_cache_init(ErtsMsegAllctr_t *ma)
 {
@@ -1425,6 +1499,11 @@ erts_mseg_init(ErtsMsegInit_t *init)
     erts_mmap_init(&erts_literal_mmapper, &init->literal_mmap, 0);
 #endif
 
+    hugepage_seg_size = erts_mmap_hugepage_size(&erts_dflt_mmapper);
+
+    erts_atomic_init_nob(&mapped_size, 0);
+    mapped_size_limit = init->msl;
+
     if (!IS_2POW(GET_PAGE_SIZE))
 	erts_exit(ERTS_ABORT_EXIT, "erts_mseg: Unexpected page_size %beu\n", GET_PAGE_SIZE);
 
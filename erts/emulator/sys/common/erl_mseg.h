@@ -59,6 +59,7 @@ typedef struct {
     Uint rmcbf;
     Uint mcs;
     Uint nos;
+    UWord msl;
     ErtsMMapInit dflt_mmap;
     ErtsMMapInit literal_mmap;
     ErtsMMapInit exec_mmap;
@@ -70,6 +71,7 @@ typedef struct {
     20,			/* rmcbf: Relative max cache bad fit	*/	\
     10,			/* mcs:   Max cache size		*/	\
     1000,		/* cci:   Cache check interval		*/	\
+    0,			/* msl:   Mapped size limit		*/	\
     ERTS_MMAP_INIT_DEFAULT_INITER,					\
     ERTS_MMAP_INIT_LITERAL_INITER,                                      \
     ERTS_MMAP_INIT_HIPE_EXEC_INITER                                     \
@@ -95,6 +97,9 @@ void  erts_mseg_clear_cache(void);
 void  erts_mseg_cache_check(void);
 Uint  erts_mseg_no( const ErtsMsegOpt_t *);
 Uint  erts_mseg_unit_size(void);
+#ifdef ERTS_HAVE_MEM_DISCARD
+UWord erts_mseg_discard_unit(void);
+#endif
 void  erts_mseg_init(ErtsMsegInit_t *init);
 void  erts_mseg_late_init(void); /* Have to be called after all allocators,
 				   threads and timers have been initialized. */
@@ -2239,6 +2239,29 @@ get_timeout_itimerspec(ErtsPollSet ps,
 
 #endif
 
+/*
+ * Only managed threads (schedulers) take part in thread progress.
+ * The poll threads polling the extra pollsets (+IOp) are unmanaged
+ * and block without telling thread progress about it.
+ */
+static ERTS_INLINE void
+poll_prepare_wait(void)
+{
+#ifdef ERTS_SMP
+    if (erts_thr_progress_is_managed_thread())
+	erts_thr_progress_prepare_wait(NULL);
+#endif
+}
+
+static ERTS_INLINE void
+poll_finalize_wait(void)
+{
+#ifdef ERTS_SMP
+    if (erts_thr_progress_is_managed_thread())
+	erts_thr_progress_finalize_wait(NULL);
+#endif
+}
+
 static ERTS_INLINE int
 check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 {
@@ -2262,9 +2285,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
                 struct itimerspec its;
                 timeout = get_timeout_itimerspec(ps, &its, timeout_time);
                 if (timeout) {
-#ifdef ERTS_SMP
-                    erts_thr_progress_prepare_wait(NULL);
-#endif
+                    poll_prepare_wait();
                     ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
                     timerfd_set(ps, &its);
                     res = epoll_wait(ps->kp_fd, ps->res_events, max_res, -1);
@@ -2276,9 +2297,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 #else /* !ERTS_POLL_USE_TIMERFD */
 	    timeout = (int) get_timeout(ps, 1000, timeout_time);
             if (timeout) {
-#ifdef ERTS_SMP
-		erts_thr_progress_prepare_wait(NULL);
-#endif
+		poll_prepare_wait();
                 ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
             }
 	    res = epoll_wait(ps->kp_fd, ps->res_events, max_res, timeout);
@@ -2289,9 +2308,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 		grow_res_events(ps, max_res);
 	    timeout = get_timeout_timespec(ps, &ts, timeout_time);
             if (timeout) {
-#ifdef ERTS_SMP
-		erts_thr_progress_prepare_wait(NULL);
-#endif
+		poll_prepare_wait();
 		ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
             }
 	    res = kevent(ps->kp_fd, NULL, 0, ps->res_events, max_res, &ts);
@@ -2318,9 +2335,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 		grow_res_events(ps, poll_res.dp_nfds);
 	    poll_res.dp_fds = ps->res_events;
 	    if (timeout) {
-#ifdef ERTS_SMP
-		erts_thr_progress_prepare_wait(NULL);
-#endif
+		poll_prepare_wait();
                 ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
             }
 	    poll_res.dp_timeout = timeout;
@@ -2329,9 +2344,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
             struct timespec ts;
 	    timeout = get_timeout_timespec(ps, &ts, timeout_time);
             if (timeout) {
-#ifdef ERTS_SMP
-		erts_thr_progress_prepare_wait(NULL);
-#endif
+		poll_prepare_wait();
 		ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
             }
             res = ppoll(ps->poll_fds, ps->no_poll_fds, &ts, NULL);
@@ -2339,9 +2352,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 	    timeout = (int) get_timeout(ps, 1000, timeout_time);
 
 	    if (timeout) {
-#ifdef ERTS_SMP
-		erts_thr_progress_prepare_wait(NULL);
-#endif
+		poll_prepare_wait();
 		ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
             }
 	    res = poll(ps->poll_fds, ps->no_poll_fds, timeout);
@@ -2353,9 +2364,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 	    ERTS_FD_COPY(&ps->output_fds, &ps->res_output_fds);
 
 	    if (timeout) {
-#ifdef ERTS_SMP
-		erts_thr_progress_prepare_wait(NULL);
-#endif
+		poll_prepare_wait();
 		ERTS_MSACC_SET_STATE_CACHED_M(ERTS_MSACC_STATE_SLEEP);
 	    }
 	    res = ERTS_SELECT(ps->max_fd + 1,
@@ -2365,7 +2374,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 			      &to);
 #ifdef ERTS_SMP
 	    if (timeout) {
-		erts_thr_progress_finalize_wait(NULL);
+		poll_finalize_wait();
 		ERTS_MSACC_POP_STATE_M();
 	    }
 	    if (res < 0
@@ -2403,9 +2412,7 @@ check_fd_events(ErtsPollSet ps, ErtsMonotonicTime timeout_time, int max_res)
 #endif				/* ----------------------------------------- */
 	}
 	if (timeout) {
-#ifdef ERTS_SMP
-	    erts_thr_progress_finalize_wait(NULL);
-#endif
+	    poll_finalize_wait();
 	    ERTS_MSACC_POP_STATE_M();
 	}
 	return res;
@@ -53,6 +53,13 @@
  */
 erts_smp_atomic_t erts_check_io_time;
 
+/*
+ * Number of pollsets used by erl_check_io, set by the +IOp flag before
+ * erl_check_io is initialized. File descriptors are spread over the
+ * pollsets by erts_check_io_pollset_ix().
+ */
+int erts_no_pollsets = 1;
+
 /* Written once and only once */
 
 static int filename_encoding = ERL_FILENAME_UNKNOWN;
@@ -168,6 +168,7 @@ struct {
     void (*check_io_interrupt)(int);
     void (*check_io_interrupt_tmd)(int, ErtsMonotonicTime);
     void (*check_io)(int);
+    void (*late_init)(void);
     Uint (*size)(void);
     Eterm (*info)(void *);
     int (*check_io_debug)(ErtsCheckIoDebugInfo *);
@@ -197,6 +198,12 @@ erts_check_io_debug(ErtsCheckIoDebugInfo *ip)
     return (*io_func.check_io_debug)(ip);
 }
 
+void
+erts_late_init_check_io(void)
+{
+    (*io_func.late_init)();
+}
+
 
 static void
 init_check_io(void)
@@ -210,6 +217,7 @@ init_check_io(void)
 	io_func.check_io_interrupt	= erts_check_io_interrupt_kp;
 	io_func.check_io_interrupt_tmd	= erts_check_io_interrupt_timed_kp;
 	io_func.check_io		= erts_check_io_kp;
+	io_func.late_init		= erts_late_init_check_io_kp;
 	io_func.size			= erts_check_io_size_kp;
 	io_func.info			= erts_check_io_info_kp;
 	io_func.check_io_debug		= erts_check_io_debug_kp;
@@ -225,6 +233,7 @@ init_check_io(void)
 	io_func.check_io_interrupt	= erts_check_io_interrupt_nkp;
 	io_func.check_io_interrupt_tmd	= erts_check_io_interrupt_timed_nkp;
 	io_func.check_io		= erts_check_io_nkp;
+	io_func.late_init		= erts_late_init_check_io_nkp;
 	io_func.size			= erts_check_io_size_nkp;
 	io_func.info			= erts_check_io_info_nkp;
 	io_func.check_io_debug		= erts_check_io_debug_nkp;
@@ -184,6 +184,8 @@ erl_sys_late_init(void)
 
     sys_signal(SIGPIPE, SIG_IGN); /* Ignore - we'll handle the write failure */
 
+    erts_late_init_check_io(); /* Start poll threads */
+
     opts.packet_bytes = 0;
     opts.use_stdio = 1;
     opts.redir_stderr = 0;
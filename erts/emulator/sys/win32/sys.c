@@ -3274,7 +3274,7 @@ void erl_sys_init(void)
 void
 erl_sys_late_init(void)
 {
-    /* do nothing */
+    erts_late_init_check_io();
 }
 
 void
@@ -30,8 +30,12 @@
 	 rbtree/1,
 	 mseg_clear_cache/1,
 	 erts_mmap/1,
+	 erts_mmap_hugepages/1,
 	 cpool/1,
-	 migration/1]).
+	 migration/1,
+	 block_cache/1,
+	 pooled_carrier_discard/1,
+	 alloc_profile/1]).
 
 -include_lib("common_test/include/ct.hrl").
 
@@ -41,7 +45,8 @@ suite() ->
 
 all() -> 
     [basic, coalesce, threads, realloc_copy, bucket_index,
-     bucket_mask, rbtree, mseg_clear_cache, erts_mmap, cpool, migration].
+     bucket_mask, rbtree, mseg_clear_cache, erts_mmap, erts_mmap_hugepages, cpool, migration,
+     block_cache, pooled_carrier_discard, alloc_profile].
 
 init_per_testcase(Case, Config) when is_list(Config) ->
     [{testcase, Case},{debug,false}|Config].
@@ -72,6 +77,136 @@ migration(Cfg) ->
 	    {skipped, "No smp"}
     end.
 
+%% Check that small blocks freed and allocated again by the same
+%% scheduler are served by the block cache of binary_alloc.
+block_cache(Config) when is_list(Config) ->
+    case block_cache_stats(binary_alloc) of
+	false ->
+	    {skipped, "No block cache"};
+	{_, _, Hits0, _} ->
+	    {Pid, Mon} = spawn_monitor(fun () -> churn_binaries(100000) end),
+	    receive {'DOWN', Mon, process, Pid, normal} -> ok end,
+	    {_, _, Hits1, Misses1} = block_cache_stats(binary_alloc),
+	    io:format("Hits: ~p Misses: ~p~n", [Hits1, Misses1]),
+	    true = Hits1 - Hits0 > 50000,
+	    {_,_,_,As} = erlang:system_info(allocator),
+	    {binary_alloc, Opts} = lists:keyfind(binary_alloc, 1, As),
+	    {bcs, Bcs} = lists:keyfind(bcs, 1, Opts),
+	    true = Bcs > 0,
+	    ok
+    end.
+
+churn_binaries(0) ->
+    ok;
+churn_binaries(N) ->
+    _ = binary:copy(<<N:800>>),
+    churn_binaries(N-1).
+
+build_binaries(0, Sz) ->
+    Sz;
+build_binaries(N, Sz) ->
+    Bin = <<N:8000>>,
+    build_binaries(N-1, Sz + byte_size(Bin)).
+
+block_cache_stats(Alloc) ->
+    Stats = [BC || {instance, _, Info} <- erlang:system_info({allocator, Alloc}),
+		   {block_cache, BC} <- Info],
+    case Stats of
+	[] ->
+	    false;
+	_ ->
+	    lists:foldl(fun (BC, {B, S, H, M}) ->
+				{blocks, B1} = lists:keyfind(blocks, 1, BC),
+				{blocks_size, S1} = lists:keyfind(blocks_size, 1, BC),
+				{hits, HG, H1} = lists:keyfind(hits, 1, BC),
+				{misses, MG, M1} = lists:keyfind(misses, 1, BC),
+				{B+B1, S+S1,
+				 H+HG*1000000000+H1,
+				 M+MG*1000000000+M1}
+			end, {0, 0, 0, 0}, Stats)
+    end.
+
+%% Check that the memory of free blocks in abandoned carriers is
+%% given back to the OS.
+pooled_carrier_discard(Config) when is_list(Config) ->
+    Acul = lists:max([0 | [A || {instance, _, Info}
+				    <- erlang:system_info({allocator,
+							   binary_alloc}),
+				{options, Opts} <- Info,
+				{acul, A} <- Opts]]),
+    case os:type() of
+	{unix,linux} when Acul > 0 ->
+	    Rss0 = vm_rss(),
+	    Parent = self(),
+	    Ps = [spawn_link(fun () -> sparse_binaries(Parent) end)
+		  || _ <- lists:seq(1, erlang:system_info(schedulers))],
+	    [receive {filled, P} -> ok end || P <- Ps],
+	    Rss1 = vm_rss(),
+	    [P ! shrink || P <- Ps],
+	    [receive {shrunk, P} -> ok end || P <- Ps],
+	    Rss2 = vm_rss(),
+	    io:format("RSS before: ~p kB, peak: ~p kB, after: ~p kB~n",
+		      [Rss0, Rss1, Rss2]),
+	    [P ! stop || P <- Ps],
+	    true = Rss1 - Rss2 > (Rss1 - Rss0) div 2,
+	    ok;
+	_ ->
+	    {skipped, "Not supported"}
+    end.
+
+sparse_binaries(Parent) ->
+    Bins = [binary:copy(<<I:64>>, 1000) || I <- lists:seq(1, 10000)],
+    Parent ! {filled, self()},
+    receive shrink -> ok end,
+    Keep = [B || {I, B} <- lists:zip(lists:seq(1, 10000), Bins),
+		 I rem 50 =:= 0],
+    erlang:garbage_collect(),
+    Parent ! {shrunk, self()},
+    receive stop -> length(Keep) end.
+
+vm_rss() ->
+    Status = os:cmd("cat /proc/" ++ os:getpid() ++ "/status"),
+    [Kb] = [list_to_integer(V) || "VmRSS:" ++ Line <- string:tokens(Status, "\n"),
+				  [V, "kB"] <- [string:tokens(Line, " \t")]],
+    Kb.
+
+%% Check that the allocation profiler attributes binary allocations
+%% to the function making them, or to the BIF it calls.
+alloc_profile(Config) when is_list(Config) ->
+    Sites = [{?MODULE, churn_binaries, 1}, {binary, copy, 1}],
+    0 = erlang:system_flag(alloc_profile, 100),
+    {Pid, Mon} = spawn_monitor(fun () -> churn_binaries(100000) end),
+    receive {'DOWN', Mon, process, Pid, normal} -> ok end,
+    Prof = erlang:system_info(alloc_profile),
+    100 = erlang:system_flag(alloc_profile, 0),
+    [] = erlang:system_info(alloc_profile),
+    io:format("~p~n", [Prof]),
+    Bins = [{C, B} || {binary_alloc, _, Site, C, B} <- Prof,
+		      lists:member(Site, Sites)],
+    {Count, Bytes} = lists:foldl(fun ({C, B}, {AC, AB}) -> {AC+C, AB+B} end,
+				 {0, 0}, Bins),
+    true = Count >= 50000,
+    true = Bytes >= Count * 100,
+    %% Binaries built by the bit syntax should be attributed to the
+    %% function building them, not to where the process last called
+    %% a BIF or was scheduled in.
+    0 = erlang:system_flag(alloc_profile, 100),
+    {BPid, BMon} = spawn_monitor(fun () -> build_binaries(100000, 0) end),
+    receive {'DOWN', BMon, process, BPid, normal} -> ok end,
+    BProf = erlang:system_info(alloc_profile),
+    100 = erlang:system_flag(alloc_profile, 0),
+    io:format("~p~n", [BProf]),
+    BSite = {?MODULE, build_binaries, 2},
+    BCount = lists:sum([C || {binary_alloc, _, Site, C, _} <- BProf,
+			     Site =:= BSite]),
+    true = BCount >= 50000,
+    [] = [S || {binary_alloc, _, Site, C, B} = S <- BProf,
+	       Site =/= BSite, B div C >= 1000],
+    badarg = try erlang:system_flag(alloc_profile, -1)
+	     catch error:Reason -> Reason
+	     end,
+    ok.
+
 erts_mmap(Config) when is_list(Config) ->
     case {os:type(), mmsc_flags()} of
 	{{unix,_}, false} ->
@@ -85,6 +220,52 @@ erts_mmap(Config) when is_list(Config) ->
 				  | io_lib:format("~p",[SkipOs])])}
     end.
 
+%% Check that multiblock carriers can be mapped with huge pages, and
+%% that we fall back on normal pages when huge pages are unavailable.
+erts_mmap_hugepages(Config) when is_list(Config) ->
+    case os:type() of
+	{unix,_} ->
+	    [erts_mmap_hugepages_do(Config, HP) || HP <- [transparent,explicit]],
+	    ok;
+	{SkipOs,_} ->
+	    {skipped,
+		   lists:flatten(["Not run on "
+				  | io_lib:format("~p",[SkipOs])])}
+    end.
+
+erts_mmap_hugepages_do(Config, HP) ->
+    {ok, Node} = start_node(Config, "+MMhp " ++ atom_to_list(HP)),
+    Self = self(),
+    Ref = make_ref(),
+    F = fun() ->
+                SI = erlang:system_info({allocator,erts_mmap}),
+                {default_mmap,EM} = lists:keyfind(default_mmap, 1, SI),
+                {options,Opts} = lists:keyfind(options, 1, EM),
+                {hp,Used} = lists:keyfind(hp, 1, Opts),
+                io:format("Requested ~w huge pages, got ~w~n", [HP, Used]),
+                true = lists:member(Used, [HP,transparent,none]),
+
+                %% Fill a couple of multiblock carriers
+                Bins = [binary:copy(<<I:64>>, 16) || I <- lists:seq(1, 100000)],
+                100000 = length(Bins),
+
+                %% Free blocks of pooled carriers are discarded in whole
+                %% huge pages, or not at all with explicit huge pages.
+                Me = self(),
+                Ps = [spawn_link(fun () -> sparse_binaries(Me) end)
+                      || _ <- lists:seq(1, erlang:system_info(schedulers))],
+                [receive {filled, P} -> ok end || P <- Ps],
+                [P ! shrink || P <- Ps],
+                [receive {shrunk, P} -> ok end || P <- Ps],
+                [P ! stop || P <- Ps],
+                Self ! {Ref, ok}
+        end,
+
+    spawn_link(Node, F),
+    Result = receive {Ref, Rslt} -> Rslt end,
+    stop_node(Node),
+    Result.
+
 %% Check if there are ERL_FLAGS set that will mess up this test case
 mmsc_flags() ->
     case mmsc_flags("ERL_FLAGS") of
@@ -31,7 +31,7 @@
 	 t_list_to_existing_atom/1,os_env/1,otp_7526/1,
 	 binary_to_atom/1,binary_to_existing_atom/1,
 	 atom_to_binary/1,min_max/1, erlang_halt/1,
-	 is_builtin/1]).
+	 is_builtin/1, shared_term/1]).
 
 suite() ->
     [{ct_hooks,[ts_install_cth]},
@@ -43,7 +43,7 @@ all() ->
      t_list_to_existing_atom, os_env, otp_7526,
      display,
      atom_to_binary, binary_to_atom, binary_to_existing_atom,
-     min_max, erlang_halt, is_builtin].
+     min_max, erlang_halt, is_builtin, shared_term].
 
 %% Uses erlang:display to test that erts_printf does not do deep recursion
 display(Config) when is_list(Config) ->
@@ -702,6 +702,129 @@ is_builtin(_Config) ->
 
     ok.
 
+%% Test erlang:publish_shared/1 and erlang:shared_term/1.
+shared_term(Config) when is_list(Config) ->
+    a = erlang:shared_term(erlang:publish_shared(a)),
+    42 = erlang:shared_term(erlang:publish_shared(42)),
+    {'EXIT',{badarg,_}} = (catch erlang:shared_term(<<"handle">>)),
+    {'EXIT',{badarg,_}} = (catch erlang:shared_term(make_ref())),
+    {'EXIT',{badarg,_}} = (catch erlang:shared_term(re:compile("a"))),
+    {'EXIT',{badarg,_}} = (catch erlang:publish_shared({fun id/1})),
+
+    %% Sharing within the term is kept.
+    Shared = lists:seq(1, 1000),
+    SharedTerm = {Shared, [Shared, Shared], #{k => Shared}},
+    SharedSize = erts_debug:size(SharedTerm),
+    SharedHandle = erlang:publish_shared(SharedTerm),
+    SharedTerm = erlang:shared_term(SharedHandle),
+    true = erts_debug:size(erlang:shared_term(SharedHandle)) =< SharedSize,
+
+    %% A large term is copied without yielding, but is still copied in
+    %% full and its sharing kept.
+    Large = [{I, integer_to_list(I), Shared} || I <- lists:seq(1, 200000)],
+    LargeHandle = erlang:publish_shared(Large),
+    Large = erlang:shared_term(LargeHandle),
+    true = erts_debug:size(erlang:shared_term(LargeHandle))
+	=< erts_debug:size(Large),
+
+    %% Many small terms are released once all of them are gone.
+    Size0 = shared_terms_size(),
+    Smalls = [erlang:publish_shared({small, I, integer_to_list(I)})
+              || I <- lists:seq(1, 10000)],
+    {small, 4711, "4711"} = erlang:shared_term(lists:nth(4711, Smalls)),
+    true = shared_terms_size() > Size0 + 100000,
+    %% All but the area that small terms are currently put in.
+    erlang:garbage_collect(),
+    wait_for_shared_term_release(Size0 + 8*1024*erlang:system_info(wordsize)),
+
+    case erlang:system_info(shared_terms) of
+        reference -> shared_term_reference();
+        copy -> shared_term_copy()
+    end.
+
+%% The term is returned without being copied.
+shared_term_reference() ->
+    Bin = list_to_binary(lists:seq(0, 255)),
+    Term = {lists:seq(1, 100000), Bin, #{a => Bin}, "abc"},
+    TermBytes = erts_debug:size(Term)*erlang:system_info(wordsize),
+
+    %% The receiver gets the term itself without it being copied.
+    Self = self(),
+    {Pid,Mon} = spawn_monitor(
+		  fun() ->
+			  T = receive
+				  {handle, H} -> erlang:shared_term(H)
+			      end,
+			  erlang:garbage_collect(),
+			  {total_heap_size, HeapSz} =
+			      process_info(self(), total_heap_size),
+			  Self ! {got_term, HeapSz},
+			  receive check -> ok end,
+			  erlang:garbage_collect(),
+			  Self ! {still_got_term, T}
+		  end),
+    Lit0 = literal_blocks_size(),
+    publish_and_send(Term, Pid),
+    true = literal_blocks_size() - Lit0 >= TermBytes,
+    receive
+	{got_term, HeapSz} ->
+	    true = HeapSz*erlang:system_info(wordsize) < TermBytes
+    end,
+
+    %% When the last handle is gone the area is released, and the
+    %% receiver that still refers to the term gets a copy of it.
+    erlang:garbage_collect(),
+    wait_for_shared_term_release(Lit0 + TermBytes div 2),
+    Pid ! check,
+    receive
+	{still_got_term, T} ->
+	    Term = T
+    end,
+    receive {'DOWN',Mon,process,Pid,normal} -> ok end,
+    ok.
+
+%% Without a literal area collector the term is copied to the caller.
+shared_term_copy() ->
+    Term = {lists:seq(1, 100000), list_to_binary(lists:seq(0, 255))},
+    Handle = erlang:publish_shared(Term),
+    Term = erlang:shared_term(Handle),
+    false = erts_debug:same(erlang:shared_term(Handle),
+			    erlang:shared_term(Handle)),
+    ok.
+
+publish_and_send(Term, Pid) ->
+    Handle = erlang:publish_shared(Term),
+    Term = erlang:shared_term(Handle),
+    true = erts_debug:same(erlang:shared_term(Handle),
+			   erlang:shared_term(Handle)),
+    Pid ! {handle, Handle},
+    ok.
+
+wait_for_shared_term_release(Size) ->
+    case shared_terms_size() =< Size of
+	true ->
+	    ok;
+	false ->
+	    receive after 100 -> ok end,
+	    wait_for_shared_term_release(Size)
+    end.
+
+%% Shared terms are put in literal areas if they are returned by
+%% reference, otherwise in long lived memory.
+shared_terms_size() ->
+    case erlang:system_info(shared_terms) of
+	reference -> blocks_size(literal_alloc);
+	copy -> blocks_size(ll_alloc)
+    end.
+
+literal_blocks_size() ->
+    blocks_size(literal_alloc).
+
+blocks_size(Alloc) ->
+    lists:sum([element(2, lists:keyfind(blocks_size, 1, Cs)) ||
+		  {instance,_,Info} <- erlang:system_info({allocator,Alloc}),
+		  {Type,Cs} <- Info, Type =:= mbcs orelse Type =:= sbcs]).
+
 
 %% Helpers
     
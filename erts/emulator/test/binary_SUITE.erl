@@ -41,6 +41,7 @@
 %%
 
 -include_lib("common_test/include/ct.hrl").
+-include_lib("common_test/include/ct_event.hrl").
 
 -export([all/0, suite/0,groups/0,init_per_suite/1, end_per_suite/1, 
 	 init_per_group/2,end_per_group/2, 
@@ -59,7 +60,8 @@
 	 ordering/1,unaligned_order/1,gc_test/1,
 	 bit_sized_binary_sizes/1,
 	 otp_6817/1,deep/1,obsolete_funs/1,robustness/1,otp_8117/1,
-	 otp_8180/1, trapping/1, large/1,
+	 otp_8180/1, trapping/1, large/1, term_to_iovec/1,
+	 immediate_shapes/1, term_to_binary_bench/1,
 	 error_after_yield/1, cmp_old_impl/1]).
 
 %% Internal exports.
@@ -79,10 +81,10 @@ all() ->
      ordering, unaligned_order, gc_test,
      bit_sized_binary_sizes, otp_6817, otp_8117, deep,
      obsolete_funs, robustness, otp_8180, trapping, large,
-     error_after_yield, cmp_old_impl].
+     term_to_iovec, immediate_shapes, error_after_yield, cmp_old_impl].
 
 groups() -> 
-    [].
+    [{term_to_binary_bench, [{repeat,5}], [term_to_binary_bench]}].
 
 init_per_suite(Config) ->
     Config.
@@ -1403,6 +1405,175 @@ large(Config) when is_list(Config) ->
     BitStr2 = list_to_bitstring(bitstring_to_list(BitStr2)),
     ok.
 
+term_to_iovec(Config) when is_list(Config) ->
+    test_terms(fun term_to_iovec_test/1),
+    Big = binary:copy(<<"abc">>, 100000),
+    <<_:1/binary, Sub:20000/binary, _/binary>> = Big,
+    <<_:3, Unaligned:20000/binary, _/bitstring>> = Big,
+    W0 = binary:copy(<<"x">>, 2000),
+    Writable = <<W0/binary, "tail">>,
+    Terms = [Big, Sub, Unaligned, Writable,
+	     binary:copy(<<1>>, 1023), binary:copy(<<2>>, 1024),
+	     [Big, {Sub, Big}, #{Big => Sub}, <<Big/binary, 1:1>>],
+	     {lists:seq(1, 1000), Big, make_ref(), self(), Writable}],
+    lists:foreach(fun term_to_iovec_test/1, Terms),
+
+    %% Large binaries are referred to, not copied.
+    [<<131,109,0,4,147,224>>, Big] = erlang:term_to_iovec(Big),
+    [<<131,104,2,109,0,0,78,32>>, Sub, <<109,0,0,0,0>>] =
+	erlang:term_to_iovec({Sub, <<>>}),
+    [_] = erlang:term_to_iovec(Unaligned),
+    [_] = erlang:term_to_iovec(Big, [compressed]),
+    {'EXIT', {badarg, _}} = (catch erlang:term_to_iovec(Big, bad)),
+    {'EXIT', {badarg, _}} = (catch erlang:term_to_iovec(Big, [bad])),
+    ok.
+
+%% Lists, tuples and maps of immediates, which are encoded and
+%% decoded without going through the stacks of the general encoder
+%% and decoder, also when interrupted by the reduction budget.
+immediate_shapes(Config) when is_list(Config) ->
+    Ints = [0, 1, 255, 256, -1, -256, (1 bsl 31) - 1, 1 bsl 31,
+	    -(1 bsl 31), -(1 bsl 31) - 1, 1 bsl 40, -(1 bsl 40),
+	    (1 bsl 59) - 1, -(1 bsl 59), 1 bsl 59, 1 bsl 64],
+    Atoms = [a, abc, '', 'åäö', list_to_atom(lists:duplicate(255, $x))],
+    Imm = Ints ++ Atoms ++ [[]],
+    Terms = [Imm, list_to_tuple(Imm), maps:from_list([{X, X} || X <- Imm]),
+	     #{a => 1, b => [1,2], c => 3, 1.0 => x},
+	     [1,2,3|4], [1,2,3|a], [1,2,3.0,4,5], [1,{2},3,4|5],
+	     lists:seq(0, 255), lists:seq(250, 300),
+	     lists:seq(1, 4096), lists:seq(1, 4097),
+	     lists:duplicate(65534, 7), lists:duplicate(65535, 7),
+	     lists:duplicate(65534, 7) ++ [300], lists:seq(1, 70000),
+	     {1, 2.0, 3, a, [], {4, 5}, 6}, {}, #{},
+	     list_to_tuple(lists:seq(1, 300)),
+	     [{I, [I | I], #{I => I}} || I <- Imm]],
+    lists:foreach(
+      fun (Term) ->
+	      Bin = ext_encode(Term),
+	      lists:foreach(
+		fun (Reds) ->
+			set_reds(Reds),
+			Bin = term_to_binary(Term),
+			set_reds(Reds),
+			Term = binary_to_term(Bin)
+		end, [1, 2, 3, 5, 17, 100, 4000]),
+	      Term = binary_to_term_stress(Bin)
+      end, Terms),
+    ok.
+
+%% A plain implementation of the external term format for the terms
+%% in immediate_shapes/1.
+ext_encode(Term) ->
+    <<131, (ext_enc(Term))/binary>>.
+
+ext_enc(I) when is_integer(I), I >= 0, I < 256 ->
+    <<97, I>>;
+ext_enc(I) when is_integer(I), I >= -(1 bsl 31), I < (1 bsl 31) ->
+    <<98, I:32/signed>>;
+ext_enc(I) when is_integer(I) ->
+    Digits = binary:encode_unsigned(abs(I), little),
+    Sign = if I < 0 -> 1; true -> 0 end,
+    <<110, (byte_size(Digits)), Sign, Digits/binary>>;
+ext_enc(A) when is_atom(A) ->
+    Name = list_to_binary(atom_to_list(A)),
+    <<100, (byte_size(Name)):16, Name/binary>>;
+ext_enc(F) when is_float(F) ->
+    <<70, F/float>>;
+ext_enc([]) ->
+    <<106>>;
+ext_enc(L) when is_list(L) ->
+    case ext_string(L, 0) of
+	true ->
+	    <<107, (length(L)):16, (list_to_binary(L))/binary>>;
+	false ->
+	    {Elements, Tail} = ext_list(L, []),
+	    <<108, (length(Elements)):32,
+	      << <<(ext_enc(E))/binary>> || E <- Elements >>/binary,
+	      (ext_enc(Tail))/binary>>
+    end;
+ext_enc(T) when is_tuple(T), tuple_size(T) < 256 ->
+    <<104, (tuple_size(T)),
+      << <<(ext_enc(E))/binary>> || E <- tuple_to_list(T) >>/binary>>;
+ext_enc(T) when is_tuple(T) ->
+    <<105, (tuple_size(T)):32,
+      << <<(ext_enc(E))/binary>> || E <- tuple_to_list(T) >>/binary>>;
+ext_enc(M) when is_map(M) ->
+    <<116, (maps:size(M)):32,
+      << <<(ext_enc(K))/binary, (ext_enc(V))/binary>>
+	 || {K, V} <- maps:to_list(M) >>/binary>>.
+
+ext_string([], N) -> N < 65535;
+ext_string([C|T], N) when is_integer(C), C >= 0, C < 256 -> ext_string(T, N+1);
+ext_string(_, _) -> false.
+
+ext_list([H|T], Acc) -> ext_list(T, [H|Acc]);
+ext_list(Tail, Acc) -> {lists:reverse(Acc), Tail}.
+
+%% Encoding and decoding terms of common shapes.
+term_to_binary_bench(_Config) ->
+    N = 10000,
+    Shapes = [{small_ints, lists:seq(1000, 1100)},
+	      {string, lists:duplicate(100, $a)},
+	      {tuple, {ok, 1, 2, 3, a, b, c, [], 100000, -1}},
+	      {atom_map, maps:from_list([{list_to_atom([C]), C}
+					 || C <- lists:seq($a, $j)])},
+	      {record, {rec, self(), "name", 1.0, [1,2,3], <<"bin">>}},
+	      {tree, tree_term(6)}],
+    Runs = [{Shape, Term, N} || {Shape, Term} <- Shapes] ++
+	[{long_list, lists:seq(1, 200000), 20}],
+    Res = [{atom_to_list(Op) ++ "_" ++ atom_to_list(Shape),
+	    Iter * 1000000 div term_to_binary_bench(Op, Term, Iter)}
+	   || {Shape, Term, Iter} <- Runs, Op <- [encode, decode]],
+    [ct_event:notify(
+       #event{name = benchmark_data,
+	      data = [{suite, "binary"},
+		      {name, "term_to_binary_" ++ Name},
+		      {value, Value}]})
+     || {Name, Value} <- Res],
+    {comment, lists:flatten(
+		[io_lib:format("~s: ~p ops/s ", [Name, Value])
+		 || {Name, Value} <- Res])}.
+
+term_to_binary_bench(encode, Term, N) ->
+    Bin = term_to_binary(Term),
+    Start = erlang:monotonic_time(),
+    Bin = term_to_binary_loop(Term, N, Bin),
+    bench_time(Start);
+term_to_binary_bench(decode, Term, N) ->
+    Bin = term_to_binary(Term),
+    Start = erlang:monotonic_time(),
+    Term = binary_to_term_loop(Bin, N, Term),
+    bench_time(Start).
+
+%% Pass the results on, so that the calls are not optimized away.
+term_to_binary_loop(_Term, 0, Bin) -> Bin;
+term_to_binary_loop(Term, N, _) ->
+    term_to_binary_loop(Term, N-1, term_to_binary(Term)).
+
+binary_to_term_loop(_Bin, 0, Term) -> Term;
+binary_to_term_loop(Bin, N, _) ->
+    binary_to_term_loop(Bin, N-1, binary_to_term(Bin)).
+
+bench_time(Start) ->
+    Time = erlang:monotonic_time() - Start,
+    max(1, erlang:convert_time_unit(Time, native, micro_seconds)).
+
+tree_term(0) -> [];
+tree_term(N) -> {tree_term(N-1), N, tree_term(N-1)}.
+
+term_to_iovec_test(Term) ->
+    IoV = erlang:term_to_iovec(Term),
+    true = lists:all(fun is_binary/1, IoV),
+    Bin = term_to_binary(Term),
+    Bin = iolist_to_binary(IoV),
+    Term = binary_to_term(Bin),
+    Opts = [{minor_version, 1}],
+    Bin1 = term_to_binary(Term, Opts),
+    Bin1 = iolist_to_binary(erlang:term_to_iovec(Term, Opts)),
+    BinC = term_to_binary(Term, [compressed]),
+    BinC = iolist_to_binary(erlang:term_to_iovec(Term, [compressed])),
+    ok.
+
 error_after_yield(Config) when is_list(Config) ->
     L2BTrap = {erts_internal, list_to_binary_continue, 1},
     error_after_yield(badarg, erlang, list_to_binary, 1, fun () -> [[mk_list(1000000), oops]] end, L2BTrap),
@@ -34,6 +34,7 @@
 %% Tests distribution and the tcp driver.
 
 -include_lib("common_test/include/ct.hrl").
+-include_lib("common_test/include/ct_event.hrl").
 
 -export([all/0, suite/0, groups/0,
          ping/1, bulk_send_small/1,
@@ -46,6 +47,14 @@
          stop_dist/1,
          dist_auto_connect_never/1, dist_auto_connect_once/1,
          dist_parallel_send/1,
+         fragmented_send/1, fragmented_overtake/1, fragmented_send_abort/1,
+         multi_channel/1,
+         compressed_send/1, compressed_send_bench/1,
+         large_atom_cache/1,
+         dist_stats/1,
+         received_bin_ref/1,
+         yielding_decode/1,
+         sent_bin_ref/1,
          atom_roundtrip/1,
          unicode_atom_roundtrip/1,
          atom_roundtrip_r15b/1,
@@ -78,7 +87,11 @@ all() ->
      link_to_dead_new_node, applied_monitor_node,
      ref_port_roundtrip, nil_roundtrip, stop_dist,
      {group, trap_bif}, {group, dist_auto_connect},
-     dist_parallel_send, atom_roundtrip, unicode_atom_roundtrip, atom_roundtrip_r15b,
+     dist_parallel_send, fragmented_send, fragmented_overtake,
+     fragmented_send_abort, multi_channel, compressed_send,
+     large_atom_cache, dist_stats, received_bin_ref, yielding_decode,
+     sent_bin_ref,
+     atom_roundtrip, unicode_atom_roundtrip, atom_roundtrip_r15b,
      contended_atom_cache_entry, contended_unicode_atom_cache_entry,
      bad_dist_structure, {group, bad_dist_ext},
      start_epmd_false, epmd_module].
@@ -92,7 +105,8 @@ groups() ->
       [dist_auto_connect_never, dist_auto_connect_once]},
      {bad_dist_ext, [],
       [bad_dist_ext_receive, bad_dist_ext_process_info,
-       bad_dist_ext_control, bad_dist_ext_connection_id]}].
+       bad_dist_ext_control, bad_dist_ext_connection_id]},
+     {compressed_send_bench, [{repeat, 5}], [compressed_send_bench]}].
 
 %% Tests pinging a node in different ways.
 ping(Config) when is_list(Config) ->
@@ -1024,6 +1038,412 @@ dist_evil_parallel_receiver() ->
     net_kernel:disconnect(node(Sender)),
     dist_evil_parallel_receiver().
 
+%% Send messages large enough to be fragmented from many processes
+%% in parallel, interleaved with small messages, and check that they
+%% arrive intact.
+fragmented_send(Config) when is_list(Config) ->
+    {ok, Node} = start_node(Config),
+    Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+    Big = {[{list_to_atom("fragmented_send_" ++ integer_to_list(I)),
+             lists:seq(1, I), binary:copy(<<I>>, 1000)}
+            || I <- lists:seq(1, 500)],
+           lists:seq(1, 100000), make_ref(), self()},
+    true = erlang:external_size(Big) > 1024*1024,
+    Parent = self(),
+    Senders = [spawn_link(fun () ->
+                                  Msg = case I rem 2 of
+                                            0 -> {I, Big};
+                                            1 -> {I, small}
+                                        end,
+                                  fragmented_send_loop(Echo, Msg, 10),
+                                  Parent ! {done, self()}
+                          end) || I <- lists:seq(1, 16)],
+    lists:foreach(fun (S) -> receive {done, S} -> ok end end, Senders),
+    unlink(Echo),
+    stop_node(Node),
+    ok.
+
+%% Check that small messages sent after a large fragmented one has
+%% started to be sent overtake it.
+fragmented_overtake(Config) when is_list(Config) ->
+    {ok, Node} = start_node(Config),
+    Parent = self(),
+    Collector = spawn_link(Node, fun () -> fragmented_collect([]) end),
+    Big = [binary:copy(<<I>>, 1000000) || I <- lists:seq(1, 50)],
+    spawn_link(fun () ->
+                       Collector ! {big, Big},
+                       Parent ! big_sent
+               end),
+    receive after 1 -> ok end,
+    [Collector ! {small, I} || I <- lists:seq(1, 10)],
+    receive big_sent -> ok end,
+    Collector ! {report, self()},
+    Order = receive {Collector, O} -> O end,
+    io:format("Order: ~p~n", [Order]),
+    11 = length(Order),
+    [1,2,3,4,5,6,7,8,9,10] = lists:delete(big, Order),
+    true = hd(Order) =/= big,
+    unlink(Collector),
+    stop_node(Node),
+    ok.
+
+fragmented_collect(Acc) ->
+    receive
+        {report, From} -> From ! {self(), lists:reverse(Acc)};
+        {big, _} -> fragmented_collect([big | Acc]);
+        {small, I} -> fragmented_collect([I | Acc])
+    end.
+
+%% Kill senders in the middle of sending large fragmented messages,
+%% and check that the receiving node drops what it has received of
+%% them.
+fragmented_send_abort(Config) when is_list(Config) ->
+    {ok, Node} = start_node(Config),
+    Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+    Big = [binary:copy(<<I>>, 1000000) || I <- lists:seq(1, 50)],
+    Binary0 = rpc:call(Node, erlang, memory, [binary]),
+    lists:foreach(fun (_) ->
+                          S = spawn(fun () -> Echo ! {self(), Big} end),
+                          receive after 20 -> ok end,
+                          exit(S, kill)
+                  end, lists:seq(1, 5)),
+    wait_until(fun () ->
+                       Binary1 = rpc:call(Node, erlang, memory, [binary]),
+                       io:format("Binary memory: ~p -> ~p~n",
+                                 [Binary0, Binary1]),
+                       Binary1 - Binary0 < 10*1024*1024
+               end),
+    fragmented_send_loop(Echo, small, 1),
+    unlink(Echo),
+    stop_node(Node),
+    ok.
+
+fragmented_send_loop(_Echo, _Msg, 0) ->
+    ok;
+fragmented_send_loop(Echo, Msg, N) ->
+    Echo ! {self(), Msg},
+    receive {Echo, Msg} -> ok end,
+    fragmented_send_loop(Echo, Msg, N-1).
+
+fragmented_echo() ->
+    receive {From, Msg} -> From ! {self(), Msg} end,
+    fragmented_echo().
+
+%% Set up a connection using several channels, check that they are
+%% all used and closed with the connection, and that messages from
+%% each sender arrive in order.
+multi_channel(Config) when is_list(Config) ->
+    Channels = 4,
+    Old = application:get_env(kernel, dist_channels),
+    application:set_env(kernel, dist_channels, Channels),
+    try
+        Before = tcp_ports(),
+        {ok, Node} = start_node(Config, "-kernel dist_channels "
+                                ++ integer_to_list(Channels)),
+        Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+        Sockets = tcp_ports() -- Before,
+        Channels = length(Sockets),
+        Parent = self(),
+        Senders = [spawn_link(fun () ->
+                                      multi_channel_loop(Echo, I, 1000),
+                                      Parent ! {done, self()}
+                              end) || I <- lists:seq(1, 4*Channels)],
+        lists:foreach(fun (S) -> receive {done, S} -> ok end end, Senders),
+        Used = [S || S <- Sockets,
+                     begin
+                         {ok, [{send_oct, Oct}]} = inet:getstat(S, [send_oct]),
+                         Oct > 0
+                     end],
+        Channels = length(Used),
+        unlink(Echo),
+        stop_node(Node),
+        wait_until(fun () -> tcp_ports() -- Before =:= [] end)
+    after
+        case Old of
+            {ok, Val} -> application:set_env(kernel, dist_channels, Val);
+            undefined -> application:unset_env(kernel, dist_channels)
+        end
+    end,
+    ok.
+
+multi_channel_loop(_Echo, _I, 0) ->
+    ok;
+multi_channel_loop(Echo, I, N) ->
+    Echo ! {self(), {I, N}},
+    receive {Echo, Msg} -> {I, N} = Msg end,
+    multi_channel_loop(Echo, I, N-1).
+
+%% Send large compressible messages to a node that compression is
+%% enabled for, and check that they arrive intact and are compressed
+%% on the wire.
+compressed_send(Config) when is_list(Config) ->
+    Old = application:get_env(kernel, dist_compression),
+    application:set_env(kernel, dist_compression, true),
+    try
+        {ok, Node} = start_node(Config, "-kernel dist_compression true"),
+        Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+        [{Node, Port}] = [C || {N, _} = C <- erlang:system_info(dist_ctrl),
+                               N =:= Node],
+        Msg = {[{compressed_send, I, lists:seq(1, 100),
+                 binary:copy(<<"compressible">>, 100)}
+                || I <- lists:seq(1, 1000)],
+               make_ref(), self()},
+        Size = erlang:external_size(Msg),
+        {ok, [{send_oct, Before}]} = inet:getstat(Port, [send_oct]),
+        fragmented_send_loop(Echo, Msg, 10),
+        {ok, [{send_oct, After}]} = inet:getstat(Port, [send_oct]),
+        true = After - Before < Size,
+        fragmented_send_loop(Echo, {small, self()}, 10),
+        %% The receiver uncompresses; also when the message is
+        %% inspected in the queue, carries a token or is never received
+        Bin = binary:copy(<<"compressible">>, 100000),
+        fragmented_send_loop(Echo, {Bin, binary:part(Bin, 10, 300000)}, 2),
+        seq_trace:set_token(label, 17),
+        fragmented_send_loop(Echo, Msg, 1),
+        {label, 17} = seq_trace:get_token(label),
+        seq_trace:set_token([]),
+        Self = self(),
+        Blocked = spawn(fun () ->
+                                receive go -> ok end,
+                                receive {Echo, M} -> Self ! {self(), M} end
+                        end),
+        Echo ! {Blocked, Msg},
+        wait_until(fun () ->
+                           {message_queue_len, 1}
+                               =:= process_info(Blocked, message_queue_len)
+                   end),
+        {messages, [{Echo, Msg}]} = process_info(Blocked, messages),
+        Blocked ! go,
+        receive {Blocked, Msg} -> ok end,
+        Killed = [spawn(fun () -> receive {Echo, _} -> ok end end)
+                  || _ <- lists:seq(1, 10)],
+        [begin Echo ! {P, Msg}, exit(P, kill) end || P <- Killed],
+        fragmented_send_loop(Echo, Msg, 2),
+        unlink(Echo),
+        stop_node(Node)
+    after
+        case Old of
+            {ok, Val} -> application:set_env(kernel, dist_compression, Val);
+            undefined -> application:unset_env(kernel, dist_compression)
+        end
+    end,
+    ok.
+
+%% Measure round trips of large compressible messages with and
+%% without compression, and the number of bytes sent.
+compressed_send_bench(Config) when is_list(Config) ->
+    Msg = [{compressed_send_bench, I, lists:seq(1, 20),
+            binary:copy(<<"compressible text ">>, 20)}
+           || I <- lists:seq(1, 100)],
+    NoMsgs = 2000,
+    Res = [{Compress, compressed_send_bench(Config, Compress, Msg, NoMsgs)}
+           || Compress <- [false, true]],
+    [ct_event:notify(
+       #event{name = benchmark_data,
+              data = [{suite, "distribution"},
+                      {name, "compressed_send_" ++ atom_to_list(Compress)},
+                      {value, NoMsgs * 1000000 div Time}]})
+     || {Compress, {Time, _Bytes}} <- Res],
+    {comment, lists:flatten(
+                [io_lib:format("compression ~p: ~p msgs/s ~p kB sent ",
+                               [Compress, NoMsgs * 1000000 div Time,
+                                Bytes div 1024])
+                 || {Compress, {Time, Bytes}} <- Res])}.
+
+compressed_send_bench(Config, Compress, Msg, NoMsgs) ->
+    Old = application:get_env(kernel, dist_compression),
+    application:set_env(kernel, dist_compression, Compress),
+    try
+        {ok, Node} = start_node(Config, "-kernel dist_compression "
+                                ++ atom_to_list(Compress)),
+        Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+        [{Node, Port}] = [C || {N, _} = C <- erlang:system_info(dist_ctrl),
+                               N =:= Node],
+        {ok, [{send_oct, Before}]} = inet:getstat(Port, [send_oct]),
+        Start = erlang:monotonic_time(),
+        fragmented_send_loop(Echo, Msg, NoMsgs),
+        Time = erlang:convert_time_unit(erlang:monotonic_time() - Start,
+                                        native, microsecond),
+        {ok, [{send_oct, After}]} = inet:getstat(Port, [send_oct]),
+        unlink(Echo),
+        stop_node(Node),
+        {erlang:max(Time, 1), After - Before}
+    after
+        case Old of
+            {ok, Val} -> application:set_env(kernel, dist_compression, Val);
+            undefined -> application:unset_env(kernel, dist_compression)
+        end
+    end.
+
+%% Use a large atom cache towards a node that it is enabled for, and
+%% check that a working set of atoms larger than the default cache
+%% stays cached.
+large_atom_cache(Config) when is_list(Config) ->
+    Old = application:get_env(kernel, dist_large_atom_cache),
+    application:set_env(kernel, dist_large_atom_cache, true),
+    try
+        {ok, Node} = start_node(Config, "-kernel dist_large_atom_cache true"),
+        Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+        %% More atoms than fit in the default cache
+        Msgs = [list_to_tuple([list_to_atom("large_atom_cache_"
+                                            ++ integer_to_list(I*100+J))
+                               || J <- lists:seq(1, 100)])
+                || I <- lists:seq(1, 40)],
+        lists:foreach(fun (M) -> fragmented_send_loop(Echo, M, 1) end, Msgs),
+        Info0 = erlang:system_info({dist_atom_cache, Node}),
+        8192 = proplists:get_value(size, Info0),
+        lists:foreach(fun (M) -> fragmented_send_loop(Echo, M, 1) end, Msgs),
+        Info1 = erlang:system_info({dist_atom_cache, Node}),
+        Hits = (proplists:get_value(out_hits, Info1)
+                - proplists:get_value(out_hits, Info0)),
+        Misses = (proplists:get_value(out_misses, Info1)
+                  - proplists:get_value(out_misses, Info0)),
+        true = Hits >= 4000,
+        true = Misses < 100,
+        undefined = erlang:system_info({dist_atom_cache, node()}),
+        unlink(Echo),
+        stop_node(Node)
+    after
+        case Old of
+            {ok, Val} ->
+                application:set_env(kernel, dist_large_atom_cache, Val);
+            undefined ->
+                application:unset_env(kernel, dist_large_atom_cache)
+        end
+    end,
+    ok.
+
+%% Check that the statistics of a connection count the messages sent
+%% and received.
+dist_stats(Config) when is_list(Config) ->
+    {ok, Node} = start_node(Config),
+    Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+    Stats0 = erlang:system_info({dist_stats, Node}),
+    Msg = {dist_stats, lists:seq(1, 100)},
+    fragmented_send_loop(Echo, Msg, 100),
+    fragmented_send_loop(Echo, lists:seq(1, 100000), 1),
+    Stats1 = erlang:system_info({dist_stats, Node}),
+    Diff = fun (Item) ->
+                   proplists:get_value(Item, Stats1)
+                       - proplists:get_value(Item, Stats0)
+           end,
+    true = Diff(out_msgs) >= 101,
+    true = Diff(in_msgs) >= 101,
+    true = Diff(out_bytes) >= 100*erlang:external_size(Msg),
+    true = Diff(in_bytes) >= 100*erlang:external_size(Msg),
+    true = Diff(encode_time) > 0,
+    true = proplists:get_value(max_queue, Stats1) > 0,
+    Hist0 = proplists:get_value(size_histogram, Stats0),
+    Hist1 = proplists:get_value(size_histogram, Stats1),
+    16 = length(Hist1),
+    true = lists:sum(Hist1) - lists:sum(Hist0) >= 101,
+    true = lists:sum(lists:nthtail(12, Hist1)) >= 1,
+    undefined = erlang:system_info({dist_stats, node()}),
+    undefined = erlang:system_info({dist_stats, 'dist_stats@nowhere'}),
+    unlink(Echo),
+    stop_node(Node),
+    ok.
+
+%% Check that large binaries received over the distribution arrive
+%% intact and refer to the buffer they were received in, and that
+%% small ones, and large ones that are a small part of the buffer,
+%% are copied.
+received_bin_ref(Config) when is_list(Config) ->
+    true = erlang:system_info(dist_bin_ref_threshold) =< 100000,
+    {ok, Node} = start_node(Config),
+    Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+    Small = binary:copy(<<"small">>, 10),
+    Large = list_to_binary([I rem 251 || I <- lists:seq(1, 100000)]),
+    Huge = binary:copy(Large, 10),
+    Echoed = fun (Msg) ->
+                     Echo ! {self(), Msg},
+                     receive {Echo, Msg} = {_, Rcvd} -> Rcvd end
+             end,
+    {L1, S1} = Echoed({Large, Small}),
+    true = binary:referenced_byte_size(L1) > byte_size(L1),
+    true = binary:referenced_byte_size(S1) =:= byte_size(S1),
+    {H2, L2, S2} = Echoed({Huge, Large, Small}),
+    true = binary:referenced_byte_size(H2) > byte_size(H2),
+    true = binary:referenced_byte_size(L2) =:= byte_size(L2),
+    true = binary:referenced_byte_size(S2) =:= byte_size(S2),
+    {L3, _} = Echoed({Large, lists:seq(1, 200000)}),
+    true = binary:referenced_byte_size(L3) =:= byte_size(L3),
+    fragmented_send_loop(Echo, {Huge, Small}, 10),
+    unlink(Echo),
+    stop_node(Node),
+    ok.
+
+%% Check that large messages, which the receiver decodes in steps,
+%% arrive intact and with their seq_trace token, also when they are
+%% inspected before being received or the receiver is killed.
+yielding_decode(Config) when is_list(Config) ->
+    {ok, Node} = start_node(Config),
+    Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+    Big = {lists:seq(1, 200000), #{a => lists:seq(1, 1000)},
+           [{I, integer_to_list(I), <<I:32>>} || I <- lists:seq(1, 10000)]},
+    fragmented_send_loop(Echo, Big, 5),
+    seq_trace:set_token(label, 17),
+    Echo ! {self(), Big},
+    receive {Echo, Big} -> ok end,
+    {label, 17} = seq_trace:get_token(label),
+    seq_trace:set_token([]),
+    Self = self(),
+    Blocked = spawn(fun () ->
+                            receive go -> ok end,
+                            receive {Echo, M} -> Self ! {self(), M} end
+                    end),
+    Echo ! {Blocked, Big},
+    wait_until(fun () ->
+                       {message_queue_len, 1}
+                           =:= process_info(Blocked, message_queue_len)
+               end),
+    {messages, [{Echo, Big}]} = process_info(Blocked, messages),
+    Blocked ! go,
+    receive {Blocked, Big} -> ok end,
+    Killed = [spawn(fun () -> receive {Echo, _} -> ok end end)
+              || _ <- lists:seq(1, 10)],
+    [begin Echo ! {P, Big}, exit(P, kill) end || P <- Killed],
+    fragmented_send_loop(Echo, Big, 2),
+    unlink(Echo),
+    stop_node(Node),
+    ok.
+
+%% Check that messages with large binaries, which the sender does not
+%% copy into the distribution buffer, arrive intact and that the
+%% binaries are released.
+sent_bin_ref(Config) when is_list(Config) ->
+    {ok, Node} = start_node(Config),
+    Echo = spawn_link(Node, fun () -> fragmented_echo() end),
+    Large = list_to_binary([I rem 251 || I <- lists:seq(1, 100000)]),
+    <<_:3/binary, Sub:50000/binary, _/binary>> = Large,
+    W0 = binary:copy(<<"w">>, 5000),
+    Writable = <<W0/binary, "tail">>,
+    Msg = {Large, [Sub, Writable, <<1,2,3>>], #{Large => Sub},
+           binary:copy(Large, 20), lists:seq(1, 1000)},
+    fragmented_send_loop(Echo, Msg, 10),
+    fragmented_send_loop(Echo, {Sub, Writable}, 10),
+    BinMem = erlang:memory(binary),
+    garbage_collect(),
+    fragmented_send_loop(Echo, Msg, 10),
+    garbage_collect(),
+    true = erlang:memory(binary) < BinMem + byte_size(Large),
+    unlink(Echo),
+    stop_node(Node),
+    ok.
+
+tcp_ports() ->
+    [P || P <- erlang:ports(),
+          erlang:port_info(P, name) =:= {name, "tcp_inet"}].
+
+wait_until(Fun) ->
+    case Fun() of
+        true ->
+            ok;
+        false ->
+            receive after 100 -> ok end,
+            wait_until(Fun)
+    end.
+
 atom_roundtrip(Config) when is_list(Config) ->
     AtomData = atom_data(),
     verify_atom_data(AtomData),
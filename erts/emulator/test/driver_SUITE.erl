@@ -75,6 +75,9 @@
          many_events/1,
          missing_callbacks/1,
          smp_select/1,
+         many_pollsets/1,
+         many_pollsets_thr_progress/1,
+         many_pollsets_stalled_port/1,
          driver_select_use/1,
          thread_mseg_alloc_cache_clean/1,
          otp_9302/1,
@@ -84,9 +87,10 @@
          consume_timeslice/1,
          z_test/1]).
 
--export([bin_prefix/2]).
+-export([bin_prefix/2, tcp_echo/3, tcp_echo_thr_progress/4, io_stall/1]).
 
 -include_lib("common_test/include/ct.hrl").
+-include_lib("common_test/include/ct_event.hrl").
 
 
 % First byte in communication with the timer driver
@@ -148,7 +152,9 @@ all() -> %% Keep a_test first and z_test last...
      larger_minor_vsn_drv, smaller_major_vsn_drv,
      smaller_minor_vsn_drv, peek_non_existing_queue,
      otp_6879, caller, many_events, missing_callbacks,
-     smp_select, driver_select_use,
+     smp_select, many_pollsets, many_pollsets_thr_progress,
+     many_pollsets_stalled_port,
+     driver_select_use,
      thread_mseg_alloc_cache_clean,
      otp_9302,
      thr_free_drv,
@@ -1698,6 +1704,208 @@ smp_select_wait(Pids, TimeoutMsg) ->
             smp_select_wait(Pids, TimeoutMsg)
     end.
 
+%% Run many concurrent TCP echo connections on nodes with one and
+%% with several pollsets (+IOp), and report the throughput.
+many_pollsets(Config) when is_list(Config) ->
+    case {os:type(), erlang:system_info(smp_support)} of
+        {{win32,_}, _} -> {skipped, "Only one pollset on this OS"};
+        {_, false} -> {skipped, "Only one pollset without SMP support"};
+        _ -> many_pollsets0(Config)
+    end.
+
+many_pollsets0(Config) ->
+    Conns = 200,
+    Msgs = 200,
+    Res = lists:map(
+            fun (NoPs) ->
+                    {ok, Node} = start_node(Config,
+                                            "+IOp " ++ integer_to_list(NoPs)),
+                    {Ops, ChkIo} = rpc:call(Node, ?MODULE, tcp_echo,
+                                            [Conns, Msgs, 64]),
+                    stop_node(Node),
+                    {pollsets, NoPs} = lists:keyfind(pollsets, 1, ChkIo),
+                    ct_event:notify(
+                      #event{name = benchmark_data,
+                             data = [{suite, "erts_check_io"},
+                                     {name, "tcp_echo_pollsets_"
+                                      ++ integer_to_list(NoPs)},
+                                     {value, Ops}]}),
+                    {NoPs, Ops}
+            end, [1, 4]),
+    {comment, lists:flatten(
+                [io_lib:format("~p pollsets: ~p echos/s ", [NoPs, Ops])
+                 || {NoPs, Ops} <- Res])}.
+
+%% The poll threads of the extra pollsets are not managed by thread
+%% progress. Keep them busy, and let them go to sleep now and then,
+%% while thread progress is pushed forward and blocked.
+many_pollsets_thr_progress(Config) when is_list(Config) ->
+    case {os:type(), erlang:system_info(smp_support)} of
+        {{win32,_}, _} -> {skipped, "Only one pollset on this OS"};
+        {_, false} -> {skipped, "Only one pollset without SMP support"};
+        _ -> many_pollsets_thr_progress0(Config)
+    end.
+
+many_pollsets_thr_progress0(Config) ->
+    {ok, Node} = start_node(Config, "+IOp 4"),
+    ok = rpc:call(Node, ?MODULE, tcp_echo_thr_progress, [10, 100, 100, 64]),
+    stop_node(Node),
+    ok.
+
+%% Called on the started node.
+tcp_echo_thr_progress(Rounds, Conns, Msgs, Size) ->
+    Parent = self(),
+    Pushers = [spawn_link(fun () -> thr_progress_pusher(Parent, Op) end)
+               || Op <- [deallocations, multi_scheduling]],
+    lists:foreach(fun (_) ->
+                          {_, ChkIo} = tcp_echo(Conns, Msgs, Size),
+                          {pollsets, 4} = lists:keyfind(pollsets, 1, ChkIo),
+                          receive after 100 -> ok end
+                  end, lists:seq(1, Rounds)),
+    [begin
+         Pid ! {stop, Parent},
+         receive {stopped, Pid, N} when N > 0 -> ok end
+     end || Pid <- Pushers],
+    wait_deallocations(),
+    ok.
+
+thr_progress_pusher(Parent, Op) ->
+    thr_progress_pusher(Parent, Op, 0).
+
+thr_progress_pusher(Parent, Op, N) ->
+    receive
+        {stop, Parent} -> Parent ! {stopped, self(), N}
+    after 0 ->
+            case Op of
+                deallocations ->
+                    wait_deallocations();
+                multi_scheduling ->
+                    erlang:system_flag(multi_scheduling, block),
+                    erlang:system_flag(multi_scheduling, unblock)
+            end,
+            receive after N rem 3 -> ok end,
+            thr_progress_pusher(Parent, Op, N+1)
+    end.
+
+%% A port whose I/O task is slow to execute must not keep the poll
+%% thread from finding events on other fds of the same pollset.
+many_pollsets_stalled_port(Config) when is_list(Config) ->
+    case {os:type(), erlang:system_info(smp_support)} of
+        {{win32,_}, _} -> {skipped, "Only one pollset on this OS"};
+        {_, false} -> {skipped, "Only one pollset without SMP support"};
+        _ -> many_pollsets_stalled_port0(Config)
+    end.
+
+many_pollsets_stalled_port0(Config) ->
+    Path = proplists:get_value(data_dir, Config),
+    {ok, Node} = start_node(Config, "+IOp 4 +S 2:2"),
+    Ms = rpc:call(Node, ?MODULE, io_stall, [Path]),
+    stop_node(Node),
+    io:format("Input on the active port took ~p ms~n", [Ms]),
+    true = is_integer(Ms),
+    true = Ms < 1000,
+    ok.
+
+%% Called on the started node. The stalled port blocks scheduler 1 for
+%% two seconds in ready_input(), while the active port, which has its fd
+%% in the same pollset, is handled by scheduler 2.
+io_stall(Path) ->
+    ok = load_driver(Path, io_stall_drv),
+    {pollsets, 4} = lists:keyfind(pollsets, 1, erlang:system_info(check_io)),
+    Parent = self(),
+    {Pid, Mon} = spawn_opt(fun () -> Parent ! {self(), io_stall0()} end,
+                           [{scheduler, 2}, monitor]),
+    Res = receive
+              {Pid, Ms} -> Ms;
+              {'DOWN', Mon, process, Pid, Reason} -> {error, Reason}
+          end,
+    ok = erl_ddll:unload_driver(io_stall_drv),
+    Res.
+
+io_stall0() ->
+    Stalled = io_stall_port(1),
+    Active = io_stall_port(2),
+    "ok" = erlang:port_control(Stalled, $s, <<2000:32>>),
+    receive {Stalled, {data, "stalling"}} -> ok end,
+    T0 = erlang:monotonic_time(),
+    "ok" = erlang:port_control(Active, $w, []),
+    receive {Active, {data, "input"}} -> ok end,
+    Ms = erlang:convert_time_unit(erlang:monotonic_time() - T0,
+                                  native, milli_seconds),
+    receive {Stalled, {data, "input"}} -> ok end,
+    true = erlang:port_close(Stalled),
+    true = erlang:port_close(Active),
+    Ms.
+
+%% Open a port in the run queue of scheduler Sched, with its fd in
+%% pollset 1, and connect it to the caller.
+io_stall_port(Sched) ->
+    Parent = self(),
+    {Pid, Mon} = spawn_opt(fun () ->
+                                   P = open_port({spawn, io_stall_drv}, []),
+                                   "ok" = erlang:port_control(P, $p, [4, 1]),
+                                   true = erlang:port_connect(P, Parent),
+                                   unlink(P),
+                                   Parent ! {self(), P}
+                           end,
+                           [{scheduler, Sched}, monitor]),
+    receive
+        {Pid, Port} ->
+            erlang:demonitor(Mon, [flush]),
+            Port
+    end.
+
+%% Called on the started node. Echo Msgs messages of Size bytes over
+%% each of Conns connections at the same time.
+tcp_echo(Conns, Msgs, Size) ->
+    {ok, L} = gen_tcp:listen(0, [binary, {active, false},
+                                 {backlog, Conns}, {reuseaddr, true}]),
+    {ok, Port} = inet:port(L),
+    Acceptor = spawn_link(fun () -> tcp_echo_accept(L) end),
+    Socks = [begin
+                 {ok, S} = gen_tcp:connect({127,0,0,1}, Port,
+                                           [binary, {active, false}]),
+                 S
+             end || _ <- lists:seq(1, Conns)],
+    Data = <<0:Size/unit:8>>,
+    Parent = self(),
+    T0 = erlang:monotonic_time(),
+    Pids = [spawn_link(fun () ->
+                               tcp_echo_client(S, Data, Msgs),
+                               Parent ! {done, self()}
+                       end) || S <- Socks],
+    [receive {done, Pid} -> ok end || Pid <- Pids],
+    Us = erlang:convert_time_unit(erlang:monotonic_time() - T0,
+                                  native, microsecond),
+    ChkIo = erlang:system_info(check_io),
+    [gen_tcp:close(S) || S <- Socks],
+    unlink(Acceptor),
+    exit(Acceptor, kill),
+    gen_tcp:close(L),
+    {Conns * Msgs * 1000000 div max(1, Us), ChkIo}.
+
+tcp_echo_accept(L) ->
+    {ok, S} = gen_tcp:accept(L),
+    Pid = spawn(fun () -> tcp_echo_server(S) end),
+    ok = gen_tcp:controlling_process(S, Pid),
+    tcp_echo_accept(L).
+
+tcp_echo_server(S) ->
+    case gen_tcp:recv(S, 0) of
+        {ok, Data} ->
+            ok = gen_tcp:send(S, Data),
+            tcp_echo_server(S);
+        {error, _} ->
+            gen_tcp:close(S)
+    end.
+
+tcp_echo_client(_S, _Data, 0) ->
+    ok;
+tcp_echo_client(S, Data, N) ->
+    ok = gen_tcp:send(S, Data),
+    {ok, Data} = gen_tcp:recv(S, byte_size(Data)),
+    tcp_echo_client(S, Data, N-1).
+
 
 %% Test driver_select() with new ERL_DRV_USE flag.
 driver_select_use(Config) when is_list(Config) -> 
@@ -2476,6 +2684,9 @@ sleep(Ms) when is_integer(Ms), Ms >= 0 ->
 
 
 start_node(Config) when is_list(Config) ->
+    start_node(Config, "").
+
+start_node(Config, Args) when is_list(Config) ->
     Pa = filename:dirname(code:which(?MODULE)),
     Name = list_to_atom(atom_to_list(?MODULE)
                         ++ "-"
@@ -2484,7 +2695,7 @@ start_node(Config) when is_list(Config) ->
                         ++ integer_to_list(erlang:system_time(second))
                         ++ "-"
                         ++ integer_to_list(erlang:unique_integer([positive]))),
-    test_server:start_node(Name, slave, [{args, "-pa "++Pa}]).
+    test_server:start_node(Name, slave, [{args, "-pa "++Pa++" "++Args}]).
 
 stop_node(Node) ->
     test_server:stop_node(Node).
@@ -0,0 +1,207 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * A port that reads from a pipe of its own, and that can be told to
+ * block in ready_input() for a while. Used to check that a port with
+ * a slow I/O task does not hold up other fds of the same pollset.
+ */
+
+#ifndef UNIX
+#if !defined(__WIN32__)
+#define UNIX 1
+#endif
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef UNIX
+#include <unistd.h>
+#endif
+#include "erl_driver.h"
+
+#define IO_STALL_DRV_PIPE	'p'
+#define IO_STALL_DRV_WRITE	'w'
+#define IO_STALL_DRV_STALL	's'
+
+typedef struct {
+    ErlDrvPort port;
+    int fds[2];
+    int stall_ms;
+} IoStallDrvData;
+
+static ErlDrvData io_stall_drv_start(ErlDrvPort, char *);
+static void io_stall_drv_stop(ErlDrvData);
+static void io_stall_drv_ready_input(ErlDrvData, ErlDrvEvent);
+static ErlDrvSSizeT io_stall_drv_control(ErlDrvData, unsigned int,
+					 char *, ErlDrvSizeT,
+					 char **, ErlDrvSizeT);
+
+static ErlDrvEntry io_stall_drv_entry = {
+    NULL, /* init */
+    io_stall_drv_start,
+    io_stall_drv_stop,
+    NULL, /* output */
+    io_stall_drv_ready_input,
+    NULL, /* ready_output */
+    "io_stall_drv",
+    NULL, /* finish */
+    NULL, /* handle */
+    io_stall_drv_control,
+    NULL, /* timeout */
+    NULL, /* outputv */
+    NULL, /* ready_async */
+    NULL, /* flush */
+    NULL, /* call */
+    NULL, /* event */
+    ERL_DRV_EXTENDED_MARKER,
+    ERL_DRV_EXTENDED_MAJOR_VERSION,
+    ERL_DRV_EXTENDED_MINOR_VERSION,
+    ERL_DRV_FLAG_USE_PORT_LOCKING,
+    NULL, /* handle2 */
+    NULL, /* process_exit */
+    NULL  /* stop_select */
+};
+
+DRIVER_INIT(io_stall_drv)
+{
+    return &io_stall_drv_entry;
+}
+
+static ErlDrvData
+io_stall_drv_start(ErlDrvPort port, char *command)
+{
+    IoStallDrvData *dp = driver_alloc(sizeof(IoStallDrvData));
+    dp->port = port;
+    dp->fds[0] = -1;
+    dp->fds[1] = -1;
+    dp->stall_ms = 0;
+    return (ErlDrvData) dp;
+}
+
+static void
+io_stall_drv_stop(ErlDrvData drv_data)
+{
+    IoStallDrvData *dp = (IoStallDrvData *) drv_data;
+#ifdef UNIX
+    if (dp->fds[0] >= 0) {
+	driver_select(dp->port,
+		      (ErlDrvEvent) (ErlDrvSInt) dp->fds[0],
+		      DO_READ,
+		      0);
+	close(dp->fds[0]);
+    }
+    if (dp->fds[1] >= 0)
+	close(dp->fds[1]);
+#endif
+    driver_free((void *) dp);
+}
+
+static void
+io_stall_drv_ready_input(ErlDrvData drv_data, ErlDrvEvent event)
+{
+    IoStallDrvData *dp = (IoStallDrvData *) drv_data;
+#ifdef UNIX
+    char c;
+    int stall_ms = dp->stall_ms;
+    if (read(dp->fds[0], &c, 1) != 1)
+	return;
+    dp->stall_ms = 0;
+    if (stall_ms) {
+	driver_output(dp->port, "stalling", 8);
+	usleep(stall_ms*1000);
+    }
+    driver_output(dp->port, "input", 5);
+#endif
+}
+
+/*
+ * IO_STALL_DRV_PIPE: buf = [NoPollsets, Ix]; create a pipe with a read
+ * end that ends up in pollset Ix, and select on it.
+ * IO_STALL_DRV_WRITE: make the pipe readable.
+ * IO_STALL_DRV_STALL: buf = Ms (as 4 bytes big endian); make the pipe
+ * readable, and block for Ms milliseconds in the ready_input() call.
+ */
+static ErlDrvSSizeT
+io_stall_drv_control(ErlDrvData drv_data,
+		     unsigned int command,
+		     char *buf, ErlDrvSizeT len,
+		     char **rbuf, ErlDrvSizeT rlen)
+{
+    IoStallDrvData *dp = (IoStallDrvData *) drv_data;
+    char *res_str = "ok";
+    ErlDrvSSizeT res_len;
+
+#ifndef UNIX
+    res_str = "nyiftos";
+#else
+    switch (command) {
+    case IO_STALL_DRV_PIPE: {
+	int no_pollsets, ix, fd, skipped[64], no_skipped = 0;
+	if (len != 2 || dp->fds[0] >= 0 || pipe(dp->fds) < 0) {
+	    res_str = "pipe failed";
+	    break;
+	}
+	no_pollsets = (unsigned char) buf[0];
+	ix = (unsigned char) buf[1];
+	fd = dp->fds[0];
+	while (fd >= 0 && fd % no_pollsets != ix && no_skipped < 64) {
+	    skipped[no_skipped++] = fd;
+	    fd = dup(fd);
+	}
+	while (no_skipped > 0) {
+	    no_skipped--;
+	    if (skipped[no_skipped] != fd)
+		close(skipped[no_skipped]);
+	}
+	if (fd < 0 || fd % no_pollsets != ix) {
+	    res_str = "dup failed";
+	    break;
+	}
+	dp->fds[0] = fd;
+	driver_select(dp->port, (ErlDrvEvent) (ErlDrvSInt) fd, DO_READ, 1);
+	break;
+    }
+    case IO_STALL_DRV_STALL:
+	if (len != 4) {
+	    res_str = "badarg";
+	    break;
+	}
+	dp->stall_ms = ((((unsigned char) buf[0]) << 24)
+			| (((unsigned char) buf[1]) << 16)
+			| (((unsigned char) buf[2]) << 8)
+			| ((unsigned char) buf[3]));
+	/* Fall through... */
+    case IO_STALL_DRV_WRITE:
+	if (write(dp->fds[1], "!", 1) != 1)
+	    res_str = "write failed";
+	break;
+    default:
+	res_str = "badarg";
+	break;
+    }
+#endif
+
+    res_len = strlen(res_str);
+    if (res_len > rlen)
+	*rbuf = driver_alloc(res_len);
+    memcpy((void *) *rbuf, (void *) res_str, res_len);
+    return res_len;
+}
@@ -1 +1,6 @@
 {groups,"../emulator_test",estone_SUITE,[estone_bench]}.
+{groups,"../emulator_test",message_queue_data_SUITE,
+ [many_to_one_bench,fix_sz_message_bench]}.
+{groups,"../emulator_test",process_SUITE,[copy_term_bench]}.
+{groups,"../emulator_test",binary_SUITE,[term_to_binary_bench]}.
+{groups,"../emulator_test",distribution_SUITE,[compressed_send_bench]}.
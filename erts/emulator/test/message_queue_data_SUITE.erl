@@ -20,19 +20,26 @@
 
 -module(message_queue_data_SUITE).
 
--export([all/0, suite/0]).
--export([basic/1, process_info_messages/1, total_heap_size/1]).
+-export([all/0, suite/0, groups/0]).
+-export([basic/1, process_info_messages/1, total_heap_size/1,
+         many_to_one/1, many_to_one_bench/1,
+         fix_sz_message_bench/1]).
 
 -export([basic_test/1]).
 
 -include_lib("common_test/include/ct.hrl").
+-include_lib("common_test/include/ct_event.hrl").
 
 suite() ->
     [{ct_hooks,[ts_install_cth]},
      {timetrap, {minutes, 2}}].
 
 all() -> 
-    [basic, process_info_messages, total_heap_size].
+    [basic, process_info_messages, total_heap_size, many_to_one].
+
+groups() ->
+    [{many_to_one_bench, [{repeat,5}], [many_to_one_bench]},
+     {fix_sz_message_bench, [{repeat,5}], [fix_sz_message_bench]}].
 
 %%
 %%
@@ -186,6 +193,125 @@ total_heap_size(_Config) ->
     ct:log("OffSize = ~p, OffSizeAfter = ~p",[OffSize, OffSizeAfter]),
     true = OffSize == OffSizeAfter.
 
+%% Many senders to one receiver. Off heap receivers are sent to
+%% without taking the message queue lock; verify that the order
+%% of messages from each sender is preserved.
+many_to_one(_Config) ->
+    lists:foreach(fun (Mqd) ->
+                          many_to_one(Mqd, 8, 20000),
+                          many_to_one(Mqd, 1, 1000)
+                  end,
+                  [on_heap, off_heap]),
+    ok.
+
+many_to_one_bench(_Config) ->
+    Senders = erlang:system_info(schedulers_online) * 4,
+    Res = [{Mqd, many_to_one(Mqd, Senders, 100000)}
+           || Mqd <- [on_heap, off_heap]],
+    [ct_event:notify(
+       #event{name = benchmark_data,
+              data = [{suite, "message_queue_data"},
+                      {name, "many_to_one_" ++ atom_to_list(Mqd)},
+                      {value, Senders * 100000 * 1000000 div Time}]})
+     || {Mqd, Time} <- Res],
+    {comment, lists:flatten(
+                [io_lib:format("~p: ~p msgs/s ", [Mqd, Senders * 100000 * 1000000 div Time])
+                 || {Mqd, Time} <- Res])}.
+
+many_to_one(Mqd, NoSenders, NoMsgs) ->
+    Tester = self(),
+    Rcvr = spawn_opt(fun () ->
+                             Tester ! {ready, self()},
+                             many_to_one_recv(maps:new(), NoSenders, NoMsgs),
+                             Tester ! {done, self()}
+                     end,
+                     [link, {message_queue_data, Mqd}]),
+    receive {ready, Rcvr} -> ok end,
+    Start = erlang:monotonic_time(),
+    Senders = [spawn_link(fun () -> many_to_one_send(Rcvr, S, 1, NoMsgs) end)
+               || S <- lists:seq(1, NoSenders)],
+    receive {done, Rcvr} -> ok end,
+    Time = erlang:convert_time_unit(erlang:monotonic_time() - Start,
+                                    native, microsecond),
+    unlink(Rcvr),
+    [unlink(S) || S <- Senders],
+    erlang:max(Time, 1).
+
+%% Messages of up to 64 heap words are allocated from scheduler
+%% specific pools, one per size class. Off heap receivers get every
+%% message in a message buffer of its own.
+fix_sz_message_bench(_Config) ->
+    Senders = erlang:system_info(schedulers_online) * 4,
+    NoMsgs = 50000,
+    Res = [{Words, fix_sz_messages(lists:seq(1, Words div 2),
+                                   Senders, NoMsgs)}
+           || Words <- [4, 12, 28, 60, 100]],
+    [ct_event:notify(
+       #event{name = benchmark_data,
+              data = [{suite, "message_queue_data"},
+                      {name, "fix_sz_message_" ++ integer_to_list(Words)},
+                      {value, Senders * NoMsgs * 1000000 div Time}]})
+     || {Words, Time} <- Res],
+    {comment, lists:flatten(
+                [io_lib:format("~p words: ~p msgs/s ",
+                               [Words, Senders * NoMsgs * 1000000 div Time])
+                 || {Words, Time} <- Res])}.
+
+fix_sz_messages(Msg, NoSenders, NoMsgs) ->
+    Tester = self(),
+    Rcvr = spawn_opt(fun () ->
+                             Tester ! {ready, self()},
+                             fix_sz_recv(NoSenders * NoMsgs),
+                             Tester ! {done, self()}
+                     end,
+                     [link, {message_queue_data, off_heap}]),
+    receive {ready, Rcvr} -> ok end,
+    Start = erlang:monotonic_time(),
+    Senders = [spawn_link(fun () -> fix_sz_send(Rcvr, Msg, NoMsgs) end)
+               || _ <- lists:seq(1, NoSenders)],
+    receive {done, Rcvr} -> ok end,
+    Time = erlang:convert_time_unit(erlang:monotonic_time() - Start,
+                                    native, microsecond),
+    unlink(Rcvr),
+    [unlink(S) || S <- Senders],
+    erlang:max(Time, 1).
+
+fix_sz_send(_Rcvr, _Msg, 0) ->
+    ok;
+fix_sz_send(Rcvr, Msg, N) ->
+    Rcvr ! Msg,
+    fix_sz_send(Rcvr, Msg, N-1).
+
+fix_sz_recv(0) ->
+    ok;
+fix_sz_recv(N) ->
+    receive _ -> fix_sz_recv(N-1) end.
+
+many_to_one_send(_Rcvr, _S, N, NoMsgs) when N > NoMsgs ->
+    ok;
+many_to_one_send(Rcvr, S, N, NoMsgs) ->
+    Rcvr ! {S, N},
+    many_to_one_send(Rcvr, S, N+1, NoMsgs).
+
+many_to_one_recv(Seen, NoSenders, NoMsgs) ->
+    case maps:size(Seen) of
+        NoSenders ->
+            case lists:all(fun (N) -> N == NoMsgs end, maps:values(Seen)) of
+                true -> ok;
+                false -> many_to_one_recv_msg(Seen, NoSenders, NoMsgs)
+            end;
+        _ ->
+            many_to_one_recv_msg(Seen, NoSenders, NoMsgs)
+    end.
+
+many_to_one_recv_msg(Seen, NoSenders, NoMsgs) ->
+    receive
+        {S, N} ->
+            %% Messages from each sender must arrive in order
+            N = maps:get(S, Seen, 0) + 1,
+            many_to_one_recv(maps:put(S, N, Seen), NoSenders, NoMsgs)
+    end.
+
 %%
 %%
 %% helpers
@@ -27,6 +27,7 @@
 %%	register/2 (partially)
 
 -include_lib("common_test/include/ct.hrl").
+-include_lib("common_test/include/ct_event.hrl").
 
 -define(heap_binary_size, 64).
 
@@ -47,6 +48,7 @@
 	 otp_4725/1, bad_register/1, garbage_collect/1, otp_6237/1,
 	 process_info_messages/1, process_flag_badarg/1, process_flag_heap_size/1,
 	 spawn_opt_heap_size/1, spawn_opt_max_heap_size/1,
+	 message_queue_limit/1, shared_terms/1, copy_term_bench/1,
 	 processes_large_tab/1, processes_default_tab/1, processes_small_tab/1,
 	 processes_this_tab/1, processes_apply_trap/1,
 	 processes_last_call_trap/1, processes_gc_trap/1,
@@ -84,7 +86,8 @@ all() ->
      bump_reductions, low_prio, yield, yield2, otp_4725,
      bad_register, garbage_collect, process_info_messages,
      process_flag_badarg, process_flag_heap_size,
-     spawn_opt_heap_size, spawn_opt_max_heap_size, otp_6237,
+     spawn_opt_heap_size, spawn_opt_max_heap_size,
+     message_queue_limit, shared_terms, otp_6237,
      {group, processes_bif},
      {group, otp_7738}, garb_other_running,
      {group, system_task}].
@@ -105,7 +108,8 @@ groups() ->
      {system_task, [],
       [no_priority_inversion, no_priority_inversion2,
        system_task_blast, system_task_on_suspended,
-       gc_request_when_gc_disabled, gc_request_blast_when_gc_disabled]}].
+       gc_request_when_gc_disabled, gc_request_blast_when_gc_disabled]},
+     {copy_term_bench, [{repeat,5}], [copy_term_bench]}].
 
 init_per_suite(Config) ->
     A0 = case application:start(sasl) of
@@ -1371,6 +1375,14 @@ process_flag_badarg(Config) when is_list(Config) ->
                                                         error_logger => gurka }) end),
     chk_badarg(fun () -> process_flag(max_heap_size, #{ size => 1 bsl 64 }) end),
 
+    chk_badarg(fun () -> process_flag(message_queue_limit, gurka) end),
+    chk_badarg(fun () -> process_flag(message_queue_limit, -1) end),
+    chk_badarg(fun () -> process_flag(message_queue_limit, #{}) end),
+    chk_badarg(fun () -> process_flag(message_queue_limit,
+                                      #{ size => 10, policy => gurka }) end),
+    chk_badarg(fun () -> process_flag(message_queue_limit,
+                                      #{ size => 10, low_watermark => 11 }) end),
+
     chk_badarg(fun () -> process_flag(priority, 4711) end),
     chk_badarg(fun () -> process_flag(save_calls, hmmm) end),
     P= spawn_link(fun () -> receive die -> ok end end),
@@ -2010,6 +2022,246 @@ spawn_opt_max_heap_size(_Config) ->
 
     ok.
 
+message_queue_limit(_Config) ->
+    #{ size := 0 } = process_flag(message_queue_limit, 100),
+    {message_queue_limit, #{ size := 100, low_watermark := 50,
+                             policy := suspend }} =
+        process_info(self(), message_queue_limit),
+    #{ size := 100 } = process_flag(message_queue_limit,
+                                    #{ size => 10, policy => drop }),
+    #{ size := 10, low_watermark := 5, policy := drop } =
+        process_flag(message_queue_limit, 0),
+
+    %% drop: messages from other processes beyond the limit are lost,
+    %% but messages from the runtime system are not.
+    Tester = self(),
+    Drop = spawn_link(
+             fun () ->
+                     process_flag(message_queue_limit,
+                                  #{ size => 10, policy => drop }),
+                     {Child,Mon} = spawn_monitor(fun () ->
+                                                         receive go -> ok end
+                                                 end),
+                     Tester ! {ready,Child},
+                     receive {'DOWN',Mon,_,_,_} -> ok end,
+                     Tester ! {drop, drain()}
+             end),
+    Child = receive {ready,C} -> C end,
+    [Drop ! {msg,N} || N <- lists:seq(1,100)],
+    Child ! go,
+    receive
+        {drop, Msgs} ->
+            Msgs = [{msg,N} || N <- lists:seq(1,10)]
+    end,
+
+    %% signal: all messages are delivered, but the sender is told
+    %% once that the limit has been reached.
+    Signal = spawn_link(
+               fun () ->
+                       process_flag(message_queue_limit,
+                                    #{ size => 10, policy => signal }),
+                       Tester ! ready,
+                       receive go -> ok end,
+                       Tester ! {signal, drain()}
+               end),
+    receive ready -> ok end,
+    [Signal ! {msg,N} || N <- lists:seq(1,100)],
+    receive {message_queue_limit, Signal} -> ok end,
+    receive {message_queue_limit, _} -> ct:fail(signalled_twice)
+    after 0 -> ok
+    end,
+    Signal ! go,
+    receive
+        {signal, SMsgs} ->
+            SMsgs = [{msg,N} || N <- lists:seq(1,100)]
+    end,
+
+    %% Messages that are not sent with send, here 'ETS-TRANSFER', are
+    %% delivered without using up the signal meant for a later sender.
+    Signal2 = spawn_link(
+                fun () ->
+                        process_flag(message_queue_limit,
+                                     #{ size => 2, policy => signal }),
+                        Tester ! ready,
+                        receive go -> ok end,
+                        Tester ! {signal, drain()}
+                end),
+    receive ready -> ok end,
+    Signal2 ! {msg,1},
+    Tab = ets:new(?MODULE, []),
+    true = ets:give_away(Tab, Signal2, gift),
+    receive {message_queue_limit, _} -> ct:fail(signalled_on_give_away)
+    after 0 -> ok
+    end,
+    Signal2 ! {msg,2},
+    receive {message_queue_limit, Signal2} -> ok end,
+    Signal2 ! go,
+    receive
+        {signal, [{msg,1}, {'ETS-TRANSFER',Tab,Tester,gift}, {msg,2}]} ->
+            ok
+    end,
+
+    %% suspend: the sender is suspended when the limit is reached,
+    %% and resumed when the queue has been drained to the low
+    %% watermark.
+    Suspend = spawn_link(
+                fun () ->
+                        process_flag(message_queue_limit,
+                                     #{ size => 10, low_watermark => 2 }),
+                        Tester ! ready,
+                        receive go -> ok end,
+                        Tester ! {suspend, drain_all(1000), drain()}
+                end),
+    receive ready -> ok end,
+    Sender = spawn_link(
+               fun () ->
+                       [Suspend ! {msg,N} || N <- lists:seq(1,1000)],
+                       Tester ! sent
+               end),
+    wait_until(fun () -> process_info(Sender, status) =:= {status,suspended} end),
+    {message_queue_len, 10} = process_info(Suspend, message_queue_len),
+    %% A nosuspend sender is not suspended, and its message is
+    %% delivered exactly once.
+    ok = erlang:send(Suspend, extra, [nosuspend]),
+    true = erlang:send_nosuspend(Suspend, extra),
+    Suspend ! go,
+    receive sent -> ok end,
+    receive
+        {suspend, SuMsgs, Extra} ->
+            SuMsgs = [{msg,N} || N <- lists:seq(1,1000)],
+            [extra, extra] = Extra
+    end,
+
+    %% A sender suspended on a process that exits is resumed.
+    Exit = spawn(fun () ->
+                         process_flag(message_queue_limit, 1),
+                         Tester ! ready,
+                         receive die -> exit(die) end
+                 end),
+    receive ready -> ok end,
+    Sender2 = spawn_link(fun () ->
+                                 [Exit ! {msg,N} || N <- lists:seq(1,10)],
+                                 Tester ! sent
+                         end),
+    wait_until(fun () -> process_info(Sender2, status) =:= {status,suspended} end),
+    exit(Exit, kill),
+    receive sent -> ok end,
+    ok.
+
+drain() ->
+    receive M -> [M|drain()]
+    after 0 -> []
+    end.
+
+drain_all(0) ->
+    [];
+drain_all(N) ->
+    receive {msg,_}=M -> [M|drain_all(N-1)] end.
+
+%% Terms with shared subterms keep their sharing when sent, passed as
+%% spawn arguments or used as exit reasons. Flattened, Shared would be
+%% 3*2^30 words.
+shared_terms(_Config) ->
+    Shared = shared_term(30),
+    SharedSize = erts_debug:size(Shared),
+    Tester = self(),
+
+    Rcvr = spawn_link(fun () ->
+                              receive M -> Tester ! {size, erts_debug:size(M)} end
+                      end),
+    Rcvr ! [a, {b, Shared}, Shared],
+    receive {size, Sz1} -> true = Sz1 < 2*SharedSize + 20 end,
+
+    spawn_link(fun () -> Tester ! {size, erts_debug:size(Shared)} end),
+    receive {size, Sz2} -> SharedSize = Sz2 end,
+
+    process_flag(trap_exit, true),
+    Child = spawn_link(fun () -> exit({shared, Shared}) end),
+    receive
+        {'EXIT', Child, Reason} ->
+            true = erts_debug:size(Reason) =< SharedSize + 3
+    end,
+    process_flag(trap_exit, false),
+
+    %% Copies are still equal to the original, whatever the shape.
+    Small = shared_term(10),
+    Terms = [Small, [Small|Small], {Small, #{a => Small, b => Small}},
+             [self(), "abc", 1.0, <<1:300>> | Small],
+             fun () -> Small end,
+             tree_term(10), lists:seq(1,1000)],
+    Echo = spawn_link(fun Echo () ->
+                              receive
+                                  {From, M} -> From ! {self(), M}, Echo()
+                              end
+                      end),
+    lists:foreach(fun (T) ->
+                          Echo ! {self(), T},
+                          receive {Echo, T} -> ok end
+                  end, Terms),
+    unlink(Echo),
+    exit(Echo, kill),
+    ok.
+
+shared_term(0) -> [];
+shared_term(N) -> T = shared_term(N-1), {T,T}.
+
+tree_term(0) -> [];
+tree_term(N) -> {tree_term(N-1), tree_term(N-1)}.
+
+%% Copying terms with and without shared subterms.
+copy_term_bench(_Config) ->
+    N = 10000,
+    Shapes = [{small, {msg, self(), make_ref(), [1,2,3]}},
+              {tree, tree_term(8)},
+              {shared, shared_term(8)}],
+    Res = [{atom_to_list(Op) ++ "_" ++ atom_to_list(Shape),
+            N * 1000000 div copy_term_bench(Op, Term, N)}
+           || {Shape, Term} <- Shapes, Op <- [send, spawn, ets]],
+    [ct_event:notify(
+       #event{name = benchmark_data,
+              data = [{suite, "process"},
+                      {name, "copy_term_" ++ Name},
+                      {value, Value}]})
+     || {Name, Value} <- Res],
+    {comment, lists:flatten(
+                [io_lib:format("~s: ~p ops/s ", [Name, Value])
+                 || {Name, Value} <- Res])}.
+
+copy_term_bench(send, Term, N) ->
+    Tester = self(),
+    Rcvr = spawn_link(fun () ->
+                              copy_term_recv(N),
+                              Tester ! {done, self()}
+                      end),
+    Start = erlang:monotonic_time(),
+    [Rcvr ! Term || _ <- lists:seq(1, N)],
+    receive {done, Rcvr} -> ok end,
+    copy_term_time(Start);
+copy_term_bench(spawn, Term, N) ->
+    Start = erlang:monotonic_time(),
+    Mons = [spawn_monitor(erlang, element, [1, Term])
+            || _ <- lists:seq(1, N)],
+    [receive {'DOWN', Mon, process, Pid, _} -> ok end
+     || {Pid, Mon} <- Mons],
+    copy_term_time(Start);
+copy_term_bench(ets, Term, N) ->
+    Tab = ets:new(copy_term_bench, [set]),
+    Start = erlang:monotonic_time(),
+    [ets:insert(Tab, {K, Term}) || K <- lists:seq(1, N)],
+    Time = copy_term_time(Start),
+    ets:delete(Tab),
+    Time.
+
+copy_term_recv(0) ->
+    ok;
+copy_term_recv(N) ->
+    receive _ -> copy_term_recv(N-1) end.
+
+copy_term_time(Start) ->
+    Time = erlang:convert_time_unit(erlang:monotonic_time() - Start,
+                                    native, microsecond),
+    erlang:max(Time, 1).
+
 max_heap_size_test(Option, Size, Kill, ErrorLogger)
   when map_size(Option) == 0 ->
     max_heap_size_test([], Size, Kill, ErrorLogger);
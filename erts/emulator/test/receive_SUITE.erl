@@ -25,14 +25,16 @@
 -include_lib("common_test/include/ct.hrl").
 
 -export([all/0, suite/0,
-	 call_with_huge_message_queue/1,receive_in_between/1]).
+	 call_with_huge_message_queue/1,receive_in_between/1,
+	 wait_reply_huge_message_queue/1]).
 
 suite() ->
     [{ct_hooks,[ts_install_cth]},
      {timetrap, {minutes, 3}}].
 
 all() -> 
-    [call_with_huge_message_queue, receive_in_between].
+    [call_with_huge_message_queue, receive_in_between,
+     wait_reply_huge_message_queue].
 
 groups() -> 
     [].
@@ -98,6 +100,75 @@ receive_one() ->
 	dummy -> ok
     end.
 
+%% Wait for replies using references that were created long before
+%% the receive, which means that recv_mark/recv_set cannot be used.
+%% The reference index of the message queue should make this cheap
+%% even with a huge message queue, and must never reorder or lose
+%% any messages.
+wait_reply_huge_message_queue(Config) when is_list(Config) ->
+    {Time,ok} = tc(fun() -> wait_replies(500) end),
+
+    [self() ! {msg,N} || N <- lists:seq(1, 100000)],
+    {NewTime1,ok} = tc(fun() -> wait_replies(500) end),
+    {NewTime2,ok} = tc(fun() -> wait_replies(500) end),
+
+    io:format("Time for empty message queue: ~p", [Time]),
+    io:format("Time1 for huge message queue: ~p", [NewTime1]),
+    io:format("Time2 for huge message queue: ~p", [NewTime2]),
+
+    %% Remove a few messages in the middle of the queue.
+    [receive {msg,N} -> ok end || N <- lists:seq(50000, 50100)],
+    ok = wait_replies(500),
+    [receive {msg,N} -> ok end || N <- lists:seq(1, 49999)],
+    ok = wait_replies(500),
+    [receive {msg,N} -> ok end || N <- lists:seq(50101, 100000)],
+    {messages,[]} = process_info(self(), messages),
+
+    case hd(lists:sort([(NewTime1+1) / (Time+1), (NewTime2+1) / (Time+1)])) of
+	Q when Q < 10 ->
+	    ok;
+	Q ->
+	    ct:fail("Best Q = ~p", [Q])
+    end,
+    ok.
+
+wait_replies(N) ->
+    Self = self(),
+    Refs = [make_ref() || _ <- lists:seq(1, N)],
+    Tagged = lists:zip(Refs, lists:seq(1, N)),
+
+    %% Send half of the replies in reverse order before starting
+    %% to wait, and the other half from another process while
+    %% waiting.
+    {Early,Late} = lists:split(N div 2, Tagged),
+    [reply(Self, Ref, I) || {Ref,I} <- lists:reverse(Early)],
+    {_,Mref} = spawn_monitor(fun() ->
+					[reply(Self, Ref, I) || {Ref,I} <- Late]
+				end),
+    [I = wait_reply(Ref) || {Ref,I} <- Tagged],
+    normal = wait_reply(Mref),
+    ok.
+
+reply(Pid, Ref, I) when I rem 3 =:= 0 ->
+    Pid ! {reply,Ref,I};
+reply(Pid, Ref, I) when I rem 3 =:= 1 ->
+    Pid ! {Ref,I};
+reply(Pid, Ref, I) ->
+    Pid ! {Ref},
+    Pid ! {Ref,I}.
+
+wait_reply(Ref) ->
+    receive
+	{Ref} ->
+	    wait_reply(Ref);
+	{Ref,Reply} ->
+	    Reply;
+	{reply,Ref,Reply} ->
+	    Reply;
+	{'DOWN',Ref,process,_,Reason} ->
+	    Reason
+    end.
+
 %%%
 %%% Common helpers.
 %%%
@@ -175,7 +175,12 @@ int main(int argc, char** argv)
     g->conn           = NULL;
     g->nodes.reg = g->nodes.unreg = g->nodes.unreg_tail = NULL;
     g->nodes.unreg_count = 0;
+    g->nodes.tab      = NULL;
+    g->nodes.tab_size = g->nodes.tab_count = 0;
     g->active_conn    = 0;
+#ifdef EPMD_USE_EPOLL
+    g->epoll_fd       = -1;
+#endif
 #ifdef HAVE_SYSTEMD_DAEMON
     g->is_systemd     = 0;
 #endif /* HAVE_SYSTEMD_DAEMON */
@@ -267,6 +272,11 @@ int main(int argc, char** argv)
 #endif
       g->max_conn = MAX_FILES;
   
+#ifdef EPMD_USE_EPOLL
+    if (g->max_conn > MAX_POLL_FILES) {
+      g->max_conn = MAX_POLL_FILES;
+    }
+#else
     /*
      * max_conn must not be greater than FD_SETSIZE.
      * (at least QNX crashes)
@@ -275,6 +285,7 @@ int main(int argc, char** argv)
     if (g->max_conn > FD_SETSIZE) {
       g->max_conn = FD_SETSIZE;
     }
+#endif
 
     if (g->is_daemon)  {
 	run_daemon(g);
@@ -571,6 +582,8 @@ static void free_all_nodes(EpmdVars *g)
 	g->nodes.unreg = tmp->next;
 	free(tmp);
     }
+    free(g->nodes.tab);
+    g->nodes.tab = NULL;
 }
 void epmd_cleanup_exit(EpmdVars *g, int exitval)
 {
@@ -585,6 +598,10 @@ void epmd_cleanup_exit(EpmdVars *g, int exitval)
   for(i=0; i < MAX_LISTEN_SOCKETS; i++)
       if(g->listenfd[i] >= 0)
           close(g->listenfd[i]);
+#ifdef EPMD_USE_EPOLL
+  if (g->epoll_fd >= 0)
+      close(g->epoll_fd);
+#endif
   free_all_nodes(g);
   if(g->argv){
       for(i=0; g->argv[i] != NULL; ++i)
@@ -28,6 +28,7 @@
 #define EPMD_ALIVE2_RESP 'y'
 #define EPMD_PORT2_RESP 'w'
 #define EPMD_NAMES_REQ 'n'
+#define EPMD_PORT2_MULTI_REQ 'm'
 
 /* Interactive client command codes */
 #define EPMD_DUMP_REQ 'd'
@@ -105,6 +105,11 @@
 #  include <sys/select.h>
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H) && !defined(__WIN32__) && !defined(VXWORKS)
+#  define EPMD_USE_EPOLL
+#  include <sys/epoll.h>
+#endif
+
 #ifdef HAVE_UNISTD_H
 #  include <unistd.h>
 #endif
@@ -169,6 +174,13 @@
 
 #define MAX_FILES 2048		/* if sysconf() isn't available, or fails */
 
+/*
+ * When using epoll() we are not limited by FD_SETSIZE, but we still
+ * put a limit on the size of the connection table.
+ */
+
+#define MAX_POLL_FILES 65536
+
 /* ************************************************************************ */
 /* Macros that let us use IPv6                                              */
 
@@ -251,6 +263,19 @@ static const struct in6_addr in6addr_loopback =
 #define MAX_UNREG_COUNT 1000
 #define DEBUG_MAX_UNREG_COUNT 5
 
+/* Initial number of buckets in the node name hash table, a power of 2.
+   The table is doubled when it holds more names than buckets. */
+
+#define NODE_HASH_INIT_SIZE 256
+
+/* Max number of events fetched by each call to epoll_wait() */
+
+#define POLL_MAX_EVENTS 64
+
+/* Set in the poll tag of listen sockets, see poll_fd_set() */
+
+#define POLL_LISTEN_TAG 0x80000000U
+
 /*
  * Maximum length of a node name == atom name
  *   255 characters; UTF-8 encoded -> max 255*4
@@ -289,6 +314,8 @@ static const struct in6_addr in6addr_loopback =
 
 /* Stuctures used by server */
 
+struct enode;
+
 typedef struct {
   int fd;			/* File descriptor */
   unsigned char open;		/* TRUE if open */
@@ -298,12 +325,17 @@ typedef struct {
   unsigned got;			/* # of bytes we have got */
   unsigned want;		/* Number of bytes we want */
   char *buf;			/* The remaining buffer */
+  struct enode *node;		/* Node registered on this connection */
 
   time_t mod_time;		/* Last activity on this socket */
 } Connection;
 
 struct enode {
-  struct enode *next;
+  struct enode *next;		/* Next in "reg" or "unreg" list */
+  struct enode *prev;		/* Previous in "reg" or "unreg" list */
+  struct enode *hnext;		/* Next in hash bucket */
+  unsigned hval;		/* Hash value of symname */
+  unsigned char active;		/* TRUE if in "reg" list */
   int fd;			/* The socket in use */
   unsigned short port;		/* Port number of Erlang node */
   char symname[MAXSYMLEN+1];	/* Name of the Erlang node */
@@ -323,6 +355,9 @@ typedef struct {
   Node *unreg;
   Node *unreg_tail;
   int unreg_count;
+  Node **tab;			/* All nodes in "reg" and "unreg", by name */
+  unsigned tab_size;
+  unsigned tab_count;
 } Nodes;
 
 
@@ -340,11 +375,15 @@ typedef struct {
   unsigned delay_write;
   int max_conn;
   int active_conn;
-  int select_fd_top;
   char *progname;
   Connection *conn;
   Nodes nodes;
+#ifdef EPMD_USE_EPOLL
+  int epoll_fd;
+#else
+  int select_fd_top;
   fd_set orig_read_mask;
+#endif
   int listenfd[MAX_LISTEN_SOCKETS];
   char *addresses;
   char **argv;
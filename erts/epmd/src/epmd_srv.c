@@ -75,10 +75,16 @@ static int conn_local_peer_check(EpmdVars*, int);
 static int conn_close_fd(EpmdVars*,int);
 
 static void node_init(EpmdVars*);
+static Node *node_lookup(EpmdVars*,char*);
 static Node *node_reg2(EpmdVars*, int, char*, int, int, unsigned char, unsigned char, int, int, int, char*);
 static int node_unreg(EpmdVars*,char*);
-static int node_unreg_sock(EpmdVars*,int);
+static int node_unreg_sock(EpmdVars*,Connection*);
 
+static void poll_init(EpmdVars*);
+static int poll_fd_set(EpmdVars*,int,unsigned);
+static void poll_fd_clr(EpmdVars*,int);
+
+static int port2_resp(char*,Node*);
 static int reply(EpmdVars*,int,char *,int);
 static void dbg_print_buf(EpmdVars*,char *,int);
 static void print_names(EpmdVars*);
@@ -190,14 +196,6 @@ static int verify_utf8(const char *src, int sz, int null_term)
 }
 
 
-static EPMD_INLINE void select_fd_set(EpmdVars* g, int fd)
-{
-    FD_SET(fd, &g->orig_read_mask);
-    if (fd >= g->select_fd_top) {
-	g->select_fd_top = fd + 1;
-    }
-}
-
 void run(EpmdVars *g)
 {
   struct EPMD_SOCKADDR_IN iserv_addr[MAX_LISTEN_SOCKETS];
@@ -207,6 +205,7 @@ void run(EpmdVars *g)
   int opt;
   unsigned short sport = g->port;
   int bound = 0;
+  time_t last_check;
 
   node_init(g);
   g->conn = conn_init(g);
@@ -343,13 +342,15 @@ void run(EpmdVars *g)
   g->active_conn = 3 + num_sockets;
   g->max_conn -= num_sockets;
 
-  FD_ZERO(&g->orig_read_mask);
-  g->select_fd_top = 0;
+  poll_init(g);
 
 #ifdef HAVE_SYSTEMD_DAEMON
   if (g->is_systemd)
+    {
       for (i = 0; i < num_sockets; i++)
-          select_fd_set(g, listensock[i]);
+          if (poll_fd_set(g, listensock[i], POLL_LISTEN_TAG | listensock[i]) < 0)
+              epmd_cleanup_exit(g,1);
+    }
   else
     {
 #endif /* HAVE_SYSTEMD_DAEMON */
@@ -438,7 +439,8 @@ void run(EpmdVars *g)
           dbg_perror(g,"failed to listen on socket");
           epmd_cleanup_exit(g,1);
       }
-      select_fd_set(g, listensock[i]);
+      if (poll_fd_set(g, listensock[i], POLL_LISTEN_TAG | listensock[i]) < 0)
+          epmd_cleanup_exit(g,1);
     }
   if (bound == 0) {
       dbg_perror(g,"unable to bind any address");
@@ -454,19 +456,65 @@ void run(EpmdVars *g)
     }
 #endif /* HAVE_SYSTEMD_DAEMON */
 
+#ifdef EPMD_USE_EPOLL
+  dbg_tty_printf(g,2,"entering the main epoll() loop");
+#else
   dbg_tty_printf(g,2,"entering the main select() loop");
+#endif
+
+  last_check = current_time(g);
 
+#ifndef EPMD_USE_EPOLL
  select_again:
+#endif
   while(1)
     {
+#ifdef EPMD_USE_EPOLL
+      struct epoll_event events[POLL_MAX_EVENTS];
+#else
       fd_set read_mask = g->orig_read_mask;
       struct timeval timeout;
+#endif
       int ret;
+      time_t now;
 
       /* If we are idle we time out now and then to enable the code
 	 below to close connections that are old and probably
 	 hanging. Make sure that select will return often enough. */
 
+#ifdef EPMD_USE_EPOLL
+      if ((ret = epoll_wait(g->epoll_fd, events, POLL_MAX_EVENTS,
+			    ((g->packet_timeout < IDLE_TIMEOUT) ?
+			     1 : IDLE_TIMEOUT) * 1000)) < 0) {
+	dbg_perror(g,"error in epoll_wait ");
+        switch (errno) {
+          case EINTR:
+            break;
+          default:
+            epmd_cleanup_exit(g,1);
+        }
+	continue;
+      }
+
+      if (g->delay_accept) {		/* Test of busy server */
+	sleep(g->delay_accept);
+      }
+
+      /* Read from connections before accepting new ones, so that
+	 a slot closed while handling a request is not reused by a
+	 new connection while there are events left for it. */
+
+      for (i = 0; i < ret; i++) {
+	unsigned tag = events[i].data.u32;
+	if (!(tag & POLL_LISTEN_TAG) && g->conn[tag].open == EPMD_TRUE)
+	  do_read(g,&g->conn[tag]);
+      }
+      for (i = 0; i < ret; i++) {
+	unsigned tag = events[i].data.u32;
+	if (tag & POLL_LISTEN_TAG)
+	  do_accept(g, (int) (tag & ~POLL_LISTEN_TAG));
+      }
+#else
       timeout.tv_sec = (g->packet_timeout < IDLE_TIMEOUT) ? 1 : IDLE_TIMEOUT;
       timeout.tv_usec = 0;
 
@@ -480,43 +528,52 @@ void run(EpmdVars *g)
           default:
             epmd_cleanup_exit(g,1);
         }
+	continue;
       }
-      else {
-	time_t now;
-	if (ret == 0) {
-	  FD_ZERO(&read_mask);
-	}
-	if (g->delay_accept) {		/* Test of busy server */
-	  sleep(g->delay_accept);
-	}
 
-	for (i = 0; i < num_sockets; i++)
-	  if (FD_ISSET(g->listenfd[i],&read_mask)) {
-	    if (do_accept(g, g->listenfd[i]) && g->active_conn < g->max_conn) {
-	      /*
-	       * The accept() succeeded, and we have at least one file
-	       * descriptor still free, which means that another accept()
-	       * could succeed. Go do do another select(), in case there
-	       * are more incoming connections waiting to be accepted.
-	       */
-	      goto select_again;
-	    }
+      if (ret == 0) {
+	FD_ZERO(&read_mask);
+      }
+      if (g->delay_accept) {		/* Test of busy server */
+	sleep(g->delay_accept);
+      }
+
+      for (i = 0; i < num_sockets; i++)
+	if (FD_ISSET(g->listenfd[i],&read_mask)) {
+	  if (do_accept(g, g->listenfd[i]) && g->active_conn < g->max_conn) {
+	    /*
+	     * The accept() succeeded, and we have at least one file
+	     * descriptor still free, which means that another accept()
+	     * could succeed. Go do do another select(), in case there
+	     * are more incoming connections waiting to be accepted.
+	     */
+	    goto select_again;
 	  }
-	  
-	/* Check all open streams marked by select for data or a
-	   close.  We also close all open sockets except ALIVE
-	   with no activity for a long period */
+	}
 
-	now = current_time(g);
+      /* Check all open streams marked by select for data or a
+	 close. */
+
+      for (i = 0; i < g->max_conn; i++) {
+	if (g->conn[i].open == EPMD_TRUE &&
+	    FD_ISSET(g->conn[i].fd,&read_mask))
+	  do_read(g,&g->conn[i]);
+      }
+#endif
+
+      /* We also close all open sockets except ALIVE with no
+	 activity for a long period. Time is counted in seconds so
+	 there is no need to look more often than that. */
+
+      now = current_time(g);
+      if (now != last_check) {
+	last_check = now;
 	for (i = 0; i < g->max_conn; i++) {
-	  if (g->conn[i].open == EPMD_TRUE) {
-	    if (FD_ISSET(g->conn[i].fd,&read_mask))
-	      do_read(g,&g->conn[i]);
-	    else if ((g->conn[i].keep == EPMD_FALSE) &&
-		     ((g->conn[i].mod_time + g->packet_timeout) < now)) {
-	      dbg_tty_printf(g,1,"closing because timed out on receive");
-	      epmd_conn_close(g,&g->conn[i]);
-	    }
+	  if ((g->conn[i].open == EPMD_TRUE) &&
+	      (g->conn[i].keep == EPMD_FALSE) &&
+	      ((g->conn[i].mod_time + g->packet_timeout) < now)) {
+	    dbg_tty_printf(g,1,"closing because timed out on receive");
+	    epmd_conn_close(g,&g->conn[i]);
 	  }
 	}
       }
@@ -549,14 +606,14 @@ static void do_read(EpmdVars *g,Connection *s)
 
       if (val == 0)
 	{
-	  node_unreg_sock(g,s->fd);
+	  node_unreg_sock(g,s);
 	  epmd_conn_close(g,s);
 	}
       else if (val < 0)
 	{
 	    dbg_tty_printf(g,1,"error on ALIVE socket %d (%d; errno=0x%x)",
 			   s->fd, val, errno);
-	  node_unreg_sock(g,s->fd);
+	  node_unreg_sock(g,s);
 	  epmd_conn_close(g,s);
 	}
       else
@@ -565,7 +622,7 @@ static void do_read(EpmdVars *g,Connection *s)
 		 s->fd,val);
 	  dbg_print_buf(g,s->buf,val);
 
-	  node_unreg_sock(g,s->fd);
+	  node_unreg_sock(g,s);
 	  epmd_conn_close(g,s);
 	}
       return;
@@ -757,6 +814,7 @@ static void do_request(g, fd, s, buf, bsize)
 
 	dbg_tty_printf(g,1,"** sent ALIVE2_RESP for \"%s\"",name);
 	s->keep = EPMD_TRUE;		/* Don't close on inactivity */
+	s->node = node;
       }
       break;
 
@@ -790,33 +848,18 @@ static void do_request(g, fd, s, buf, bsize)
 	    return;
 	}
 
-	wbuf[0] = EPMD_PORT2_RESP;
-	for (node = g->nodes.reg; node; node = node->next) {
-	    int offset;
-	    if (is_same_str(node->symname, name)) {
-		wbuf[1] = 0; /* ok */
-		put_int16(node->port,wbuf+2);
-		wbuf[4] = node->nodetype;
-		wbuf[5] = node->protocol;
-		put_int16(node->highvsn,wbuf+6);
-		put_int16(node->lowvsn,wbuf+8);
-		put_int16(length_str(node->symname),wbuf+10);
-		offset = 12;
-		offset += copy_str(wbuf + offset,node->symname);
-		put_int16(node->extralen,wbuf + offset);
-		offset += 2;
-		memcpy(wbuf + offset,node->extra,node->extralen);
-		offset += node->extralen;
-		if (reply(g, fd, wbuf, offset) != offset)
-		  {
-		    dbg_tty_printf(g,1,"** failed to send PORT2_RESP (ok) for \"%s\"",name);
-		    return;
-		  }
-		dbg_tty_printf(g,1,"** sent PORT2_RESP (ok) for \"%s\"",name);
+	node = node_lookup(g, name);
+	if (node && node->active) {
+	    int offset = port2_resp(wbuf, node);
+	    if (reply(g, fd, wbuf, offset) != offset)
+	      {
+		dbg_tty_printf(g,1,"** failed to send PORT2_RESP (ok) for \"%s\"",name);
 		return;
-	    }
+	      }
+	    dbg_tty_printf(g,1,"** sent PORT2_RESP (ok) for \"%s\"",name);
+	    return;
 	}
-	wbuf[1] = 1; /* error */
+	port2_resp(wbuf, NULL);
 	if (reply(g, fd, wbuf, 2) != 2)
 	  {
 	    dbg_tty_printf(g,1,"** failed to send PORT2_RESP (error) for \"%s\"",name);
@@ -827,6 +870,82 @@ static void do_request(g, fd, s, buf, bsize)
       }
       break;
 
+    case EPMD_PORT2_MULTI_REQ:
+      dbg_printf(g,1,"** got PORT2_MULTI_REQ");
+
+      /* The packet has the format "m" followed by one or more node
+	 names, each preceded by its length in two bytes. We answer
+	 with one PORT2_RESP for each name, in the same order. */
+
+      {
+	char name[MAXSYMLEN+1];
+	int count = 0;
+	int offset = 0;
+	int namelen = 0;
+	Node *node;
+
+	for (i = 1; i < bsize; i += 2 + namelen)
+	  {
+	    int j, nsz;
+
+	    if (i + 2 > bsize ||
+		(namelen = get_int16(&buf[i])) == 0 ||
+		i + 2 + namelen > bsize)
+	      {
+		dbg_printf(g,0,"node name size error in PORT2_MULTI_REQ");
+		return;
+	      }
+	    for (j = i + 2; j < i + 2 + namelen; j++)
+	      if (buf[j] == '\000')
+		{
+		  dbg_printf(g,0,"node name contains ascii 0 in PORT2_MULTI_REQ");
+		  return;
+		}
+	    nsz = verify_utf8(&buf[i + 2], namelen, 0);
+	    if (nsz < 1 || 255 < nsz) {
+		dbg_printf(g,0,"invalid node name in PORT2_MULTI_REQ");
+		return;
+	    }
+	    count++;
+	  }
+
+	if (count == 0)
+	  {
+	    dbg_printf(g,0,"packet too small for request PORT2_MULTI_REQ (%d)",
+		       bsize);
+	    return;
+	  }
+
+	for (i = 1; i < bsize; i += 2 + namelen)
+	  {
+	    namelen = get_int16(&buf[i]);
+	    memcpy(name, &buf[i + 2], namelen);
+	    name[namelen] = '\000';
+
+	    /* Room for the largest possible response? */
+	    if (OUTBUF_SIZE - offset < 14 + 2*MAXSYMLEN)
+	      {
+		if (reply(g, fd, wbuf, offset) != offset)
+		  goto failed_port2_multi_resp;
+		offset = 0;
+	      }
+
+	    node = node_lookup(g, name);
+	    offset += port2_resp(wbuf + offset,
+				 (node && node->active) ? node : NULL);
+	  }
+
+	if (reply(g, fd, wbuf, offset) != offset)
+	  {
+	  failed_port2_multi_resp:
+	    dbg_tty_printf(g,1,"** failed to send PORT2_RESP for %d names",
+			   count);
+	    return;
+	  }
+	dbg_tty_printf(g,1,"** sent PORT2_RESP for %d names",count);
+      }
+      break;
+
     case EPMD_NAMES_REQ:
       dbg_printf(g,1,"** got NAMES_REQ");
       {
@@ -1003,6 +1122,62 @@ static void do_request(g, fd, s, buf, bsize)
 }
 
 
+/****************************************************************************
+ *
+ *  Wait for sockets to read, using epoll() if available, otherwise select()
+ *
+ ****************************************************************************/
+
+static void poll_init(EpmdVars *g)
+{
+#ifdef EPMD_USE_EPOLL
+  if ((g->epoll_fd = epoll_create(g->max_conn)) < 0)
+    {
+      dbg_perror(g,"cannot create epoll set");
+      epmd_cleanup_exit(g,1);
+    }
+#else
+  FD_ZERO(&g->orig_read_mask);
+  g->select_fd_top = 0;
+#endif
+}
+
+/* The tag is the connection slot, or the file descriptor with
+   POLL_LISTEN_TAG set for a listen socket. */
+
+static int poll_fd_set(EpmdVars *g, int fd, unsigned tag)
+{
+#ifdef EPMD_USE_EPOLL
+  struct epoll_event ev;
+
+  ev.events = EPOLLIN;
+  ev.data.u64 = 0;
+  ev.data.u32 = tag;
+  if (epoll_ctl(g->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+      dbg_perror(g,"failed to add file descriptor %d to epoll set",fd);
+      return -1;
+    }
+#else
+  FD_SET(fd, &g->orig_read_mask);
+  if (fd >= g->select_fd_top) {
+    g->select_fd_top = fd + 1;
+  }
+#endif
+  return 0;
+}
+
+/* With epoll() there is nothing to do; closing the file descriptor
+   removes it from the epoll set */
+
+static void poll_fd_clr(EpmdVars *g, int fd)
+{
+#ifndef EPMD_USE_EPOLL
+  FD_CLR(fd,&g->orig_read_mask);
+  /* we don't bother lowering g->select_fd_top */
+#endif
+}
+
 /****************************************************************************
  *
  *  Handle database with data for each socket to read
@@ -1052,15 +1227,19 @@ static int conn_open(EpmdVars *g,int fd)
 
   for (i = 0; i < g->max_conn; i++) {
     if (g->conn[i].open == EPMD_FALSE) {
+      /* From now on we want to know if there are data to be read */
+      if (poll_fd_set(g, fd, i) < 0) {
+	close(fd);
+	return EPMD_FALSE;
+      }
+
       g->active_conn++;
       s = &g->conn[i];
-     
-      /* From now on we want to know if there are data to be read */
-      select_fd_set(g, fd);
 
       s->fd   = fd;
       s->open = EPMD_TRUE;
       s->keep = EPMD_FALSE;
+      s->node = NULL;
 
       s->local_peer = conn_local_peer_check(g, s->fd);
       dbg_tty_printf(g,2,(s->local_peer) ? "Local peer connected" :
@@ -1147,7 +1326,7 @@ static int conn_close_fd(EpmdVars *g,int fd)
   int i;
 
   for (i = 0; i < g->max_conn; i++)
-    if (g->conn[i].fd == fd)
+    if (g->conn[i].open == EPMD_TRUE && g->conn[i].fd == fd)
       {
 	epmd_conn_close(g,&g->conn[i]);
 	return EPMD_TRUE;
@@ -1161,10 +1340,10 @@ int epmd_conn_close(EpmdVars *g,Connection *s)
 {
   dbg_tty_printf(g,2,"closing connection on file descriptor %d",s->fd);
 
-  FD_CLR(s->fd,&g->orig_read_mask);
-  /* we don't bother lowering g->select_fd_top */
+  poll_fd_clr(g,s->fd);
   close(s->fd);			/* Sometimes already closed but close anyway */
   s->open = EPMD_FALSE;
+  s->node = NULL;
   if (s->buf != NULL) {		/* Should never be NULL but test anyway */
     free(s->buf);
   }
@@ -1185,81 +1364,168 @@ static void node_init(EpmdVars *g)
   g->nodes.unreg       = NULL;
   g->nodes.unreg_tail  = NULL;
   g->nodes.unreg_count = 0;
+  g->nodes.tab_size    = NODE_HASH_INIT_SIZE;
+  g->nodes.tab_count   = 0;
+  g->nodes.tab = (Node **)calloc(g->nodes.tab_size, sizeof(Node *));
+  if (g->nodes.tab == NULL)
+    {
+      dbg_printf(g,0,"epmd: Insufficient memory");
+      exit(1);
+    }
 }
 
+/*
+ * All nodes, registered or not, are also kept in a hash table on the
+ * name. A name is never in both the "reg" and the "unreg" list.
+ */
 
-/* We have got a close on a connection and it may be a
-   EPMD_ALIVE_CLOSE_REQ. Note that this call should be called
-   *before* calling conn_close() */
+static unsigned node_hash(char *name)
+{
+  unsigned char *p = (unsigned char *) name;
+  unsigned h = 0;
+  unsigned hg;
 
-static int node_unreg(EpmdVars *g,char *name)
+  while (*p)
+    {
+      h = (h << 4) + *p++;
+      if ((hg = h & 0xf0000000) != 0)
+	{
+	  h ^= (hg >> 24);
+	  h ^= hg;
+	}
+    }
+  return h;
+}
+
+static Node *node_lookup(EpmdVars *g, char *name)
 {
-  Node **prev = &g->nodes.reg;	/* Point to cell pointing to... */
-  Node *node  = g->nodes.reg;	/* Point to first node */
+  unsigned hval = node_hash(name);
+  Node *node = g->nodes.tab[hval & (g->nodes.tab_size - 1)];
 
-  for (; node; prev = &node->next, node = node->next)
-    if (is_same_str(node->symname, name))
-      {
-	dbg_tty_printf(g,1,"unregistering '%s:%d', port %d",
-		       node->symname, node->creation, node->port);
+  for (; node; node = node->hnext)
+    if (node->hval == hval && is_same_str(node->symname, name))
+      return node;
+  return NULL;
+}
 
-	*prev = node->next;	/* Link out from "reg" list */
+static void node_hash_put(EpmdVars *g, Node *node)
+{
+  Node **bucket;
 
-	if (g->nodes.unreg == NULL) /* Link into "unreg" list */
-	  g->nodes.unreg = g->nodes.unreg_tail = node;
-	else
-	  {
-	    g->nodes.unreg_tail->next = node;
-	    g->nodes.unreg_tail = node;
-	  }
+  if (g->nodes.tab_count >= g->nodes.tab_size)
+    {
+      unsigned size = 2 * g->nodes.tab_size;
+      Node **tab = (Node **)calloc(size, sizeof(Node *));
+      unsigned i;
 
-	g->nodes.unreg_count++;
+      if (tab != NULL)		/* Keep the old table if out of memory */
+	{
+	  for (i = 0; i < g->nodes.tab_size; i++)
+	    {
+	      Node *next, *n;
+	      for (n = g->nodes.tab[i]; n; n = next)
+		{
+		  next = n->hnext;
+		  n->hnext = tab[n->hval & (size - 1)];
+		  tab[n->hval & (size - 1)] = n;
+		}
+	    }
+	  free(g->nodes.tab);
+	  g->nodes.tab = tab;
+	  g->nodes.tab_size = size;
+	}
+    }
 
-	node->next = NULL;	/* Last in list == first in FIFO queue */
+  node->hval = node_hash(node->symname);
+  bucket = &g->nodes.tab[node->hval & (g->nodes.tab_size - 1)];
+  node->hnext = *bucket;
+  *bucket = node;
+  g->nodes.tab_count++;
+}
 
-	print_names(g);
+static void node_hash_remove(EpmdVars *g, Node *node)
+{
+  Node **prev = &g->nodes.tab[node->hval & (g->nodes.tab_size - 1)];
 
-	return node->fd;
+  for (; *prev; prev = &(*prev)->hnext)
+    if (*prev == node)
+      {
+	*prev = node->hnext;
+	g->nodes.tab_count--;
+	return;
       }
+}
 
-  dbg_tty_printf(g,1,"trying to unregister node with unknown name %s", name);
-  return -1;
+/* Link out a node from the "reg" list, or from the "unreg" list if
+   tail is not NULL */
+
+static void node_list_remove(Node **head, Node **tail, Node *node)
+{
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    *head = node->next;
+
+  if (node->next)
+    node->next->prev = node->prev;
+  else if (tail)
+    *tail = node->prev;
+
+  node->next = node->prev = NULL;
 }
 
+/* Move a registered node last in the "unreg" FIFO queue */
 
-static int node_unreg_sock(EpmdVars *g,int fd)
+static int node_unreg_node(EpmdVars *g, Node *node)
 {
-  Node **prev = &g->nodes.reg;	/* Point to cell pointing to... */
-  Node *node  = g->nodes.reg;	/* Point to first node */
+  dbg_tty_printf(g,1,"unregistering '%s:%d', port %d",
+		 node->symname, node->creation, node->port);
 
-  for (; node; prev = &node->next, node = node->next)
-    if (node->fd == fd)
-      {
-	dbg_tty_printf(g,1,"unregistering '%s:%d', port %d",
-		       node->symname, node->creation, node->port);
+  node_list_remove(&g->nodes.reg, NULL, node); /* Link out from "reg" list */
+  node->active = EPMD_FALSE;
 
-	*prev = node->next;	/* Link out from "reg" list */
+  node->prev = g->nodes.unreg_tail; /* Link into "unreg" list */
+  if (g->nodes.unreg == NULL)
+    g->nodes.unreg = node;
+  else
+    g->nodes.unreg_tail->next = node;
+  g->nodes.unreg_tail = node;
 
-	if (g->nodes.unreg == NULL) /* Link into "unreg" list */
-	  g->nodes.unreg = g->nodes.unreg_tail = node;
-	else
-	  {
-	    g->nodes.unreg_tail->next = node;
-	    g->nodes.unreg_tail = node;
-	  }
+  g->nodes.unreg_count++;
 
-	g->nodes.unreg_count++;
+  print_names(g);
 
-	node->next = NULL;	/* Last in list == first in FIFO queue */
+  return node->fd;
+}
+
+/* We have got a close on a connection and it may be a
+   EPMD_ALIVE_CLOSE_REQ. Note that this call should be called
+   *before* calling conn_close() */
 
-	print_names(g);
+static int node_unreg(EpmdVars *g,char *name)
+{
+  Node *node = node_lookup(g, name);
 
-	return node->fd;
-      }
+  if (node && node->active)
+    return node_unreg_node(g, node);
+
+  dbg_tty_printf(g,1,"trying to unregister node with unknown name %s", name);
+  return -1;
+}
+
+
+static int node_unreg_sock(EpmdVars *g,Connection *s)
+{
+  if (s->node && s->node->active && s->node->fd == s->fd)
+    {
+      Node *node = s->node;
+      s->node = NULL;
+      return node_unreg_node(g, node);
+    }
 
   dbg_tty_printf(g,1,
 		 "trying to unregister node with unknown file descriptor %d",
-		 fd);
+		 s->fd);
   return -1;
 }
 
@@ -1289,8 +1555,7 @@ static Node *node_reg2(EpmdVars *g,
 		       int extralen,
 		       char* extra)
 {
-  Node *prev;			/* Point to previous node or NULL */
-  Node *node;			/* Point to first node */
+  Node *node;
   int sz;
 
   /* Can be NULL; means old style */
@@ -1338,51 +1603,29 @@ static Node *node_reg2(EpmdVars *g,
 
   /* Fail if it is already registered */
 
-  for (node = g->nodes.reg; node; node = node->next)
-    if (is_same_str(node->symname, name))
-      {
-	dbg_printf(g,0,"node name already occupied %s", name);
-	return NULL;
-      }
+  node = node_lookup(g, name);
+
+  if (node && node->active)
+    {
+      dbg_printf(g,0,"node name already occupied %s", name);
+      return NULL;
+    }
 
   /* Try to find the name in the used queue so that we
      can change "creation" number 1..3 */
 
-  prev = NULL;
-
-  for (node = g->nodes.unreg; node; prev = node, node = node->next)
-    if (is_same_str(node->symname, name))
-      {
-	dbg_tty_printf(g,1,"reusing slot with same name '%s'", node->symname);
-
-	if (prev == NULL)	/* First in list matched */
-	  {
-	    if (node->next == NULL) /* Only one element */
-	      g->nodes.unreg = g->nodes.unreg_tail = NULL;
-	    else
-	      g->nodes.unreg = node->next;
-	  }
-	else
-	  {
-	    if (node->next == NULL) /* Last in list */
-	      {
-		g->nodes.unreg_tail = prev; /* Point to new last */
-		prev->next = NULL; /* New last has no next */
-	      }
-	    else
-	      prev->next = node->next; /* Simple link out from list */
-	  }
-
-	g->nodes.unreg_count--;
-
-	/* When reusing we change the "creation" number 1..3 */
+  if (node)
+    {
+      dbg_tty_printf(g,1,"reusing slot with same name '%s'", node->symname);
 
-	node->creation = node->creation % 3 + 1;
+      node_list_remove(&g->nodes.unreg, &g->nodes.unreg_tail, node);
+      g->nodes.unreg_count--;
 
-	break;
-      }
+      /* When reusing we change the "creation" number 1..3 */
 
-  if (node == NULL)
+      node->creation = node->creation % 3 + 1;
+    }
+  else
     {
       /* A new name. If the "unreg" list is too long we steal the
 	 oldest node structure and use it for the new node, else
@@ -1391,10 +1634,10 @@ static Node *node_reg2(EpmdVars *g,
       if ((g->nodes.unreg_count > MAX_UNREG_COUNT) ||
 	  (g->debug && (g->nodes.unreg_count > DEBUG_MAX_UNREG_COUNT)))
 	{
-	  /* MAX_UNREG_COUNT > 1 so no need to check unreg_tail */
 	  node = g->nodes.unreg;	/* Take first == oldest */
-	  g->nodes.unreg = node->next; /* Link out */
+	  node_list_remove(&g->nodes.unreg, &g->nodes.unreg_tail, node);
 	  g->nodes.unreg_count--;
+	  node_hash_remove(g, node);
 	}
       else
 	{
@@ -1406,10 +1649,17 @@ static Node *node_reg2(EpmdVars *g,
 
 	  node->creation = (current_time(g) % 3) + 1; /* "random" 1-3 */
 	}
+
+      copy_str(node->symname,name);
+      node_hash_put(g, node);
     }
 
-  node->next = g->nodes.reg; /* Link into "reg" queue */
+  node->prev = NULL;		/* Link into "reg" queue */
+  node->next = g->nodes.reg;
+  if (g->nodes.reg)
+    g->nodes.reg->prev = node;
   g->nodes.reg  = node;
+  node->active = EPMD_TRUE;
 
   node->fd       = fd;
   node->port     = port;
@@ -1419,8 +1669,6 @@ static Node *node_reg2(EpmdVars *g,
   node->lowvsn   = lowvsn;
   node->extralen = extralen;
   memcpy(node->extra,extra,extralen);
-  copy_str(node->symname,name);
-  select_fd_set(g, fd);
 
   if (highvsn == 0) {
     dbg_tty_printf(g,1,"registering '%s:%d', port %d",
@@ -1438,6 +1686,35 @@ static Node *node_reg2(EpmdVars *g,
 }
   
 
+/* Encode a PORT2_RESP for a registered node, or an error response
+   if node is NULL. Returns the number of bytes written to buf. */
+
+static int port2_resp(char *buf, Node *node)
+{
+  int offset;
+
+  buf[0] = EPMD_PORT2_RESP;
+  if (node == NULL)
+    {
+      buf[1] = 1; /* error */
+      return 2;
+    }
+  buf[1] = 0; /* ok */
+  put_int16(node->port,buf+2);
+  buf[4] = node->nodetype;
+  buf[5] = node->protocol;
+  put_int16(node->highvsn,buf+6);
+  put_int16(node->lowvsn,buf+8);
+  put_int16(length_str(node->symname),buf+10);
+  offset = 12;
+  offset += copy_str(buf + offset,node->symname);
+  put_int16(node->extralen,buf + offset);
+  offset += 2;
+  memcpy(buf + offset,node->extra,node->extralen);
+  offset += node->extralen;
+  return offset;
+}
+
 static time_t current_time(EpmdVars *g)
 {
   time_t t = time((time_t *)0);
@@ -46,6 +46,8 @@
          long_unicode_name/1,
          get_port_nr/1,
          slow_get_port_nr/1,
+         get_port_nr_multi/1,
+         bad_port_multi_req/1,
          unregister_others_name_1/1,
          unregister_others_name_2/1,
          register_overflow/1,
@@ -97,6 +99,7 @@
 -define(EPMD_PORT_PLEASE2_REQ,	$z).
 -define(EPMD_PORT2_RESP,	$w).
 -define(EPMD_NAMES_REQ,	$n).
+-define(EPMD_PORT_PLEASE2_MULTI_REQ,	$m).
 -define(EPMD_DUMP_REQ,	$d).
 -define(EPMD_KILL_REQ,	$k).
 -define(EPMD_STOP_REQ,	$s).
@@ -114,6 +117,7 @@ all() ->
      register_names_1, register_names_2,
      register_duplicate_name, unicode_name, long_unicode_name,
      get_port_nr, slow_get_port_nr,
+     get_port_nr_multi, bad_port_multi_req,
      unregister_others_name_1, unregister_others_name_2,
      register_overflow, name_with_null_inside,
      name_null_terminated, stupid_names_req, no_data,
@@ -420,6 +424,63 @@ port_request(M) ->
     end,
     ok.
 
+%% Ask for the port numbers of several nodes in one request
+get_port_nr_multi(Config) when is_list(Config) ->
+    ok = epmdrun(),
+    {ok,RSock1} = register_node("foo", 1042),
+    {ok,RSock2} = register_node([16#1f608], 1043),
+    M = port_please_multi_req(["foo", "bar", [16#1f608], "foo"]),
+    {ok,Sock} = connect(),
+    ok = send(Sock,[size16(M),M]),
+    {ok,Resp} = recv_until_sock_closes(Sock),
+    [{ok,#node_info{port=1042,node_name="foo"}},
+     error,
+     {ok,#node_info{port=1043,node_name=[16#1f608]}},
+     {ok,#node_info{port=1042,node_name="foo"}}] =
+        parse_port2_multi_resp(list_to_binary(Resp)),
+    ok = close(RSock1),
+    ok = close(RSock2),
+    ok.
+
+%% Malformed multi requests are not answered
+bad_port_multi_req(Config) when is_list(Config) ->
+    ok = epmdrun(),
+    {ok,RSock} = register_node("foo", 1042),
+    lists:foreach(
+      fun(M) ->
+              {ok,Sock} = connect(),
+              ok = send(Sock,[size16(M),M]),
+              {ok,[]} = recv_until_sock_closes(Sock)
+      end,
+      [[?EPMD_PORT_PLEASE2_MULTI_REQ],
+       [?EPMD_PORT_PLEASE2_MULTI_REQ,put16(4),"foo"],
+       [?EPMD_PORT_PLEASE2_MULTI_REQ,put16(3),"foo",put16(0)],
+       [?EPMD_PORT_PLEASE2_MULTI_REQ,put16(3),"foo",0],
+       [?EPMD_PORT_PLEASE2_MULTI_REQ,put16(3),"f",0,"o"]]),
+    ok = close(RSock),
+    ok.
+
+port_please_multi_req(Names) ->
+    [?EPMD_PORT_PLEASE2_MULTI_REQ |
+     [begin
+          Utf8Name = unicode:characters_to_binary(Name),
+          [put16(size(Utf8Name)), binary_to_list(Utf8Name)]
+      end || Name <- Names]].
+
+parse_port2_multi_resp(<<>>) ->
+    [];
+parse_port2_multi_resp(<<?EPMD_PORT2_RESP,0,Port:16,NodeType,Prot,
+                         HVsn:16,LVsn:16,
+                         NLen:16,NodeName:NLen/binary,
+                         ELen:16,Extra:ELen/binary,Rest/binary>>) ->
+    [{ok, #node_info{port=Port,node_type=NodeType,prot=Prot,
+                     hvsn=HVsn,lvsn=LVsn,
+                     node_name=unicode:characters_to_list(NodeName),
+                     extra=binary_to_list(Extra)}} |
+     parse_port2_multi_resp(Rest)];
+parse_port2_multi_resp(<<?EPMD_PORT2_RESP,Res,Rest/binary>>) when Res > 0 ->
+    [error | parse_port2_multi_resp(Rest)].
+
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
 %% Unregister name of other node
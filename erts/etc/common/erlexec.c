@@ -84,6 +84,7 @@ static char *plusM_au_alloc_switches[] = {
     "as",
     "asbcst",
     "acul",
+    "bcs",
     "e",
     "t",
     "lmbcs",
@@ -115,10 +116,12 @@ static char *plusM_other_switches[] = {
     "Mamcbf",
     "Mrmcbf",
     "Mmcs",
+    "Mmsl",
     "Mscs",
     "Mscrfsd",
     "Msco",
     "Mscrpm",
+    "Mhp",
     "Ye",
     "Ym",
     "Ytp",
@@ -167,6 +170,8 @@ static char *plusr_val_switches[] = {
 /* +z arguments with values */
 static char *plusz_val_switches[] = {
     "dbbl",
+    "dbrt",
+    "dct",
     "dntgc",
     "ebwt",
     NULL
@@ -859,6 +864,17 @@ int main(int argc, char **argv)
 		      add_Eargs(argv[i+1]);
 		      i++;
 		      break;
+		  case 'I':
+		      if (argv[i][2] != 'O' || argv[i][3] != 'p'
+			  || argv[i][4] != '\0')
+			  goto the_default;
+		      if (i+1 >= argc)
+			  usage(argv[i]);
+		      argv[i][0] = '-';
+		      add_Eargs(argv[i]);
+		      add_Eargs(argv[i+1]);
+		      i++;
+		      break;
 		  case 'S':
 		      if (argv[i][2] == 'P') {
 			  if (argv[i][3] != '\0')
@@ -140,6 +140,7 @@
 -export([unique_integer/0, unique_integer/1]).
 -export([time_offset/0, time_offset/1, timestamp/0]).
 -export([process_display/2]).
+-export([publish_shared/1, shared_term/1]).
 -export([process_flag/3, process_info/1, processes/0, purge_module/1]).
 -export([put/2, raise/3, read_timer/1, read_timer/2, ref_to_list/1, register/2]).
 -export([send_after/3, send_after/4, start_timer/3, start_timer/4]).
@@ -163,7 +164,8 @@
          process_info/2, send/2, send/3, seq_trace_info/1,
          setelement/3, spawn_opt/1,
 	 statistics/1, subtract/2, system_flag/2,
-         term_to_binary/1, term_to_binary/2, tl/1, trace_pattern/2,
+         term_to_binary/1, term_to_binary/2,
+         term_to_iovec/1, term_to_iovec/2, tl/1, trace_pattern/2,
          trace_pattern/3, tuple_to_list/1, system_info/1,
          universaltime_to_localtime/1]).
 -export([dt_get_tag/0, dt_get_tag_data/0, dt_prepend_vm_tag_data/1, dt_append_vm_tag_data/1,
@@ -1472,6 +1474,13 @@ process_info(_Pid) ->
 processes() ->
     erlang:nif_error(undefined).
 
+%% publish_shared/1
+-spec erlang:publish_shared(Term) -> SharedRef when
+      Term :: term(),
+      SharedRef :: binary().
+publish_shared(_Term) ->
+    erlang:nif_error(undefined).
+
 %% purge_module/1
 -spec purge_module(Module) -> true when
       Module :: atom().
@@ -1614,10 +1623,16 @@ setnode(_P1, _P2) ->
 -spec erlang:setnode(P1, P2, P3) -> true when
       P1 :: atom(),
       P2 :: port(),
-      P3 :: {term(), term(), term(), term()}.
+      P3 :: {term(), term(), term(), term()} | {term(), term(), term()}.
 setnode(_P1, _P2, _P3) ->
     erlang:nif_error(undefined).
 
+%% shared_term/1
+-spec erlang:shared_term(SharedRef) -> term() when
+      SharedRef :: binary().
+shared_term(_SharedRef) ->
+    erlang:nif_error(undefined).
+
 %% size/1
 %% Shadowed by erl_bif_types: erlang:size/1
 -spec size(Item) -> non_neg_integer() when
@@ -2086,6 +2101,12 @@ open_port(PortName, PortSettings) ->
 -type message_queue_data() ::
 	off_heap | on_heap.
 
+-type message_queue_limit() ::
+        Size :: non_neg_integer()
+      | #{ size => non_neg_integer(),
+           low_watermark => non_neg_integer(),
+           policy => drop | signal | suspend }.
+
 -spec process_flag(trap_exit, Boolean) -> OldBoolean when
       Boolean :: boolean(),
       OldBoolean :: boolean();
@@ -2104,6 +2125,9 @@ open_port(PortName, PortSettings) ->
                   (message_queue_data, MQD) -> OldMQD when
       MQD :: message_queue_data(),
       OldMQD :: message_queue_data();
+                  (message_queue_limit, MQL) -> OldMQL when
+      MQL :: message_queue_limit(),
+      OldMQL :: message_queue_limit();
                   (priority, Level) -> OldLevel when
       Level :: priority_level(),
       OldLevel :: priority_level();
@@ -2144,6 +2168,7 @@ process_flag(_Flag, _Value) ->
       monitored_by |
       monitors |
       message_queue_data |
+      message_queue_limit |
       priority |
       reductions |
       registered_name |
@@ -2188,6 +2213,7 @@ process_flag(_Flag, _Value) ->
        Monitors :: [{process | port, Pid :: pid() | port() |
                                      {RegName :: atom(), Node :: node()}}]} |
       {message_queue_data, MQD :: message_queue_data()} |
+      {message_queue_limit, MQL :: message_queue_limit()} |
       {priority, Level :: priority_level()} |
       {reductions, Number :: non_neg_integer()} |
       {registered_name, [] | (Atom :: atom())} |
@@ -2381,6 +2407,9 @@ subtract(_,_) ->
       OldTCW :: non_neg_integer();
 			(time_offset, finalize) -> OldState when
       OldState :: preliminary | final | volatile;
+                        (alloc_profile, Interval) -> OldInterval when
+      Interval :: non_neg_integer(),
+      OldInterval :: non_neg_integer();
                         %% These are deliberately not documented
 			(internal_cpu_topology, term()) -> term();
                         (sequential_tracer, pid() | port() | {module(), term()} | false) -> pid() | port() | false;
@@ -2402,6 +2431,19 @@ term_to_binary(_Term) ->
 term_to_binary(_Term, _Options) ->
     erlang:nif_error(undefined).
 
+-spec term_to_iovec(Term) -> [ext_binary()] when
+      Term :: term().
+term_to_iovec(_Term) ->
+    erlang:nif_error(undefined).
+
+-spec term_to_iovec(Term, Options) -> [ext_binary()] when
+      Term :: term(),
+      Options :: [compressed |
+                  {compressed, Level :: 0..9} |
+                  {minor_version, Version :: 0..1} ].
+term_to_iovec(_Term, _Options) ->
+    erlang:nif_error(undefined).
+
 %% Shadowed by erl_bif_types: erlang:tl/1
 -spec tl(List) -> term() when
       List :: [term(), ...].
@@ -2524,7 +2566,19 @@ tuple_to_list(_Tuple) ->
          (dirty_cpu_schedulers_online) -> non_neg_integer();
          (dirty_io_schedulers) -> non_neg_integer();
          (dist) -> binary();
+         ({dist_atom_cache, Node}) -> undefined | [{Item, Value}] when
+      Node :: node(),
+      Item :: size | out_hits | out_misses | in_hits | in_misses,
+      Value :: non_neg_integer();
+         ({dist_stats, Node}) -> undefined | [{Item, Value}] when
+      Node :: node(),
+      Item :: out_msgs | out_bytes | in_msgs | in_bytes | queue
+            | max_queue | busy_count | busy_time | encode_time
+            | size_histogram,
+      Value :: non_neg_integer() | [non_neg_integer()];
+         (dist_bin_ref_threshold) -> non_neg_integer();
          (dist_buf_busy_limit) -> non_neg_integer();
+         (dist_compress_threshold) -> non_neg_integer();
          (dist_ctrl) -> {Node :: node(),
                          ControllingEntity :: port() | pid()};
          (driver_version) -> string();
@@ -2586,7 +2640,14 @@ tuple_to_list(_Tuple) ->
          (trace_control_word) -> non_neg_integer();
          (update_cpu_info) -> changed | unchanged;
          (version) -> string();
-         (wordsize | {wordsize, internal} | {wordsize, external}) -> 4 | 8.
+         (wordsize | {wordsize, internal} | {wordsize, external}) -> 4 | 8;
+         (alloc_profile) -> [{Alloc, Type, Site, Count, Bytes}] when
+      Alloc :: atom(),
+      Type :: atom(),
+      Site :: {module(), atom(), arity()} | port | other | undefined,
+      Count :: non_neg_integer(),
+      Bytes :: non_neg_integer();
+         (shared_terms) -> reference | copy.
 system_info(_Item) ->
     erlang:nif_error(undefined).
 
@@ -20,7 +20,7 @@
 
 -module(beam_receive).
 -export([module/2]).
--import(lists, [foldl/3,reverse/1,reverse/2]).
+-import(lists, [foldl/3,member/2,reverse/1,reverse/2]).
 
 %%%
 %%% In code such as:
@@ -64,6 +64,27 @@
 %%% We use a reference to a label (i.e. a position in the loaded code)
 %%% as the SomeUniqInteger.
 %%%
+%%% When the reference was not created in the same function, as in
+%%%
+%%%    wait_reply(Ref) ->
+%%%        receive
+%%%           {Ref,Reply} -> Reply;
+%%%           {'DOWN',Ref,process,_,Reason} -> exit(Reason)
+%%%        end.
+%%%
+%%% but every message that can be matched out must contain the
+%%% reference as the first or second element of a tuple, we instead
+%%% emit the following instruction before the receive:
+%%%
+%%%    recv_ref(Ref),
+%%%    receive
+%%%       ...
+%%%    end.
+%%%
+%%% The runtime system keeps an index of the messages in the message
+%%% queue that contain a reference in any of these positions, and uses
+%%% it to skip messages that cannot possibly be matched out.
+%%%
 
 module({Mod,Exp,Attr,Fs0,Lc}, _Opts) ->
     Fs = [function(F) || F <- Fs0],
@@ -116,6 +137,16 @@ opt([{call_ext,Arity,{extfunc,erlang,Name,Arity}}=I|Is0], D, Acc) ->
 	false ->
 	    opt(Is0, D, [I|Acc])
     end;
+opt([{recv_set,_}=RecvSet,{label,_}=Lbl,{loop_rec,_,_}=Loop|Is], D, Acc) ->
+    %% Already optimized using recv_mark/recv_set.
+    opt(Is, D, [Loop,Lbl,RecvSet|Acc]);
+opt([{label,_}=Lbl,{loop_rec,{f,Fail},{x,0}}=Loop|Is], D, Acc) ->
+    case opt_recv_ref(Is, Fail, D) of
+	no ->
+	    opt(Is, D, [Loop,Lbl|Acc]);
+	{yes,Ref} ->
+	    opt(Is, D, [Loop,Lbl,{recv_ref,Ref}|Acc])
+    end;
 opt([I|Is], D, Acc) ->
     opt(Is, D, [I|Acc]);
 opt([], _, Acc) ->
@@ -248,8 +279,10 @@ opt_update_regs_bl([], Regs) -> Regs.
 %%  'false' (the optimization may be unsafe).
 
 opt_ref_used(Is, RefRegs, Fail, D) ->
+    opt_ref_used(Is, RefRegs, Fail, D, regs_init_x0()).
+
+opt_ref_used(Is, RefRegs, Fail, D, Regs) ->
     Done = gb_sets:singleton(Fail),
-    Regs = regs_init_x0(),
     try
 	_ = opt_ref_used_1(Is, RefRegs, D, Done, Regs),
 	true
@@ -303,6 +336,8 @@ opt_ref_used_1([_I|_], _RefReg, _D, _Done, _Regs) ->
 %% is_ref_msg_comparison(Args, RefRegs, RegisterSet) -> true|false.
 %%  Return 'true' if Args denotes a comparison between the
 %%  reference and message or part of the message.
+is_ref_msg_comparison(Args, RefRegs, {key,_,_,Keys}) ->
+    is_ref_msg_comparison(Args, RefRegs, Keys);
 is_ref_msg_comparison([R1,R2], RefRegs, Regs) ->
     (regs_is_member(R2, RefRegs) andalso regs_is_member(R1, Regs)) orelse
     (regs_is_member(R1, RefRegs) andalso regs_is_member(R2, Regs)).
@@ -326,6 +361,8 @@ opt_ref_used_bl([{set,[],[],remove_message}|_], _) ->
     %% We have proved that a message that does not depend on the
     %% reference can be matched out.
     throw(not_used);
+opt_ref_used_bl(Is, {key,_,_,_}=Regs) ->
+    opt_key_used_bl(Is, Regs);
 opt_ref_used_bl([{set,Ds,Ss,_}|Is], Regs0) ->
     case regs_all_members(Ss, Regs0) of
 	false ->
@@ -341,6 +378,69 @@ opt_ref_used_bl([{set,Ds,Ss,_}|Is], Regs0) ->
     end;
 opt_ref_used_bl([], Regs) -> Regs.
 
+%% opt_recv_ref([Instruction], FailLabel, LabelIndex) -> no|{yes,RefReg}
+%%  Determine whether the receive statement only can match out messages
+%%  that contain the value of a Y register as the first or second
+%%  element of a tuple (the value is typically a reference).
+
+opt_recv_ref(Is, Fail, D) ->
+    opt_recv_ref_1(recv_ref_candidates(Is, []), Is, Fail, D).
+
+opt_recv_ref_1([Y|Ys], Is, Fail, D) ->
+    Regs = {key,Y,regs_init_x0(),regs_init()},
+    case opt_ref_used(Is, regs_init_singleton(Y), Fail, D, Regs) of
+	true -> {yes,Y};
+	false -> opt_recv_ref_1(Ys, Is, Fail, D)
+    end;
+opt_recv_ref_1([], _, _, _) -> no.
+
+recv_ref_candidates([{test,is_eq_exact,_,Args}|Is], Acc) ->
+    recv_ref_candidates(Is, [Y || {y,_}=Y <- Args] ++ Acc);
+recv_ref_candidates([{loop_rec_end,_}|_], Acc) ->
+    ordsets:from_list(Acc);
+recv_ref_candidates([_|Is], Acc) ->
+    recv_ref_candidates(Is, Acc);
+recv_ref_candidates([], Acc) ->
+    ordsets:from_list(Acc).
+
+%% opt_key_used_bl([BlockInstruction], {key,RefReg,MsgRegs,KeyRegs}) ->
+%%     {key,RefReg,MsgRegs,KeyRegs}
+%%  Keep track of registers holding the message (MsgRegs) and
+%%  registers holding the first or second element of the message
+%%  (KeyRegs). The register holding the reference must not be
+%%  overwritten inside the receive statement.
+
+opt_key_used_bl([{set,[],[],remove_message}|_], _) ->
+    throw(not_used);
+opt_key_used_bl([{set,Ds,Ss,Op}|Is], {key,Ref,Msg0,Keys0}) ->
+    case member(Ref, Ds) of
+	true -> throw(not_used);
+	false -> ok
+    end,
+    Msg1 = regs_kill(Ds, Msg0),
+    Keys1 = regs_kill(Ds, Keys0),
+    {Msg,Keys} =
+	case {Ds,Ss,Op} of
+	    {[Dst],[Src],{get_tuple_element,I}} when I =:= 0; I =:= 1 ->
+		case regs_is_member(Src, Msg0) of
+		    true -> {Msg1,regs_add(Dst, Keys1)};
+		    false -> {Msg1,Keys1}
+		end;
+	    {[Dst],[Src],move} ->
+		{case regs_is_member(Src, Msg0) of
+		     true -> regs_add(Dst, Msg1);
+		     false -> Msg1
+		 end,
+		 case regs_is_member(Src, Keys0) of
+		     true -> regs_add(Dst, Keys1);
+		     false -> Keys1
+		 end};
+	    {_,_,_} ->
+		{Msg1,Keys1}
+	end,
+    opt_key_used_bl(Is, {key,Ref,Msg,Keys});
+opt_key_used_bl([], Regs) -> Regs.
+
 %%%
 %%% Functions for keeping track of a set of registers.
 %%%
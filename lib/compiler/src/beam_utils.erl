@@ -470,6 +470,11 @@ check_liveness(R, [{loop_rec,{f,_},{x,0}}|_], St) ->
     end;
 check_liveness(R, [{loop_rec_end,{f,Fail}}|_], St) ->
     check_liveness_at(R, Fail, St);
+check_liveness(R, [{recv_ref,Src}|Is], St) ->
+    case R of
+	Src -> {used,St};
+	_ -> check_liveness(R, Is, St)
+    end;
 check_liveness(R, [{line,_}|Is], St) ->
     check_liveness(R, Is, St);
 check_liveness(R, [{get_map_elements,{f,Fail},S,{list,L}}|Is], St0) ->
@@ -780,6 +785,8 @@ live_opt([{recv_set,_}=I|Is], Regs, D, Acc) ->
     live_opt(Is, Regs, D, [I|Acc]);
 live_opt([{recv_mark,_}=I|Is], Regs, D, Acc) ->
     live_opt(Is, Regs, D, [I|Acc]);
+live_opt([{recv_ref,Src}=I|Is], Regs, D, Acc) ->
+    live_opt(Is, x_live([Src], Regs), D, [I|Acc]);
 
 live_opt([], _, _, Acc) -> Acc.
 
@@ -219,7 +219,11 @@ do_ref_opt(Source, PrivDir) ->
 		[] = collect_recv_opt_instrs(Code);
 	    "yes_"++_ ->
 		[{recv_mark,{f,L}},{recv_set,{f,L}}] =
-		    collect_recv_opt_instrs(Code)
+		    collect_recv_opt_instrs(Code);
+	    "ref_"++_ ->
+		[] = collect_recv_opt_instrs(Code),
+		[_|_] = [I || {function,_,_,_,Is} <- Code,
+			      {recv_ref,_}=I <- Is]
 	end,
 	ok
     catch Class:Error ->
@@ -0,0 +1,18 @@
+-module(ref_1).
+-compile(export_all).
+
+?MODULE() ->
+    Ref = make_ref(),
+    self() ! {Ref,42},
+    42 = wait_reply(Ref),
+    {_,Mref} = spawn_monitor(fun() -> ok end),
+    normal = wait_reply(Mref),
+    ok.
+
+wait_reply(Ref) ->
+    receive
+	{Ref,Reply} ->
+	    Reply;
+	{'DOWN',Ref,process,_,Reason} ->
+	    Reason
+    end.
@@ -0,0 +1,27 @@
+-module(ref_2).
+-compile(export_all).
+
+?MODULE() ->
+    Ref = make_ref(),
+    self() ! {reply,Ref,42},
+    self() ! {Ref},
+    42 = wait_reply(Ref),
+    {Ref} = wait_ack(Ref),
+    timeout = wait_ack(Ref),
+    ok.
+
+wait_reply(Ref) ->
+    receive
+	{reply,Ref,Reply} ->
+	    Reply
+    after 1000 ->
+	    timeout
+    end.
+
+wait_ack(Ref) ->
+    receive
+	{Ref}=Ack ->
+	    Ack
+    after 0 ->
+	    timeout
+    end.
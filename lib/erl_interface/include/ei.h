@@ -137,6 +137,8 @@
 #define ERL_NEW_FUN_EXT	      'p'
 #define ERL_MAP_EXT           't'
 #define ERL_FUN_EXT	      'u'
+#define ERL_EXPORT_EXT        'q'
+#define ERL_BIT_BINARY_EXT    'M'
  
 #define ERL_NEW_CACHE         'N' /* c nodes don't know these two */
 #define ERL_CACHED_ATOM       'C'
@@ -279,6 +281,27 @@ typedef struct {
     } value;
 } ei_term;
 
+/* a ring buffer that terms are decoded from, see ei_stream_next() */
+typedef struct ei_stream_TAG {
+    const char* buff;		/* the ring buffer */
+    int size;			/* size of the ring buffer */
+    int start;			/* offset of the first byte not decoded */
+    int len;			/* number of bytes available from start */
+} ei_stream;
+
+/* a term, or the header of one, decoded by ei_stream_next() */
+typedef struct {
+    int ei_type;
+    int arity;			/* tuples, lists and maps */
+    int size;			/* number of bytes in data */
+    union {
+	long i_val;
+	double d_val;
+    } value;
+    const char* data[2];	/* data[1] is used if data wraps around */
+    int datalen[2];
+} ei_stream_term;
+
 /* XXX */
 
 typedef struct {
@@ -306,8 +329,12 @@ typedef struct ei_x_buff_TAG {
     char* buff;
     int buffsz;
     int index;
+    int flags;			/* EI_X_ARENA */
 } ei_x_buff;
 
+/* ei_x_buff flags */
+#define EI_X_ARENA 1		/* buff is owned by the caller, see ei_x_new_arena() */
+
 
 /* -------------------------------------------------------------------- */
 /*    Function definitions (listed in same order as documentation)      */
@@ -326,6 +353,7 @@ int ei_connect(ei_cnode* ec, char *nodename);
 int ei_connect_tmo(ei_cnode* ec, char *nodename, unsigned ms);
 int ei_xconnect(ei_cnode* ec, Erl_IpAddr adr, char *alivename);
 int ei_xconnect_tmo(ei_cnode* ec, Erl_IpAddr adr, char *alivename, unsigned ms);
+int ei_close_connection(int fd);
 
 int ei_receive(int fd, unsigned char *bufp, int bufsize);
 int ei_receive_tmo(int fd, unsigned char *bufp, int bufsize, unsigned ms);
@@ -333,6 +361,8 @@ int ei_receive_msg(int fd, erlang_msg* msg, ei_x_buff* x);
 int ei_receive_msg_tmo(int fd, erlang_msg* msg, ei_x_buff* x, unsigned ms);
 int ei_xreceive_msg(int fd, erlang_msg* msg, ei_x_buff* x);
 int ei_xreceive_msg_tmo(int fd, erlang_msg* msg, ei_x_buff* x, unsigned ms);
+int ei_xreceive_msg_nb(int fd, ei_x_buff* inbuf, erlang_msg* msg, ei_x_buff* x);
+int ei_xparse_msg(ei_x_buff* inbuf, erlang_msg* msg, ei_x_buff* x);
 
 int ei_send(int fd, erlang_pid* to, char* buf, int len);
 int ei_send_tmo(int fd, erlang_pid* to, char* buf, int len, unsigned ms);
@@ -524,6 +554,17 @@ int ei_decode_map_header(const char *buf, int *index, int *arity);
 
 int ei_decode_ei_term(const char* buf, int* index, ei_term* term);
 
+/*
+ * Pull-style decoding from a ring buffer, one term or term header
+ * at a time, without copying or allocating. Returns -1 with erl_errno
+ * set to EAGAIN if more data is needed.
+ */
+
+void ei_stream_init(ei_stream* s, const char* buff, int size);
+int ei_stream_decode_version(ei_stream* s, int* version);
+int ei_stream_next(ei_stream* s, ei_stream_term* t);
+void ei_stream_term_copy(const ei_stream_term* t, char* p);
+
 
 /*
  * ei_print_term to print out a binary coded term
@@ -541,6 +582,8 @@ int ei_x_format_wo_ver(ei_x_buff* x, const char *fmt, ...);
 
 int ei_x_new(ei_x_buff* x);
 int ei_x_new_with_version(ei_x_buff* x);
+int ei_x_new_arena(ei_x_buff* x, char* arena, int size);
+int ei_x_new_arena_with_version(ei_x_buff* x, char* arena, int size);
 int ei_x_free(ei_x_buff* x);
 int ei_x_append(ei_x_buff* x, const ei_x_buff* x2);
 int ei_x_append_buf(ei_x_buff* x, const char* buf, int len);
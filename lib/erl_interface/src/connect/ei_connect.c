@@ -84,6 +84,7 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "eiext.h"
 #include "ei_portio.h"
@@ -92,14 +93,21 @@
 #include "ei_locking.h"
 #include "eisend.h"
 #include "eirecv.h"
+#include "ei_x_encode.h"
 #include "eimd5.h"
 #include "putget.h"
 #include "ei_resolve.h"
 #include "ei_epmd.h"
 #include "ei_internal.h"
+#include "ei_shm.h"
 
 int ei_tracelevel = 0;
 
+#ifdef EI_SHM
+/* Connect to nodes on this host over shared memory, see ei_shm.c */
+static int ei_shm_dist = 0;
+#endif
+
 #define COOKIE_FILE "/.erlang.cookie"
 #define EI_MAX_HOME_PATH 1024
 
@@ -179,6 +187,7 @@ static int put_ei_socket_info(int fd, int dist_version, char* cookie, ei_cnode *
 	    if (dist_version == -1) {
 		memmove(&ei_sockets[i], &ei_sockets[i+1],
 			sizeof(ei_sockets[0])*(ei_n_sockets-i-1));
+		--ei_n_sockets;
 	    } else {
 		ei_sockets[i].dist_version = dist_version;
 		/* Copy the content, see ei_socket_info */
@@ -191,6 +200,12 @@ static int put_ei_socket_info(int fd, int dist_version, char* cookie, ei_cnode *
 	    return 0;
 	}
     }
+    if (dist_version == -1) {
+#ifdef _REENTRANT
+	ei_mutex_unlock(ei_sockets_lock);
+#endif /* _REENTRANT */
+	return 0;
+    }
     if (ei_n_sockets == ei_sz_sockets) {
 	ei_sz_sockets += 5;
 	ei_sockets = realloc(ei_sockets,
@@ -202,25 +217,22 @@ static int put_ei_socket_info(int fd, int dist_version, char* cookie, ei_cnode *
 #endif /* _REENTRANT */
 	    return -1;
 	}
-	ei_sockets[ei_n_sockets].socket = fd;
-	ei_sockets[ei_n_sockets].dist_version = dist_version;
-	ei_sockets[i].cnode = *ec;
-	strcpy(ei_sockets[ei_n_sockets].cookie, cookie);
-	++ei_n_sockets;
     }
+    ei_sockets[ei_n_sockets].socket = fd;
+    ei_sockets[ei_n_sockets].dist_version = dist_version;
+    ei_sockets[ei_n_sockets].cnode = *ec;
+    strcpy(ei_sockets[ei_n_sockets].cookie, cookie);
+    ++ei_n_sockets;
 #ifdef _REENTRANT
     ei_mutex_unlock(ei_sockets_lock);
 #endif /* _REENTRANT */
     return 0;
 }
 
-#if 0
-/* FIXME not used ?! */
-static int remove_ei_socket_info(int fd, int dist_version, char* cookie)
+static int remove_ei_socket_info(int fd)
 {
-    return put_ei_socket_info(fd, -1, NULL);
+    return put_ei_socket_info(fd, -1, NULL, NULL);
 }
-#endif
 
 static ei_socket_info* get_ei_socket_info(int fd)
 {
@@ -468,6 +480,14 @@ int ei_connect_xinit(ei_cnode* ec, const char *thishostname,
 	(dbglevel = getenv("ERL_DEBUG_DIST")) != NULL)
 	ei_tracelevel = atoi(dbglevel);
 
+#ifdef EI_SHM
+    {
+	char *shm = getenv("EI_SHM_DIST");
+	if (shm != NULL)
+	    ei_shm_dist = atoi(shm) > 0;
+    }
+#endif
+
     return 0;
 }
 
@@ -566,6 +586,7 @@ static int cnct(uint16 port, struct in_addr *ip_addr, int addr_len, unsigned ms)
 	erl_errno = errno;
 	return ERL_ERROR;
     }
+    ei_shm_forget(s);
     
     memset((char*)&iserv_addr, 0, sizeof(struct sockaddr_in));
     memcpy((char*)&iserv_addr.sin_addr, (char*)ip_addr, addr_len);
@@ -679,9 +700,10 @@ int ei_xconnect_tmo(ei_cnode* ec, Erl_IpAddr adr, char *alivename, unsigned ms)
 {
     struct in_addr *ip_addr=(struct in_addr *) adr;
     int rport = 0; /*uint16 rport = 0;*/
-    int sockd;
+    int sockd = -1;
     int one = 1;
     int dist = 0;
+    int shm = 0;
     ErlConnect her_name;
     unsigned her_flags, her_version;
 
@@ -695,9 +717,20 @@ int ei_xconnect_tmo(ei_cnode* ec, Erl_IpAddr adr, char *alivename, unsigned ms)
 	/* ei_epmd_port_tmo() has set erl_errno */
 	return ERL_NO_PORT;
     }
-    
+
+#ifdef EI_SHM
+    /* If asked to, a node on this host running shm_dist is connected to
+       over shared memory, falling back to TCP if that fails */
+    if (ei_shm_dist && ei_shm_listening(ip_addr, alivename)
+	&& (sockd = ei_shm_connect(alivename, ms)) >= 0) {
+	EI_TRACE_CONN0("ei_xconnect","-> CONNECT over shared memory");
+	shm = 1;
+    }
+#endif
+
     /* we now have port number to enode, try to connect */
-    if((sockd = cnct((uint16)rport, ip_addr, sizeof(struct in_addr),ms)) < 0) {
+    if (!shm
+	&& (sockd = cnct((uint16)rport, ip_addr, sizeof(struct in_addr),ms)) < 0) {
 	EI_TRACE_ERR0("ei_xconnect","-> CONNECT socket connect failed");
 	/* cnct() has set erl_errno */
 	return ERL_CONNECT_FAIL;
@@ -731,8 +764,10 @@ int ei_xconnect_tmo(ei_cnode* ec, Erl_IpAddr adr, char *alivename, unsigned ms)
 	put_ei_socket_info(sockd, dist, null_cookie, ec); /* FIXME check == 0 */
     }
     
-    setsockopt(sockd, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(one));
-    setsockopt(sockd, SOL_SOCKET, SO_KEEPALIVE, (char *)&one, sizeof(one));
+    if (!shm) {
+	setsockopt(sockd, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(one));
+	setsockopt(sockd, SOL_SOCKET, SO_KEEPALIVE, (char *)&one, sizeof(one));
+    }
 
     EI_TRACE_CONN1("ei_xconnect","-> CONNECT (ok) remote = %s",alivename);
     
@@ -741,7 +776,7 @@ int ei_xconnect_tmo(ei_cnode* ec, Erl_IpAddr adr, char *alivename, unsigned ms)
     
 error:
     EI_TRACE_ERR0("ei_xconnect","-> CONNECT failed");
-    closesocket(sockd);
+    ei_close_connection(sockd);
     return ERL_ERROR;
 } /* ei_xconnect */
 
@@ -752,14 +787,18 @@ int ei_xconnect(ei_cnode* ec, Erl_IpAddr adr, char *alivename)
 
 
   /* 
-  * For symmetry reasons
+  * Close a connection set up by ei_connect() or ei_accept(),
+  * over TCP or shared memory.
 */
-#if 0
 int ei_close_connection(int fd)
 {
+    remove_ei_socket_info(fd);
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd))
+	return ei_shm_close(fd);
+#endif
     return closesocket(fd);
 } /* ei_close_connection */
-#endif
 
   /*
   * Accept and initiate a connection from another
@@ -789,6 +828,7 @@ int ei_accept_tmo(ei_cnode* ec, int lfd, ErlConnect *conp, unsigned ms)
 	erl_errno = (fd == -2) ? ETIMEDOUT : EIO;
 	goto error;
     }
+    ei_shm_forget(fd);
     
     EI_TRACE_CONN0("ei_accept","<- ACCEPT connected to remote");
     
@@ -913,6 +953,32 @@ int ei_send(int fd, erlang_pid* to, char* buf, int len)
 }
 
 
+/* Check that a received control message is one we pass on */
+static int check_msgtype(erlang_msg* msg)
+{
+    switch (msg->msgtype) {	/* FIXME does not handle trace tokens and monitors */
+    case ERL_SEND:
+    case ERL_REG_SEND:
+    case ERL_LINK:
+    case ERL_UNLINK:
+    case ERL_GROUP_LEADER:
+    case ERL_EXIT:
+    case ERL_EXIT2:
+	return ERL_MSG;
+	
+    default:
+	/*if (emsg->to) 'erl'_free_term(emsg->to);
+	  if (emsg->from) 'erl'_free_term(emsg->from);
+	  if (emsg->msg) 'erl'_free_term(emsg->msg);
+	  emsg->to = NULL;
+	  emsg->from = NULL;
+	  emsg->msg = NULL;*/
+	
+	erl_errno = EIO;
+	return ERL_ERROR;
+    }
+}
+
 /* 
 * Try to receive an Erlang message on a given socket. Returns
 * ERL_TICK, ERL_MSG, or ERL_ERROR. Sets `erl_errno' on ERL_ERROR and
@@ -925,6 +991,10 @@ int ei_do_receive_msg(int fd, int staticbuffer_p,
     int msglen;
     int i;
     
+    if (x->flags & EI_X_ARENA) {
+	erl_errno = EINVAL;
+	return ERL_ERROR;
+    }
     if (!(i=ei_recv_internal(fd, &x->buff, &x->buffsz, msg, &msglen, 
 	staticbuffer_p, ms))) {
 	erl_errno = EAGAIN;
@@ -940,28 +1010,104 @@ int ei_do_receive_msg(int fd, int staticbuffer_p,
 	return ERL_ERROR;
     }
     x->index = x->buffsz;
-    switch (msg->msgtype) {	/* FIXME does not handle trace tokens and monitors */
-    case ERL_SEND:
-    case ERL_REG_SEND:
-    case ERL_LINK:
-    case ERL_UNLINK:
-    case ERL_GROUP_LEADER:
-    case ERL_EXIT:
-    case ERL_EXIT2:
-	return ERL_MSG;
-	
-    default:
-	/*if (emsg->to) 'erl'_free_term(emsg->to);
-	  if (emsg->from) 'erl'_free_term(emsg->from);
-	  if (emsg->msg) 'erl'_free_term(emsg->msg);
-	  emsg->to = NULL;
-	  emsg->from = NULL;
-	  emsg->msg = NULL;*/
-	
-	erl_errno = EIO;
+    return check_msgtype(msg);
+} /* do_receive_msg */
+
+/*
+ * Parse the first packet of the inbuf->index bytes in inbuf, which the
+ * caller has read from a connection, and remove it from inbuf. Returns
+ * ERL_MSG, ERL_TICK or ERL_ERROR like ei_xreceive_msg(). If inbuf does
+ * not hold a complete packet yet, ERL_ERROR is returned with erl_errno
+ * set to EAGAIN and inbuf is left as it is. Ticks are not answered.
+ */
+int ei_xparse_msg(ei_x_buff* inbuf, erlang_msg* msg, ei_x_buff* x)
+{
+    int msglen;
+    int used;
+    int i;
+
+    if (x->flags & EI_X_ARENA) {
+	erl_errno = EINVAL;
 	return ERL_ERROR;
     }
-} /* do_receive_msg */
+    i = ei_parse_internal(inbuf->buff, inbuf->index, &used,
+			  &x->buff, &x->buffsz, msg, &msglen);
+    if (used > 0) {
+	inbuf->index -= used;
+	if (inbuf->index > 0)
+	    memmove(inbuf->buff, inbuf->buff + used, inbuf->index);
+    }
+    if (!i) {
+	erl_errno = EAGAIN;
+	return ERL_TICK;
+    }
+    if (i<0) {
+	/* erl_errno set by ei_parse_internal() */
+	return ERL_ERROR;
+    }
+    x->index = msglen;
+    return check_msgtype(msg);
+}
+
+/*
+ * Non-blocking ei_xreceive_msg(), for use when fd is polled by the
+ * caller. Reads what is available of the current packet into inbuf,
+ * which keeps a partially received packet between calls, and never
+ * reads beyond the end of it. Returns ERL_ERROR with erl_errno set to
+ * EAGAIN when the packet is not complete yet, otherwise as
+ * ei_xreceive_msg(). Ticks are answered.
+ */
+int ei_xreceive_msg_nb(int fd, ei_x_buff* inbuf, erlang_msg* msg,
+		       ei_x_buff* x)
+{
+    int need = 4;
+    int res;
+
+    for (;;) {
+	if (inbuf->index >= 4) {
+	    unsigned len = (unsigned) get_int32((unsigned char *) inbuf->buff);
+	    if (len > INT_MAX - 4) {
+		erl_errno = EIO;
+		return ERL_ERROR;
+	    }
+	    need = 4 + (int) len;
+	}
+	if (inbuf->index >= need)
+	    break;
+	if (!x_fix_buff(inbuf, need)) {
+	    erl_errno = ENOMEM;
+	    return ERL_ERROR;
+	}
+	res = ei_read_nb(fd, inbuf->buff + inbuf->index, need - inbuf->index);
+	if (res == -2) {
+	    erl_errno = EAGAIN;
+	    return ERL_ERROR;
+	}
+	if (res <= 0) {
+	    erl_errno = EIO;
+	    return ERL_ERROR;
+	}
+	inbuf->index += res;
+    }
+
+    res = ei_xparse_msg(inbuf, msg, x);
+    if (res == ERL_TICK) {
+	/*
+	 * Answer without blocking. If there is no room for the tock the
+	 * peer still has data from us to read, which it counts as a sign
+	 * of life as well. A partly written tock breaks the packet
+	 * framing, so that is an error.
+	 */
+	char tock[4] = {0,0,0,0};
+	int w = ei_write_nb(fd, tock, 4);
+	if (w != 4 && w != -2) {
+	    erl_errno = EIO;
+	    return ERL_ERROR;
+	}
+	erl_errno = EAGAIN;
+    }
+    return res;
+}
 
 
 int ei_receive_msg(int fd, erlang_msg* msg, ei_x_buff* x)
@@ -1419,6 +1565,11 @@ static int recv_challenge(int fd, unsigned *challenge,
 	goto error;
     }
 
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd)) /* a node on this host */
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    else
+#endif
     if (getpeername(fd, (struct sockaddr *) &sin, &sin_len) < 0) {
 	EI_TRACE_ERR0("recv_challenge","<- RECV_CHALLENGE can't get peername");
 	erl_errno = errno;
@@ -0,0 +1,738 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+/*
+ * Purpose: Connections over shared memory ring buffers to a node on
+ *          the same host that runs the shm_dist carrier.
+ *
+ * The C node connects to the Unix domain socket that the node listens
+ * on, in a directory that only the user can get into, and checks that
+ * the node runs as the same user. It then creates a sealed memfd
+ * segment with one ring buffer in each direction and an eventfd for
+ * each side, and passes them to the node over the socket.
+ * After that the bytes that would have gone over TCP go through the
+ * rings, and the socket is only used to notice that the node has gone
+ * away. A side only writes to the eventfd of the other side when the
+ * other side has said that it is about to sleep.
+ *
+ * The layout of the segment and the setup message must match
+ * lib/kernel/examples/shm_dist/c_src/shm_drv.c.
+ *
+ * The descriptor handed out for a connection is an epoll descriptor
+ * watching our eventfd and the socket. Whenever there is data in the
+ * ring our eventfd is kept readable, so the descriptor can be used in
+ * select() or poll() by the user like the socket of a TCP connection.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE			/* struct ucred */
+#endif
+
+#include "eidef.h"
+#include "ei_shm.h"
+
+#ifdef EI_SHM
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+
+#include "ei_portio.h"
+#include "ei_locking.h"
+#include "putget.h"
+
+#define SHM_SOCKET_PATH "/tmp/erlang-shm"
+
+#define SHM_MAGIC "ERLSHM1"		/* including the '\0', 8 bytes */
+#define SHM_MAGIC_SIZE 8
+#define SHM_HELLO_SIZE (SHM_MAGIC_SIZE + 4)
+#define SHM_HEADER_SIZE 4096		/* data starts on the next page */
+#define SHM_RING_SIZE (1 << 17)
+#define CACHE_LINE 64
+
+/* From linux/memfd.h and linux/fcntl.h, for older C libraries */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+typedef unsigned int Word;
+
+/* The counters are free running, the number of bytes in the ring is
+ * head - tail. See shm_drv.c. */
+typedef struct {
+    volatile Word head;			/* written by the producer */
+    char pad0[CACHE_LINE - sizeof(Word)];
+    volatile Word tail;			/* written by the consumer */
+    char pad1[CACHE_LINE - sizeof(Word)];
+    volatile Word consumer_waiting;
+    char pad2[CACHE_LINE - sizeof(Word)];
+    volatile Word producer_waiting;
+    char pad3[CACHE_LINE - sizeof(Word)];
+} shm_ring;
+
+typedef struct {
+    char magic[SHM_MAGIC_SIZE];
+    Word size;				/* size of each ring */
+    char pad[CACHE_LINE - SHM_MAGIC_SIZE - sizeof(Word)];
+    shm_ring ring[2];			/* [0] is connector -> acceptor */
+} shm_header;
+
+#define MEMORY_BARRIER __sync_synchronize()
+#define TAKE_FLAG(F) ((F) && __sync_fetch_and_and(&(F), 0))
+
+typedef struct {
+    int sock;			/* the socket, only to notice the peer die */
+    int efd;			/* our eventfd, written by the peer */
+    int peer_efd;		/* the eventfd of the peer */
+    char *segment;
+    size_t segment_size;
+    Word size;			/* of each ring, a power of two */
+    shm_ring *rx;
+    shm_ring *tx;
+    char *rx_data;
+    char *tx_data;
+} shm_conn;
+
+/*
+ * Connections indexed by descriptor. The table only grows and the old
+ * tables are never freed, so it can be read without taking the lock.
+ */
+static shm_conn **shm_conns = NULL;
+static volatile int shm_n_conns = 0;
+
+static shm_conn *get_conn(int fd)
+{
+    int n = shm_n_conns;
+    MEMORY_BARRIER;
+    return (fd >= 0 && fd < n) ? shm_conns[fd] : NULL;
+}
+
+static int put_conn(int fd, shm_conn *c)
+{
+    int res = 0;
+
+#ifdef _REENTRANT
+    ei_mutex_lock(ei_sockets_lock, 0);
+#endif /* _REENTRANT */
+    if (fd >= shm_n_conns) {
+	int n = (fd + 64) & ~63;
+	shm_conn **tab = calloc(n, sizeof(shm_conn *));
+	if (tab == NULL) {
+	    res = -1;
+	} else {
+	    if (shm_n_conns > 0)
+		memcpy(tab, shm_conns, shm_n_conns * sizeof(shm_conn *));
+	    shm_conns = tab;
+	    MEMORY_BARRIER;		/* the table before its size */
+	    shm_n_conns = n;
+	}
+    }
+    if (res == 0)
+	shm_conns[fd] = c;
+#ifdef _REENTRANT
+    ei_mutex_unlock(ei_sockets_lock);
+#endif /* _REENTRANT */
+    return res;
+}
+
+static void free_conn(shm_conn *c)
+{
+    if (c->segment != NULL)
+	munmap(c->segment, c->segment_size);
+    if (c->sock >= 0)
+	close(c->sock);
+    if (c->efd >= 0)
+	close(c->efd);
+    if (c->peer_efd >= 0)
+	close(c->peer_efd);
+    free(c);
+}
+
+static void signal_fd(int fd)
+{
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+	/* the counter is already set, or the peer is gone */
+    }
+}
+
+static void drain_fd(int fd)
+{
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0) {
+	/* not signalled */
+    }
+}
+
+/* The sockets are in SHM_SOCKET_PATH-<uid>, see shm_drv.c */
+static int socket_address(struct sockaddr_un *s_un, const char *alive)
+{
+    char dir[sizeof(SHM_SOCKET_PATH) + 16];
+
+    memset(s_un, 0, sizeof(*s_un));
+    sprintf(dir, "%s-%u", SHM_SOCKET_PATH, (unsigned) geteuid());
+    if (strchr(alive, '/') != NULL
+	|| strlen(dir) + 1 + strlen(alive) >= sizeof(s_un->sun_path))
+	return -1;
+    s_un->sun_family = AF_UNIX;
+    sprintf(s_un->sun_path, "%s/%s", dir, alive);
+    return (int) sizeof(*s_un);
+}
+
+/* Is path ours and not accessible to anybody else? */
+static int private_to_user(const char *path, mode_t type)
+{
+    struct stat st;
+
+    return lstat(path, &st) == 0 && (st.st_mode & S_IFMT) == type
+	&& st.st_uid == geteuid() && (st.st_mode & 077) == 0;
+}
+
+/* Does the peer of a connected Unix socket run as the same user as we? */
+static int peer_is_user(int sock)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    return getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0
+	&& cred.uid == geteuid();
+}
+
+/*
+ * An anonymous file to map. It is sealed at its size, as the node will
+ * not map a segment that we could shrink under it.
+ */
+static int create_segment(size_t size)
+{
+    int fd;
+
+#ifdef SYS_memfd_create
+    fd = syscall(SYS_memfd_create, "ei_shm", MFD_CLOEXEC|MFD_ALLOW_SEALING);
+#else
+    fd = -1;
+    errno = ENOSYS;
+#endif
+    if (fd < 0)
+	return -1;
+    if (ftruncate(fd, size) < 0
+	|| fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) < 0) {
+	int save_errno = errno;
+	close(fd);
+	errno = save_errno;
+	return -1;
+    }
+    return fd;
+}
+
+/* Is the socket to the peer at end of file? */
+static int peer_closed(shm_conn *c)
+{
+    char b;
+    return recv(c->sock, &b, 1, MSG_PEEK|MSG_DONTWAIT) == 0;
+}
+
+/*
+ * Make sure that we will be woken up when the peer writes to the ring,
+ * and that our eventfd is readable if there already is something in it.
+ */
+static void rearm_rx(shm_conn *c)
+{
+    shm_ring *r = c->rx;
+
+    r->consumer_waiting = 1;
+    MEMORY_BARRIER;
+    if (r->head != r->tail && TAKE_FLAG(r->consumer_waiting))
+	signal_fd(c->efd);
+}
+
+/* Wait until our eventfd or the socket is readable */
+static int wait_peer(shm_conn *c, unsigned ms)
+{
+    struct pollfd fds[2];
+    int res;
+
+    fds[0].fd = c->efd;
+    fds[0].events = POLLIN;
+    fds[1].fd = c->sock;
+    fds[1].events = POLLIN;
+    do {
+	res = poll(fds, 2, ms ? (int) ms : -1);
+    } while (res < 0 && errno == EINTR);
+    if (res < 0)
+	return -1;
+    if (res == 0)
+	return -2;
+    return 0;
+}
+
+/* Read what is in the ring, at most len bytes */
+static int ring_read(shm_conn *c, char *buf, int len)
+{
+    shm_ring *r = c->rx;
+    Word mask = c->size - 1;
+    Word tail = r->tail;
+    Word avail = r->head - tail;
+    Word n, pos, first;
+
+    if (avail == 0)
+	return 0;
+    if (avail > c->size) {		/* the node has gone haywire */
+	errno = EIO;
+	return -1;
+    }
+    MEMORY_BARRIER;			/* head before the data */
+    n = ((Word) len < avail) ? (Word) len : avail;
+    pos = tail & mask;
+    first = (n <= c->size - pos) ? n : c->size - pos;
+    memcpy(buf, c->rx_data + pos, first);
+    memcpy(buf + first, c->rx_data, n - first);
+    MEMORY_BARRIER;			/* the data before tail */
+    r->tail = tail + n;
+    MEMORY_BARRIER;			/* tail before the flag */
+    if (TAKE_FLAG(r->producer_waiting))
+	signal_fd(c->peer_efd);
+    if (n == avail && r->consumer_waiting == 0) {
+	/* The ring is empty and our eventfd may have been signalled */
+	drain_fd(c->efd);
+	rearm_rx(c);
+    }
+    return (int) n;
+}
+
+static int read_nb(shm_conn *c, char *buf, int len)
+{
+    int n;
+
+    if ((n = ring_read(c, buf, len)) != 0)
+	return n;
+    drain_fd(c->efd);
+    rearm_rx(c);
+    if ((n = ring_read(c, buf, len)) != 0)
+	return n;
+    if (peer_closed(c))
+	return 0;
+    return -2;
+}
+
+/*
+ * Copy as much of the vector as there is room for to the ring, starting
+ * skip bytes into it. Returns the number of bytes copied.
+ */
+static int ring_write(shm_conn *c, const struct iovec *iov, int iovcnt,
+		      int skip)
+{
+    shm_ring *r = c->tx;
+    Word mask = c->size - 1;
+    Word head = r->head;
+    Word space = c->size - (head - r->tail);
+    Word done = 0;
+    int i;
+
+    if (space == 0)
+	return 0;
+    MEMORY_BARRIER;			/* tail before writing data */
+    for (i = 0; i < iovcnt && done < space; i++) {
+	const char *p = iov[i].iov_base;
+	Word n = iov[i].iov_len;
+	if ((Word) skip >= n) {
+	    skip -= n;
+	    continue;
+	}
+	p += skip;
+	n -= skip;
+	skip = 0;
+	if (n > space - done)
+	    n = space - done;
+	while (n > 0) {
+	    Word pos = (head + done) & mask;
+	    Word chunk = (n <= c->size - pos) ? n : c->size - pos;
+	    memcpy(c->tx_data + pos, p, chunk);
+	    p += chunk;
+	    n -= chunk;
+	    done += chunk;
+	}
+    }
+    MEMORY_BARRIER;			/* the data before head */
+    r->head = head + done;
+    MEMORY_BARRIER;			/* head before the flag */
+    if (TAKE_FLAG(r->consumer_waiting))
+	signal_fd(c->peer_efd);
+    return (int) done;
+}
+
+/*
+ * Wait for the peer to make room in the ring. This takes over our
+ * eventfd, so rearm_rx() must be called when done writing.
+ */
+static int wait_space(shm_conn *c, unsigned ms)
+{
+    shm_ring *r = c->tx;
+    int res = 0;
+
+    drain_fd(c->efd);
+    r->producer_waiting = 1;
+    MEMORY_BARRIER;
+    if (r->head - r->tail == c->size) {
+	if (peer_closed(c)) {
+	    errno = EPIPE;
+	    res = -1;
+	} else {
+	    res = wait_peer(c, ms);
+	}
+    }
+    r->producer_waiting = 0;
+    return res;
+}
+
+static int write_all(shm_conn *c, const struct iovec *iov, int iovcnt,
+		     int len, unsigned ms)
+{
+    int done = 0, waited = 0, res = len;
+
+    while (done < len) {
+	int n = ring_write(c, iov, iovcnt, done);
+	if (n > 0) {
+	    done += n;
+	} else {
+	    waited = 1;
+	    if ((res = wait_space(c, ms)) < 0)
+		break;
+	    res = len;
+	}
+    }
+    if (waited)
+	rearm_rx(c);
+    return res;
+}
+
+/* Is addr an address of this host? */
+static int local_address(const struct in_addr *addr)
+{
+    struct ifaddrs *ifa, *p;
+    int res = 0;
+
+    if ((ntohl(addr->s_addr) >> 24) == 127)
+	return 1;
+    if (getifaddrs(&ifa) < 0)
+	return 0;
+    for (p = ifa; p != NULL && !res; p = p->ifa_next) {
+	res = p->ifa_addr != NULL && p->ifa_addr->sa_family == AF_INET
+	    && ((struct sockaddr_in *) p->ifa_addr)->sin_addr.s_addr
+	       == addr->s_addr;
+    }
+    freeifaddrs(ifa);
+    return res;
+}
+
+/*
+ * Is the node named alivename at addr on this host, and listening for
+ * shared memory connections? Only the sockets of nodes run by the same
+ * user, in a directory that nobody else can get into, are considered.
+ */
+int ei_shm_listening(const struct in_addr *addr, const char *alivename)
+{
+    struct sockaddr_un s_un;
+    struct stat st;
+    char *slash;
+
+    if (socket_address(&s_un, alivename) < 0 || !local_address(addr))
+	return 0;
+    slash = strrchr(s_un.sun_path, '/');
+    *slash = '\0';
+    if (!private_to_user(s_un.sun_path, S_IFDIR))
+	return 0;
+    *slash = '/';
+    return lstat(s_un.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)
+	&& st.st_uid == geteuid();
+}
+
+/*
+ * Connect to the node named alivename on this host. Returns the
+ * descriptor of the connection, or -1 with errno set, or -2 on
+ * timeout. The distribution handshake is then done as over TCP.
+ */
+int ei_shm_connect(const char *alivename, unsigned ms)
+{
+    struct sockaddr_un s_un;
+    int addr_len, res;
+    int segfd = -1, epfd = -1;
+    size_t total = SHM_HEADER_SIZE + 2 * (size_t) SHM_RING_SIZE;
+    char hello[SHM_HELLO_SIZE];
+    char *s;
+    char status;
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof(int))];
+    } cmsg;
+    int fds[3];
+    struct epoll_event ev;
+    shm_header *h;
+    shm_conn *c;
+
+    if ((addr_len = socket_address(&s_un, alivename)) < 0) {
+	errno = ENAMETOOLONG;
+	return -1;
+    }
+    if ((c = malloc(sizeof(shm_conn))) == NULL)
+	return -1;
+    memset(c, 0, sizeof(shm_conn));
+    c->efd = c->peer_efd = -1;
+    if ((c->sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	goto error;
+    fcntl(c->sock, F_SETFD, FD_CLOEXEC);
+    if ((res = ei_connect_t(c->sock, (struct sockaddr *) &s_un,
+			    addr_len, ms)) < 0)
+	goto error_res;
+    if (!peer_is_user(c->sock)) {
+	errno = EACCES;
+	goto error;
+    }
+
+    if ((segfd = create_segment(total)) < 0
+	|| (c->efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0
+	|| (c->peer_efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0)
+	goto error;
+    c->segment = mmap(NULL, total, PROT_READ|PROT_WRITE, MAP_SHARED, segfd, 0);
+    if (c->segment == MAP_FAILED) {
+	c->segment = NULL;
+	goto error;
+    }
+    c->segment_size = total;
+    c->size = SHM_RING_SIZE;
+    h = (shm_header *) c->segment;
+    memset(h, 0, sizeof(shm_header));
+    memcpy(h->magic, SHM_MAGIC, SHM_MAGIC_SIZE);
+    h->size = SHM_RING_SIZE;
+    /* both sides start out waiting for data */
+    h->ring[0].consumer_waiting = 1;
+    h->ring[1].consumer_waiting = 1;
+    c->tx = &h->ring[0];
+    c->rx = &h->ring[1];
+    c->tx_data = c->segment + SHM_HEADER_SIZE;
+    c->rx_data = c->segment + SHM_HEADER_SIZE + SHM_RING_SIZE;
+
+    /* pass the segment, the eventfd of the node and our own */
+    memcpy(hello, SHM_MAGIC, SHM_MAGIC_SIZE);
+    s = hello + SHM_MAGIC_SIZE;
+    put32be(s, SHM_RING_SIZE);
+    iov.iov_base = hello;
+    iov.iov_len = SHM_HELLO_SIZE;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    cmsg.hdr.cmsg_len = CMSG_LEN(3 * sizeof(int));
+    fds[0] = segfd;
+    fds[1] = c->peer_efd;
+    fds[2] = c->efd;
+    memcpy(CMSG_DATA(&cmsg.hdr), fds, sizeof(fds));
+    if (sendmsg(c->sock, &msg, 0) != SHM_HELLO_SIZE)
+	goto error;
+    close(segfd);
+    segfd = -1;
+    if ((res = ei_read_fill_t(c->sock, &status, 1, ms)) != 1) {
+	if (res == 0) {			/* the node did not like it */
+	    errno = ECONNREFUSED;
+	    res = -1;
+	}
+	goto error_res;
+    }
+    if (status != 0) {
+	errno = ECONNREFUSED;
+	goto error;
+    }
+
+    if ((epfd = epoll_create(2)) < 0)
+	goto error;
+    fcntl(epfd, F_SETFD, FD_CLOEXEC);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->efd, &ev) < 0)
+	goto error;
+    ev.events = EPOLLIN|EPOLLRDHUP;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->sock, &ev) < 0)
+	goto error;
+    ei_shm_forget(epfd);
+    if (put_conn(epfd, c) < 0)
+	goto error;
+    return epfd;
+
+error:
+    res = -1;
+error_res:
+    {
+	int save_errno = errno;
+	if (segfd >= 0)
+	    close(segfd);
+	if (epfd >= 0)
+	    close(epfd);
+	free_conn(c);
+	errno = save_errno;
+    }
+    return res;
+}
+
+int ei_shm_close(int fd)
+{
+    shm_conn *c = get_conn(fd);
+
+    if (c == NULL) {
+	errno = EBADF;
+	return -1;
+    }
+    put_conn(fd, NULL);
+    free_conn(c);
+    return close(fd);
+}
+
+/*
+ * Forget the connection that fd was the descriptor of, if any. Called
+ * for new descriptors, in case a connection was closed with close()
+ * rather than with ei_close_connection().
+ */
+void ei_shm_forget(int fd)
+{
+    shm_conn *c = get_conn(fd);
+
+    if (c != NULL) {
+	put_conn(fd, NULL);
+	free_conn(c);
+    }
+}
+
+int ei_shm_is_conn(int fd)
+{
+    return get_conn(fd) != NULL;
+}
+
+/*
+ * Read at most len bytes, waiting at most ms milliseconds (forever if
+ * ms is 0) for something to read. Returns the number of bytes read, 0
+ * if the peer is gone, -1 for error and -2 on timeout.
+ */
+int ei_shm_read(int fd, char *buf, int len, unsigned ms)
+{
+    shm_conn *c = get_conn(fd);
+    int res;
+
+    if (c == NULL) {
+	errno = EBADF;
+	return -1;
+    }
+    while ((res = read_nb(c, buf, len)) == -2) {
+	if ((res = wait_peer(c, ms)) < 0)
+	    return res;
+    }
+    return res;
+}
+
+/* As ei_shm_read(), but returns -2 at once if there is nothing to read */
+int ei_shm_read_nb(int fd, char *buf, int len)
+{
+    shm_conn *c = get_conn(fd);
+
+    if (c == NULL) {
+	errno = EBADF;
+	return -1;
+    }
+    return read_nb(c, buf, len);
+}
+
+/*
+ * Write all of buf, waiting at most ms milliseconds (forever if ms is
+ * 0) each time the ring is full. Returns len, -1 for error and -2 on
+ * timeout.
+ */
+int ei_shm_write(int fd, const char *buf, int len, unsigned ms)
+{
+    shm_conn *c = get_conn(fd);
+    struct iovec iov;
+
+    if (c == NULL) {
+	errno = EBADF;
+	return -1;
+    }
+    iov.iov_base = (char *) buf;
+    iov.iov_len = len;
+    return write_all(c, &iov, 1, len, ms);
+}
+
+/* As ei_shm_write(), but returns -2 at once if the ring is full */
+int ei_shm_write_nb(int fd, const char *buf, int len)
+{
+    shm_conn *c = get_conn(fd);
+    struct iovec iov;
+    int res;
+
+    if (c == NULL) {
+	errno = EBADF;
+	return -1;
+    }
+    iov.iov_base = (char *) buf;
+    iov.iov_len = len;
+    res = ring_write(c, &iov, 1, 0);
+    return res > 0 ? res : -2;
+}
+
+#ifdef HAVE_WRITEV
+int ei_shm_writev(int fd, const struct iovec *iov, int iovcnt, unsigned ms)
+{
+    shm_conn *c = get_conn(fd);
+    int i, len = 0;
+
+    if (c == NULL) {
+	errno = EBADF;
+	return -1;
+    }
+    for (i = 0; i < iovcnt; i++)
+	len += iov[i].iov_len;
+    return write_all(c, iov, iovcnt, len, ms);
+}
+#endif /* HAVE_WRITEV */
+
+#endif /* EI_SHM */
@@ -0,0 +1,63 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+#ifndef _EI_SHM_H
+#define _EI_SHM_H
+
+/*
+ * Internal interface to connections over shared memory ring buffers
+ * to a node on the same host that runs the shm_dist carrier, see
+ * lib/kernel/examples/shm_dist. The file descriptor of a connection
+ * is an epoll descriptor that is readable when there is something to
+ * read, so it can be used in select() and poll() like a socket.
+ */
+
+#if defined(__linux__) && defined(HAVE_SYS_EVENTFD_H) \
+    && defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_MMAN_H)
+#define EI_SHM 1
+#endif
+
+#ifdef EI_SHM
+
+#include <netinet/in.h>
+#ifdef HAVE_WRITEV
+#include <sys/uio.h>
+#endif
+
+int ei_shm_listening(const struct in_addr *addr, const char *alivename);
+int ei_shm_connect(const char *alivename, unsigned ms);
+int ei_shm_close(int fd);
+void ei_shm_forget(int fd);
+int ei_shm_is_conn(int fd);
+int ei_shm_read(int fd, char *buf, int len, unsigned ms);
+int ei_shm_read_nb(int fd, char *buf, int len);
+int ei_shm_write(int fd, const char *buf, int len, unsigned ms);
+int ei_shm_write_nb(int fd, const char *buf, int len);
+#ifdef HAVE_WRITEV
+int ei_shm_writev(int fd, const struct iovec *iov, int iovcnt, unsigned ms);
+#endif
+
+#else /* !EI_SHM */
+
+#define ei_shm_is_conn(fd) 0
+#define ei_shm_forget(fd) ((void) 0)
+
+#endif /* !EI_SHM */
+
+#endif /* _EI_SHM_H */
@@ -43,59 +43,21 @@
 
 #define EIRECVBUF 2048 /* largest possible header is approx 1300 bytes */
 
-/* length (4), PASS_THOUGH (1), header, message */
-int 
-ei_recv_internal (int fd, 
-		  char **mbufp, int *bufsz, 
-		  erlang_msg *msg, int *msglenp, 
-		  int staticbufp, unsigned ms)
+/*
+ * Decode the pass-through byte and control message at the start of a
+ * distribution packet. Returns 0 on success, and sets *showp if the
+ * message is to be shown when tracing.
+ */
+static int
+recv_decode_header(char *header, int *indexp, erlang_msg *msg, int *showp)
 {
-  char header[EIRECVBUF];
-  char *s=header;
-  char *mbuf=*mbufp;
-  int len = 0;
-  int msglen = 0;
-  int bytesread = 0;
-  int remain;
+  char *s = header;
   int arity;
   int version;
-  int index = 0;
-  int i = 0;
-  int res;
+  int index = 1;
   int show_this_msg = 0;
 
-  /* get length field */
-  if ((res = ei_read_fill_t(fd, header, 4, ms)) != 4) 
-  {
-      erl_errno = (res == -2) ? ETIMEDOUT : EIO;
-      return -1;
-  }
-  len = get32be(s);
-
-  /* got tick - respond and return */
-  if (!len) {
-    char tock[] = {0,0,0,0};
-    ei_write_fill_t(fd, tock, sizeof(tock), ms); /* Failure no problem */
-    *msglenp = 0;
-    return 0;			/* maybe flag ERL_EAGAIN [sverkerw] */
-  }
-  
-  /* turn off tracing on each receive. it will be turned back on if
-   * we receive a trace token.
-   */
-  ei_trace(-1,NULL);
-  
-  /* read enough to get at least entire header */
-  bytesread = (len > EIRECVBUF ? EIRECVBUF : len); 
-  if ((i = ei_read_fill_t(fd,header,bytesread,ms)) != bytesread) {
-      erl_errno = (i == -2) ? ETIMEDOUT : EIO;
-      return -1;
-  }
-
-  /* now decode header */
   /* pass-through, version, control tuple header, control message type */
-  s = header;
-  index = 1;
   if ((get8(s) != ERL_PASS_THROUGH)
       || ei_decode_version(header,&index,&version)
       || (version != ERL_VERSION_MAGIC) 
@@ -202,6 +164,63 @@ ei_recv_internal (int fd,
     break;
   }
 
+  *indexp = index;
+  *showp = show_this_msg;
+  return 0;
+}
+
+
+/* length (4), PASS_THOUGH (1), header, message */
+int 
+ei_recv_internal (int fd, 
+		  char **mbufp, int *bufsz, 
+		  erlang_msg *msg, int *msglenp, 
+		  int staticbufp, unsigned ms)
+{
+  char header[EIRECVBUF];
+  char *s=header;
+  char *mbuf=*mbufp;
+  int len = 0;
+  int msglen = 0;
+  int bytesread = 0;
+  int remain;
+  int index = 0;
+  int i = 0;
+  int res;
+  int show_this_msg = 0;
+
+  /* get length field */
+  if ((res = ei_read_fill_t(fd, header, 4, ms)) != 4) 
+  {
+      erl_errno = (res == -2) ? ETIMEDOUT : EIO;
+      return -1;
+  }
+  len = get32be(s);
+
+  /* got tick - respond and return */
+  if (!len) {
+    char tock[] = {0,0,0,0};
+    ei_write_fill_t(fd, tock, sizeof(tock), ms); /* Failure no problem */
+    *msglenp = 0;
+    return 0;			/* maybe flag ERL_EAGAIN [sverkerw] */
+  }
+  
+  /* turn off tracing on each receive. it will be turned back on if
+   * we receive a trace token.
+   */
+  ei_trace(-1,NULL);
+  
+  /* read enough to get at least entire header */
+  bytesread = (len > EIRECVBUF ? EIRECVBUF : len); 
+  if ((i = ei_read_fill_t(fd,header,bytesread,ms)) != bytesread) {
+      erl_errno = (i == -2) ? ETIMEDOUT : EIO;
+      return -1;
+  }
+
+  /* now decode header */
+  if (recv_decode_header(header, &index, msg, &show_this_msg) < 0)
+      return -1;
+
   /* actual message is remaining part of headerbuf, plus any unread bytes */
   msglen = len - index;     /* message size (payload) */
   remain = len - bytesread; /* bytes left to read */
@@ -264,6 +283,89 @@ ei_recv_internal (int fd,
   return msg->msgtype;
 }
 
+/*
+ * As ei_recv_internal(), but parses the first packet of the len bytes
+ * in buf, as read from a connection by the caller. Returns -1 with
+ * erl_errno set to EAGAIN if buf does not hold a complete packet yet,
+ * otherwise *usedp is set to the size of the packet. Ticks are not
+ * answered.
+ */
+int
+ei_parse_internal(const char *buf, int len, int *usedp,
+		  char **mbufp, int *bufsz,
+		  erlang_msg *msg, int *msglenp)
+{
+  char header[EIRECVBUF];
+  const char *s = buf;
+  char *mbuf = *mbufp;
+  int plen;
+  int msglen;
+  int hlen;
+  int index = 0;
+  int show_this_msg = 0;
+
+  *usedp = 0;
+  if (len < 4) {
+    erl_errno = EAGAIN;
+    return -1;
+  }
+  plen = get32be(s);
+  if (plen < 0) {
+    erl_errno = EIO;
+    return -1;
+  }
+  if (len - 4 < plen) {
+    erl_errno = EAGAIN;
+    return -1;
+  }
+  *usedp = 4 + plen;
+
+  /* got tick */
+  if (!plen) {
+    *msglenp = 0;
+    return 0;
+  }
+
+  /* turn off tracing on each receive. it will be turned back on if
+   * we receive a trace token.
+   */
+  ei_trace(-1,NULL);
+
+  /* decode the header from a copy, as ei_recv_internal() does, so
+   * that a bad packet cannot make us read outside of buf
+   */
+  hlen = (plen > EIRECVBUF ? EIRECVBUF : plen);
+  memcpy(header, s, hlen);
+  if (recv_decode_header(header, &index, msg, &show_this_msg) < 0)
+      return -1;
+  if (index > hlen) {
+      erl_errno = EIO;
+      return -1;
+  }
+
+  msglen = plen - index;     /* message size (payload) */
+  if (msglen > *bufsz) {
+      if ((mbuf = realloc(*mbufp, msglen)) == NULL)
+      {
+	  erl_errno = ENOMEM;
+	  return -1;
+      }
+      *mbufp = mbuf;
+      *bufsz = msglen;
+  }
+  memcpy(mbuf, s + index, msglen);
+  *msglenp = msglen;
+
+  if (show_this_msg)
+      ei_show_recmsg(stderr,msg,mbuf);
+
+  /* the caller only sees "untraced" message types */
+  /* the trace token is buried in the message struct */
+  if (msg->msgtype > 10) msg->msgtype -= 10;
+  
+  return msg->msgtype;
+}
+
 int ei_receive_encoded(int fd, char **mbufp, int *bufsz,
 		       erlang_msg *msg, int *msglen)
 {
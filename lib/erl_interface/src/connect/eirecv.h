@@ -23,5 +23,8 @@
 /* Internal interface */
 int ei_recv_internal(int fd, char **mbufp, int *bufsz, erlang_msg *msg,
 		     int *msglenp, int staticbufp, unsigned ms);
+int ei_parse_internal(const char *buf, int len, int *usedp,
+		      char **mbufp, int *bufsz,
+		      erlang_msg *msg, int *msglenp);
 
 #endif /* _EIRECV_H */
@@ -0,0 +1,399 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+/*
+ * Pull-style decoding of terms from a ring buffer. Each call to
+ * ei_stream_next() decodes one term, or only the header of a tuple,
+ * list or map, and consumes its bytes. Atoms, strings and binaries
+ * are returned as pointers into the ring buffer, and pids, ports,
+ * references, funs, exports and bignums that do not fit in a long as
+ * pointers to their encoding, so nothing is copied or allocated.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "eidef.h"
+#include "eiext.h"
+#include "putget.h"
+
+/* largest fixed size part that is decoded, FLOAT_EXT */
+#define STREAM_MAX_HEAD 32
+
+/* Returns a pointer to n contiguous bytes at offset off from the first
+ * undecoded byte, copying them to tmp if they wrap around the end of
+ * the ring buffer, or NULL if they are not available yet. */
+static const char* stream_peek(const ei_stream* s, int off, int n, char* tmp)
+{
+    int pos;
+
+    if (n > s->len - off)
+	return NULL;
+    pos = s->start + off;
+    if (pos >= s->size)
+	pos -= s->size;
+    if (pos + n <= s->size)
+	return s->buff + pos;
+    memcpy(tmp, s->buff + pos, s->size - pos);
+    memcpy(tmp + s->size - pos, s->buff, n - (s->size - pos));
+    return tmp;
+}
+
+/* Point the data of t at the n bytes at offset off */
+static void stream_data(const ei_stream* s, int off, int n, ei_stream_term* t)
+{
+    int pos = s->start + off;
+
+    if (pos >= s->size)
+	pos -= s->size;
+    t->size = n;
+    t->data[0] = s->buff + pos;
+    if (pos + n <= s->size) {
+	t->datalen[0] = n;
+    } else {
+	t->datalen[0] = s->size - pos;
+	t->data[1] = s->buff;
+	t->datalen[1] = n - t->datalen[0];
+    }
+}
+
+/* Returns the size of the atom at offset off, -1 if it is not an atom
+ * and -2 if more data is needed. */
+static int stream_atom_size(const ei_stream* s, int off)
+{
+    char tmp[3];
+    const char* p;
+
+    if ((p = stream_peek(s, off, 1, tmp)) == NULL)
+	return -2;
+    switch (get8(p)) {
+    case ERL_ATOM_EXT:
+    case ERL_ATOM_UTF8_EXT:
+	if ((p = stream_peek(s, off, 3, tmp)) == NULL)
+	    return -2;
+	p++;
+	return 3 + get16be(p);
+    case ERL_SMALL_ATOM_EXT:
+    case ERL_SMALL_ATOM_UTF8_EXT:
+	if ((p = stream_peek(s, off, 2, tmp)) == NULL)
+	    return -2;
+	p++;
+	return 2 + get8(p);
+    default:
+	return -1;
+    }
+}
+
+/* Returns the size of the n terms at offset off, -1 if they are not
+ * valid and -2 if more data is needed. Used for old funs, whose size
+ * is not known until their free variables have been walked, and for
+ * exports. */
+static int stream_terms_size(const ei_stream* s, int off, int n)
+{
+    ei_stream sub = *s;
+    ei_stream_term t;
+
+    sub.start += off;
+    if (sub.start >= sub.size)
+	sub.start -= sub.size;
+    sub.len -= off;
+    while (n > 0) {
+	if (ei_stream_next(&sub, &t) < 0)
+	    return (erl_errno == EIO) ? -1 : -2;
+	n--;
+	if (t.arity > sub.len)
+	    return -2;
+	switch (t.ei_type) {
+	case ERL_SMALL_TUPLE_EXT:
+	case ERL_LARGE_TUPLE_EXT: n += t.arity; break;
+	case ERL_LIST_EXT:        n += t.arity + 1; break;
+	case ERL_MAP_EXT:         n += 2 * t.arity; break;
+	}
+    }
+    return s->len - off - sub.len;
+}
+
+/* Little endian magnitude of n bytes, returns 0 if it does not fit */
+static int stream_big_to_long(const char* p, int n, int sign, long* lp)
+{
+    unsigned long u = 0;
+    int i;
+
+    if (n > (int) sizeof(long))
+	return 0;
+    for (i = 0; i < n; i++)
+	u |= ((unsigned long) get8(p)) << (i * 8);
+    if (sign) {
+	if (u > (unsigned long) LONG_MAX + 1)
+	    return 0;
+	*lp = -(long) (u - 1) - 1;
+    } else {
+	if (u > LONG_MAX)
+	    return 0;
+	*lp = (long) u;
+    }
+    return 1;
+}
+
+void ei_stream_init(ei_stream* s, const char* buff, int size)
+{
+    s->buff = buff;
+    s->size = size;
+    s->start = 0;
+    s->len = 0;
+}
+
+int ei_stream_decode_version(ei_stream* s, int* version)
+{
+    char tmp[1];
+    const char* p;
+    int v;
+
+    if ((p = stream_peek(s, 0, 1, tmp)) == NULL) {
+	erl_errno = EAGAIN;
+	return -1;
+    }
+    v = get8(p);
+    if (version) *version = v;
+    if (v != ERL_VERSION_MAGIC) {
+	erl_errno = EIO;
+	return -1;
+    }
+    if (++s->start == s->size)
+	s->start = 0;
+    s->len--;
+    return 0;
+}
+
+int ei_stream_next(ei_stream* s, ei_stream_term* t)
+{
+    char tmp[STREAM_MAX_HEAD];
+    const char* head = s->buff + s->start;
+    int contig = s->size - s->start; /* bytes until the end of the ring */
+    const char* p;
+    int used;			/* bytes in the term or header */
+    int n, a;
+
+    /* make the first N bytes available at p, skipping the tag */
+#define PEEK(N) do {						\
+	if ((N) <= contig && (N) <= s->len)			\
+	    p = head;						\
+	else if ((p = stream_peek(s, 0, (N), tmp)) == NULL)	\
+	    { used = (N); goto more; }				\
+	p++;							\
+    } while (0)
+
+    t->arity = 0;
+    t->size = 0;
+    t->data[0] = t->data[1] = NULL;
+    t->datalen[0] = t->datalen[1] = 0;
+
+    PEEK(1);
+    t->ei_type = ((unsigned char *) p)[-1];
+    switch (t->ei_type) {
+    case ERL_SMALL_INTEGER_EXT:
+	PEEK(2);
+	t->value.i_val = get8(p);
+	used = 2;
+	break;
+    case ERL_INTEGER_EXT:
+	PEEK(5);
+	t->value.i_val = get32be(p);
+	used = 5;
+	break;
+    case ERL_SMALL_BIG_EXT:
+    case ERL_LARGE_BIG_EXT:
+	if (t->ei_type == ERL_SMALL_BIG_EXT) {
+	    PEEK(3);
+	    n = get8(p);
+	    used = 3;
+	} else {
+	    PEEK(6);
+	    n = get32be(p);
+	    used = 6;
+	    if (n < 0) goto bad;
+	}
+	if (n <= (int) sizeof(long)) {
+	    PEEK(used + n);
+	    p += used - 2;
+	    a = get8(p);
+	    if (stream_big_to_long(p, n, a, &t->value.i_val)) {
+		used += n;
+		break;
+	    }
+	}
+	/* does not fit, pass on the encoding */
+	if (n > INT_MAX - used) goto bad;
+	used += n;
+	goto raw;
+    case ERL_FLOAT_EXT:
+	{
+	    char f[STREAM_MAX_HEAD];
+	    PEEK(32);
+	    memcpy(f, p, 31);
+	    f[31] = '\0';
+	    if (sscanf(f, "%lf", &t->value.d_val) != 1) goto bad;
+	    used = 32;
+	}
+	break;
+    case NEW_FLOAT_EXT:
+	{
+	    FloatExt f;
+	    PEEK(9);
+	    f.val = get64be(p);
+	    t->value.d_val = f.d;
+	    used = 9;
+	}
+	break;
+    case ERL_ATOM_EXT:
+    case ERL_ATOM_UTF8_EXT:
+    case ERL_STRING_EXT:
+	PEEK(3);
+	n = get16be(p);
+	used = 3;
+	goto data;
+    case ERL_SMALL_ATOM_EXT:
+    case ERL_SMALL_ATOM_UTF8_EXT:
+	PEEK(2);
+	n = get8(p);
+	used = 2;
+	goto data;
+    case ERL_BINARY_EXT:
+	PEEK(5);
+	n = get32be(p);
+	used = 5;
+	if (n < 0 || n > INT_MAX - used) goto bad;
+	goto data;
+    case ERL_BIT_BINARY_EXT:
+	PEEK(6);
+	n = get32be(p);
+	t->value.i_val = get8(p); /* bits used in the last byte */
+	used = 6;
+	if (n < 0 || n > INT_MAX - used || t->value.i_val > 8
+	    || (n > 0) != (t->value.i_val > 0)) goto bad;
+    data:
+	if (n > s->len - used) {
+	    used += n;
+	    goto more;
+	}
+	stream_data(s, used, n, t);
+	used += n;
+	break;
+    case ERL_SMALL_TUPLE_EXT:
+	PEEK(2);
+	t->arity = get8(p);
+	used = 2;
+	break;
+    case ERL_LARGE_TUPLE_EXT:
+    case ERL_LIST_EXT:
+    case ERL_MAP_EXT:
+	PEEK(5);
+	t->arity = get32be(p);
+	if (t->arity < 0) goto bad;
+	used = 5;
+	break;
+    case ERL_NIL_EXT:
+	used = 1;
+	break;
+    case ERL_PID_EXT:
+    case ERL_NEW_PID_EXT:
+    case ERL_PORT_EXT:
+    case ERL_NEW_PORT_EXT:
+    case ERL_REFERENCE_EXT:
+	if ((a = stream_atom_size(s, 1)) < 0) {
+	    used = 1 + 3;
+	    if (a == -2) goto more;
+	    goto bad;
+	}
+	switch (t->ei_type) {
+	case ERL_PID_EXT:      used = 1 + a + 4 + 4 + 1; break;
+	case ERL_NEW_PID_EXT:  used = 1 + a + 4 + 4 + 4; break;
+	case ERL_PORT_EXT:     used = 1 + a + 4 + 1;     break;
+	case ERL_NEW_PORT_EXT: used = 1 + a + 4 + 4;     break;
+	default:               used = 1 + a + 4 + 1;     break;
+	}
+	goto raw;
+    case ERL_NEW_REFERENCE_EXT:
+    case ERL_NEWER_REFERENCE_EXT:
+	PEEK(3);
+	n = get16be(p);
+	if ((a = stream_atom_size(s, 3)) < 0) {
+	    used = 3 + 3;
+	    if (a == -2) goto more;
+	    goto bad;
+	}
+	used = 3 + a + (t->ei_type == ERL_NEW_REFERENCE_EXT ? 1 : 4) + 4 * n;
+	goto raw;
+    case ERL_FUN_EXT:
+	PEEK(5);
+	n = get32be(p);		/* number of free variables */
+	if (n < 0) goto bad;
+	/* pid, module, index, uniq and the free variables */
+	if (n > s->len || (a = stream_terms_size(s, 5, 4 + n)) < 0) {
+	    used = s->len + 1;
+	    if (n > s->len || a == -2) goto more;
+	    goto bad;
+	}
+	used = 5 + a;
+	goto raw;
+    case ERL_EXPORT_EXT:
+	/* module, function and arity */
+	if ((a = stream_terms_size(s, 1, 3)) < 0) {
+	    used = s->len + 1;
+	    if (a == -2) goto more;
+	    goto bad;
+	}
+	used = 1 + a;
+	goto raw;
+    case ERL_NEW_FUN_EXT:
+	PEEK(5);
+	n = get32be(p);		/* includes the size field */
+	if (n < 4 || n == INT_MAX) goto bad;
+	used = 1 + n;
+    raw:
+	if (used > s->len) goto more;
+	stream_data(s, 0, used, t);
+	break;
+    default:
+	goto bad;
+    }
+#undef PEEK
+
+    s->start += used;
+    if (s->start >= s->size)
+	s->start -= s->size;
+    s->len -= used;
+    return 0;
+
+more:
+    /* a term that does not fit in the ring buffer can never be decoded */
+    erl_errno = (used > s->size) ? EMSGSIZE : EAGAIN;
+    return -1;
+bad:
+    erl_errno = EIO;
+    return -1;
+}
+
+/* Copy the data of a term returned by ei_stream_next() to p */
+void ei_stream_term_copy(const ei_stream_term* t, char* p)
+{
+    memcpy(p, t->data[0], t->datalen[0]);
+    if (t->datalen[1] > 0)
+	memcpy(p + t->datalen[0], t->data[1], t->datalen[1]);
+}
@@ -3,9 +3,12 @@ $(ST_OBJDIR)/ei_connect.o: connect/ei_connect.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h misc/eiext.h misc/ei_portio.h \
   misc/ei_internal.h connect/ei_connect_int.h misc/ei_locking.h \
   connect/eisend.h connect/eirecv.h misc/eimd5.h misc/putget.h \
-  connect/ei_resolve.h epmd/ei_epmd.h
+  connect/ei_resolve.h epmd/ei_epmd.h connect/ei_shm.h
 $(ST_OBJDIR)/ei_resolve.o: connect/ei_resolve.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h connect/ei_resolve.h misc/ei_locking.h
+$(ST_OBJDIR)/ei_shm.o: connect/ei_shm.c misc/eidef.h $(TARGET)/config.h \
+  ../include/ei.h connect/ei_shm.h misc/ei_portio.h misc/ei_locking.h \
+  misc/putget.h
 $(ST_OBJDIR)/eirecv.o: connect/eirecv.c misc/eidef.h $(TARGET)/config.h \
   ../include/ei.h misc/eiext.h connect/eirecv.h misc/ei_portio.h \
   misc/ei_internal.h misc/putget.h misc/ei_trace.h misc/show_msg.h
@@ -64,6 +67,9 @@ $(ST_OBJDIR)/decode_ref.o: decode/decode_ref.c misc/eidef.h \
 $(ST_OBJDIR)/decode_skip.o: decode/decode_skip.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   decode/decode_skip.h
+$(ST_OBJDIR)/decode_stream.o: decode/decode_stream.c misc/eidef.h \
+  $(TARGET)/config.h ../include/ei.h misc/eiext.h \
+  misc/putget.h
 $(ST_OBJDIR)/decode_string.o: decode/decode_string.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/putget.h
@@ -154,7 +160,8 @@ $(ST_OBJDIR)/ei_format.o: misc/ei_format.c misc/eidef.h $(TARGET)/config.h \
 $(ST_OBJDIR)/ei_locking.o: misc/ei_locking.c $(TARGET)/config.h \
   misc/ei_malloc.h misc/ei_locking.h
 $(ST_OBJDIR)/ei_malloc.o: misc/ei_malloc.c misc/ei_malloc.h
-$(ST_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h
+$(ST_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h \
+  connect/ei_shm.h
 $(ST_OBJDIR)/ei_printterm.o: misc/ei_printterm.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/ei_printterm.h misc/ei_malloc.h
@@ -286,9 +293,12 @@ $(MT_OBJDIR)/ei_connect.o: connect/ei_connect.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h misc/eiext.h misc/ei_portio.h \
   misc/ei_internal.h connect/ei_connect_int.h misc/ei_locking.h \
   connect/eisend.h connect/eirecv.h misc/eimd5.h misc/putget.h \
-  connect/ei_resolve.h epmd/ei_epmd.h
+  connect/ei_resolve.h epmd/ei_epmd.h connect/ei_shm.h
 $(MT_OBJDIR)/ei_resolve.o: connect/ei_resolve.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h connect/ei_resolve.h misc/ei_locking.h
+$(MT_OBJDIR)/ei_shm.o: connect/ei_shm.c misc/eidef.h $(TARGET)/config.h \
+  ../include/ei.h connect/ei_shm.h misc/ei_portio.h misc/ei_locking.h \
+  misc/putget.h
 $(MT_OBJDIR)/eirecv.o: connect/eirecv.c misc/eidef.h $(TARGET)/config.h \
   ../include/ei.h misc/eiext.h connect/eirecv.h misc/ei_portio.h \
   misc/ei_internal.h misc/putget.h misc/ei_trace.h misc/show_msg.h
@@ -347,6 +357,9 @@ $(MT_OBJDIR)/decode_ref.o: decode/decode_ref.c misc/eidef.h \
 $(MT_OBJDIR)/decode_skip.o: decode/decode_skip.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   decode/decode_skip.h
+$(MT_OBJDIR)/decode_stream.o: decode/decode_stream.c misc/eidef.h \
+  $(TARGET)/config.h ../include/ei.h misc/eiext.h \
+  misc/putget.h
 $(MT_OBJDIR)/decode_string.o: decode/decode_string.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/putget.h
@@ -437,7 +450,8 @@ $(MT_OBJDIR)/ei_format.o: misc/ei_format.c misc/eidef.h $(TARGET)/config.h \
 $(MT_OBJDIR)/ei_locking.o: misc/ei_locking.c $(TARGET)/config.h \
   misc/ei_malloc.h misc/ei_locking.h
 $(MT_OBJDIR)/ei_malloc.o: misc/ei_malloc.c misc/ei_malloc.h
-$(MT_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h
+$(MT_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h \
+  connect/ei_shm.h
 $(MT_OBJDIR)/ei_printterm.o: misc/ei_printterm.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/ei_printterm.h misc/ei_malloc.h
@@ -569,9 +583,12 @@ $(MD_OBJDIR)/ei_connect.o: connect/ei_connect.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h misc/eiext.h misc/ei_portio.h \
   misc/ei_internal.h connect/ei_connect_int.h misc/ei_locking.h \
   connect/eisend.h connect/eirecv.h misc/eimd5.h misc/putget.h \
-  connect/ei_resolve.h epmd/ei_epmd.h
+  connect/ei_resolve.h epmd/ei_epmd.h connect/ei_shm.h
 $(MD_OBJDIR)/ei_resolve.o: connect/ei_resolve.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h connect/ei_resolve.h misc/ei_locking.h
+$(MD_OBJDIR)/ei_shm.o: connect/ei_shm.c misc/eidef.h $(TARGET)/config.h \
+  ../include/ei.h connect/ei_shm.h misc/ei_portio.h misc/ei_locking.h \
+  misc/putget.h
 $(MD_OBJDIR)/eirecv.o: connect/eirecv.c misc/eidef.h $(TARGET)/config.h \
   ../include/ei.h misc/eiext.h connect/eirecv.h misc/ei_portio.h \
   misc/ei_internal.h misc/putget.h misc/ei_trace.h misc/show_msg.h
@@ -630,6 +647,9 @@ $(MD_OBJDIR)/decode_ref.o: decode/decode_ref.c misc/eidef.h \
 $(MD_OBJDIR)/decode_skip.o: decode/decode_skip.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   decode/decode_skip.h
+$(MD_OBJDIR)/decode_stream.o: decode/decode_stream.c misc/eidef.h \
+  $(TARGET)/config.h ../include/ei.h misc/eiext.h \
+  misc/putget.h
 $(MD_OBJDIR)/decode_string.o: decode/decode_string.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/putget.h
@@ -720,7 +740,8 @@ $(MD_OBJDIR)/ei_format.o: misc/ei_format.c misc/eidef.h $(TARGET)/config.h \
 $(MD_OBJDIR)/ei_locking.o: misc/ei_locking.c $(TARGET)/config.h \
   misc/ei_malloc.h misc/ei_locking.h
 $(MD_OBJDIR)/ei_malloc.o: misc/ei_malloc.c misc/ei_malloc.h
-$(MD_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h
+$(MD_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h \
+  connect/ei_shm.h
 $(MD_OBJDIR)/ei_printterm.o: misc/ei_printterm.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/ei_printterm.h misc/ei_malloc.h
@@ -852,9 +873,12 @@ $(MDD_OBJDIR)/ei_connect.o: connect/ei_connect.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h misc/eiext.h misc/ei_portio.h \
   misc/ei_internal.h connect/ei_connect_int.h misc/ei_locking.h \
   connect/eisend.h connect/eirecv.h misc/eimd5.h misc/putget.h \
-  connect/ei_resolve.h epmd/ei_epmd.h
+  connect/ei_resolve.h epmd/ei_epmd.h connect/ei_shm.h
 $(MDD_OBJDIR)/ei_resolve.o: connect/ei_resolve.c $(TARGET)/config.h \
   misc/eidef.h ../include/ei.h connect/ei_resolve.h misc/ei_locking.h
+$(MDD_OBJDIR)/ei_shm.o: connect/ei_shm.c misc/eidef.h $(TARGET)/config.h \
+  ../include/ei.h connect/ei_shm.h misc/ei_portio.h misc/ei_locking.h \
+  misc/putget.h
 $(MDD_OBJDIR)/eirecv.o: connect/eirecv.c misc/eidef.h $(TARGET)/config.h \
   ../include/ei.h misc/eiext.h connect/eirecv.h misc/ei_portio.h \
   misc/ei_internal.h misc/putget.h misc/ei_trace.h misc/show_msg.h
@@ -913,6 +937,9 @@ $(MDD_OBJDIR)/decode_ref.o: decode/decode_ref.c misc/eidef.h \
 $(MDD_OBJDIR)/decode_skip.o: decode/decode_skip.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   decode/decode_skip.h
+$(MDD_OBJDIR)/decode_stream.o: decode/decode_stream.c misc/eidef.h \
+  $(TARGET)/config.h ../include/ei.h misc/eiext.h \
+  misc/putget.h
 $(MDD_OBJDIR)/decode_string.o: decode/decode_string.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/putget.h
@@ -1003,7 +1030,8 @@ $(MDD_OBJDIR)/ei_format.o: misc/ei_format.c misc/eidef.h $(TARGET)/config.h \
 $(MDD_OBJDIR)/ei_locking.o: misc/ei_locking.c $(TARGET)/config.h \
   misc/ei_malloc.h misc/ei_locking.h
 $(MDD_OBJDIR)/ei_malloc.o: misc/ei_malloc.c misc/ei_malloc.h
-$(MDD_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h
+$(MDD_OBJDIR)/ei_portio.o: misc/ei_portio.c misc/ei_portio.h misc/ei_internal.h \
+  connect/ei_shm.h
 $(MDD_OBJDIR)/ei_printterm.o: misc/ei_printterm.c misc/eidef.h \
   $(TARGET)/config.h ../include/ei.h misc/eiext.h \
   misc/ei_printterm.h misc/ei_malloc.h
@@ -179,7 +179,7 @@ int erl_xconnect(Erl_IpAddr addr, char *alivename)
  *
  *  API: erl_close_connection()
  *
- *  Close a connection. FIXME call ei_close_connection() later. 
+ *  Close a connection.
  *
  *  Returns 0 on success and -1 on failure.
  *
@@ -187,7 +187,7 @@ int erl_xconnect(Erl_IpAddr addr, char *alivename)
 
 int erl_close_connection(int fd)
 {
-    return closesocket(fd);
+    return ei_close_connection(fd);
 }
 
 /*
@@ -99,6 +99,7 @@ static unsigned long param_one = 1;
 #include <string.h>
 #include "ei_portio.h"
 #include "ei_internal.h"
+#include "ei_shm.h"
 
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
@@ -142,6 +143,10 @@ int ei_writev_fill_t(int fd,  const  struct  iovec  *iov,  int iovcnt, unsigned
     int current_iovcnt;
     int sum;
 
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd))
+	return ei_shm_writev(fd, iov, iovcnt, ms);
+#endif
     for (sum = 0, i = 0; i < iovcnt; ++i) {
 	sum += iov[i].iov_len;
     }
@@ -281,6 +286,10 @@ int ei_accept_t(int fd, void  *addr,   void  *addrlen, unsigned ms)
 static int ei_read_t(int fd, char* buf, int len, unsigned  ms)
 {
     int res;
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd))
+	return ei_shm_read(fd, buf, len, ms);
+#endif
     if (ms != 0) {
 	fd_set readmask;
 	struct timeval tv;
@@ -352,11 +361,101 @@ int ei_read_fill(int fd, char* buf, int len)
     return ei_read_fill_t(fd, buf, len, 0);
 }
 
+/*
+ * Read what is available on fd without blocking, at most len bytes.
+ * Returns the number of bytes read, 0 for EOF, -2 if nothing could
+ * be read right now and -1 (and sets errno) for error. The socket
+ * itself is left in blocking mode.
+ */
+int ei_read_nb(int fd, char* buf, int len)
+{
+    int res;
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd))
+	return ei_shm_read_nb(fd, buf, len);
+#endif
+#ifdef MSG_DONTWAIT
+    res = recv(fd, buf, len, MSG_DONTWAIT);
+    if (MEANS_SOCKET_ERROR(res)) {
+	int err = GET_SOCKET_ERROR();
+	if (err == ERROR_WOULDBLOCK || err == EAGAIN || err == EINTR)
+	    return -2;
+	return -1;
+    }
+    return res;
+#else
+    fd_set readmask;
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    FD_ZERO(&readmask);
+    FD_SET(fd,&readmask);
+    switch (select(fd+1, &readmask, NULL, NULL, &tv)) {
+    case -1 :
+	return -1; /* i/o error */
+    case 0:
+	return -2; /* nothing to read */
+    default:
+	if (!FD_ISSET(fd, &readmask)) {
+	    return -1; /* Other error */
+	}
+    }
+    res = readsocket(fd, buf, len);
+    return (res < 0) ? -1 : res;
+#endif
+}
+
+/*
+ * Write at most len bytes without blocking. Returns the number of bytes
+ * written, -2 if nothing could be written right now, or -1 on error.
+ */
+int ei_write_nb(int fd, const char* buf, int len)
+{
+    int res;
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd))
+	return ei_shm_write_nb(fd, buf, len);
+#endif
+#ifdef MSG_DONTWAIT
+    res = send(fd, buf, len, MSG_DONTWAIT);
+    if (MEANS_SOCKET_ERROR(res)) {
+	int err = GET_SOCKET_ERROR();
+	if (err == ERROR_WOULDBLOCK || err == EAGAIN || err == EINTR)
+	    return -2;
+	return -1;
+    }
+    return res;
+#else
+    fd_set writemask;
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    FD_ZERO(&writemask);
+    FD_SET(fd,&writemask);
+    switch (select(fd+1, NULL, &writemask, NULL, &tv)) {
+    case -1 :
+	return -1; /* i/o error */
+    case 0:
+	return -2; /* no room to write */
+    default:
+	if (!FD_ISSET(fd, &writemask)) {
+	    return -1; /* Other error */
+	}
+    }
+    res = writesocket(fd, buf, len);
+    return (res < 0) ? -1 : res;
+#endif
+}
+
 /* write entire buffer on fd  or fail (setting errno)
  */
 int ei_write_fill_t(int fd, const char *buf, int len, unsigned ms)
 {
     int i,done=0;
+#ifdef EI_SHM
+    if (ei_shm_is_conn(fd))
+	return ei_shm_write(fd, buf, len, ms);
+#endif
     if (ms != 0U) {
 	SET_NONBLOCKING(fd);
     }    
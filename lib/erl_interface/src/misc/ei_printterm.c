@@ -341,6 +341,7 @@ int ei_s_print_term(char** s, const char* buf, int* index)
 	x.buff = *s;
 	x.index = 0;
 	x.buffsz = BUFSIZ;
+	x.flags = 0;
     } else {
 	ei_x_new(&x);
     }
@@ -48,6 +48,7 @@ int ei_x_new(ei_x_buff* x)
     x->buff = ei_malloc(ei_x_extra);
     x->buffsz = ei_x_extra;
     x->index = 0;
+    x->flags = 0;
     return x->buff != NULL ? 0 : -1;
 }
 
@@ -58,18 +59,46 @@ int ei_x_new_with_version(ei_x_buff* x)
     return ei_encode_version(x->buff, &x->index);
 }
 
+/*
+ * An ei_x_buff that encodes into memory owned by the caller and is
+ * never reallocated; encoding fails when the arena is full. Such a
+ * buffer is marked by the EI_X_ARENA flag.
+ */
+int ei_x_new_arena(ei_x_buff* x, char* arena, int size)
+{
+    if (arena == NULL || size <= 0)
+	return -1;
+    x->buff = arena;
+    x->buffsz = size;
+    x->index = 0;
+    x->flags = EI_X_ARENA;
+    return 0;
+}
+
+int ei_x_new_arena_with_version(ei_x_buff* x, char* arena, int size)
+{
+    if (ei_x_new_arena(x, arena, size) < 0)
+	return -1;
+    return ei_encode_version(x->buff, &x->index);
+}
+
 int ei_x_free(ei_x_buff* x)
 {
     if (x->buff == NULL)
 	return -1;
-    ei_free(x->buff);
+    if (!(x->flags & EI_X_ARENA))
+	ei_free(x->buff);
     x->buff = NULL;
     return 0;
 }
 
 int x_fix_buff(ei_x_buff* x, int szneeded)
 {
-    int sz = szneeded + ei_x_extra;
+    int sz;
+
+    if (x->flags & EI_X_ARENA)
+	return szneeded <= x->buffsz;
+    sz = szneeded + ei_x_extra;
     if (sz > x->buffsz) {
 	sz += ei_x_extra;	/* to avoid reallocating each and every time */
 	x->buffsz = sz;
@@ -100,6 +100,7 @@ int get_bin_term(ei_x_buff* x, ei_term* term)
     x->buff = read_packet(&len);
     x->buffsz = len;
     x->index = 0;
+    x->flags = 0;
     switch (x->buff[x->index++]) {
     case 'e':
 	return 1;
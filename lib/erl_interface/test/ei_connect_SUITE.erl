@@ -22,6 +22,8 @@
 -module(ei_connect_SUITE).
 
 -include_lib("common_test/include/ct.hrl").
+-include_lib("kernel/include/file.hrl").
+-include_lib("kernel/include/net_address.hrl").
 -include("ei_connect_SUITE_data/ei_connect_test_cases.hrl").
 
 -export([all/0, suite/0,
@@ -32,7 +34,10 @@
          rpc_test/1,
          ei_send_funs/1,
          ei_threaded_send/1,
-         ei_set_get_tracelevel/1]).
+         ei_set_get_tracelevel/1,
+         ei_receive_nb/1,
+         ei_socket_info/1,
+         ei_shm_connect/1]).
 
 -import(runner, [get_term/1,send_term/2]).
 
@@ -42,7 +47,8 @@ suite() ->
 
 all() -> 
     [ei_send, ei_reg_send, ei_rpc, ei_format_pid, ei_send_funs,
-     ei_threaded_send, ei_set_get_tracelevel].
+     ei_threaded_send, ei_set_get_tracelevel, ei_receive_nb,
+     ei_socket_info, ei_shm_connect].
 
 ei_send(Config) when is_list(Config) ->
     P = runner:start(?interpret),
@@ -165,6 +171,188 @@ ei_set_get_tracelevel(Config) when is_list(Config) ->
     runner:recv_eot(P),
     ok.
 
+ei_receive_nb(Config) when is_list(Config) ->
+    P = runner:start(?interpret),
+    0 = ei_connect_init(P, 42, erlang:get_cookie(), 0),
+    {ok,Fd} = ei_connect(P, node()),
+    [CNode] = nodes(hidden),
+
+    Msgs = [a, {b,"a string",3.14}, lists:seq(1, 1000),
+            list_to_binary(lists:duplicate(20000, "abc")),
+            [self()|make_ref()]],
+    N = length(Msgs),
+    [begin
+         send_command(P, ei_receive_nb, [Fd,N,Chunk]),
+         [{any,CNode} ! M || M <- Msgs],
+         {term,Msgs} = get_term(P)
+     end || Chunk <- [0, 1, 7, 4096]],
+
+    runner:send_eot(P),
+    runner:recv_eot(P),
+    ok.
+
+%% The distribution version of each connection is kept in a table that
+%% grows five entries at a time. Check that no connection is lost from
+%% it, and that closed connections are removed from it.
+ei_socket_info(Config) when is_list(Config) ->
+    P = runner:start(?interpret),
+    Connect = fun(I) ->
+                      0 = ei_connect_init(P, I, erlang:get_cookie(), 0),
+                      {ok,Fd} = ei_connect(P, node()),
+                      Fd
+              end,
+    Fds = [Connect(I) || I <- lists:seq(1, 12)],
+    [true = erl_distversion(P, Fd) > 4 || Fd <- Fds],
+
+    {Close,Keep} = lists:split(7, Fds),
+    [ok = ei_close_connection(P, Fd) || Fd <- Close],
+    [-1 = erl_distversion(P, Fd) || Fd <- Close],
+    [true = erl_distversion(P, Fd) > 4 || Fd <- Keep],
+
+    %% The descriptors of the closed connections are reused
+    Fds2 = [Connect(I) || I <- lists:seq(13, 19)],
+    [true = erl_distversion(P, Fd) > 4 || Fd <- Keep ++ Fds2],
+    [ok = ei_close_connection(P, Fd) || Fd <- Keep ++ Fds2],
+    [-1 = erl_distversion(P, Fd) || Fd <- Keep ++ Fds2],
+
+    runner:send_eot(P),
+    runner:recv_eot(P),
+    ok.
+
+%% Connect to a node on this host that runs the shm_dist example
+%% carrier. The connection goes over shared memory only when asked for
+%% with EI_SHM_DIST, and only if the socket directory is private.
+ei_shm_connect(Config) when is_list(Config) ->
+    case os:type() of
+        {unix,linux} ->
+            case build_shm_dist(Config) of
+                {ok,Ebin} -> ei_shm_connect(Config, Ebin);
+                {error,Reason} -> {skip,Reason}
+            end;
+        _ ->
+            {skip,"Only on Linux"}
+    end.
+
+ei_shm_connect(Config, Ebin) ->
+    {ok,Node} = test_server:start_node(ei_shm_connect, peer,
+                                       [{args,"-pa " ++ Ebin ++
+                                             " -proto_dist inet_tcp shm"}]),
+    try
+        [Alive,_] = string:tokens(atom_to_list(Node), "@"),
+        Dir = filename:dirname(rpc:call(Node, shm, socket_name, [Alive])),
+        {ok,#file_info{mode=Mode}} = file:read_file_info(Dir),
+        0 = Mode band 8#077,
+
+        P = start_shm_runner(Config, true),
+        {ok,Fd} = ei_connect(P, Node),
+        CNode = shm_cnode(Node),
+        shm = shm_protocol(Node, CNode),
+
+        S = "Hej du glade!", SRev = lists:reverse(S),
+        {term,S} = ei_rpc(P, Fd, self(), {lists,reverse}, [SRev]),
+
+        %% Larger than the rings, in both directions
+        Big = list_to_binary(lists:duplicate(100000, "abcdefghij")),
+        Msgs = [a, Big, {b,"a string",3.14}, Big, lists:seq(1, 1000)],
+        send_command(P, ei_receive_nb, [Fd,length(Msgs),0]),
+        [rpc:call(Node, erlang, send, [{any,CNode},M]) || M <- Msgs],
+        {term,Msgs} = runner:get_term(P, 10000),
+        Sink = rpc:call(Node, erlang, spawn, [timer,sleep,[infinity]]),
+        ok = ei_send(P, Fd, Sink, {Big,Msgs}),
+        ok = wait_until(fun() ->
+                                rpc:call(Node, erlang, process_info,
+                                         [Sink,messages]) =:=
+                                    {messages,[{Big,Msgs}]}
+                        end),
+
+        ok = ei_close_connection(P, Fd),
+        ok = wait_until(fun() ->
+                                rpc:call(Node, erlang, nodes, [hidden]) =:= []
+                        end),
+        runner:send_eot(P),
+        runner:recv_eot(P),
+
+        %% Not asked for
+        tcp = shm_connect_protocol(Config, Node, false),
+
+        %% Not a private directory
+        ok = file:change_mode(Dir, 8#755),
+        tcp = shm_connect_protocol(Config, Node, true),
+        ok = file:change_mode(Dir, 8#700),
+        shm = shm_connect_protocol(Config, Node, true)
+    after
+        test_server:stop_node(Node)
+    end,
+    ok.
+
+shm_connect_protocol(Config, Node, Shm) ->
+    P = start_shm_runner(Config, Shm),
+    {ok,Fd} = ei_connect(P, Node),
+    Protocol = shm_protocol(Node, shm_cnode(Node)),
+    ok = ei_close_connection(P, Fd),
+    ok = wait_until(fun() ->
+                            rpc:call(Node, erlang, nodes, [hidden]) =:= []
+                    end),
+    runner:send_eot(P),
+    runner:recv_eot(P),
+    Protocol.
+
+%% The environment of the C program is taken when it is started
+start_shm_runner(Config, Shm) ->
+    true = os:putenv("EI_SHM_DIST", if Shm -> "1"; true -> "0" end),
+    P = runner:start(?interpret),
+    true = os:unsetenv("EI_SHM_DIST"),
+    0 = ei_connect_init(P, 42, erlang:get_cookie(), 0),
+    P.
+
+shm_cnode(Node) ->
+    [CNode] = rpc:call(Node, erlang, nodes, [hidden]),
+    CNode.
+
+shm_protocol(Node, CNode) ->
+    {ok,Info} = rpc:call(Node, net_kernel, node_info, [CNode]),
+    #net_address{protocol=Protocol} = proplists:get_value(address, Info),
+    Protocol.
+
+%% Build the shm_dist example from the kernel application into priv_dir
+build_shm_dist(Config) ->
+    Src = filename:join(code:lib_dir(kernel), "examples/shm_dist"),
+    Dir = filename:join(proplists:get_value(priv_dir, Config), "shm_dist"),
+    Ebin = filename:join(Dir, "ebin"),
+    Lib = filename:join(Dir, "priv/lib"),
+    Include = filename:join([code:root_dir(),"usr","include"]),
+    Drv = filename:join(Lib, "shm_drv.so"),
+    case filelib:is_dir(Src) of
+        false ->
+            {error,"No shm_dist example"};
+        true ->
+            ok = filelib:ensure_dir(filename:join(Ebin, "x")),
+            ok = filelib:ensure_dir(filename:join(Lib, "x")),
+            [{ok,_} = compile:file(filename:join([Src,"src",M]),
+                                   [{outdir,Ebin},report])
+             || M <- ["shm_server","shm","shm_dist"]],
+            {ok,_} = file:copy(filename:join([Src,"src","shm_dist.app"]),
+                               filename:join(Ebin, "shm_dist.app")),
+            Out = os:cmd("cc -O2 -fPIC -shared -I" ++ Include ++
+                             " -o " ++ Drv ++ " " ++
+                             filename:join([Src,"c_src","shm_drv.c"])),
+            case filelib:is_file(Drv) of
+                true -> {ok,Ebin};
+                false -> {error,"Could not build shm_drv: " ++ Out}
+            end
+    end.
+
+wait_until(Fun) ->
+    wait_until(Fun, 100).
+
+wait_until(_Fun, 0) ->
+    timeout;
+wait_until(Fun, N) ->
+    case Fun() of
+        true -> ok;
+        false -> receive after 100 -> wait_until(Fun, N-1) end
+    end.
+
 
 %%% Interface functions for ei (erl_interface) functions.
 
@@ -181,6 +369,16 @@ ei_connect(P, Node) ->
         {term,{-1,Errno}} -> {error,Errno}
     end.
 
+ei_close_connection(P, Fd) ->
+    send_command(P, ei_close_connection, [Fd]),
+    get_send_result(P).
+
+erl_distversion(P, Fd) ->
+    send_command(P, erl_distversion, [Fd]),
+    case get_term(P) of
+        {term,Version} when is_integer(Version) -> Version
+    end.
+
 ei_set_get_tracelevel(P, Tracelevel) ->
     send_command(P, ei_set_get_tracelevel, [Tracelevel]),
     case get_term(P) of
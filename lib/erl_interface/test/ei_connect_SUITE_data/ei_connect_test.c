@@ -30,8 +30,17 @@
 #ifdef VXWORKS
 #include "reclaim.h"
 #endif
+#ifdef __WIN32__
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
 
 #include "ei_runner.h"
+#include "erl_interface.h"
 
 static void cmd_ei_connect_init(char* buf, int len);
 static void cmd_ei_connect(char* buf, int len);
@@ -41,6 +50,9 @@ static void cmd_ei_send_funs(char* buf, int len);
 static void cmd_ei_reg_send(char* buf, int len);
 static void cmd_ei_rpc(char* buf, int len);
 static void cmd_ei_set_get_tracelevel(char* buf, int len);
+static void cmd_ei_receive_nb(char* buf, int len);
+static void cmd_ei_close_connection(char* buf, int len);
+static void cmd_erl_distversion(char* buf, int len);
 
 static void send_errno_result(int value);
 
@@ -60,6 +72,9 @@ static struct {
     "ei_rpc",  		     4, cmd_ei_rpc,
     "ei_set_get_tracelevel", 1, cmd_ei_set_get_tracelevel,
     "ei_format_pid",         2, cmd_ei_format_pid,
+    "ei_receive_nb",         3, cmd_ei_receive_nb,
+    "ei_close_connection",   1, cmd_ei_close_connection,
+    "erl_distversion",       1, cmd_erl_distversion,
 };
 
 
@@ -299,6 +314,95 @@ static void cmd_ei_rpc(char* buf, int len)
     ei_x_free(&rpc_x);
 }
 
+/*
+ * Receives n messages on fd and sends them back as a list. If chunk
+ * is 0, the messages are received with ei_xreceive_msg_nb() when
+ * select() says fd is readable, otherwise the data is read from fd
+ * chunk bytes at a time and the messages are taken apart with
+ * ei_xparse_msg().
+ */
+static void cmd_ei_receive_nb(char* buf, int len)
+{
+    int index = 0, got = 0, r, version;
+    long fd, n, chunk;
+    erlang_msg msg;
+    ei_x_buff inbuf, x, res;
+    char data[4096];
+
+    if (ei_decode_long(buf, &index, &fd) < 0)
+	fail("expected long (fd)");
+    if (ei_decode_long(buf, &index, &n) < 0)
+	fail("expected long (n)");
+    if (ei_decode_long(buf, &index, &chunk) < 0 || chunk > sizeof(data))
+	fail("expected long (chunk)");
+    ei_x_new(&inbuf);
+    ei_x_new(&x);
+    ei_x_new_with_version(&res);
+    ei_x_encode_list_header(&res, n);
+    while (got < n) {
+	if (chunk == 0) {
+	    fd_set readmask;
+	    FD_ZERO(&readmask);
+	    FD_SET(fd, &readmask);
+	    if (select(fd+1, &readmask, NULL, NULL, NULL) < 0)
+		fail("select");
+	    r = ei_xreceive_msg_nb(fd, &inbuf, &msg, &x);
+	} else {
+	    r = ei_xparse_msg(&inbuf, &msg, &x);
+	    if (r == ERL_ERROR && erl_errno == EAGAIN) {
+		int i = recv(fd, data, chunk, 0);
+		if (i <= 0)
+		    fail("recv");
+		if (ei_x_append_buf(&inbuf, data, i) < 0)
+		    fail("append");
+		continue;
+	    }
+	}
+	if (r == ERL_ERROR) {
+	    if (erl_errno == EAGAIN)
+		continue;
+	    fail("receive");
+	} else if (r == ERL_MSG) {
+	    index = 0;
+	    if (ei_decode_version(x.buff, &index, &version) < 0)
+		fail("version");
+	    if (ei_x_append_buf(&res, x.buff + index, x.index - index) < 0)
+		fail("append");
+	    got++;
+	}
+    }
+    ei_x_encode_empty_list(&res);
+    send_bin_term(&res);
+    ei_x_free(&res);
+    ei_x_free(&x);
+    ei_x_free(&inbuf);
+}
+
+static void cmd_ei_close_connection(char* buf, int len)
+{
+    int index = 0;
+    long fd;
+
+    if (ei_decode_long(buf, &index, &fd) < 0)
+	fail("expected long (fd)");
+    send_errno_result(ei_close_connection(fd));
+}
+
+/* The distribution version kept for fd, or -1 if fd is not known */
+static void cmd_erl_distversion(char* buf, int len)
+{
+    int index = 0;
+    long fd;
+    ei_x_buff x;
+
+    if (ei_decode_long(buf, &index, &fd) < 0)
+	fail("expected long (fd)");
+    ei_x_new_with_version(&x);
+    ei_x_encode_long(&x, erl_distversion(fd));
+    send_bin_term(&x);
+    ei_x_free(&x);
+}
+
 static void send_errno_result(int value)
 {
     ei_x_buff x;
@@ -0,0 +1,113 @@
+%%
+%% %CopyrightBegin%
+%%
+%% Copyright Ericsson AB 2016. All Rights Reserved.
+%%
+%% Licensed under the Apache License, Version 2.0 (the "License");
+%% you may not use this file except in compliance with the License.
+%% You may obtain a copy of the License at
+%%
+%%     http://www.apache.org/licenses/LICENSE-2.0
+%%
+%% Unless required by applicable law or agreed to in writing, software
+%% distributed under the License is distributed on an "AS IS" BASIS,
+%% WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+%% See the License for the specific language governing permissions and
+%% limitations under the License.
+%%
+%% %CopyrightEnd%
+%%
+
+%%
+-module(ei_stream_SUITE).
+
+-include_lib("common_test/include/ct.hrl").
+-include_lib("common_test/include/ct_event.hrl").
+-include("ei_stream_SUITE_data/ei_stream_test_cases.hrl").
+
+-export([all/0, suite/0,
+         test_ei_stream_decode/1,
+         test_ei_stream_bench/1]).
+
+suite() ->
+    [{ct_hooks,[ts_install_cth]}].
+
+all() ->
+    [test_ei_stream_decode, test_ei_stream_bench].
+
+%% Decode terms fed in chunks to ring buffers of different sizes, and
+%% encode them again into an arena.
+test_ei_stream_decode(Config) when is_list(Config) ->
+    P = runner:start(?test_ei_stream_decode),
+
+    Small = [a, 'åäö', 0, 42, -1, 256,
+             -(1 bsl 31), 1 bsl 40, -(1 bsl 63), (1 bsl 63) - 1, 1 bsl 64,
+             -(1 bsl 200), 3.14, -0.5, "string", [], [1,2|3], {}, {a,{b,[c]}},
+             #{}, #{a => 1, "k" => {v}}, <<>>, <<1,2,3>>, <<1:1>>, <<1,2:7>>,
+             <<3:8/unit:8,1:3>>, fun lists:reverse/1, {fun erlang:abs/1},
+             self(), make_ref(), hd(erlang:ports()), [self()|make_ref()]],
+    Large = [lists:seq(1, 300), list_to_binary(lists:seq(0, 255)),
+             lists:duplicate(10, "a somewhat longer string"),
+             fun(X) -> {X, P} end, list_to_tuple(Small),
+             [{I, integer_to_list(I), <<I:64>>} || I <- lists:seq(1, 50)]],
+    Old = [term_to_binary(T, [{minor_version,0}]) || T <- [3.14, -0.5]] ++
+          [<<131,$v,(byte_size(A)):16,A/binary>> || A <- [<<"åäö"/utf8>>]] ++
+          [<<131,$w,(byte_size(A)):8,A/binary>> || A <- [<<"åäö"/utf8>>]] ++
+          [old_fun([])],
+    SmallEncs = [term_to_binary(T) || T <- Small] ++ Old,
+    LargeEncs = [term_to_binary(T) || T <- Large] ++
+                [old_fun([42, {x, [y, "z"]}, #{k => [v]},
+                          binary_to_term(old_fun([1]))])],
+
+    [Term = stream_rec(P, Bin, Ring, Chunk)
+     || Bin <- SmallEncs ++ LargeEncs, Term <- [binary_to_term(Bin)],
+        {Ring,Chunk} <- [{1024,1}, {1024,64}, {65536,65536}]],
+    [Term = stream_rec(P, Bin, Ring, Chunk)
+     || Bin <- SmallEncs, Term <- [binary_to_term(Bin)],
+        {Ring,Chunk} <- [{64,1}, {64,7}, {100,13}]],
+
+    %% A binary that does not fit in the ring buffer.
+    emsgsize = stream_rec(P, term_to_binary(<<0:1024/unit:8>>), 512, 100),
+
+    runner:send_eot(P),
+    runner:recv_eot(P),
+    ok.
+
+%% Compare the speed of decoding with ei_stream_next() and encoding
+%% into an arena with the ordinary ei_decode and ei_x_encode functions.
+test_ei_stream_bench(Config) when is_list(Config) ->
+    Term = [{record, I, float(I), <<I:800>>, "a short string",
+             [a, b, c], #{key => I}}
+            || I <- lists:seq(1, 200)],
+    N = 1000,
+    P = runner:start(?test_ei_stream_bench),
+    P ! {self(), {command, [$b, <<N:32>>, term_to_binary(Term)]}},
+    {term, {DecEi, DecStream, EncX, EncArena}} = runner:get_term(P, 60000),
+    runner:recv_eot(P),
+    Res = [{"decode_ei", DecEi}, {"decode_stream", DecStream},
+           {"encode_ei_x", EncX}, {"encode_arena", EncArena}],
+    [ct_event:notify(
+       #event{name = benchmark_data,
+              data = [{suite, "erl_interface"},
+                      {name, "ei_stream_" ++ Name},
+                      {value, N * 1000000 div max(1, Us)}]})
+     || {Name, Us} <- Res],
+    {comment, lists:flatten(
+                io_lib:format("decode ei/stream: ~p/~p us, "
+                              "encode ei_x/arena: ~p/~p us",
+                              [DecEi, DecStream, EncX, EncArena]))}.
+
+%% An R7 and older fun, FUN_EXT, whose size is only known after its
+%% free variables have been walked.
+old_fun(Free) ->
+    <<131,Pid/binary>> = term_to_binary(self()),
+    <<131,Mod/binary>> = term_to_binary(?MODULE),
+    Vars = << <<Enc/binary>> || V <- Free,
+                                <<131,Enc/binary>> <- [term_to_binary(V)] >>,
+    <<131,$u,(length(Free)):32,Pid/binary,Mod/binary,
+      97,1,98,4711:32,Vars/binary>>.
+
+stream_rec(P, Bin, Ring, Chunk) ->
+    P ! {self(), {command, [$d, <<Ring:32, Chunk:32>>, Bin]}},
+    {term, Term} = runner:get_term(P),
+    Term.
@@ -0,0 +1,351 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef VXWORKS
+#include "reclaim.h"
+#endif
+
+#include "ei_runner.h"
+
+/*
+ * Purpose: Tests decoding from a ring buffer with ei_stream_next() and
+ *          encoding into an arena, and compares their speed with the
+ *          ordinary ei_decode and ei_x_encode functions.
+ */
+
+static char arena[1 << 20];
+static char scratch[1 << 16];
+
+static int get32(const char* p)
+{
+    const unsigned char* s = (const unsigned char*) p;
+    return (s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3];
+}
+
+/*
+ * Encodes a term or header returned by ei_stream_next(). Returns the
+ * number of terms that follow as part of it.
+ */
+static int encode_stream_term(ei_x_buff* x, const ei_stream_term* t)
+{
+    const char* p = t->data[0];
+    int r, n = 0;
+
+    if (t->datalen[1] > 0) {
+	ei_stream_term_copy(t, scratch);
+	p = scratch;
+    }
+    switch (t->ei_type) {
+    case ERL_SMALL_INTEGER_EXT:
+    case ERL_INTEGER_EXT:
+	r = ei_x_encode_long(x, t->value.i_val);
+	break;
+    case ERL_SMALL_BIG_EXT:
+    case ERL_LARGE_BIG_EXT:
+	if (t->size == 0)
+	    r = ei_x_encode_long(x, t->value.i_val);
+	else
+	    r = ei_x_append_buf(x, p, t->size);
+	break;
+    case ERL_FLOAT_EXT:
+    case NEW_FLOAT_EXT:
+	r = ei_x_encode_double(x, t->value.d_val);
+	break;
+    case ERL_ATOM_EXT:
+    case ERL_SMALL_ATOM_EXT:
+	r = ei_x_encode_atom_len_as(x, p, t->size,
+				    ERLANG_LATIN1, ERLANG_LATIN1);
+	break;
+    case ERL_ATOM_UTF8_EXT:
+    case ERL_SMALL_ATOM_UTF8_EXT:
+	r = ei_x_encode_atom_len_as(x, p, t->size,
+				    ERLANG_UTF8, ERLANG_UTF8);
+	break;
+    case ERL_STRING_EXT:
+	r = ei_x_encode_string_len(x, p, t->size);
+	break;
+    case ERL_BINARY_EXT:
+	r = ei_x_encode_binary(x, p, t->size);
+	break;
+    case ERL_BIT_BINARY_EXT:
+	{
+	    char head[6];
+	    head[0] = ERL_BIT_BINARY_EXT;
+	    head[1] = (char) (t->size >> 24);
+	    head[2] = (char) (t->size >> 16);
+	    head[3] = (char) (t->size >> 8);
+	    head[4] = (char) t->size;
+	    head[5] = (char) t->value.i_val;
+	    r = ei_x_append_buf(x, head, 6);
+	    if (r >= 0)
+		r = ei_x_append_buf(x, p, t->size);
+	}
+	break;
+    case ERL_SMALL_TUPLE_EXT:
+    case ERL_LARGE_TUPLE_EXT:
+	r = ei_x_encode_tuple_header(x, t->arity);
+	n = t->arity;
+	break;
+    case ERL_LIST_EXT:
+	r = ei_x_encode_list_header(x, t->arity);
+	n = t->arity + 1;
+	break;
+    case ERL_NIL_EXT:
+	r = ei_x_encode_empty_list(x);
+	break;
+    case ERL_MAP_EXT:
+	r = ei_x_encode_map_header(x, t->arity);
+	n = 2 * t->arity;
+	break;
+    default:
+	r = ei_x_append_buf(x, p, t->size);
+	break;
+    }
+    if (r < 0)
+	fail("encode");
+    return n;
+}
+
+/* Appends at most chunk bytes of the remaining data to the ring */
+static int feed(ei_stream* s, char* ring, const char* data, int len,
+		int* fed, int chunk)
+{
+    int n = len - *fed, pos, first;
+
+    if (n > chunk)
+	n = chunk;
+    if (n > s->size - s->len)
+	n = s->size - s->len;
+    if (n <= 0)
+	return 0;
+    pos = (s->start + s->len) % s->size;
+    first = (pos + n <= s->size) ? n : s->size - pos;
+    memcpy(ring + pos, data + *fed, first);
+    memcpy(ring, data + *fed + first, n - first);
+    s->len += n;
+    *fed += n;
+    return n;
+}
+
+/*
+ * Reads packets of 'd', ring size, chunk size and an encoded term.
+ * The term is fed in chunks to a ring buffer, decoded from it and
+ * encoded again into an arena, and sent back.
+ */
+
+TESTCASE(test_ei_stream_decode)
+{
+    for (;;) {
+	int len, ring_size, chunk, fed = 0, pending = 1, version = 0, r;
+	char* packet = read_packet(&len);
+	char* ring;
+	ei_stream s;
+	ei_stream_term t;
+	ei_x_buff x;
+
+	if (packet[0] == 'e') {
+	    free_packet(packet);
+	    break;
+	}
+	ring_size = get32(packet + 1);
+	chunk = get32(packet + 5);
+	if ((ring = malloc(ring_size)) == NULL)
+	    fail("malloc");
+	ei_stream_init(&s, ring, ring_size);
+	if (ei_x_new_arena_with_version(&x, arena, sizeof(arena)) < 0)
+	    fail("ei_x_new_arena_with_version");
+
+	while (pending > 0) {
+	    if (!version) {
+		r = ei_stream_decode_version(&s, &version);
+	    } else if ((r = ei_stream_next(&s, &t)) == 0) {
+		pending += encode_stream_term(&x, &t) - 1;
+	    }
+	    if (r < 0) {
+		if (erl_errno == EMSGSIZE)
+		    break;
+		if (erl_errno != EAGAIN)
+		    fail("decode");
+		if (!feed(&s, ring, packet + 9, len - 9, &fed, chunk))
+		    fail("no more data");
+	    }
+	}
+	if (pending > 0) {
+	    ei_x_new_arena_with_version(&x, arena, sizeof(arena));
+	    ei_x_encode_atom(&x, "emsgsize");
+	} else if (s.len != 0 || fed != len - 9) {
+	    fail("trailing data");
+	}
+	send_bin_term(&x);
+	ei_x_free(&x);
+	free(ring);
+	free_packet(packet);
+    }
+    report(1);
+}
+
+/*
+ * Benchmarks.
+ */
+
+static int walk_ei(const char* buf, int* index)
+{
+    int type, size, i, n;
+    long l;
+    double d;
+
+    if (ei_get_type(buf, index, &type, &size) < 0)
+	return -1;
+    switch (type) {
+    case ERL_SMALL_INTEGER_EXT:
+    case ERL_INTEGER_EXT:
+	return ei_decode_long(buf, index, &l);
+    case ERL_FLOAT_EXT:
+    case NEW_FLOAT_EXT:
+	return ei_decode_double(buf, index, &d);
+    case ERL_ATOM_EXT:
+	return ei_decode_atom(buf, index, scratch);
+    case ERL_STRING_EXT:
+	return ei_decode_string(buf, index, scratch);
+    case ERL_BINARY_EXT:
+	return ei_decode_binary(buf, index, scratch, &l);
+    case ERL_SMALL_TUPLE_EXT:
+    case ERL_LARGE_TUPLE_EXT:
+	if (ei_decode_tuple_header(buf, index, &n) < 0)
+	    return -1;
+	break;
+    case ERL_LIST_EXT:
+	if (ei_decode_list_header(buf, index, &n) < 0)
+	    return -1;
+	n++;
+	break;
+    case ERL_NIL_EXT:
+	return ei_decode_list_header(buf, index, &n);
+    case ERL_MAP_EXT:
+	if (ei_decode_map_header(buf, index, &n) < 0)
+	    return -1;
+	n *= 2;
+	break;
+    default:
+	return ei_skip_term(buf, index);
+    }
+    for (i = 0; i < n; i++)
+	if (walk_ei(buf, index) < 0)
+	    return -1;
+    return 0;
+}
+
+static long elapsed_us(clock_t start)
+{
+    return (long) ((double) (clock() - start) * 1000000.0 / CLOCKS_PER_SEC);
+}
+
+/*
+ * Reads a packet of 'b', a number of iterations and an encoded term,
+ * and replies with the time in microseconds taken to decode the term
+ * that many times with the ei_decode functions and ei_stream_next(),
+ * and to encode it with ei_x_buff growing from ei_x_new() and backed
+ * by an arena.
+ */
+
+TESTCASE(test_ei_stream_bench)
+{
+    int len, n, i, j, index, version, pending, ntok;
+    char* packet = read_packet(&len);
+    const char* term = packet + 5;
+    int term_len = len - 5;
+    ei_stream s;
+    ei_stream_term* toks;
+    ei_x_buff x;
+    long us[4], sum = 0;
+    clock_t start;
+
+    n = get32(packet + 1);
+    if ((toks = malloc(term_len * sizeof(ei_stream_term))) == NULL)
+	fail("malloc");
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	index = 0;
+	if (ei_decode_version(term, &index, &version) < 0
+	    || walk_ei(term, &index) < 0)
+	    fail("walk_ei");
+    }
+    us[0] = elapsed_us(start);
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	ei_stream_init(&s, term, term_len);
+	s.len = term_len;
+	if (ei_stream_decode_version(&s, &version) < 0)
+	    fail("ei_stream_decode_version");
+	for (pending = 1, ntok = 0; pending > 0; pending--, ntok++) {
+	    ei_stream_term* t = &toks[ntok];
+	    if (ei_stream_next(&s, t) < 0)
+		fail("ei_stream_next");
+	    switch (t->ei_type) {
+	    case ERL_SMALL_TUPLE_EXT:
+	    case ERL_LARGE_TUPLE_EXT: pending += t->arity; break;
+	    case ERL_LIST_EXT:        pending += t->arity + 1; break;
+	    case ERL_MAP_EXT:         pending += 2 * t->arity; break;
+	    default:                  sum += t->size; break;
+	    }
+	}
+    }
+    us[1] = elapsed_us(start);
+
+    /* encode the terms from the last decoding */
+    start = clock();
+    for (i = 0; i < n; i++) {
+	ei_x_new_with_version(&x);
+	for (j = 0; j < ntok; j++)
+	    encode_stream_term(&x, &toks[j]);
+	sum += x.index;
+	ei_x_free(&x);
+    }
+    us[2] = elapsed_us(start);
+
+    start = clock();
+    for (i = 0; i < n; i++) {
+	ei_x_new_arena_with_version(&x, arena, sizeof(arena));
+	for (j = 0; j < ntok; j++)
+	    encode_stream_term(&x, &toks[j]);
+	sum += x.index;
+	ei_x_free(&x);
+    }
+    us[3] = elapsed_us(start);
+
+    if (sum == 0)
+	fail("nothing decoded");
+    ei_x_new_with_version(&x);
+    ei_x_encode_tuple_header(&x, 4);
+    for (i = 0; i < 4; i++)
+	ei_x_encode_long(&x, us[i]);
+    send_bin_term(&x);
+    ei_x_free(&x);
+    free(toks);
+    free_packet(packet);
+    report(1);
+}
@@ -0,0 +1,1469 @@
+/*
+ * %CopyrightBegin%
+ *
+ * Copyright Ericsson AB 2016. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * %CopyrightEnd%
+ */
+
+/*
+ * Purpose: Distribution over shared memory ring buffers between nodes
+ *          on the same host (Linux only).
+ *
+ * A connection is set up over a Unix domain socket in SOCKET_PATH-<uid>,
+ * a directory that only the user running the node can get into. Both
+ * sides check that the other side runs as the same user. The connecting
+ * side creates a sealed memfd segment with one ring buffer in each
+ * direction and an eventfd for each side, and passes them to the
+ * accepting side over the socket. After that all data goes through the
+ * ring buffers and the socket is only used to notice that the other side
+ * has gone away.
+ *
+ * A side only writes to the eventfd of the other side when the other
+ * side has said that it is about to sleep, so a busy connection moves
+ * data without any system calls. The layout of the segment and the
+ * setup message must match lib/erl_interface/src/connect/ei_shm.c.
+ */
+
+#ifndef __linux__
+#error "shm_drv needs eventfd and is only supported on Linux"
+#endif
+
+#define _GNU_SOURCE			/* struct ucred */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+
+#define HAVE_UIO_H
+#include "erl_driver.h"
+
+/*#define HARDDEBUG 1*/
+
+#ifdef HARDDEBUG
+#define DEBUGF(P) debugf P
+#include <stdarg.h>
+static void debugf(char *str, ...)
+{
+    va_list ap;
+    va_start(ap,str);
+    fprintf(stderr,"Shm_drv debug: ");
+    vfprintf(stderr,str, ap);
+    fprintf(stderr,"\r\n");
+    va_end(ap);
+}
+#else
+#define DEBUGF(P)
+#endif
+
+#define SET_NONBLOCKING(FD)			\
+     fcntl((FD), F_SETFL, 			\
+	   fcntl((FD), F_GETFL, 0) | O_NONBLOCK)
+
+#define ALLOC(X) my_malloc(X)
+#define FREE(X) driver_free(X)
+
+#define SOCKET_PATH "/tmp/erlang-shm"
+#define LOCK_SUFFIX ".lock"
+
+/* Packets delivered from one ready_input() call before yielding */
+#define RECV_BUDGET 64
+
+/* Limits for the output queue, in bytes */
+#define HIGH_WATERMARK (1024*1024)
+#define LOW_WATERMARK (256*1024)
+
+/*
+** The shared memory segment
+*/
+
+#define SHM_MAGIC "ERLSHM1"		/* including the '\0', 8 bytes */
+#define SHM_MAGIC_SIZE 8
+#define SHM_HELLO_SIZE (SHM_MAGIC_SIZE + 4)
+#define SHM_HEADER_SIZE 4096		/* data starts on the next page */
+#define SHM_RING_SIZE (1 << 17)		/* size of the rings we create */
+#define SHM_MIN_RING_SIZE 4096
+#define SHM_MAX_RING_SIZE (1 << 30)
+#define CACHE_LINE 64
+
+/* From linux/memfd.h and linux/fcntl.h, for older C libraries */
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+/* The segment must not change size once it is mapped */
+#define SHM_SEALS (F_SEAL_SHRINK | F_SEAL_GROW)
+
+typedef unsigned char Byte;
+typedef unsigned int Word;
+
+/*
+** The counters are free running byte counts, the number of bytes in
+** the ring is head - tail. Each counter and flag has a cache line of
+** its own. A consumer sets consumer_waiting before it sleeps and a
+** producer that has run out of space sets producer_waiting; the other
+** side clears the flag and writes to the eventfd of the sleeper.
+*/
+typedef struct {
+    volatile Word head;			/* written by the producer */
+    char pad0[CACHE_LINE - sizeof(Word)];
+    volatile Word tail;			/* written by the consumer */
+    char pad1[CACHE_LINE - sizeof(Word)];
+    volatile Word consumer_waiting;
+    char pad2[CACHE_LINE - sizeof(Word)];
+    volatile Word producer_waiting;
+    char pad3[CACHE_LINE - sizeof(Word)];
+} ShmRing;
+
+typedef struct {
+    char magic[SHM_MAGIC_SIZE];
+    Word size;				/* size of each ring */
+    char pad[CACHE_LINE - SHM_MAGIC_SIZE - sizeof(Word)];
+    ShmRing ring[2];			/* [0] is connector -> acceptor */
+} ShmHeader;
+
+#define MEMORY_BARRIER __sync_synchronize()
+#define TAKE_FLAG(F) ((F) && __sync_fetch_and_and(&(F), 0))
+
+/*
+** Internal structures
+*/
+
+typedef enum {
+    portTypeUnknown,      /* An uninitialized port */
+    portTypeListener,     /* A listening port/socket */
+    portTypeAcceptor,     /* An intermediate stage when accepting
+			     on a listen port */
+    portTypeConnector,    /* Waiting for the answer to our setup message */
+    portTypeSetup,        /* Accepted, waiting for the setup message */
+    portTypeCommand,      /* A connected open port in command mode */
+    portTypeIntermediate, /* A connected open port in special half
+			     active mode */
+    portTypeData          /* A connected open port in data mode */
+} PortType;
+
+typedef struct shm_data {
+    int fd;                   /* The socket */
+    int efd;                  /* Our eventfd, written by the other side */
+    int peer_efd;             /* The eventfd of the other side */
+    ErlDrvPort port;          /* The port identifier */
+    int lockfd;               /* The file descriptor for a lock file in
+				 case of listen sockets */
+    Byte creation;            /* The creation serial derived from the
+				 lockfile */
+    PortType type;            /* Type of port */
+    char *name;               /* Short name of socket for unlink */
+    Word sent;                /* Packets sent */
+    Word received;            /* Packets received */
+    struct shm_data *partner; /* The partner in an accept/listen pair */
+    struct shm_data *next;    /* Next structure in list */
+
+    /* The segment and the rings */
+    char *segment;
+    size_t segment_size;
+    Word size;                /* Size of each ring, a power of two */
+    ShmRing *rx;
+    ShmRing *tx;
+    char *rx_data;
+    char *tx_data;
+    int peer_closed;          /* The socket has been closed by the peer */
+
+    /* The packet being received */
+    int header_length;        /* 2 in command mode, otherwise 4 */
+    int recv_pending;         /* A receive command waits for a packet */
+    Byte header[4];
+    int header_pos;
+    ErlDrvBinary *bin;
+    int bin_pos;
+} ShmData;
+
+/*
+** Interface routines
+*/
+static ErlDrvData shm_start(ErlDrvPort port, char *buff);
+static void shm_stop(ErlDrvData handle);
+static void shm_outputv(ErlDrvData handle, ErlIOVec *ev);
+static void shm_input(ErlDrvData handle, ErlDrvEvent event);
+static void shm_finish(void);
+static ErlDrvSSizeT shm_control(ErlDrvData handle, unsigned int command,
+				char* buf, ErlDrvSizeT count,
+				char** res, ErlDrvSizeT res_size);
+static void shm_stop_select(ErlDrvEvent event, void*);
+
+/*
+** Local helpers forward declarations
+*/
+
+static void shm_command(ShmData *sd, char *buff, int bufflen);
+static void shm_command_listen(ShmData *sd, char *buff, int bufflen);
+static void shm_command_accept(ShmData *sd, char *buff, int bufflen);
+static void shm_command_connect(ShmData *sd, char *buff, int bufflen);
+static void do_accept(ShmData *ld);
+static void do_setup(ShmData *sd);
+static void do_connected(ShmData *sd);
+static int check_peer_closed(ShmData *sd);
+static void connection_closed(ShmData *sd);
+
+static void do_stop(ShmData *sd, int shutting_down);
+static void do_send(ShmData *sd, char *buff, int bufflen);
+static void do_sendv(ShmData *sd, ErlIOVec *ev);
+static void do_recv(ShmData *sd);
+static void do_recv_command(ShmData *sd);
+
+static int report_control_error(char **buffer, int buff_len,
+				char *error_message);
+static void send_out_queue(ShmData *sd);
+static int copy_out(ShmData *sd, SysIOVec *iov, int vlen, int len);
+static int read_packet(ShmData *sd);
+static int arm_rx(ShmData *sd);
+static int map_segment(ShmData *sd, int segfd, Word size, int acceptor);
+static int create_segment(size_t size);
+static void signal_fd(int fd);
+static void drain_fd(int fd);
+static int get_packet_length(char *b);
+static void put_packet_length(char *b, int len);
+static void *my_malloc(size_t size);
+static int peer_is_user(int fd);
+static int try_lock(char *sockname, Byte *p_creation);
+static int ensure_dir(char *path);
+static int socket_address(struct sockaddr_un *s_un, char *name);
+static void do_unlink(char *name);
+
+/*
+** Global data
+*/
+
+/* The driver entry */
+ErlDrvEntry shm_driver_entry = {
+    NULL,		   /* init, N/A */
+    shm_start,             /* start, called when port is opened */
+    shm_stop,              /* stop, called when port is closed */
+    NULL,                  /* output, outputv is used instead */
+    shm_input,             /* ready_input, called when input descriptor
+			      ready */
+    NULL,                  /* ready_output, not used */
+    "shm_drv",             /* char *driver_name, the argument to open_port */
+    shm_finish,            /* finish, called when unloaded */
+    NULL,                  /* void * that is not used (BC) */
+    shm_control,           /* control, port_control callback */
+    NULL,                  /* timeout, called on timeouts */
+    shm_outputv,           /* outputv, vector output interface */
+    NULL,                  /* ready_async */
+    NULL,                  /* flush */
+    NULL,                  /* call */
+    NULL,                  /* event */
+    ERL_DRV_EXTENDED_MARKER,
+    ERL_DRV_EXTENDED_MAJOR_VERSION,
+    ERL_DRV_EXTENDED_MINOR_VERSION,
+    ERL_DRV_FLAG_SOFT_BUSY, /* ERL_DRV_FLAGs, required by dist ports */
+    NULL,
+    NULL,                  /* process_exit */
+    shm_stop_select
+};
+
+/* Beginning of linked list of ports */
+static ShmData *first_data;
+
+/* SOCKET_PATH-<uid>, the directory of our sockets */
+static char socket_dir[sizeof(SOCKET_PATH) + 16];
+
+/*
+**
+** Driver interface routines
+**
+*/
+
+/*
+** Driver initialization routine
+*/
+DRIVER_INIT(shm_drv)
+{
+    first_data = NULL;
+    sprintf(socket_dir, SOCKET_PATH "-%u", (unsigned) geteuid());
+    return &shm_driver_entry;
+}
+
+/*
+** A port is opened, we need no information whatsoever about the socket
+** at this stage.
+*/
+static ErlDrvData shm_start(ErlDrvPort port, char *buff)
+{
+    ShmData *sd;
+
+    sd = ALLOC(sizeof(ShmData));
+    memset(sd, 0, sizeof(ShmData));
+    sd->fd = -1;
+    sd->efd = -1;
+    sd->peer_efd = -1;
+    sd->lockfd = -1;
+    sd->port = port;
+    sd->type = portTypeUnknown;
+    sd->header_length = 2;
+    sd->next = first_data;
+    first_data = sd;
+
+    return((ErlDrvData) sd);
+}
+
+/*
+** Close the socket/port and free up
+*/
+static void shm_stop(ErlDrvData handle)
+{
+    do_stop((ShmData *) handle, 0);
+}
+
+/*
+** In data and intermediate mode everything that arrives is a packet
+** to send. In command mode the first byte is an opcode:
+** 'L'<socketname>: Lock and listen on socket.
+** 'A'<listennumber as 32 bit bigendian>: Accept from the port referenced
+**                                        by the "listennumber"
+** 'C'<socketname>: Connect to the socket named <socketname>
+** 'S'<data>: Send the data <data>
+** 'R': Receive one packet of data
+*/
+static void shm_outputv(ErlDrvData handle, ErlIOVec *ev)
+{
+    ShmData *sd = (ShmData *) handle;
+    char *buff;
+
+    if (sd->type == portTypeData || sd->type == portTypeIntermediate) {
+	do_sendv(sd, ev);
+	return;
+    }
+    if (ev->size == 0) {
+	return;
+    }
+    buff = ALLOC(ev->size);
+    driver_vec_to_buf(ev, buff, ev->size);
+    shm_command(sd, buff, ev->size);
+    FREE(buff);
+}
+
+static void shm_command(ShmData *sd, char *buff, int bufflen)
+{
+    switch (*buff) {
+    case 'L':
+	if (sd->type != portTypeUnknown) {
+	    driver_failure_posix(sd->port, ENOTSUP);
+	    return;
+	}
+	shm_command_listen(sd,buff,bufflen);
+	return;
+    case 'A':
+	if (sd->type != portTypeUnknown) {
+	    driver_failure_posix(sd->port, ENOTSUP);
+	    return;
+	}
+	shm_command_accept(sd,buff,bufflen);
+	return;
+    case 'C':
+	if (sd->type != portTypeUnknown) {
+	    driver_failure_posix(sd->port, ENOTSUP);
+	    return;
+	}
+	shm_command_connect(sd,buff,bufflen);
+	return;
+    case 'S':
+	if (sd->type != portTypeCommand) {
+	    driver_failure_posix(sd->port, ENOTSUP);
+	    return;
+	}
+	do_send(sd, buff + 1, bufflen - 1);
+	driver_output(sd->port, "Sok", 3);
+	return;
+    case 'R':
+	if (sd->type != portTypeCommand && sd->type != portTypeSetup) {
+	    driver_failure_posix(sd->port, ENOTSUP);
+	    return;
+	}
+	sd->recv_pending = 1;
+	if (sd->type == portTypeCommand) {
+	    do_recv_command(sd);
+	}
+	return;
+    default:
+	driver_failure_posix(sd->port, EINVAL);
+	return;
+    }
+}
+
+static void shm_input(ErlDrvData handle, ErlDrvEvent event)
+{
+    ShmData *sd = (ShmData *) handle;
+    int fd = (int)(long) event;
+
+    DEBUGF(("In shm_input type = %d, fd = %d", sd->type, fd));
+    switch (sd->type) {
+    case portTypeListener:
+	do_accept(sd);
+	return;
+    case portTypeSetup:
+	do_setup(sd);
+	return;
+    case portTypeConnector:
+	do_connected(sd);
+	return;
+    default:
+	break;
+    }
+    if (fd == sd->fd) {
+	if (check_peer_closed(sd) < 0) {
+	    return;
+	}
+    } else {
+	drain_fd(sd->efd);
+    }
+    if (driver_sizeq(sd->port) > 0) {
+	send_out_queue(sd);
+    }
+    if (sd->type == portTypeData) {
+	do_recv(sd);
+    } else if (sd->recv_pending) {
+	do_recv_command(sd);
+    } else if (sd->peer_closed) {
+	connection_closed(sd);
+    }
+}
+
+static void shm_finish(void)
+{
+    while (first_data != NULL) {
+	do_stop(first_data, 1);
+    }
+}
+
+/*
+** Protocol to control:
+** 'C': Set port in command mode.
+** 'I': Set port in intermediate mode
+** 'D': Set port in data mode
+** 'N': Get identification number for listen port
+** 'S': Get statistics
+** 'T': Send a tick message
+** 'R': Get creation number of listen socket
+** 'P': Get the directory of the sockets
+** Answer is one byte status (0 == ok, Other is followed by error as string)
+** followed by data if applicable
+*/
+static ErlDrvSSizeT shm_control(ErlDrvData handle, unsigned int command,
+				char* buf, ErlDrvSizeT count,
+				char** res, ErlDrvSizeT res_size)
+{
+/* Local macro to ensure large enough buffer. */
+#define ENSURE(N) 				\
+   do {						\
+       if (res_size < N) {			\
+	   *res = ALLOC(N);			\
+       }					\
+   } while(0)
+
+   ShmData *sd = (ShmData *) handle;
+
+   DEBUGF(("Control, type = %d, fd = %d, command = %c", sd->type, sd->fd,
+	   (char) command));
+   switch (command) {
+   case 'S':
+       {
+	   ENSURE(13);
+	   **res = 0;
+	   put_packet_length((*res) + 1, sd->received);
+	   put_packet_length((*res) + 5, sd->sent);
+	   put_packet_length((*res) + 9, driver_sizeq(sd->port));
+	   return 13;
+       }
+   case 'C':
+       if (sd->type < portTypeCommand) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       sd->type = portTypeCommand;
+       sd->header_length = 2;
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'I':
+       if (sd->type < portTypeCommand) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       sd->type = portTypeIntermediate;
+       sd->header_length = 4;
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'D':
+       if (sd->type < portTypeCommand) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       sd->type = portTypeData;
+       sd->header_length = 4;
+       do_recv(sd);
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'N':
+       if (sd->type != portTypeListener) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       ENSURE(5);
+       (*res)[0] = 0;
+       put_packet_length((*res) + 1, sd->fd);
+       return 5;
+   case 'T': /* tick */
+       if (sd->type != portTypeData) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       do_send(sd, "", 0);
+       ENSURE(1);
+       **res = 0;
+       return 1;
+   case 'R':
+       if (sd->type != portTypeListener) {
+	   return report_control_error(res, res_size, "einval");
+       }
+       ENSURE(2);
+       (*res)[0] = 0;
+       (*res)[1] = sd->creation;
+       return 2;
+   case 'P':
+       {
+	   int n = strlen(socket_dir);
+	   ENSURE(n + 1);
+	   (*res)[0] = 0;
+	   memcpy((*res) + 1, socket_dir, n);
+	   return n + 1;
+       }
+   default:
+       return report_control_error(res, res_size, "einval");
+   }
+#undef ENSURE
+}
+
+static void shm_stop_select(ErlDrvEvent event, void* _)
+{
+    close((int)(long)event);
+}
+
+/*
+**
+** Local helpers
+**
+*/
+
+/*
+** Command implementations
+*/
+static void shm_command_connect(ShmData *sd, char *buff, int bufflen)
+{
+    char *str;
+    int fd, segfd, efd, peer_efd;
+    struct sockaddr_un s_un;
+    int length;
+    char hello[SHM_HELLO_SIZE];
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof(int))];
+    } cmsg;
+    int fds[3];
+
+    str = ALLOC(bufflen);
+    memcpy(str, buff + 1, bufflen - 1);
+    str[bufflen - 1] = '\0';
+    length = socket_address(&s_un, str);
+    FREE(str);
+    if (length < 0) {
+	driver_failure_posix(sd->port, ENAMETOOLONG);
+	return;
+    }
+    DEBUGF(("Connect peer filename: %s", s_un.sun_path));
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	driver_failure_posix(sd->port, errno);
+	return;
+    }
+    sd->fd = fd;
+    SET_NONBLOCKING(fd);
+    /* A Unix domain socket connects at once or not at all */
+    if (connect(fd, (struct sockaddr *) &s_un, length) < 0) {
+	driver_failure_posix(sd->port, errno);
+	return;
+    }
+    if (!peer_is_user(fd)) {
+	driver_failure_posix(sd->port, EACCES);
+	return;
+    }
+
+    if ((segfd = create_segment(SHM_HEADER_SIZE + 2 * (size_t) SHM_RING_SIZE))
+	< 0) {
+	driver_failure_posix(sd->port, errno);
+	return;
+    }
+    if ((efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+	driver_failure_posix(sd->port, errno);
+	close(segfd);
+	return;
+    }
+    sd->efd = efd;
+    if ((peer_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+	driver_failure_posix(sd->port, errno);
+	close(segfd);
+	return;
+    }
+    sd->peer_efd = peer_efd;
+    if (map_segment(sd, segfd, SHM_RING_SIZE, 0) < 0) {
+	driver_failure_posix(sd->port, errno);
+	close(segfd);
+	return;
+    }
+
+    /* Pass the segment, the eventfd of the acceptor and our own */
+    memcpy(hello, SHM_MAGIC, SHM_MAGIC_SIZE);
+    put_packet_length(hello + SHM_MAGIC_SIZE, SHM_RING_SIZE);
+    iov.iov_base = hello;
+    iov.iov_len = SHM_HELLO_SIZE;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+    cmsg.hdr.cmsg_level = SOL_SOCKET;
+    cmsg.hdr.cmsg_type = SCM_RIGHTS;
+    cmsg.hdr.cmsg_len = CMSG_LEN(3 * sizeof(int));
+    fds[0] = segfd;
+    fds[1] = peer_efd;
+    fds[2] = efd;
+    memcpy(CMSG_DATA(&cmsg.hdr), fds, sizeof(fds));
+    if (sendmsg(fd, &msg, 0) != SHM_HELLO_SIZE) {
+	driver_failure_posix(sd->port, errno ? errno : EIO);
+	close(segfd);
+	return;
+    }
+    close(segfd);
+    sd->type = portTypeConnector;
+    driver_select(sd->port, (ErlDrvEvent)(long) fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    /* Silent, answer will be sent when the acceptor has answered */
+}
+
+static void shm_command_accept(ShmData *sd, char *buff, int bufflen)
+{
+    int listen_no;
+    ShmData *lp;
+
+    if (bufflen < 5) {
+	driver_failure_posix(sd->port, EINVAL);
+	return;
+    }
+
+    listen_no = get_packet_length(buff + 1); /* Same format as
+						packet headers */
+    DEBUGF(("Accept listen_no = %d",listen_no));
+    for (lp = first_data; lp != NULL && lp->fd != listen_no; lp = lp->next)
+	;
+    if (lp == NULL || lp->type != portTypeListener) {
+	DEBUGF(("Could not find listen port"));
+	driver_failure_posix(sd->port, EINVAL);
+	return;
+    }
+    if (lp->partner != NULL) {
+	DEBUGF(("Listen port busy"));
+	driver_failure_posix(sd->port, EADDRINUSE);
+	return;
+    }
+    lp->partner = sd;
+    sd->partner = lp;
+    sd->type = portTypeAcceptor;
+    driver_select(lp->port, (ErlDrvEvent)(long) lp->fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    /* Silent, answer will be sent in input routine */
+}
+
+static void shm_command_listen(ShmData *sd, char *buff, int bufflen)
+{
+    char *str;
+    int fd;
+    struct sockaddr_un s_un;
+    int length;
+    ShmData *tmp;
+    Byte creation;
+
+    str = ALLOC(bufflen);
+    memcpy(str, buff + 1,bufflen - 1);
+    str[bufflen - 1] = '\0';
+
+    /*
+    ** Before trying lockfiles etc, we need to assure that our own process is
+    ** not using the filename. Advisory locks can be recursive in one process.
+    */
+    for(tmp = first_data; tmp != NULL; tmp = tmp->next) {
+	if (tmp->name != NULL && strcmp(str, tmp->name) == 0) {
+	    driver_failure_posix(sd->port, EADDRINUSE);
+	    FREE(str);
+	    return;
+	}
+    }
+    if ((length = socket_address(&s_un, str)) < 0) {
+	driver_failure_posix(sd->port, ENAMETOOLONG);
+	FREE(str);
+	return;
+    }
+    if ((fd = try_lock(str, &creation)) < 0) {
+	driver_failure_posix(sd->port, EADDRINUSE);
+	FREE(str);
+	return;
+    }
+    sd->name = str;
+    sd->type = portTypeListener;
+    sd->lockfd = fd;
+    sd->creation = creation;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	driver_failure_posix(sd->port, errno);
+	return;
+    }
+    SET_NONBLOCKING(fd);
+    sd->fd = fd;
+    do_unlink(str);
+    DEBUGF(("Listen filename: %s", s_un.sun_path));
+    if (bind(fd, (struct sockaddr *) &s_un, length) < 0) {
+	driver_failure_posix(sd->port, errno);
+	return;
+    }
+    if (listen(fd, 5) < 0) {
+	driver_failure_posix(sd->port, errno);
+	return;
+    }
+    driver_output(sd->port, "Lok", 3);
+}
+
+/*
+** Connection setup helpers
+*/
+
+/* A connection attempt on a listen socket */
+static void do_accept(ShmData *ld)
+{
+    ShmData *ad = ld->partner;
+    int fd;
+
+    if (ad == NULL) {
+	driver_select(ld->port, (ErlDrvEvent)(long) ld->fd, ERL_DRV_READ, 0);
+	return;
+    }
+    if ((fd = accept(ld->fd, NULL, NULL)) < 0) {
+	if (errno != EWOULDBLOCK && errno != EINTR) {
+	    DEBUGF(("Accept failed."));
+	    driver_failure_posix(ld->port, errno);
+	}
+	return;
+    }
+    if (!peer_is_user(fd)) {
+	DEBUGF(("Connection from another user refused."));
+	close(fd);
+	return;
+    }
+    SET_NONBLOCKING(fd);
+    ad->fd = fd;
+    ad->partner = NULL;
+    ad->type = portTypeSetup;
+    ld->partner = NULL;
+    DEBUGF(("Accept successful."));
+    driver_select(ld->port, (ErlDrvEvent)(long) ld->fd, ERL_DRV_READ, 0);
+    driver_select(ad->port, (ErlDrvEvent)(long) fd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    driver_output(ad->port, "Aok", 3);
+}
+
+/* The setup message has arrived on an accepted socket */
+static void do_setup(ShmData *sd)
+{
+    char hello[SHM_HELLO_SIZE];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *c;
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof(int))];
+    } cmsg;
+    int fds[3] = {-1, -1, -1};
+    Word size;
+    int res, i;
+    char status = 1;
+
+    iov.iov_base = hello;
+    iov.iov_len = SHM_HELLO_SIZE;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+    if ((res = recvmsg(sd->fd, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+	if (errno != EWOULDBLOCK && errno != EINTR) {
+	    driver_failure_posix(sd->port, errno);
+	}
+	return;
+    }
+    c = CMSG_FIRSTHDR(&msg);
+    if (c != NULL && c->cmsg_level == SOL_SOCKET
+	&& c->cmsg_type == SCM_RIGHTS
+	&& c->cmsg_len == CMSG_LEN(3 * sizeof(int))) {
+	memcpy(fds, CMSG_DATA(c), sizeof(fds));
+    }
+    size = get_packet_length(hello + SHM_MAGIC_SIZE);
+    if (res == SHM_HELLO_SIZE && !(msg.msg_flags & MSG_CTRUNC)
+	&& fds[0] >= 0
+	&& memcmp(hello, SHM_MAGIC, SHM_MAGIC_SIZE) == 0
+	&& map_segment(sd, fds[0], size, 1) == 0) {
+	sd->efd = fds[1];
+	sd->peer_efd = fds[2];
+	fds[1] = fds[2] = -1;
+	status = 0;
+    }
+    for (i = 0; i < 3; i++) {
+	if (fds[i] >= 0) {
+	    close(fds[i]);
+	}
+    }
+    if (status != 0 || write(sd->fd, &status, 1) != 1) {
+	DEBUGF(("Bad setup message"));
+	driver_failure_eof(sd->port);
+	return;
+    }
+    sd->type = portTypeCommand;
+    driver_select(sd->port, (ErlDrvEvent)(long) sd->efd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    if (sd->recv_pending) {
+	do_recv_command(sd);
+    }
+}
+
+/* The acceptor has answered our setup message */
+static void do_connected(ShmData *sd)
+{
+    char status;
+    int res;
+
+    if ((res = read(sd->fd, &status, 1)) < 0
+	&& (errno == EWOULDBLOCK || errno == EINTR)) {
+	return;
+    }
+    if (res != 1 || status != 0) {
+	driver_failure_eof(sd->port);
+	return;
+    }
+    sd->type = portTypeCommand;
+    driver_select(sd->port, (ErlDrvEvent)(long) sd->efd,
+		  ERL_DRV_READ|ERL_DRV_USE, 1);
+    driver_output(sd->port, "Cok", 3);
+}
+
+/*
+** The socket is readable when the other side has closed it. Stop
+** selecting on it and let the ring buffer be drained.
+*/
+static int check_peer_closed(ShmData *sd)
+{
+    char c;
+    int res = recv(sd->fd, &c, 1, MSG_PEEK);
+
+    if (res < 0 && (errno == EWOULDBLOCK || errno == EINTR)) {
+	return 0;
+    }
+    if (res > 0) {
+	/* Nothing is sent on the socket after the setup */
+	driver_failure_posix(sd->port, EIO);
+	return -1;
+    }
+    sd->peer_closed = 1;
+    driver_select(sd->port, (ErlDrvEvent)(long) sd->fd, ERL_DRV_READ, 0);
+    return 0;
+}
+
+/*
+** The ring is drained and the peer is gone. The distribution
+** controller in dist_util only notices {tcp_closed, Port}, a port
+** that exits normally does not take the connection down with it.
+*/
+static void connection_closed(ShmData *sd)
+{
+    ErlDrvTermData spec[6];
+
+    if (sd->type != portTypeCommand) {
+	spec[0] = ERL_DRV_ATOM;
+	spec[1] = driver_mk_atom("tcp_closed");
+	spec[2] = ERL_DRV_PORT;
+	spec[3] = driver_mk_port(sd->port);
+	spec[4] = ERL_DRV_TUPLE;
+	spec[5] = 2;
+	erl_drv_output_term(driver_mk_port(sd->port), spec, 6);
+    }
+    driver_failure_eof(sd->port);
+}
+
+/*
+** Input/output/stop helpers
+*/
+static void do_stop(ShmData *sd, int shutting_down)
+{
+    ShmData **tmp;
+
+    DEBUGF(("Cleaning up, type = %d, fd = %d, lockfd = %d", sd->type,
+	    sd->fd, sd->lockfd));
+    for (tmp = &first_data; *tmp != NULL && *tmp != sd; tmp = &((*tmp)->next))
+	;
+    *tmp = (*tmp)->next;
+    if (sd->bin != NULL) {
+	driver_free_binary(sd->bin);
+    }
+    if (sd->fd >= 0) {
+	driver_select(sd->port, (ErlDrvEvent)(long) sd->fd,
+		      ERL_DRV_READ|ERL_DRV_WRITE|ERL_DRV_USE, 0);
+    }
+    if (sd->efd >= 0) {
+	driver_select(sd->port, (ErlDrvEvent)(long) sd->efd,
+		      ERL_DRV_READ|ERL_DRV_USE, 0);
+    }
+    if (sd->peer_efd >= 0) {
+	close(sd->peer_efd);
+    }
+    if (sd->segment != NULL) {
+	munmap(sd->segment, sd->segment_size);
+    }
+    if (sd->name) {
+	do_unlink(sd->name);
+	FREE(sd->name);
+    }
+    if (sd->lockfd >= 0) {
+	close(sd->lockfd); /* the lock will be released */
+	/* But leave the file there for the creation counter... */
+    }
+    if (!shutting_down) { /* Dont bother if the driver is shutting down. */
+	if (sd->partner != NULL) {
+	    if (sd->type == portTypeAcceptor) {
+		ShmData *listener = sd->partner;
+		listener->partner = NULL;
+		driver_select(listener->port, (ErlDrvEvent)(long) listener->fd,
+			      ERL_DRV_READ, 0);
+	    } else {
+		ShmData *acceptor = sd->partner;
+		acceptor->partner = NULL;
+		driver_failure_eof(acceptor->port);
+	    }
+	}
+    }
+    FREE(sd);
+}
+
+/*
+** Send a packet, the header is 2 bytes in command mode, otherwise 4.
+*/
+static void do_send(ShmData *sd, char *buff, int bufflen)
+{
+    SysIOVec iov[2];
+    ErlIOVec eio;
+    ErlDrvBinary *binv[] = {NULL,NULL};
+
+    iov[0].iov_base = NULL;
+    iov[0].iov_len = 0;
+    iov[1].iov_base = buff;
+    iov[1].iov_len = bufflen;
+    eio.iov = iov;
+    eio.binv = binv;
+    eio.vsize = 2;
+    eio.size = bufflen;
+    do_sendv(sd, &eio);
+}
+
+/* The first element of ev is free for the header, like in inet_drv */
+static void do_sendv(ShmData *sd, ErlIOVec *ev)
+{
+    char header[4];
+    int hl = sd->header_length;
+    int written = 0;
+
+    if (hl == 2) {
+	header[0] = (ev->size >> 8) & 0xFF;
+	header[1] = ev->size & 0xFF;
+    } else {
+	put_packet_length(header, ev->size);
+    }
+    ev->iov[0].iov_base = header;
+    ev->iov[0].iov_len = hl;
+    ev->size += hl;
+    sd->sent++;
+    if (driver_sizeq(sd->port) == 0) {
+	written = copy_out(sd, ev->iov, ev->vsize, ev->size);
+	if ((ErlDrvSizeT) written == ev->size) {
+	    return;
+	}
+    }
+    driver_enqv(sd->port, ev, written);
+    send_out_queue(sd);
+}
+
+/* Deliver the received packets to the distribution */
+static void do_recv(ShmData *sd)
+{
+    int n;
+
+    for (n = 0; n < RECV_BUDGET; n++) {
+	if (!read_packet(sd)) {
+	    if (!arm_rx(sd)) {
+		continue;
+	    }
+	    if (sd->peer_closed) {
+		connection_closed(sd);
+	    }
+	    return;
+	}
+	driver_output_binary(sd->port, NULL, 0, sd->bin, 0, sd->bin->orig_size);
+	driver_free_binary(sd->bin);
+	sd->bin = NULL;
+	sd->received++;
+    }
+    /* Come back after the other ports have had their turn */
+    signal_fd(sd->efd);
+}
+
+/* Answer a receive command with the next packet */
+static void do_recv_command(ShmData *sd)
+{
+    while (!read_packet(sd)) {
+	if (arm_rx(sd)) {
+	    if (sd->peer_closed) {
+		connection_closed(sd);
+	    }
+	    return;
+	}
+    }
+    sd->recv_pending = 0;
+    sd->received++;
+    driver_output2(sd->port, "R", 1, sd->bin->orig_bytes, sd->bin->orig_size);
+    driver_free_binary(sd->bin);
+    sd->bin = NULL;
+}
+
+/*
+** Report control error, helper for error messages from control
+*/
+static int report_control_error(char **buffer, int buff_len,
+				char *error_message)
+{
+    int elen = strlen(error_message);
+    if (elen + 1 > buff_len) {
+	*buffer = ALLOC(elen + 1);
+    }
+    **buffer = 1;
+    memcpy((*buffer) + 1, error_message, elen);
+    return elen + 1;
+}
+
+/*
+** Ring buffer helpers
+*/
+
+/* Move as much of the output queue as fits to the ring */
+static void send_out_queue(ShmData *sd)
+{
+    SysIOVec *iov;
+    int vlen, wrote;
+
+    for (;;) {
+	while ((iov = driver_peekq(sd->port, &vlen)) != NULL
+	       && (wrote = copy_out(sd, iov, vlen,
+				    driver_sizeq(sd->port))) > 0) {
+	    driver_deq(sd->port, wrote);
+	}
+	if (iov == NULL) {
+	    break;
+	}
+	/* Full, ask the other side to wake us up when there is room */
+	sd->tx->producer_waiting = 1;
+	MEMORY_BARRIER;
+	if (sd->tx->head - sd->tx->tail == sd->size) {
+	    break;
+	}
+    }
+    if (driver_sizeq(sd->port) > HIGH_WATERMARK) {
+	set_busy_port(sd->port, 1);
+    } else if (driver_sizeq(sd->port) < LOW_WATERMARK) {
+	set_busy_port(sd->port, 0);
+    }
+}
+
+/*
+** Copy at most len bytes of iov to the ring and wake up the consumer
+** if it sleeps. Returns the number of bytes copied.
+*/
+static int copy_out(ShmData *sd, SysIOVec *iov, int vlen, int len)
+{
+    ShmRing *r = sd->tx;
+    Word mask = sd->size - 1;
+    Word head = r->head;
+    Word space = sd->size - (head - r->tail);
+    int done = 0;
+    int i;
+
+    if (space == 0) {
+	return 0;
+    }
+    MEMORY_BARRIER;			/* read tail before writing data */
+    if ((Word) len > space) {
+	len = space;
+    }
+    for (i = 0; i < vlen && done < len; i++) {
+	char *p = iov[i].iov_base;
+	int n = iov[i].iov_len;
+	if (n > len - done) {
+	    n = len - done;
+	}
+	while (n > 0) {
+	    Word pos = (head + done) & mask;
+	    int chunk = n;
+	    if ((Word) chunk > sd->size - pos) {
+		chunk = sd->size - pos;
+	    }
+	    memcpy(sd->tx_data + pos, p, chunk);
+	    p += chunk;
+	    n -= chunk;
+	    done += chunk;
+	}
+    }
+    MEMORY_BARRIER;			/* data before head */
+    r->head = head + done;
+    MEMORY_BARRIER;			/* head before the flag */
+    if (TAKE_FLAG(r->consumer_waiting)) {
+	signal_fd(sd->peer_efd);
+    }
+    return done;
+}
+
+/*
+** Read from the ring into the packet being received. Returns 1 when
+** sd->bin holds a complete packet, otherwise 0.
+*/
+static int read_packet(ShmData *sd)
+{
+    ShmRing *r = sd->rx;
+    Word mask = sd->size - 1;
+    Word tail = r->tail;
+    Word avail = r->head - tail;
+    int hl = sd->header_length;
+    int done = 0;
+
+    MEMORY_BARRIER;			/* read head before the data */
+    while (sd->bin == NULL) {
+	if (avail == 0) {
+	    goto out;
+	}
+	sd->header[sd->header_pos++] = sd->rx_data[tail & mask];
+	tail++;
+	avail--;
+	if (sd->header_pos == hl) {
+	    int len = (hl == 2) ? ((sd->header[0] << 8) | sd->header[1])
+		: get_packet_length((char *) sd->header);
+	    sd->header_pos = 0;
+	    sd->bin = driver_alloc_binary(len);
+	    sd->bin_pos = 0;
+	}
+    }
+    while (sd->bin_pos < sd->bin->orig_size && avail > 0) {
+	Word pos = tail & mask;
+	Word n = sd->bin->orig_size - sd->bin_pos;
+	if (n > avail) {
+	    n = avail;
+	}
+	if (n > sd->size - pos) {
+	    n = sd->size - pos;
+	}
+	memcpy(sd->bin->orig_bytes + sd->bin_pos, sd->rx_data + pos, n);
+	sd->bin_pos += n;
+	tail += n;
+	avail -= n;
+    }
+    done = (sd->bin_pos == sd->bin->orig_size);
+ out:
+    if (tail != r->tail) {
+	MEMORY_BARRIER;			/* data before tail */
+	r->tail = tail;
+	MEMORY_BARRIER;			/* tail before the flag */
+	if (TAKE_FLAG(r->producer_waiting)) {
+	    signal_fd(sd->peer_efd);
+	}
+    }
+    return done;
+}
+
+/*
+** Tell the producer to wake us up. Returns 0 if data arrived in the
+** meantime, in which case the flag is taken back.
+*/
+static int arm_rx(ShmData *sd)
+{
+    sd->rx->consumer_waiting = 1;
+    MEMORY_BARRIER;
+    if (sd->rx->head != sd->rx->tail) {
+	sd->rx->consumer_waiting = 0;
+	return 0;
+    }
+    return 1;
+}
+
+static int map_segment(ShmData *sd, int segfd, Word size, int acceptor)
+{
+    struct stat st;
+    size_t total = SHM_HEADER_SIZE + 2 * (size_t) size;
+    ShmHeader *h;
+    char *seg;
+
+    /* The other side must not be able to shrink the segment under us */
+    if (size < SHM_MIN_RING_SIZE || size > SHM_MAX_RING_SIZE
+	|| (size & (size - 1)) != 0
+	|| (fcntl(segfd, F_GET_SEALS) & SHM_SEALS) != SHM_SEALS
+	|| fstat(segfd, &st) < 0 || (size_t) st.st_size < total) {
+	errno = EINVAL;
+	return -1;
+    }
+    seg = mmap(NULL, total, PROT_READ|PROT_WRITE, MAP_SHARED, segfd, 0);
+    if (seg == MAP_FAILED) {
+	return -1;
+    }
+    h = (ShmHeader *) seg;
+    if (acceptor) {
+	if (memcmp(h->magic, SHM_MAGIC, SHM_MAGIC_SIZE) != 0
+	    || h->size != size) {
+	    munmap(seg, total);
+	    errno = EINVAL;
+	    return -1;
+	}
+    } else {
+	memset(h, 0, sizeof(ShmHeader));
+	memcpy(h->magic, SHM_MAGIC, SHM_MAGIC_SIZE);
+	h->size = size;
+	/* Both sides start out waiting for data */
+	h->ring[0].consumer_waiting = 1;
+	h->ring[1].consumer_waiting = 1;
+    }
+    sd->segment = seg;
+    sd->segment_size = total;
+    sd->size = size;
+    sd->tx = &h->ring[acceptor];
+    sd->rx = &h->ring[!acceptor];
+    sd->tx_data = seg + SHM_HEADER_SIZE + (size_t) acceptor * size;
+    sd->rx_data = seg + SHM_HEADER_SIZE + (size_t) !acceptor * size;
+    return 0;
+}
+
+/* An anonymous file to map, sealed at its size */
+static int create_segment(size_t size)
+{
+    int fd;
+
+#ifdef SYS_memfd_create
+    fd = syscall(SYS_memfd_create, "shm_drv", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    fd = -1;
+    errno = ENOSYS;
+#endif
+    if (fd < 0) {
+	return -1;
+    }
+    if (ftruncate(fd, size) < 0
+	|| fcntl(fd, F_ADD_SEALS, SHM_SEALS | F_SEAL_SEAL) < 0) {
+	int save_errno = errno;
+	close(fd);
+	errno = save_errno;
+	return -1;
+    }
+    return fd;
+}
+
+static void signal_fd(int fd)
+{
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0) {
+	/* The counter is already set, or the other side is gone */
+    }
+}
+
+static void drain_fd(int fd)
+{
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0) {
+	/* Not signalled */
+    }
+}
+
+static int get_packet_length(char *b)
+{
+    Byte *u = (Byte *) b;
+    int x = (((Word) u[0]) << 24) | (((Word) u[1]) << 16) |
+	(((Word) u[2]) << 8) | ((Word) u[3]);
+    return x;
+}
+
+static void put_packet_length(char *b, int len)
+{
+    Byte *p = (Byte *) b;
+    Word n = (Word) len;
+    p[0] = (n >> 24) & 0xFF;
+    p[1] = (n >> 16) & 0xFF;
+    p[2] = (n >> 8) & 0xFF;
+    p[3] = n & 0xFF;
+}
+
+/*
+** Malloc wrapper
+*/
+static void *my_malloc(size_t size)
+{
+    void *ptr;
+
+    if ((ptr = driver_alloc(size)) == NULL) {
+	fprintf(stderr, "Could not allocate %lu bytes of memory",(unsigned long) size);
+	abort();
+    }
+    return ptr;
+}
+
+/*
+** Socket file handling helpers
+*/
+
+/* Does the peer of a connected Unix socket run as the same user as we? */
+static int peer_is_user(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0
+	&& cred.uid == geteuid();
+}
+
+/*
+** Check that the directory exists, create it if not (only works for
+** one level). It must be ours and closed to everybody else, as anyone
+** who can get into it can connect to us or pretend to be us.
+*/
+static int ensure_dir(char *path)
+{
+    struct stat st;
+
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+	return -1;
+    }
+    if (lstat(path, &st) != 0) {
+	return -1;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid()
+	|| (st.st_mode & 077) != 0) {
+	errno = EPERM;
+	return -1;
+    }
+    return 0;
+}
+
+/*
+** Try to open a lock file and lock the first byte write-only (advisory)
+** return the file descriptor if successful, otherwise -1 (<0).
+*/
+static int try_lock(char *sockname, Byte *p_creation)
+{
+    char *lockname;
+    int lockfd;
+    struct flock fl;
+    Byte creation;
+
+    lockname = ALLOC(strlen(socket_dir)+1+strlen(sockname)+
+		     strlen(LOCK_SUFFIX)+1);
+    sprintf(lockname, "%s/%s" LOCK_SUFFIX, socket_dir, sockname);
+    DEBUGF(("lockname = %s", lockname));
+    if (ensure_dir(socket_dir) != 0) {
+	DEBUGF(("ensure_dir failed, errno = %d", errno));
+	FREE(lockname);
+	return -1;
+    }
+    if ((lockfd = open(lockname, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0) {
+	DEBUGF(("open failed, errno = %d", errno));
+	FREE(lockname);
+	return -1;
+    }
+    FREE(lockname);
+    memset(&fl,0,sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 1;
+    if (fcntl(lockfd, F_SETLK, &fl) < 0) {
+	DEBUGF(("fcntl failed, errno = %d", errno));
+	close(lockfd);
+	return -1;
+    }
+    /* OK, check for creation and update */
+    if (read(lockfd, &creation, 1) < 1) {
+	creation = 0;
+    } else {
+	creation = (creation + 1) % 4;
+    }
+    lseek(lockfd, 0, SEEK_SET);
+    if (write(lockfd, &creation, 1) < 1) {
+	close(lockfd);
+	return -1;
+    }
+    *p_creation = creation;
+    return lockfd;
+}
+
+/* Returns the length of the address of socket name, or -1 */
+static int socket_address(struct sockaddr_un *s_un, char *name)
+{
+    if (strlen(socket_dir) + 1 + strlen(name) >= sizeof(s_un->sun_path)
+	|| strchr(name, '/') != NULL) {
+	return -1;
+    }
+    memset(s_un, 0, sizeof(*s_un));
+    s_un->sun_family = AF_UNIX;
+    sprintf(s_un->sun_path, "%s/%s", socket_dir, name);
+    return sizeof(s_un->sun_family) + strlen(s_un->sun_path);
+}
+
+static void do_unlink(char *name)
+{
+    struct sockaddr_un s_un;
+
+    if (socket_address(&s_un, name) >= 0) {
+	unlink(s_un.sun_path);
+    }
+}
@@ -0,0 +1,248 @@
+%%
+%% %CopyrightBegin%
+%%
+%% Copyright Ericsson AB 2016. All Rights Reserved.
+%%
+%% Licensed under the Apache License, Version 2.0 (the "License");
+%% you may not use this file except in compliance with the License.
+%% You may obtain a copy of the License at
+%%
+%%     http://www.apache.org/licenses/LICENSE-2.0
+%%
+%% Unless required by applicable law or agreed to in writing, software
+%% distributed under the License is distributed on an "AS IS" BASIS,
+%% WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+%% See the License for the specific language governing permissions and
+%% limitations under the License.
+%%
+%% %CopyrightEnd%
+%%
+-module(shm_dist).
+
+%% Handles the connection setup phase with other Erlang nodes, and C
+%% nodes, on the same host over shared memory ring buffers. Typically
+%% started together with inet_tcp, as in "-proto_dist shm inet_tcp",
+%% so that nodes on other hosts are reached over TCP.
+
+-export([childspecs/0, listen/1, accept/1, accept_connection/5,
+	 setup/5, close/1, select/1, is_node_name/1]).
+
+%% internal exports
+
+-export([accept_loop/2,do_accept/6,do_setup/6,getstat/1,tick/1,
+	 setopts/2,getopts/2]).
+
+-import(error_logger,[error_msg/2]).
+
+-include_lib("kernel/include/net_address.hrl").
+-include_lib("kernel/include/dist.hrl").
+-include_lib("kernel/include/dist_util.hrl").
+
+%% -------------------------------------------------------------
+%% This function should return a valid childspec, so that
+%% the driver holder gets supervised
+%% -------------------------------------------------------------
+childspecs() ->
+    {ok, [{shm_server,{shm_server, start_link, []},
+	   permanent, 2000, worker, [shm_server]}]}.
+
+%% ------------------------------------------------------------
+%%  Select this protocol for nodes on this host that listen
+%%  for shared memory connections.
+%%  select(Node) => Bool
+%% ------------------------------------------------------------
+
+select(Node) ->
+    {ok, MyHost} = inet:gethostname(),
+    case split_node(atom_to_list(Node), $@, []) of
+	[Name, Host] ->
+	    lists:member(Host, [MyHost, "localhost"]) andalso
+		is_listening(Name);
+	_ ->
+	    false
+    end.
+
+is_listening(Name) ->
+    case file:read_file_info(shm:socket_name(Name)) of
+	{ok, _} -> true;
+	_ -> false
+    end.
+
+%% ------------------------------------------------------------
+%% Create the listen socket, i.e. the port that this erlang
+%% node is accessible through.
+%% ------------------------------------------------------------
+
+listen(Name) ->
+    case shm:listen(atom_to_list(Name)) of
+	{ok, Socket} ->
+	    {ok, {Socket,
+		  #net_address{address = [],
+			       host = inet:gethostname(),
+			       protocol = shm,
+			       family = shm},
+		  shm:get_creation(Socket)}};
+	Error ->
+	    Error
+    end.
+
+%% ------------------------------------------------------------
+%% Accepts new connection attempts from other nodes.
+%% ------------------------------------------------------------
+
+accept(Listen) ->
+    spawn_opt(?MODULE, accept_loop, [self(), Listen],
+	      [link, {priority, max}]).
+
+accept_loop(Kernel, Listen) ->
+    case shm:accept(Listen) of
+	{ok, Socket} ->
+	    Kernel ! {accept,self(),Socket,shm,shm},
+	    controller(Kernel, Socket),
+	    accept_loop(Kernel, Listen);
+	Error ->
+	    exit(Error)
+    end.
+
+controller(Kernel, Socket) ->
+    receive
+	{Kernel, controller, Pid} ->
+	    shm:controlling_process(Socket, Pid),
+	    Pid ! {self(), controller};
+	{Kernel, unsupported_protocol} ->
+	    exit(unsupported_protocol)
+    end.
+
+%% ------------------------------------------------------------
+%% Accepts a new connection attempt from another node.
+%% Performs the handshake with the other side.
+%% ------------------------------------------------------------
+
+accept_connection(AcceptPid, Socket, MyNode, Allowed, SetupTime) ->
+    spawn_opt(?MODULE, do_accept,
+	      [self(), AcceptPid, Socket, MyNode, Allowed, SetupTime],
+	      [link, {priority, max}]).
+
+do_accept(Kernel, AcceptPid, Socket, MyNode, Allowed, SetupTime) ->
+    receive
+	{AcceptPid, controller} ->
+	    Timer = dist_util:start_timer(SetupTime),
+	    HSData = hs_data(Kernel, MyNode, Socket, Timer),
+	    dist_util:handshake_other_started(
+	      HSData#hs_data{allowed = Allowed,
+			     f_address = fun get_remote_id/2})
+    end.
+
+%% ------------------------------------------------------------
+%% Get remote information about a Socket.
+%% ------------------------------------------------------------
+
+get_remote_id(_Socket, Node) ->
+    [_, Host] = split_node(atom_to_list(Node), $@, []),
+    #net_address{address = [],
+		 host = Host,
+		 protocol = shm,
+		 family = shm}.
+
+%% ------------------------------------------------------------
+%% Setup a new connection to another node on this host.
+%% Performs the handshake with the other side.
+%% ------------------------------------------------------------
+
+setup(Node, Type, MyNode, LongOrShortNames, SetupTime) ->
+    spawn_opt(?MODULE, do_setup,
+	      [self(), Node, Type, MyNode, LongOrShortNames, SetupTime],
+	      [link, {priority, max}]).
+
+do_setup(Kernel, Node, Type, MyNode, LongOrShortNames, SetupTime) ->
+    [Name, _Host] = splitnode(Node, LongOrShortNames),
+    Timer = dist_util:start_timer(SetupTime),
+    case shm:connect(Name) of
+	{ok, Socket} ->
+	    HSData = hs_data(Kernel, MyNode, Socket, Timer),
+	    dist_util:handshake_we_started(
+	      HSData#hs_data{other_node = Node,
+			     other_version = 5,
+			     request_type = Type,
+			     f_address = fun get_remote_id/2});
+	_ ->
+	    ?shutdown(Node)
+    end.
+
+hs_data(Kernel, MyNode, Socket, Timer) ->
+    #hs_data{kernel_pid = Kernel,
+	     this_node = MyNode,
+	     socket = Socket,
+	     timer = Timer,
+	     this_flags = 0,
+	     f_send = fun shm:send/2,
+	     f_recv = fun(S, _N, _T) -> shm:recv(S) end,
+	     f_setopts_pre_nodeup = fun(S) -> shm:set_mode(S, intermediate) end,
+	     f_setopts_post_nodeup = fun(S) -> shm:set_mode(S, data) end,
+	     f_getll = fun shm:get_port/1,
+	     mf_tick = fun ?MODULE:tick/1,
+	     mf_getstat = fun ?MODULE:getstat/1,
+	     mf_setopts = fun ?MODULE:setopts/2,
+	     mf_getopts = fun ?MODULE:getopts/2}.
+
+%%
+%% Close a socket.
+%%
+close(Socket) ->
+    shm:close(Socket).
+
+
+%% If Node is illegal terminate the connection setup!!
+splitnode(Node, LongOrShortNames) ->
+    case split_node(atom_to_list(Node), $@, []) of
+	[Name|Tail] when Tail =/= [] ->
+	    Host = lists:append(Tail),
+	    case split_node(Host, $., []) of
+		[_] when LongOrShortNames =:= longnames ->
+		    error_msg("** System running to use "
+			      "fully qualified "
+			      "hostnames **~n"
+			      "** Hostname ~s is illegal **~n",
+			      [Host]),
+		    ?shutdown(Node);
+		L when length(L) > 1, LongOrShortNames =:= shortnames ->
+		    error_msg("** System NOT running to use fully qualified "
+			      "hostnames **~n"
+			      "** Hostname ~s is illegal **~n",
+			      [Host]),
+		    ?shutdown(Node);
+		_ ->
+		    [Name, Host]
+	    end;
+	[_] ->
+	    error_msg("** Nodename ~p illegal, no '@' character **~n",
+		      [Node]),
+	    ?shutdown(Node);
+	_ ->
+	    error_msg("** Nodename ~p illegal **~n", [Node]),
+	    ?shutdown(Node)
+    end.
+
+split_node([Chr|T], Chr, Ack) -> [lists:reverse(Ack)|split_node(T, Chr, [])];
+split_node([H|T], Chr, Ack)   -> split_node(T, Chr, [H|Ack]);
+split_node([], _, Ack)        -> [lists:reverse(Ack)].
+
+is_node_name(Node) when is_atom(Node) ->
+    case split_node(atom_to_list(Node), $@, []) of
+	[_, _Host] -> true;
+	_ -> false
+    end;
+is_node_name(_Node) ->
+    false.
+
+tick(Socket) ->
+    shm:tick(Socket).
+
+getstat(Socket) ->
+    shm:get_status_counters(Socket).
+
+setopts(_Socket, _Opts) ->
+    {error, enotsup}.
+
+getopts(_Socket, _Opts) ->
+    {error, enotsup}.
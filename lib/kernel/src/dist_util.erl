@@ -83,10 +83,17 @@ remove_flag(Flag, Flags) ->
     end.
 
 adjust_flags(ThisFlags, OtherFlags) ->
-    case (?DFLAG_PUBLISHED band ThisFlags) band OtherFlags of
+    both_flag(?DFLAG_LARGE_ATOM_CACHE,
+	      both_flag(?DFLAG_COMPRESSED,
+			both_flag(?DFLAG_PUBLISHED,
+				  {ThisFlags, OtherFlags}))).
+
+%% Flag only to be used if both nodes set it.
+both_flag(Flag, {ThisFlags, OtherFlags}) ->
+    case (Flag band ThisFlags) band OtherFlags of
 	0 ->
-	    {remove_flag(?DFLAG_PUBLISHED, ThisFlags),
-	     remove_flag(?DFLAG_PUBLISHED, OtherFlags)};
+	    {remove_flag(Flag, ThisFlags),
+	     remove_flag(Flag, OtherFlags)};
 	_ ->
 	    {ThisFlags, OtherFlags}
     end.
@@ -101,8 +108,26 @@ publish_flag(_, OtherNode) ->
 	    0
     end.
 
+compress_flag() ->
+    case application:get_env(kernel, dist_compression) of
+	{ok, true} ->
+	    ?DFLAG_COMPRESSED;
+	_ ->
+	    0
+    end.
+
+large_atom_cache_flag() ->
+    case application:get_env(kernel, dist_large_atom_cache) of
+	{ok, true} ->
+	    ?DFLAG_LARGE_ATOM_CACHE;
+	_ ->
+	    0
+    end.
+
 make_this_flags(RequestType, OtherNode) ->
     publish_flag(RequestType, OtherNode) bor
+    compress_flag() bor
+    large_atom_cache_flag() bor
 	%% The parenthesis below makes the compiler generate better code.
 	(?DFLAG_EXPORT_PTR_TAG bor
 	 ?DFLAG_EXTENDED_PIDS_PORTS bor
@@ -119,10 +144,24 @@ make_this_flags(RequestType, OtherNode) ->
 	 ?DFLAG_SMALL_ATOM_TAGS bor
 	 ?DFLAG_UTF8_ATOMS bor
 	 ?DFLAG_MAP_TAG bor
-	 ?DFLAG_BIG_CREATION).
+	 ?DFLAG_BIG_CREATION bor
+	 ?DFLAG_FRAGMENTS bor
+	 ?DFLAG_MULTI_CHANNEL).
+
+handshake_other_started(#hs_data{}=HSData0) ->
+    case recv_name(HSData0) of
+	{channel,Channel,PreOtherFlags,Node,Version} ->
+	    channel_other_started(HSData0, Channel, PreOtherFlags,
+				  Node, Version);
+	{PreOtherFlags,Node,Version} ->
+	    handshake_other_started(HSData0, PreOtherFlags, Node, Version)
+    end;
+
+handshake_other_started(OldHsData) when element(1,OldHsData) =:= hs_data ->
+    handshake_other_started(convert_old_hsdata(OldHsData)).
 
-handshake_other_started(#hs_data{request_type=ReqType}=HSData0) ->
-    {PreOtherFlags,Node,Version} = recv_name(HSData0),
+handshake_other_started(#hs_data{request_type=ReqType}=HSData0,
+			PreOtherFlags, Node, Version) ->
     PreThisFlags = make_this_flags(ReqType, Node),
     {ThisFlags, OtherFlags} = adjust_flags(PreThisFlags,
 					   PreOtherFlags),
@@ -143,10 +182,49 @@ handshake_other_started(#hs_data{request_type=ReqType}=HSData0) ->
     ChallengeB = recv_challenge_reply(HSData, ChallengeA, MyCookie),
     send_challenge_ack(HSData, gen_digest(ChallengeB, HisCookie)),
     ?debug({dist_util, self(), accept_connection, Node}),
-    connection(HSData);
+    connection(HSData).
 
-handshake_other_started(OldHsData) when element(1,OldHsData) =:= hs_data ->
-    handshake_other_started(convert_old_hsdata(OldHsData)).
+%%
+%% An extra channel of a connection that the other node is setting
+%% up. The channel is authenticated like any connection, registered
+%% in the emulator, and handed over to the process setting up the
+%% connection. This process then stays around as the owner of the
+%% channel until the connection goes down.
+%%
+channel_other_started(#hs_data{kernel_pid=Kernel,
+			       request_type=ReqType}=HSData0,
+		      Channel, PreOtherFlags, Node, Version) ->
+    PreThisFlags = make_this_flags(ReqType, Node),
+    {ThisFlags, OtherFlags} = adjust_flags(PreThisFlags,
+					   PreOtherFlags),
+    HSData = HSData0#hs_data{this_flags=ThisFlags,
+			     other_flags=OtherFlags,
+			     other_version=Version,
+			     other_node=Node,
+			     other_started=true},
+    is_allowed(HSData),
+    Owner = case channel_owner(Kernel, Node) of
+		{ok, Pid} when Channel >= 1, Channel < ?DIST_MAX_CHANNELS ->
+		    Pid;
+		_ ->
+		    send_status(HSData, nok),
+		    ?shutdown2(Node, {channel_other_started, no_connection})
+	    end,
+    send_status(HSData, ok),
+    {MyCookie,HisCookie} = get_cookies(Node),
+    ChallengeA = gen_challenge(),
+    send_challenge(HSData, ChallengeA),
+    reset_timer(HSData#hs_data.timer),
+    ChallengeB = recv_challenge_reply(HSData, ChallengeA, MyCookie),
+    send_challenge_ack(HSData, gen_digest(ChallengeB, HisCookie)),
+    Ref = erlang:monitor(process, Owner),
+    do_setchannel(HSData, Channel),
+    cancel_timer(HSData#hs_data.timer),
+    Owner ! {self(), {dist_channel, Channel, HSData#hs_data.socket}},
+    receive
+	{'DOWN', Ref, process, Owner, _} ->
+	    ?shutdown2(Node, connection_closed)
+    end.
 
 
 %%
@@ -346,7 +424,16 @@ convert_old_hsdata({hs_data, KP, ON, TN, S, T, TF, A, OV, OF, OS, FS, FR,
        this_flags = TF, allowed = A, other_version = OV, other_flags = OF,
        other_started = OS, f_send = FS, f_recv = FR, f_setopts_pre_nodeup = FS_PRE,
        f_setopts_post_nodeup = FS_POST, f_getll = FG, f_address = FA,
-       mf_tick = MFT, mf_getstat = MFG, request_type = RT}.
+       mf_tick = MFT, mf_getstat = MFG, request_type = RT};
+convert_old_hsdata({hs_data, KP, ON, TN, S, T, TF, A, OV, OF, OS, FS, FR,
+		    FS_PRE, FS_POST, FG, FA, MFT, MFG, RT, MFS, MFGO}) ->
+    #hs_data{
+       kernel_pid = KP, other_node = ON, this_node = TN, socket = S, timer = T,
+       this_flags = TF, allowed = A, other_version = OV, other_flags = OF,
+       other_started = OS, f_send = FS, f_recv = FR, f_setopts_pre_nodeup = FS_PRE,
+       f_setopts_post_nodeup = FS_POST, f_getll = FG, f_address = FA,
+       mf_tick = MFT, mf_getstat = MFG, request_type = RT,
+       mf_setopts = MFS, mf_getopts = MFGO}.
 
 
 %% --------------------------------------------------------------
@@ -358,6 +445,7 @@ connection(#hs_data{other_node = Node,
 		    f_address = FAddress,
 		    f_setopts_pre_nodeup = FPreNodeup,
 		    f_setopts_post_nodeup = FPostNodeup}= HSData) ->
+    Channels = setup_channels(HSData), % Succeeds or exits the process.
     cancel_timer(HSData#hs_data.timer),
     PType = publish_type(HSData#hs_data.other_flags), 
     case FPreNodeup(Socket) of
@@ -365,8 +453,8 @@ connection(#hs_data{other_node = Node,
 	    do_setnode(HSData), % Succeeds or exits the process.
 	    Address = FAddress(Socket,Node),
 	    mark_nodeup(HSData,Address),
-	    case FPostNodeup(Socket) of
-		ok ->
+	    case lists:usort([FPostNodeup(S) || S <- [Socket|Channels]]) of
+		[ok] ->
 		    con_loop({HSData#hs_data.kernel_pid,
 			      Node,
 			      Socket,
@@ -383,6 +471,144 @@ connection(#hs_data{other_node = Node,
 	    ?shutdown(Node)
     end.
 
+%% --------------------------------------------------------------
+%% Extra channels of the connection.
+%% The number of channels is negotiated over the connection once
+%% both nodes are authenticated. The node that set up the connection
+%% then opens one more connection per extra channel and registers
+%% them in the emulator, and the other node waits for its accepting
+%% processes to do the same, before the connection is set up.
+%% Returns the sockets of the extra channels.
+%% --------------------------------------------------------------
+
+setup_channels(#hs_data{this_flags = ThisFlags,
+			other_flags = OtherFlags} = HSData)
+  when ThisFlags band OtherFlags band ?DFLAG_MULTI_CHANNEL =/= 0 ->
+    case negotiate_channels(HSData) of
+	1 ->
+	    [];
+	N when HSData#hs_data.other_started ->
+	    wait_channels(HSData, lists:seq(1, N-1), []);
+	N ->
+	    [connect_channel(HSData, Channel) || Channel <- lists:seq(1, N-1)]
+    end;
+setup_channels(_HSData) ->
+    [].
+
+negotiate_channels(#hs_data{other_started = false,
+			    socket = Socket,
+			    other_node = Node,
+			    f_send = FSend,
+			    f_recv = FRecv} = HSData) ->
+    Wanted = case HSData#hs_data.f_connect_channel of
+		 undefined -> 1;
+		 _ -> dist_channels()
+	     end,
+    _ = ?to_port(FSend, Socket, [$C, Wanted]),
+    reset_timer(HSData#hs_data.timer),
+    case FRecv(Socket, 0, infinity) of
+	{ok, [$C, N]} when N >= 1, N =< Wanted ->
+	    N;
+	Other ->
+	    ?shutdown2(Node, {negotiate_channels_failed, Other})
+    end;
+negotiate_channels(#hs_data{other_started = true,
+			    socket = Socket,
+			    other_node = Node,
+			    f_send = FSend,
+			    f_recv = FRecv} = HSData) ->
+    case FRecv(Socket, 0, infinity) of
+	{ok, [$C, Wanted]} when Wanted >= 1 ->
+	    N = min(Wanted, dist_channels()),
+	    _ = ?to_port(FSend, Socket, [$C, N]),
+	    reset_timer(HSData#hs_data.timer),
+	    N;
+	Other ->
+	    ?shutdown2(Node, {negotiate_channels_failed, Other})
+    end.
+
+dist_channels() ->
+    case application:get_env(kernel, dist_channels) of
+	{ok, N} when is_integer(N), N >= 1 ->
+	    min(N, ?DIST_MAX_CHANNELS);
+	_ ->
+	    1
+    end.
+
+connect_channel(#hs_data{other_node = Node,
+			 this_node = MyNode,
+			 this_flags = Flags,
+			 other_version = Version,
+			 f_send = FSend,
+			 f_recv = FRecv,
+			 f_connect_channel = FConnect} = HSData0,
+		Channel) ->
+    reset_timer(HSData0#hs_data.timer),
+    Socket = case FConnect() of
+		 {ok, S} -> S;
+		 Error -> ?shutdown2(Node, {connect_channel_failed, Error})
+	     end,
+    HSData = HSData0#hs_data{socket = Socket},
+    _ = ?to_port(FSend, Socket, [$c, ?int16(Version), ?int32(Flags),
+				 Channel, atom_to_list(MyNode)]),
+    case FRecv(Socket, 0, infinity) of
+	{ok, "sok"} -> ok;
+	Other -> ?shutdown2(Node, {connect_channel_failed, Other})
+    end,
+    {_, ChallengeA} = recv_challenge(HSData),
+    MyChallenge = gen_challenge(),
+    {MyCookie,HisCookie} = get_cookies(Node),
+    send_challenge_reply(HSData, MyChallenge,
+			 gen_digest(ChallengeA, HisCookie)),
+    reset_timer(HSData#hs_data.timer),
+    recv_challenge_ack(HSData, MyChallenge, MyCookie),
+    do_setchannel(HSData, Channel),
+    Socket.
+
+wait_channels(_HSData, [], Sockets) ->
+    Sockets;
+wait_channels(HSData, Channels, Sockets) ->
+    receive
+	{_Pid, {dist_channel, Channel, Socket}} ->
+	    case lists:member(Channel, Channels) of
+		true ->
+		    reset_timer(HSData#hs_data.timer),
+		    wait_channels(HSData, lists:delete(Channel, Channels),
+				  [Socket|Sockets]);
+		false ->
+		    ?shutdown2(HSData#hs_data.other_node,
+			       {wait_channels_failed, Channel})
+	    end
+    end.
+
+%% No error return; either succeeds or terminates the process.
+do_setchannel(#hs_data{other_node = Node, socket = Socket,
+		       other_flags = Flags, other_version = Version,
+		       f_setopts_pre_nodeup = FPreNodeup,
+		       f_getll = GetLL}, Channel) ->
+    case FPreNodeup(Socket) of
+	ok -> ok;
+	_ -> ?shutdown2(Node, {setchannel_failed, Channel})
+    end,
+    case GetLL(Socket) of
+	{ok,Port} ->
+	    case (catch erlang:setnode(Node, Port,
+				       {Flags, Version, Channel})) of
+		{'EXIT', Reason} ->
+		    ?shutdown2(Node, {setchannel_failed, Reason});
+		_ ->
+		    ok
+	    end;
+	_ ->
+	    ?shutdown2(Node, {setchannel_failed, no_port})
+    end.
+
+channel_owner(Kernel, Node) ->
+    Kernel ! {self(), {channel_owner, Node}},
+    receive
+	{Kernel, {channel_owner, Reply}} -> Reply
+    end.
+
 %% Generate a message digest from Challenge number and Cookie	
 gen_digest(Challenge, Cookie) when is_integer(Challenge), is_atom(Cookie) ->
     erlang:md5([atom_to_list(Cookie)|integer_to_list(Challenge)]).
@@ -578,6 +804,10 @@ recv_name(#hs_data{socket = Socket, f_recv = Recv}) ->
 get_name([$n,VersionA, VersionB, Flag1, Flag2, Flag3, Flag4 | OtherNode]) ->
     {?u32(Flag1, Flag2, Flag3, Flag4), list_to_atom(OtherNode), 
      ?u16(VersionA,VersionB)};
+get_name([$c,VersionA, VersionB, Flag1, Flag2, Flag3, Flag4, Channel
+	  | OtherNode]) ->
+    {channel, Channel, ?u32(Flag1, Flag2, Flag3, Flag4),
+     list_to_atom(OtherNode), ?u16(VersionA,VersionB)};
 get_name(Data) ->
     ?shutdown(Data).
 
@@ -212,6 +212,7 @@ do_accept(Driver, Kernel, AcceptPid, Socket, MyNode, Allowed, SetupTime) ->
 					   [{active, true},
 					    {deliver, port},
 					    {packet, 4},
+					    binary,
 					    nodelay()])
 		      end,
 		      f_getll = fun(S) ->
@@ -323,6 +324,7 @@ do_setup(Driver, Kernel, Node, Type, MyNode, LongOrShortNames, SetupTime) ->
 					 [{active, true},
 					  {deliver, port},
 					  {packet, 4},
+					  binary,
 					  nodelay()])
 			      end,
 
@@ -339,7 +341,14 @@ do_setup(Driver, Kernel, Node, Type, MyNode, LongOrShortNames, SetupTime) ->
 			      mf_getstat = fun ?MODULE:getstat/1,
 			      request_type = Type,
 			      mf_setopts = fun ?MODULE:setopts/2,
-			      mf_getopts = fun ?MODULE:getopts/2
+			      mf_getopts = fun ?MODULE:getopts/2,
+			      f_connect_channel =
+			      fun() ->
+				      Driver:connect(
+					Ip, TcpPort,
+					connect_options([{active, false},
+							 {packet, 2}]))
+			      end
 			     },
 			    dist_util:handshake_we_started(HSData);
 			_ ->
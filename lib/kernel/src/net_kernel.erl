@@ -730,6 +730,22 @@ handle_info({SetupPid, {is_pending, Node}}, State) ->
     SetupPid ! {self(), {is_pending, Reply}},
     {noreply, State};
 
+%%
+%% An extra channel of a connection being set up by the other node
+%% asks which process is setting up the connection.
+%%
+handle_info({ChannelPid, {channel_owner, Node}}, State) ->
+    Reply = case ets:lookup(sys_dist, Node) of
+		[#connection{state = pending, owner = Owner}] ->
+		    {ok, Owner};
+		[#connection{state = up_pending, pending_owner = Owner}] ->
+		    {ok, Owner};
+		_ ->
+		    error
+	    end,
+    ChannelPid ! {self(), {channel_owner, Reply}},
+    {noreply, State};
+
 
 %%
 %% Handle different types of process terminations.
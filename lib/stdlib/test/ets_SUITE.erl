@@ -79,6 +79,7 @@
 -export([ets_all/1]).
 -export([memory_check_summary/1]).
 -export([take/1]).
+-export([shared_subterms/1]).
 
 -export([init_per_testcase/2, end_per_testcase/2]).
 %% Convenience for manual testing
@@ -102,7 +103,8 @@
 	 do_heavy_concurrent/1, tab2file2_do/2, exit_large_table_owner_do/2,
          types_do/1, sleeper/0, memory_do/1, update_counter_with_default_do/1,
 	 update_counter_table_growth_do/1,
-	 ms_tracee_dummy/1, ms_tracee_dummy/2, ms_tracee_dummy/3, ms_tracee_dummy/4
+	 ms_tracee_dummy/1, ms_tracee_dummy/2, ms_tracee_dummy/3, ms_tracee_dummy/4,
+	 shared_subterms_do/1
 	]).
 
 -export([t_select_reverse/1]).
@@ -158,6 +160,7 @@ all() ->
      otp_9423,
      ets_all,
      take,
+     shared_subterms,
 
      memory_check_summary]. % MUST BE LAST
 
@@ -5588,6 +5591,46 @@ take(Config) when is_list(Config) ->
     ets:delete(T3),
     ok.
 
+%% Objects with shared subterms are stored with the sharing intact.
+%% Flattened, Shared would be 3*2^30 words.
+shared_subterms(Config) when is_list(Config) ->
+    repeat_for_opts(shared_subterms_do, [[set,ordered_set], write_concurrency]).
+
+shared_subterms_do(Opts) ->
+    Shared = shared_term(30),
+    Size = erts_debug:size(Shared),
+    T = ets_new(shared, Opts),
+    ets:insert(T, {key, Shared, 1.0}),
+    [{key, S1, 1.0}] = ets:lookup(T, key),
+    Size = erts_debug:size(S1),
+    [{key, S2, 1.0}] = ets:match_object(T, {key, '_', '_'}),
+    Size = erts_debug:size(S2),
+    [{key, S3, 1.0}] = ets:select(T, [{'_', [], ['$_']}]),
+    Size = erts_debug:size(S3),
+
+    %% The whole object is copied again when an element is updated.
+    Words = ets:info(T, memory),
+    true = ets:update_element(T, key, {3, Shared}),
+    true = ets:info(T, memory) - Words =< Size,
+    [{key, S4, S5}] = ets:lookup(T, key),
+    Size = erts_debug:size(S4),
+    Size = erts_debug:size(S5),
+
+    %% A shared float must not be updated in place.
+    F = float(length(Opts)) + 0.5,
+    ets:insert(T, {float, F, F, {F}}),
+    true = ets:update_element(T, float, {2, 2.5}),
+    [{float, 2.5, F, {F}}] = ets:lookup(T, float),
+
+    %% Literals are never shared with the table.
+    ets:insert(T, {literal, {a,b,c}, {a,b,c}}),
+    [{literal, {a,b,c}, {a,b,c}}] = ets:lookup(T, literal),
+    ets:delete(T),
+    ok.
+
+shared_term(0) -> [];
+shared_term(N) -> T = shared_term(N-1), {T,T}.
+
 
 %%
 %% Utility functions: